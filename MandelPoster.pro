@@ -9,12 +9,16 @@ MOC_DIR = build/
 # === Frameworks and compiler
 TEMPLATE = app
 QT += gui
+QT += network
 QT += widgets
 QT += xml
 CONFIG += c++17
 CONFIG += release
 CONFIG += silent
 
+# zlib (streaming PNG output)
+LIBS += -lz
+
 # Don't allow deprecated versions of methods (before Qt 6.8)
 DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060800
 
@@ -32,8 +36,14 @@ HEADERS += shared/StringHelper.h
 SOURCES += shared/StringHelper.cpp
 
 # Specific classes
+HEADERS += src/AnimationRenderer.h
+SOURCES += src/AnimationRenderer.cpp
 HEADERS += src/Application.h
 SOURCES += src/Application.cpp
+HEADERS += src/AutoDepthProbe.h
+SOURCES += src/AutoDepthProbe.cpp
+HEADERS += src/CachePrefetcher.h
+SOURCES += src/CachePrefetcher.cpp
 HEADERS += src/Deploy.h
 HEADERS += src/Fractal.h
 SOURCES += src/Fractal.cpp
@@ -45,9 +55,31 @@ HEADERS += src/FractalWidget.h
 SOURCES += src/FractalWidget.cpp
 HEADERS += src/FractalWorker.h
 SOURCES += src/FractalWorker.cpp
+HEADERS += src/HeadlessRenderer.h
+SOURCES += src/HeadlessRenderer.cpp
+HEADERS += src/TileCacheEncoding.h
+SOURCES += src/TileCacheEncoding.cpp
+HEADERS += src/TileCacheFile.h
+SOURCES += src/TileCacheFile.cpp
 SOURCES += src/main.cpp
 HEADERS += src/MainWindow.h
 SOURCES += src/MainWindow.cpp
+HEADERS += src/PngStreamWriter.h
+SOURCES += src/PngStreamWriter.cpp
 HEADERS += src/Preferences.h
 SOURCES += src/Preferences.cpp
+HEADERS += src/RecolorEngine.h
+SOURCES += src/RecolorEngine.cpp
+HEADERS += src/RenderDaemon.h
+SOURCES += src/RenderDaemon.cpp
+HEADERS += src/RenderJournal.h
+SOURCES += src/RenderJournal.cpp
+HEADERS += src/ShardMerger.h
+SOURCES += src/ShardMerger.cpp
+HEADERS += src/WorkQueueClient.h
+SOURCES += src/WorkQueueClient.cpp
+HEADERS += src/WorkQueueProtocol.h
+SOURCES += src/WorkQueueProtocol.cpp
+HEADERS += src/WorkQueueServer.h
+SOURCES += src/WorkQueueServer.cpp
 
@@ -0,0 +1,863 @@
+// AnimationRenderer.cpp
+// Class implementation
+
+// Project includes
+#include "AnimationRenderer.h"
+#include "CallTracer.h"
+#include "Fractal.h"
+#include "FractalImage.h"
+#include "MessageLogger.h"
+#include "Preferences.h"
+#include "StringHelper.h"
+
+// Qt includes
+#include <QDir>
+#include <QFileInfo>
+#include <QTextStream>
+
+// System includes
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Frames rendered at the same time, unless the animation says otherwise
+#define DEFAULT_PARALLEL_FRAMES 2
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+AnimationRenderer::AnimationRenderer()
+{
+    CALL_IN("");
+
+    m_Width = 0;
+    m_Height = 0;
+    m_NumberOfFrames = 0;
+    m_IsExponentialMap = false;
+    m_StripWidth = 0;
+    m_StripHeight = 0;
+    m_LogRadiusMin = 0;
+    m_LogRadiusMax = 0;
+    m_IsStreaming = false;
+    m_NextFrameToStream = 0;
+    m_ParallelFrames = DEFAULT_PARALLEL_FRAMES;
+    m_ThreadsPerFrame = 1;
+    m_IsDispatching = false;
+    m_IsDispatchNeeded = false;
+    m_FramesDone = 0;
+    m_FramesRecolored = 0;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+AnimationRenderer::~AnimationRenderer()
+{
+    CALL_IN("");
+
+    for (FractalImage * image : m_Images)
+    {
+        image -> Stop();
+        delete image;
+    }
+    qDeleteAll(m_Keyframes);
+
+    CALL_OUT("");
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start rendering
+bool AnimationRenderer::Start(const QString & mcrFilename,
+    const int mcThreads)
+{
+    CALL_IN(QString("mcrFilename=%1, mcThreads=%2")
+        .arg(CALL_SHOW(mcrFilename),
+             CALL_SHOW(mcThreads)));
+
+    if (!ReadAnimation(mcrFilename))
+    {
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Output
+    if (m_IsStreaming)
+    {
+        if (!m_Stream.open(stdout, QIODevice::WriteOnly))
+        {
+            m_LastError = tr("Could not write to stdout: %1")
+                .arg(m_Stream.errorString());
+            CALL_OUT(m_LastError);
+            return false;
+        }
+    } else if (!QDir().mkpath(m_OutputDirectory))
+    {
+        m_LastError = tr("Could not create directory \"%1\".")
+            .arg(m_OutputDirectory);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Zoom from a single exponential map
+    if (m_IsExponentialMap)
+    {
+        if (!StartStrip(mcThreads))
+        {
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        CALL_OUT("");
+        return true;
+    }
+
+    // Images to render with (threads are shared among them)
+    m_ParallelFrames = qBound(1, m_ParallelFrames, m_NumberOfFrames);
+    m_ThreadsPerFrame = qMax(1, mcThreads / m_ParallelFrames);
+    for (int index = 0; index < m_ParallelFrames; index++)
+    {
+        FractalImage * image = new FractalImage();
+        connect (image, SIGNAL(Finished()),
+            this, SLOT(FrameFinished()));
+        m_Images << image;
+    }
+
+    // Parameters of all frames (so we can tell which ones only need to be
+    // recolored)
+    m_FrameParameters.clear();
+    for (int frame = 0; frame < m_NumberOfFrames; frame++)
+    {
+        m_FrameParameters << GetFrameParameters(frame);
+    }
+
+    // Go
+    m_PendingFrames.clear();
+    for (int frame = 0; frame < m_NumberOfFrames; frame++)
+    {
+        m_PendingFrames << frame;
+    }
+    m_Timer.start();
+    Log(tr("Rendering %1 frames of \"%2\" (%3x%4), %5 at a time on %6 "
+        "threads each")
+        .arg(m_NumberOfFrames)
+        .arg(m_Name)
+        .arg(m_Width)
+        .arg(m_Height)
+        .arg(m_ParallelFrames)
+        .arg(m_ThreadsPerFrame));
+    DispatchFrames();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Last error
+QString AnimationRenderer::GetLastError() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_LastError;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Frame done
+void AnimationRenderer::FrameFinished()
+{
+    CALL_IN("");
+
+    FractalImage * image = qobject_cast < FractalImage * >(sender());
+    if (!m_ImageToFrame.contains(image))
+    {
+        CALL_OUT("Not rendering a frame");
+        return;
+    }
+    const int frame = m_ImageToFrame.take(image);
+    WriteFrame(frame, image -> GetImage());
+    m_FramesDone++;
+    Log(tr("Frame %1 done (%2 of %3)")
+        .arg(frame)
+        .arg(m_FramesDone)
+        .arg(m_NumberOfFrames));
+
+    // Image is free for the next frame
+    DispatchFrames();
+
+    // All done
+    if (m_FramesDone == m_NumberOfFrames)
+    {
+        if (m_IsStreaming)
+        {
+            m_Stream.close();
+        }
+        Log(tr("Done: %1 frames (%2 recolored from cache) in %3 ms")
+            .arg(m_NumberOfFrames)
+            .arg(m_FramesRecolored)
+            .arg(m_Timer.elapsed()));
+        emit Finished();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read animation file
+bool AnimationRenderer::ReadAnimation(const QString & mcrFilename)
+{
+    CALL_IN(QString("mcrFilename=%1")
+        .arg(CALL_SHOW(mcrFilename)));
+
+    QFile file(mcrFilename);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        m_LastError = tr("Could not open \"%1\": %2")
+            .arg(mcrFilename,
+                 file.errorString());
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    const QFileInfo file_info(mcrFilename);
+    const QDir directory = file_info.absoluteDir();
+    m_Name = file_info.completeBaseName();
+    m_OutputDirectory = directory.absoluteFilePath(m_Name);
+
+    // Lines
+    QList < QPair < int, QString > > keyframes;
+    const QStringList lines = QString::fromUtf8(file.readAll()).split('\n');
+    for (const QString & line : lines)
+    {
+        const QString trimmed_line = line.trimmed();
+        if (trimmed_line.isEmpty() ||
+            trimmed_line.startsWith('#'))
+        {
+            continue;
+        }
+        const int separator = trimmed_line.indexOf('=');
+        if (separator < 0)
+        {
+            m_LastError = tr("Invalid line \"%1\"").arg(trimmed_line);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        const QString key = trimmed_line.left(separator).trimmed();
+        const QString value = trimmed_line.mid(separator + 1).trimmed();
+        bool is_number = true;
+        if (key == "keyframe")
+        {
+            const int space = value.indexOf(' ');
+            const int frame = value.left(space).toInt(&is_number);
+            if (space < 0 ||
+                !is_number ||
+                frame < 0)
+            {
+                m_LastError = tr("Invalid keyframe \"%1\"").arg(value);
+                CALL_OUT(m_LastError);
+                return false;
+            }
+            keyframes << qMakePair(frame,
+                directory.absoluteFilePath(value.mid(space + 1).trimmed()));
+        } else if (key == "width")
+        {
+            m_Width = value.toInt(&is_number);
+        } else if (key == "height")
+        {
+            m_Height = value.toInt(&is_number);
+        } else if (key == "output")
+        {
+            m_IsStreaming = (value == "-");
+            m_OutputDirectory = directory.absoluteFilePath(value);
+        } else if (key == "exponential map")
+        {
+            m_IsExponentialMap = (value == "yes");
+            is_number = (value == "yes" || value == "no");
+        } else if (key == "strip width")
+        {
+            m_StripWidth = value.toInt(&is_number);
+            is_number = is_number && m_StripWidth >= 0;
+        } else if (key == "parallel frames")
+        {
+            m_ParallelFrames = value.toInt(&is_number);
+            is_number = is_number && m_ParallelFrames >= 1;
+        } else
+        {
+            m_LastError = tr("Unknown key \"%1\"").arg(key);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        if (!is_number)
+        {
+            m_LastError = tr("Invalid %1 \"%2\"")
+                .arg(key,
+                     value);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+    }
+
+    // Keyframes, in order
+    if (keyframes.size() < 2)
+    {
+        m_LastError = tr("Animation needs at least two keyframes.");
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    std::sort(keyframes.begin(), keyframes.end());
+    for (int index = 0; index < keyframes.size(); index++)
+    {
+        if (index > 0 &&
+            keyframes[index].first == keyframes[index - 1].first)
+        {
+            m_LastError = tr("There are two keyframes for frame %1.")
+                .arg(keyframes[index].first);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        if (!QFile::exists(keyframes[index].second))
+        {
+            m_LastError = tr("Fractal \"%1\" does not exist.")
+                .arg(keyframes[index].second);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        Fractal * keyframe = new Fractal();
+        if (!keyframe -> FromFile(keyframes[index].second))
+        {
+            delete keyframe;
+            m_LastError = tr("Fractal \"%1\" could not be read.")
+                .arg(keyframes[index].second);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        m_KeyframeNumbers << keyframes[index].first;
+        m_Keyframes << keyframe;
+    }
+    m_NumberOfFrames = m_KeyframeNumbers.last() + 1;
+
+    // Resolution
+    if (m_Width <= 0 ||
+        m_Height <= 0)
+    {
+        if (!m_Keyframes.first() -> HasFixedResolution())
+        {
+            m_LastError = tr("Animation needs a width and height (or the "
+                "first keyframe a fixed resolution).");
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        const QPair < int, int > resolution =
+            m_Keyframes.first() -> GetFixedResolution();
+        m_Width = resolution.first;
+        m_Height = resolution.second;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Fractal of a frame
+void AnimationRenderer::GetFrameFractal(const int mcFrame,
+    Fractal & mrFractal) const
+{
+    CALL_IN(QString("mcFrame=%1, mrFractal=...")
+        .arg(CALL_SHOW(mcFrame)));
+
+    // Keyframes around the frame (frames before the first one look like it)
+    int segment = 0;
+    while (segment < m_KeyframeNumbers.size() - 2 &&
+        m_KeyframeNumbers[segment + 1] <= mcFrame)
+    {
+        segment++;
+    }
+    const int start_frame = m_KeyframeNumbers[segment];
+    const int end_frame = m_KeyframeNumbers[segment + 1];
+    mrFractal.Interpolate(m_Keyframes[segment], m_Keyframes[segment + 1],
+        double(mcFrame - start_frame) / (end_frame - start_frame));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Parameters of a frame
+QHash < QString, QString > AnimationRenderer::GetFrameParameters(
+    const int mcFrame) const
+{
+    CALL_IN(QString("mcFrame=%1")
+        .arg(CALL_SHOW(mcFrame)));
+
+    Fractal fractal;
+    GetFrameFractal(mcFrame, fractal);
+
+    // Frames are kept in memory only; images need their values to be
+    // recolored
+    QHash < QString, QString > parameters =
+        fractal.GetParametersForResolution(m_Width, m_Height,
+            Preferences::Instance());
+    parameters["use fixed resolution"] = "yes";
+    parameters["fixed resolution width"] = QString("%1").arg(m_Width);
+    parameters["fixed resolution height"] = QString("%1").arg(m_Height);
+    parameters["storage render journal"] = "no";
+    parameters["storage save picture"] = "no";
+    parameters["storage save statistics"] = "no";
+    parameters["storage save cache data to memory"] = "yes";
+    parameters["storage save cache data to disk"] = "no";
+    parameters["render threads"] = QString("%1").arg(m_ThreadsPerFrame);
+    parameters["render work queue address"] = "";
+
+    CALL_OUT("");
+    return parameters;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start rendering the exponential map
+bool AnimationRenderer::StartStrip(const int mcThreads)
+{
+    CALL_IN(QString("mcThreads=%1")
+        .arg(CALL_SHOW(mcThreads)));
+
+    // Half the width of every frame in the plane
+    m_FrameLogHalfWidth.clear();
+    double log_half_width_min = INFINITY;
+    double log_half_width_max = -INFINITY;
+    int deepest_frame = 0;
+    for (int frame = 0; frame < m_NumberOfFrames; frame++)
+    {
+        Fractal fractal;
+        GetFrameFractal(frame, fractal);
+        const QHash < QString, QString > range =
+            fractal.GetRangeForResolution(m_Width, m_Height);
+        const long double half_width =
+            (StringHelper::ToLongDouble(range["real max"]) -
+             StringHelper::ToLongDouble(range["real min"])) / 2;
+        const double log_half_width = log(double(half_width));
+        m_FrameLogHalfWidth << log_half_width;
+        if (log_half_width < log_half_width_min)
+        {
+            log_half_width_min = log_half_width;
+            deepest_frame = frame;
+        }
+        log_half_width_max = qMax(log_half_width_max, log_half_width);
+    }
+
+    // Zoom center
+    const QHash < QString, QString > end_range =
+        m_Keyframes.last() -> GetRange();
+    const long double center_real =
+        (StringHelper::ToLongDouble(end_range["real min"]) +
+         StringHelper::ToLongDouble(end_range["real max"])) / 2;
+    const long double center_imag =
+        (StringHelper::ToLongDouble(end_range["imag min"]) +
+         StringHelper::ToLongDouble(end_range["imag max"])) / 2;
+
+    // Only the zoom can be animated: all keyframes need the same center (to
+    // within a pixel of the deepest frame)...
+    const long double pixel_size =
+        2 * expl(log_half_width_min) / m_Width;
+    for (const Fractal * keyframe : m_Keyframes)
+    {
+        const QHash < QString, QString > range = keyframe -> GetRange();
+        const long double keyframe_center_real =
+            (StringHelper::ToLongDouble(range["real min"]) +
+             StringHelper::ToLongDouble(range["real max"])) / 2;
+        const long double keyframe_center_imag =
+            (StringHelper::ToLongDouble(range["imag min"]) +
+             StringHelper::ToLongDouble(range["imag max"])) / 2;
+        if (fabsl(keyframe_center_real - center_real) > pixel_size ||
+            fabsl(keyframe_center_imag - center_imag) > pixel_size)
+        {
+            m_LastError = tr("Exponential map needs all keyframes to have "
+                "the same center, but \"%1\" doesn't.")
+                .arg(keyframe -> GetName());
+            CALL_OUT(m_LastError);
+            return false;
+        }
+    }
+
+    // ...and the same parameters apart from the range, depth and precision
+    QList < QString > zoom_parameters;
+    zoom_parameters << "name" << "real min" << "real max" << "imag min" <<
+        "imag max" << "depth" << "precision" << "aspect ratio" <<
+        "use fixed resolution" << "fixed resolution width" <<
+        "fixed resolution height";
+    QHash < QString, QString > first_parameters =
+        m_Keyframes.first() -> GetAllParameters();
+    for (const QString & parameter : zoom_parameters)
+    {
+        first_parameters.remove(parameter);
+    }
+    for (const Fractal * keyframe : m_Keyframes)
+    {
+        QHash < QString, QString > parameters =
+            keyframe -> GetAllParameters();
+        for (const QString & parameter : zoom_parameters)
+        {
+            parameters.remove(parameter);
+        }
+        if (parameters != first_parameters)
+        {
+            m_LastError = tr("Exponential map can only animate the zoom, "
+                "but \"%1\" differs from \"%2\" in other parameters.")
+                .arg(keyframe -> GetName(),
+                     m_Keyframes.first() -> GetName());
+            CALL_OUT(m_LastError);
+            return false;
+        }
+    }
+
+    // Map reaches from the corners of the widest frame to half a pixel of
+    // the narrowest one; its width gives the corners of frames about one
+    // sample per pixel, and its rows are as high as they are wide
+    const double aspect_ratio = double(m_Height) / m_Width;
+    m_LogRadiusMax =
+        log_half_width_max + 0.5 * log(1 + aspect_ratio * aspect_ratio);
+    m_LogRadiusMin = log_half_width_min - log(double(m_Width));
+    if (m_StripWidth == 0)
+    {
+        m_StripWidth = int(ceil(M_PI * hypot(m_Width, m_Height)));
+    }
+    m_StripHeight = qMax(1, int(ceil(m_StripWidth *
+        (m_LogRadiusMax - m_LogRadiusMin) / (2 * M_PI))));
+
+    // Where the pixels of a frame are in the map (the same for every frame,
+    // except for a vertical offset; workers sample pixels at their corner)
+    m_PixelStripX.resize(m_Width * m_Height);
+    m_PixelLogDistance.resize(m_Width * m_Height);
+    for (int y = 0; y < m_Height; y++)
+    {
+        for (int x = 0; x < m_Width; x++)
+        {
+            const double distance_x = (2 * (x + 0.5) - m_Width) / m_Width;
+            const double distance_y = (m_Height - 2 * (y + 0.5)) / m_Width;
+            double angle = atan2(distance_y, distance_x);
+            if (angle < 0)
+            {
+                angle += 2 * M_PI;
+            }
+            const int index = y * m_Width + x;
+            m_PixelStripX[index] = float(angle / (2 * M_PI) * m_StripWidth);
+            m_PixelLogDistance[index] = float(0.5 *
+                log(distance_x * distance_x + distance_y * distance_y));
+        }
+    }
+
+    // Parameters (deepest frame sets precision and depth)
+    QHash < QString, QString > parameters = m_Keyframes.first() ->
+        GetParametersForResolution(m_StripWidth, m_StripHeight,
+            Preferences::Instance());
+    parameters["projection"] = "log-polar";
+    parameters["log polar center real"] = StringHelper::ToString(center_real);
+    parameters["log polar center imag"] = StringHelper::ToString(center_imag);
+    parameters["log polar radius min"] =
+        QString::number(exp(m_LogRadiusMin), 'g', 17);
+    parameters["log polar radius max"] =
+        QString::number(exp(m_LogRadiusMax), 'g', 17);
+    Fractal deepest_fractal;
+    GetFrameFractal(deepest_frame, deepest_fractal);
+    parameters["precision"] = deepest_fractal.GetPrecision();
+    int depth = 0;
+    for (const Fractal * keyframe : m_Keyframes)
+    {
+        depth = qMax(depth, keyframe -> GetDepth());
+    }
+    parameters["depth"] = QString("%1").arg(depth);
+    parameters["use fixed resolution"] = "yes";
+    parameters["fixed resolution width"] = QString("%1").arg(m_StripWidth);
+    parameters["fixed resolution height"] =
+        QString("%1").arg(m_StripHeight);
+    parameters["storage render journal"] = "no";
+    parameters["storage save picture"] = "no";
+    parameters["storage save statistics"] = "no";
+    parameters["storage save cache data to memory"] = "no";
+    parameters["storage save cache data to disk"] = "no";
+    parameters["render threads"] = QString("%1").arg(mcThreads);
+    parameters["render work queue address"] = "";
+
+    // Go
+    FractalImage * image = new FractalImage();
+    connect (image, SIGNAL(Finished()),
+        this, SLOT(StripFinished()));
+    m_Images << image;
+    m_Timer.start();
+    Log(tr("Rendering exponential map of \"%1\" (%2x%3) for %4 frames")
+        .arg(m_Name)
+        .arg(m_StripWidth)
+        .arg(m_StripHeight)
+        .arg(m_NumberOfFrames));
+    image -> Render(parameters);
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Exponential map done
+void AnimationRenderer::StripFinished()
+{
+    CALL_IN("");
+
+    FractalImage * image = qobject_cast < FractalImage * >(sender());
+    if (!image)
+    {
+        CALL_OUT("No image");
+        return;
+    }
+    m_Strip = image -> GetImage().convertToFormat(QImage::Format_RGB32);
+    Log(tr("Exponential map done after %1 ms").arg(m_Timer.elapsed()));
+
+    // All frames come from it
+    for (int frame = 0; frame < m_NumberOfFrames; frame++)
+    {
+        WriteFrame(frame, ReprojectFrame(frame));
+        m_FramesDone++;
+    }
+    if (m_IsStreaming)
+    {
+        m_Stream.close();
+    }
+    Log(tr("Done: %1 frames from the exponential map in %2 ms")
+        .arg(m_NumberOfFrames)
+        .arg(m_Timer.elapsed()));
+    emit Finished();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Frame from the exponential map (bilinear; the map wraps around
+// horizontally)
+QImage AnimationRenderer::ReprojectFrame(const int mcFrame) const
+{
+    CALL_IN(QString("mcFrame=%1")
+        .arg(CALL_SHOW(mcFrame)));
+
+    QImage frame(m_Width, m_Height, QImage::Format_RGB32);
+    const double rows_per_log =
+        m_StripHeight / (m_LogRadiusMax - m_LogRadiusMin);
+    const double row_offset =
+        (m_LogRadiusMax - m_FrameLogHalfWidth[mcFrame]) * rows_per_log;
+    for (int y = 0; y < m_Height; y++)
+    {
+        QRgb * line = reinterpret_cast < QRgb * >(frame.scanLine(y));
+        for (int x = 0; x < m_Width; x++)
+        {
+            const int index = y * m_Width + x;
+
+            // Position in the map
+            const double strip_x = m_PixelStripX[index];
+            const double strip_y = qBound(0.,
+                row_offset - m_PixelLogDistance[index] * rows_per_log,
+                m_StripHeight - 1.);
+            const int x0 = int(floor(strip_x));
+            const double fraction_x = strip_x - x0;
+            const int column_0 = (x0 % m_StripWidth + m_StripWidth) %
+                m_StripWidth;
+            const int column_1 = (column_0 + 1) % m_StripWidth;
+            const int row_0 = int(strip_y);
+            const double fraction_y = strip_y - row_0;
+            const int row_1 = qMin(row_0 + 1, m_StripHeight - 1);
+
+            // Blend neighbors
+            const QRgb * strip_line_0 = reinterpret_cast < const QRgb * >(
+                m_Strip.constScanLine(row_0));
+            const QRgb * strip_line_1 = reinterpret_cast < const QRgb * >(
+                m_Strip.constScanLine(row_1));
+            const QRgb corners[4] = { strip_line_0[column_0],
+                strip_line_0[column_1], strip_line_1[column_0],
+                strip_line_1[column_1] };
+            const double weights[4] = {
+                (1 - fraction_x) * (1 - fraction_y),
+                fraction_x * (1 - fraction_y),
+                (1 - fraction_x) * fraction_y,
+                fraction_x * fraction_y };
+            double red = 0;
+            double green = 0;
+            double blue = 0;
+            for (int corner = 0; corner < 4; corner++)
+            {
+                red += weights[corner] * qRed(corners[corner]);
+                green += weights[corner] * qGreen(corners[corner]);
+                blue += weights[corner] * qBlue(corners[corner]);
+            }
+            line[x] = qRgb(int(red + 0.5), int(green + 0.5), int(blue + 0.5));
+        }
+    }
+
+    CALL_OUT("");
+    return frame;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Hand out frames to images that are idle
+void AnimationRenderer::DispatchFrames()
+{
+    CALL_IN("");
+
+    // Starting a frame may finish it (and get us here again)
+    if (m_IsDispatching)
+    {
+        m_IsDispatchNeeded = true;
+        CALL_OUT("Dispatching already");
+        return;
+    }
+    m_IsDispatching = true;
+    do
+    {
+        m_IsDispatchNeeded = false;
+        for (FractalImage * image : m_Images)
+        {
+            if (m_ImageToFrame.contains(image) ||
+                m_PendingFrames.isEmpty())
+            {
+                continue;
+            }
+
+            // Rather recolor a frame than calculate one (images that have
+            // rendered something before have its values in memory)
+            int frame = -1;
+            bool is_recolored = false;
+            for (const int pending_frame : m_PendingFrames)
+            {
+                if (m_ImagesWithValues.contains(image) &&
+                    !image -> WillParametersInvalidateCache(
+                        m_FrameParameters[pending_frame]))
+                {
+                    frame = pending_frame;
+                    is_recolored = true;
+                    break;
+                }
+            }
+
+            // Otherwise the first frame that no other image can recolor
+            for (int index = 0;
+                 frame < 0 && index < m_PendingFrames.size();
+                 index++)
+            {
+                const int pending_frame = m_PendingFrames[index];
+                bool can_be_recolored = false;
+                for (FractalImage * other_image : m_Images)
+                {
+                    if (other_image != image &&
+                        m_ImagesWithValues.contains(other_image) &&
+                        !other_image -> WillParametersInvalidateCache(
+                            m_FrameParameters[pending_frame]))
+                    {
+                        can_be_recolored = true;
+                        break;
+                    }
+                }
+                if (!can_be_recolored)
+                {
+                    frame = pending_frame;
+                }
+            }
+            if (frame < 0)
+            {
+                continue;
+            }
+
+            // Keep track of it before rendering (in case it's done right
+            // away)
+            m_PendingFrames.removeAll(frame);
+            m_ImageToFrame[image] = frame;
+            m_ImagesWithValues << image;
+            if (is_recolored)
+            {
+                m_FramesRecolored++;
+            }
+            image -> Render(m_FrameParameters[frame]);
+        }
+    } while (m_IsDispatchNeeded);
+    m_IsDispatching = false;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write a frame that is done (in order, if frames go to a stream)
+void AnimationRenderer::WriteFrame(const int mcFrame, const QImage & mcrImage)
+{
+    CALL_IN(QString("mcFrame=%1, mcrImage=%2")
+        .arg(CALL_SHOW(mcFrame),
+             CALL_SHOW(mcrImage)));
+
+    // Numbered pictures
+    if (!m_IsStreaming)
+    {
+        const QString filename = QString("%1/%2-%3.png")
+            .arg(m_OutputDirectory,
+                 m_Name)
+            .arg(mcFrame, 5, 10, QChar('0'));
+        if (!mcrImage.save(filename, "PNG"))
+        {
+            MessageLogger::Error(CALL_METHOD,
+                tr("Could not save \"%1\".").arg(filename));
+        }
+        CALL_OUT("");
+        return;
+    }
+
+    // Raw RGB, one frame after the other
+    m_FramesToStream[mcFrame] = mcrImage;
+    while (m_FramesToStream.contains(m_NextFrameToStream))
+    {
+        const QImage image = m_FramesToStream.take(m_NextFrameToStream)
+            .convertToFormat(QImage::Format_RGB888);
+        for (int y = 0; y < image.height(); y++)
+        {
+            m_Stream.write(
+                reinterpret_cast < const char * >(image.constScanLine(y)),
+                3 * image.width());
+        }
+        m_Stream.flush();
+        m_NextFrameToStream++;
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Progress messages (not to stdout if frames go there)
+void AnimationRenderer::Log(const QString & mcrMessage) const
+{
+    CALL_IN(QString("mcrMessage=%1")
+        .arg(CALL_SHOW(mcrMessage)));
+
+    QTextStream(m_IsStreaming ? stderr : stdout) << mcrMessage << Qt::endl;
+
+    CALL_OUT("");
+}
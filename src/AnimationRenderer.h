@@ -0,0 +1,168 @@
+// AnimationRenderer.h
+// Class definition
+
+// Renders the frames of an animation between keyframes (zooms, Julia
+// constant morphs, color cycling) without GUI. Frames are interpolated with
+// Fractal::Interpolate, and several frames are rendered at the same time,
+// each by its own FractalImage. A frame that only differs from the one its
+// image rendered last in coloring is recolored from that image's memory
+// cache instead of being calculated again.
+//
+// Animations are described by a file with "key=value" lines:
+//
+//   keyframe=<frame> <fractal file>
+//                              (at least two; relative to the animation file)
+//   width=<pixels>, height=<pixels>
+//                              (default: fixed resolution of the first
+//                              keyframe)
+//   output=<directory>         (numbered PNG frames; default: directory named
+//                              after the animation, next to it) or "-" (raw
+//                              24 bit RGB frames to stdout, e.g. for
+//                              "ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH")
+//   parallel frames=<number>   (default 2)
+//   exponential map=yes|no     (default no; see below)
+//   strip width=<pixels>       (default: enough for the frame diagonal)
+//
+// Zooms can be rendered as an exponential map instead: a single tall strip
+// in log-polar coordinates around the center of the last keyframe (x is
+// the angle, y the logarithm of the radius), from which all frames are
+// reprojected. Every region of the plane is then calculated once instead
+// of in every frame it appears in. Only the zoom can be animated then:
+// keyframes have to share their center (to within a pixel of the deepest
+// frame) and everything else but their depth and precision.
+
+#ifndef ANIMATIONRENDERER_H
+#define ANIMATIONRENDERER_H
+
+// Qt includes
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+// Forward declaration
+class Fractal;
+class FractalImage;
+
+// Class definition
+class AnimationRenderer
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    AnimationRenderer();
+
+    // Destructor
+    virtual ~AnimationRenderer();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Start rendering (threads are shared by the frames rendered at the same
+    // time)
+    bool Start(const QString & mcrFilename, const int mcThreads);
+
+    // Last error
+    QString GetLastError() const;
+
+signals:
+    // All frames done
+    void Finished();
+
+private slots:
+    // Frame done
+    void FrameFinished();
+
+    // Exponential map done
+    void StripFinished();
+
+private:
+    // Read animation file
+    bool ReadAnimation(const QString & mcrFilename);
+
+    // Fractal of a frame
+    void GetFrameFractal(const int mcFrame, Fractal & mrFractal) const;
+
+    // Parameters of a frame
+    QHash < QString, QString > GetFrameParameters(const int mcFrame) const;
+
+    // Start rendering the exponential map
+    bool StartStrip(const int mcThreads);
+
+    // Frame from the exponential map
+    QImage ReprojectFrame(const int mcFrame) const;
+
+    // Hand out frames to images that are idle
+    void DispatchFrames();
+
+    // Write frames that are done (in order, if they go to a stream)
+    void WriteFrame(const int mcFrame, const QImage & mcrImage);
+
+    // Progress messages (not to stdout if frames go there)
+    void Log(const QString & mcrMessage) const;
+
+    // Keyframes (sorted by frame)
+    QList < int > m_KeyframeNumbers;
+    QList < Fractal * > m_Keyframes;
+
+    // Frames
+    QString m_Name;
+    int m_Width;
+    int m_Height;
+    int m_NumberOfFrames;
+    QList < QHash < QString, QString > > m_FrameParameters;
+
+    // Exponential map (size, radii in the plane, and half the width of
+    // each frame in the plane; all logarithmic)
+    bool m_IsExponentialMap;
+    int m_StripWidth;
+    int m_StripHeight;
+    double m_LogRadiusMin;
+    double m_LogRadiusMax;
+    QList < double > m_FrameLogHalfWidth;
+    QImage m_Strip;
+
+    // Where frame pixels are in the exponential map (angle as strip x, and
+    // logarithm of the distance from the center in half frame widths)
+    QVector < float > m_PixelStripX;
+    QVector < float > m_PixelLogDistance;
+
+    // Output
+    QString m_OutputDirectory;
+    bool m_IsStreaming;
+    QFile m_Stream;
+    int m_NextFrameToStream;
+    QHash < int, QImage > m_FramesToStream;
+
+    // Images rendering frames at the same time (and the frames they're
+    // working on)
+    int m_ParallelFrames;
+    int m_ThreadsPerFrame;
+    QList < FractalImage * > m_Images;
+    QHash < FractalImage *, int > m_ImageToFrame;
+    QSet < FractalImage * > m_ImagesWithValues;
+    QList < int > m_PendingFrames;
+    bool m_IsDispatching;
+    bool m_IsDispatchNeeded;
+
+    // Statistics
+    int m_FramesDone;
+    int m_FramesRecolored;
+    QElapsedTimer m_Timer;
+
+    // Last error
+    QString m_LastError;
+};
+
+#endif
@@ -2,15 +2,21 @@
 // Class definition
 
 // Project includes
+#include "AnimationRenderer.h"
 #include "Application.h"
 #include "CallTracer.h"
 #include "Deploy.h"
+#include "HeadlessRenderer.h"
 #include "MainWindow.h"
 #include "MessageLogger.h"
 #include "Preferences.h"
+#include "RenderDaemon.h"
+#include "ShardMerger.h"
+#include "WorkQueueClient.h"
 
 // Qt includes
 #include <QAction>
+#include <QCommandLineParser>
 #include <QDebug>
 #include <QDialog>
 #include <QDir>
@@ -19,6 +25,8 @@
 #include <QMessageBox>
 #include <QPixmap>
 #include <QPushButton>
+#include <QTextStream>
+#include <QThread>
 #include <QVBoxLayout>
 
 // Debugging
@@ -53,6 +61,77 @@ Application::Application(int & argc, char ** argv)
     // Coloring preferences
     p -> SetDefaultTagValue("Coloring:Number of Presets", "0");
 
+    // Cache preferences
+    p -> SetDefaultTagValue("Cache:Prefetch Threads", "2");
+    p -> SetDefaultTagValue("Cache:Prefetch Memory Budget MB", "256");
+    p -> SetDefaultTagValue("Cache:Size Limit MB", "4096");
+    p -> SetDefaultTagValue("Cache:Memory Format", "double");
+    p -> SetDefaultTagValue("Cache:Orbit Data", "yes");
+    p -> SetDefaultTagValue("Cache:Resume Orbits", "no");
+    p -> SetDefaultTagValue("Cache:Render Journal", "yes");
+    p -> SetDefaultTagValue("Cache:Render Journal Max Age Days", "14");
+
+    // Rendering preferences
+    p -> SetDefaultTagValue("Render:Depth Passes", "1");
+    p -> SetDefaultTagValue("Render:Auto Depth Probe Size", "64");
+    p -> SetDefaultTagValue("Render:Keep Scale When Resizing", "no");
+    p -> SetDefaultTagValue("Render:Snap Zoom", "yes");
+    p -> SetDefaultTagValue("Render:Progressive Start Step", "8");
+    p -> SetDefaultTagValue("Render:Progressive Antialiasing", "yes");
+    p -> SetDefaultTagValue("Render:Dispatch Order", "center");
+    p -> SetDefaultTagValue("Render:History Memory Budget MB", "256");
+    p -> SetDefaultTagValue("Render:History Keeps Samples", "yes");
+    p -> SetDefaultTagValue("Render:Threads", "0");
+    p -> SetDefaultTagValue("Render:CPU Affinity", "");
+    p -> SetDefaultTagValue("Render:NUMA Local Buffers", "yes");
+    p -> SetDefaultTagValue("Render:Work Queue Address", "");
+    p -> SetDefaultTagValue("Render:Work Queue Secret", "");
+
+    // Command line options (for this session only)
+    QCommandLineParser parser;
+    AddCommandLineOptions(parser);
+    parser.process(arguments());
+    if (parser.isSet("threads"))
+    {
+        p -> SetSessionTagValue("Render:Threads",
+            parser.value("threads"));
+    }
+    if (parser.isSet("affinity"))
+    {
+        p -> SetSessionTagValue("Render:CPU Affinity",
+            parser.value("affinity"));
+    }
+    if (parser.isSet("numa-local"))
+    {
+        p -> SetSessionTagValue("Render:NUMA Local Buffers",
+            parser.value("numa-local"));
+    }
+    if (parser.isSet("serve"))
+    {
+        p -> SetSessionTagValue("Render:Work Queue Address",
+            parser.value("serve"));
+    }
+    if (parser.isSet("secret"))
+    {
+        p -> SetSessionTagValue("Render:Work Queue Secret",
+            parser.value("secret"));
+    }
+    m_RenderFilename = parser.value("render");
+    m_RenderShard = parser.value("shard");
+    m_MergeDirectory = parser.value("merge");
+    m_WorkerAddress = parser.value("worker");
+    m_JobDirectory = parser.value("daemon");
+    m_IsExitingWhenIdle = false;
+    if (parser.isSet("batch"))
+    {
+        m_JobDirectory = parser.value("batch");
+        m_IsExitingWhenIdle = true;
+    }
+    m_JobCores = parser.value("cores");
+    m_ControlDirectory = parser.value("control");
+    m_ControlCommand = parser.positionalArguments().join(" ");
+    m_AnimationFilename = parser.value("animate");
+
     CALL_OUT("");
 }
 
@@ -89,7 +168,10 @@ Application * Application::Instance(int & argc, char ** argv)
         m_Instance = new Application(argc, argv);
         
         // Initialize GUI
-        m_Instance -> InitGUI();
+        if (!m_Instance -> IsHeadless())
+        {
+            m_Instance -> InitGUI();
+        }
     }
 
     CALL_OUT("");
@@ -142,3 +224,272 @@ void Application::InitGUI()
 
     CALL_OUT("");
 }
+
+
+
+// =================================================================== Headless
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if we've been asked to work without GUI
+bool Application::IsHeadless() const
+{
+    CALL_IN("");
+
+    const bool is_headless = !m_RenderFilename.isEmpty() ||
+        !m_MergeDirectory.isEmpty() ||
+        !m_WorkerAddress.isEmpty() ||
+        !m_JobDirectory.isEmpty() ||
+        !m_ControlDirectory.isEmpty() ||
+        !m_AnimationFilename.isEmpty();
+
+    CALL_OUT("");
+    return is_headless;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Command line options
+void Application::AddCommandLineOptions(QCommandLineParser & mrParser)
+{
+    CALL_IN("mrParser=...");
+
+    mrParser.addHelpOption();
+    const QCommandLineOption threads_option("threads",
+        tr("Number of worker threads (0: all cores but one)."), "number");
+    mrParser.addOption(threads_option);
+    const QCommandLineOption affinity_option("affinity",
+        tr("Cores to pin worker threads to, e.g. \"0-7,16-23\"."), "cores");
+    mrParser.addOption(affinity_option);
+    const QCommandLineOption numa_option("numa-local",
+        tr("Allocate the scratch buffers of workers on their NUMA node."),
+        "yes|no");
+    mrParser.addOption(numa_option);
+    const QCommandLineOption render_option("render",
+        tr("Render a fractal without GUI (needs a fixed resolution)."),
+        "fractal.xml");
+    mrParser.addOption(render_option);
+    const QCommandLineOption shard_option("shard",
+        tr("Only render shard i of N, e.g. \"2/8\" (with --render)."),
+        "i/N");
+    mrParser.addOption(shard_option);
+    const QCommandLineOption merge_option("merge",
+        tr("Merge the shards in a directory into picture and statistics."),
+        "directory");
+    mrParser.addOption(merge_option);
+    const QCommandLineOption serve_option("serve",
+        tr("Hand out units to worker processes connecting to this address "
+        "(\"host:port\" or a local socket name; \"*:port\" for all "
+        "interfaces, which needs --secret)."), "address");
+    mrParser.addOption(serve_option);
+    const QCommandLineOption secret_option("secret",
+        tr("Secret shared by the coordinator and its workers (with --serve "
+        "or --worker)."), "secret");
+    mrParser.addOption(secret_option);
+    const QCommandLineOption worker_option("worker",
+        tr("Work for the coordinator at this address, without GUI."),
+        "address");
+    mrParser.addOption(worker_option);
+    const QCommandLineOption daemon_option("daemon",
+        tr("Render the jobs in a directory, watching it for new ones."),
+        "directory");
+    mrParser.addOption(daemon_option);
+    const QCommandLineOption batch_option("batch",
+        tr("Render the jobs in a directory, and stop when there are no "
+        "more."), "directory");
+    mrParser.addOption(batch_option);
+    const QCommandLineOption cores_option("cores",
+        tr("Cores the jobs may use altogether (with --daemon or --batch)."),
+        "number");
+    mrParser.addOption(cores_option);
+    const QCommandLineOption control_option("control",
+        tr("Send a command to the daemon working on a directory."),
+        "directory");
+    mrParser.addOption(control_option);
+    const QCommandLineOption animate_option("animate",
+        tr("Render the frames of an animation between keyframes."),
+        "animation file");
+    mrParser.addOption(animate_option);
+    mrParser.addPositionalArgument("command",
+        tr("With --control: \"enqueue <file> [priority]\", \"cancel <job>\" "
+        "or \"status\"."), "[command...]");
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if a command line asks for work without GUI (before there is an
+// application; options may be given as "--option value" or
+// "--option=value")
+bool Application::IsHeadlessCommandLine(const QStringList & mcrArguments)
+{
+    CALL_IN(QString("mcrArguments=%1")
+        .arg(CALL_SHOW(mcrArguments)));
+
+    QCommandLineParser parser;
+    AddCommandLineOptions(parser);
+    parser.parse(mcrArguments);
+    const bool is_headless = parser.isSet("render") ||
+        parser.isSet("merge") ||
+        parser.isSet("worker") ||
+        parser.isSet("daemon") ||
+        parser.isSet("batch") ||
+        parser.isSet("control") ||
+        parser.isSet("animate");
+
+    CALL_OUT("");
+    return is_headless;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Do the work without GUI
+int Application::RunHeadless()
+{
+    CALL_IN("");
+
+    // Merge shards
+    if (!m_MergeDirectory.isEmpty())
+    {
+        ShardMerger merger;
+        if (!merger.Merge(m_MergeDirectory))
+        {
+            MessageLogger::Error(CALL_METHOD, merger.GetLastError());
+            CALL_OUT(merger.GetLastError());
+            return 1;
+        }
+        CALL_OUT("");
+        return 0;
+    }
+
+    // Work for a coordinator (until it goes away; all cores unless
+    // configured otherwise)
+    if (!m_WorkerAddress.isEmpty())
+    {
+        int threads = Preferences::Instance() ->
+            GetTagValue("Render:Threads").toInt();
+        if (threads <= 0)
+        {
+            threads = QThread::idealThreadCount();
+        }
+        WorkQueueClient client;
+        connect (&client, SIGNAL(Finished()),
+            this, SLOT(quit()));
+        if (!client.Connect(m_WorkerAddress, threads,
+            Preferences::Instance() ->
+                GetTagValue("Render:Work Queue Secret")))
+        {
+            MessageLogger::Error(CALL_METHOD, client.GetLastError());
+            CALL_OUT(client.GetLastError());
+            return 1;
+        }
+        const int result = exec();
+        CALL_OUT("");
+        return result;
+    }
+
+    // Talk to a daemon
+    if (!m_ControlDirectory.isEmpty())
+    {
+        QString answer;
+        const bool success = RenderDaemon::SendCommand(m_ControlDirectory,
+            m_ControlCommand, answer);
+        QTextStream(success ? stdout : stderr) << answer << Qt::endl;
+        CALL_OUT("");
+        return (success ? 0 : 1);
+    }
+
+    // Render jobs (all cores unless told otherwise)
+    if (!m_JobDirectory.isEmpty())
+    {
+        int cores = QThread::idealThreadCount();
+        if (!m_JobCores.isEmpty())
+        {
+            bool is_number = false;
+            cores = m_JobCores.toInt(&is_number);
+            if (!is_number)
+            {
+                cores = 0;
+            }
+        }
+        RenderDaemon daemon;
+        connect (&daemon, SIGNAL(Finished()),
+            this, SLOT(quit()), Qt::QueuedConnection);
+        if (!daemon.Start(m_JobDirectory, cores, m_IsExitingWhenIdle))
+        {
+            MessageLogger::Error(CALL_METHOD, daemon.GetLastError());
+            CALL_OUT(daemon.GetLastError());
+            return 1;
+        }
+        const int result = exec();
+        CALL_OUT("");
+        return result;
+    }
+
+    // Render an animation (all cores unless configured otherwise)
+    if (!m_AnimationFilename.isEmpty())
+    {
+        int threads = Preferences::Instance() ->
+            GetTagValue("Render:Threads").toInt();
+        if (threads <= 0)
+        {
+            threads = QThread::idealThreadCount();
+        }
+        AnimationRenderer renderer;
+        connect (&renderer, SIGNAL(Finished()),
+            this, SLOT(quit()), Qt::QueuedConnection);
+        if (!renderer.Start(m_AnimationFilename, threads))
+        {
+            MessageLogger::Error(CALL_METHOD, renderer.GetLastError());
+            CALL_OUT(renderer.GetLastError());
+            return 1;
+        }
+        const int result = exec();
+        CALL_OUT("");
+        return result;
+    }
+
+    // Shard to render ("i/N"; everything if there is none)
+    int shard_index = 1;
+    int shard_count = 1;
+    if (!m_RenderShard.isEmpty())
+    {
+        const QStringList shard = m_RenderShard.split("/");
+        bool index_ok = false;
+        bool count_ok = false;
+        if (shard.size() == 2)
+        {
+            shard_index = shard[0].toInt(&index_ok);
+            shard_count = shard[1].toInt(&count_ok);
+        }
+        if (!index_ok ||
+            !count_ok)
+        {
+            const QString reason = tr("Invalid shard \"%1\" (expected "
+                "\"i/N\").").arg(m_RenderShard);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return 1;
+        }
+    }
+
+    // Render (exits when done)
+    HeadlessRenderer renderer;
+    connect (&renderer, SIGNAL(Finished()),
+        this, SLOT(quit()));
+    if (!renderer.Start(m_RenderFilename, shard_index, shard_count))
+    {
+        MessageLogger::Error(CALL_METHOD, renderer.GetLastError());
+        CALL_OUT(renderer.GetLastError());
+        return 1;
+    }
+    const int result = exec();
+
+    CALL_OUT("");
+    return result;
+}
@@ -7,6 +7,8 @@
 // Qt includes
 #include <QAction>
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QStringList>
 
 // Class definition
 class Application
@@ -40,6 +42,43 @@ private:
 private:
     // Initialize GUI
     void InitGUI();
+
+
+
+    // =============================================================== Headless
+public:
+    // Check if we've been asked to work without GUI
+    bool IsHeadless() const;
+
+    // Do the work without GUI; returns the exit code
+    int RunHeadless();
+
+    // Check if a command line asks for work without GUI
+    static bool IsHeadlessCommandLine(const QStringList & mcrArguments);
+
+private:
+    // Command line options
+    static void AddCommandLineOptions(QCommandLineParser & mrParser);
+
+    // Fractal to render, shard of it ("<index>/<count>"), directory with
+    // shards to merge, and coordinator to work for
+    QString m_RenderFilename;
+    QString m_RenderShard;
+    QString m_MergeDirectory;
+    QString m_WorkerAddress;
+
+    // Job directory (stop when it's empty, or keep watching it), and cores
+    // the jobs may use
+    QString m_JobDirectory;
+    bool m_IsExitingWhenIdle;
+    QString m_JobCores;
+
+    // Daemon to talk to, and what to tell it
+    QString m_ControlDirectory;
+    QString m_ControlCommand;
+
+    // Animation to render
+    QString m_AnimationFilename;
 };
 
 #endif
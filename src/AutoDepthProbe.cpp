@@ -0,0 +1,307 @@
+// AutoDepthProbe.cpp
+// Class implementation
+
+// Project includes
+#include "AutoDepthProbe.h"
+#include "CallTracer.h"
+#include "FractalImage.h"
+#include "FractalWorker.h"
+
+// System includes
+#include <algorithm>
+#include <cmath>
+
+// Depth the probe starts with
+#define FIRST_PROBE_DEPTH 1000
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+AutoDepthProbe::AutoDepthProbe()
+{
+    CALL_IN("");
+
+    m_RunState.storeRelaxed(RUN_STATE_RUNNING);
+    m_Worker = nullptr;
+    m_WorkerThread = nullptr;
+    m_UnitID = -1;
+    m_NextUnitID = 0;
+    m_ProbeDepth = 0;
+    m_NumberOfSamples = 0;
+    m_Depth = 0;
+    m_ProbeTime_ms = 0;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+AutoDepthProbe::~AutoDepthProbe()
+{
+    CALL_IN("");
+
+    Stop();
+
+    CALL_OUT("");
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start probing the view of a render
+void AutoDepthProbe::Start(const QHash < QString, QString > & mcrParameters)
+{
+    CALL_IN(QString("mcrParameters=%1")
+        .arg(CALL_SHOW(mcrParameters)));
+
+    // Only one probe at a time
+    Stop();
+
+    m_Parameters = mcrParameters;
+    m_RunState.storeRelaxed(RUN_STATE_RUNNING);
+    m_Depth = 0;
+    m_ProbeTime_ms = 0;
+    m_ProbeDepth =
+        qMin(m_Parameters["depth"].toInt(), FIRST_PROBE_DEPTH);
+    m_Timer.start();
+    LaunchWorker();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Stop probing
+void AutoDepthProbe::Stop()
+{
+    CALL_IN("");
+
+    if (!m_Worker)
+    {
+        CALL_OUT("Not probing");
+        return;
+    }
+
+    // (Whatever the worker still reports is ignored)
+    m_RunState.storeRelaxed(RUN_STATE_STOPPED);
+    disconnect (m_Worker, nullptr,
+        this, nullptr);
+    m_UnitID = -1;
+    EndWorker();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if we're probing
+bool AutoDepthProbe::IsRunning() const
+{
+    CALL_IN("");
+
+    CALL_OUT("");
+    return (m_Worker != nullptr);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Depth chosen
+int AutoDepthProbe::GetDepth() const
+{
+    CALL_IN("");
+
+    CALL_OUT("");
+    return m_Depth;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// How long probing took
+qint64 AutoDepthProbe::GetProbeTime_ms() const
+{
+    CALL_IN("");
+
+    CALL_OUT("");
+    return m_ProbeTime_ms;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Launch a worker probing with the current depth
+void AutoDepthProbe::LaunchWorker()
+{
+    CALL_IN("");
+
+    // Probe has the aspect ratio of the view, and its longer side has the
+    // probe size
+    const int width = m_Parameters["actual resolution width"].toInt();
+    const int height = m_Parameters["actual resolution height"].toInt();
+    const int probe_size =
+        qMax(8, m_Parameters["render auto depth probe size"].toInt());
+    int probe_width = probe_size;
+    int probe_height = probe_size;
+    if (width >= height)
+    {
+        probe_height = qMax(2, probe_size * height / qMax(1, width));
+    } else
+    {
+        probe_width = qMax(2, probe_size * width / qMax(1, height));
+    }
+    QHash < QString, QString > parameters = m_Parameters;
+    m_UnitID = m_NextUnitID++;
+    parameters["unit id"] = QString("%1").arg(m_UnitID);
+    parameters["tile id"] = "-1";
+    parameters["total pixel width"] = QString("%1").arg(probe_width);
+    parameters["total pixel height"] = QString("%1").arg(probe_height);
+    parameters["pixel x min"] = "0";
+    parameters["pixel x max"] = QString("%1").arg(probe_width);
+    parameters["pixel y min"] = "0";
+    parameters["pixel y max"] = QString("%1").arg(probe_height);
+    parameters["oversampling"] = "1";
+    parameters["depth"] = QString("%1").arg(m_ProbeDepth);
+    parameters.remove("core");
+
+    // Escape iterations are read from the orbit data
+    parameters["storage cache orbit data"] = "yes";
+    parameters["storage cache resume orbits"] = "no";
+
+    // Same as FractalImage does it for tiles
+    m_Worker = new FractalWorker();
+    m_Worker -> Prepare(parameters);
+    m_Worker -> SetRunState(&m_RunState);
+    connect (m_Worker, SIGNAL(Finished(const int)),
+        this, SLOT(WorkerFinished(const int)));
+    m_WorkerThread = new QThread();
+    connect (m_WorkerThread, SIGNAL(started()),
+        m_Worker, SLOT(Start()));
+    m_Worker -> moveToThread(m_WorkerThread);
+    m_WorkerThread -> start();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// End the thread of the current worker
+void AutoDepthProbe::EndWorker()
+{
+    CALL_IN("");
+
+    m_Worker -> deleteLater();
+    m_Worker = nullptr;
+    m_WorkerThread -> quit();
+    m_WorkerThread -> wait();
+    m_WorkerThread -> deleteLater();
+    m_WorkerThread = nullptr;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Worker is done with a probe
+void AutoDepthProbe::WorkerFinished(const int mcUnitID)
+{
+    CALL_IN(QString("mcUnitID=%1")
+        .arg(CALL_SHOW(mcUnitID)));
+
+    // Workers that have been stopped may still report back
+    if (mcUnitID != m_UnitID ||
+        !m_Worker)
+    {
+        CALL_OUT("Not the current probe");
+        return;
+    }
+
+    // Escape iterations of all samples that escaped; samples out of bounds
+    // don't depend on the depth at all
+    const QVector < double > orbit_data = m_Worker -> GetColorData();
+    EndWorker();
+    m_EscapeIterations.clear();
+    m_NumberOfSamples = 0;
+    bool is_escaping_late = false;
+    const int late_depth = m_ProbeDepth - m_ProbeDepth / DEPTH_PASS_FACTOR;
+    for (int offset = 0; offset < orbit_data.size(); offset += 3)
+    {
+        const double value = orbit_data[offset];
+        if (value == -INFINITY)
+        {
+            continue;
+        }
+        m_NumberOfSamples++;
+        if (value != INFINITY)
+        {
+            m_EscapeIterations << int(value);
+            if (value >= late_depth)
+            {
+                is_escaping_late = true;
+            }
+        }
+    }
+
+    // Settled if samples escaped, but none in the last quarter of the
+    // probe's depth (the rest is taken to be inside the set); otherwise go
+    // deeper
+    const int max_depth = m_Parameters["depth"].toInt();
+    if (m_ProbeDepth < max_depth &&
+        (m_EscapeIterations.isEmpty() || is_escaping_late))
+    {
+        m_ProbeDepth = int(qMin(qint64(max_depth),
+            qint64(m_ProbeDepth) * DEPTH_PASS_FACTOR));
+        LaunchWorker();
+        CALL_OUT("Going deeper");
+        return;
+    }
+    SelectDepth();
+    m_ProbeTime_ms = m_Timer.elapsed();
+    emit Finished();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Choose depth from the escape iterations of the probe
+void AutoDepthProbe::SelectDepth()
+{
+    CALL_IN("");
+
+    // Samples escaping at iteration n come out as inside the set with any
+    // depth up to n. Pick the smallest depth that gets all but the allowed
+    // share of them right (samples that hit the limit in the probe are
+    // counted as inside the set either way).
+    const int max_depth = m_Parameters["depth"].toInt();
+    const double fidelity =
+        qBound(0., m_Parameters["auto depth fidelity"].toDouble(), 100.);
+    const int allowed_errors =
+        int((1. - fidelity / 100.) * m_NumberOfSamples);
+    int depth = 1;
+    if (m_EscapeIterations.size() > allowed_errors)
+    {
+        std::sort(m_EscapeIterations.begin(), m_EscapeIterations.end(),
+            std::greater < int >());
+        depth = m_EscapeIterations[allowed_errors] + 1;
+    }
+    m_Depth = qBound(1, depth, max_depth);
+
+    CALL_OUT("");
+}
@@ -0,0 +1,103 @@
+// AutoDepthProbe.h
+// Class definition
+
+// Chooses the depth of a render from the escape iterations in a
+// low-resolution probe of the view. The probe runs in a thread of its own:
+// it starts shallow and only goes deeper (by DEPTH_PASS_FACTOR at a time)
+// while samples keep escaping near its depth, up to the depth in the
+// parameters.
+
+#ifndef AUTODEPTHPROBE_H
+#define AUTODEPTHPROBE_H
+
+// Qt includes
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QThread>
+
+// Forward declaration
+class FractalWorker;
+
+// Class definition
+class AutoDepthProbe
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    AutoDepthProbe();
+
+    // Destructor
+    virtual ~AutoDepthProbe();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Start probing the view of a render
+    void Start(const QHash < QString, QString > & mcrParameters);
+
+    // Stop probing right away (Finished() isn't emitted)
+    void Stop();
+
+    // Check if we're probing
+    bool IsRunning() const;
+
+    // Depth chosen
+    int GetDepth() const;
+
+    // How long probing took
+    qint64 GetProbeTime_ms() const;
+
+signals:
+    // Probe is done
+    void Finished();
+
+private slots:
+    // Worker is done with a probe
+    void WorkerFinished(const int mcUnitID);
+
+private:
+    // Launch a worker probing with the current depth
+    void LaunchWorker();
+
+    // End the thread of the current worker
+    void EndWorker();
+
+    // Choose depth from the escape iterations of the probe
+    void SelectDepth();
+
+    // Parameters of the render
+    QHash < QString, QString > m_Parameters;
+
+    // Run state of the workers (only ever running or stopped)
+    QAtomicInt m_RunState;
+
+    // Current worker, and the unit ID it reports (IDs of workers that have
+    // been stopped are never reused)
+    FractalWorker * m_Worker;
+    QThread * m_WorkerThread;
+    int m_UnitID;
+    int m_NextUnitID;
+
+    // Current depth of the probe, and escape iterations of its samples
+    // (samples out of bounds don't count)
+    int m_ProbeDepth;
+    QList < int > m_EscapeIterations;
+    int m_NumberOfSamples;
+
+    // Result
+    int m_Depth;
+    QElapsedTimer m_Timer;
+    qint64 m_ProbeTime_ms;
+};
+
+#endif
@@ -0,0 +1,69 @@
+// CachePrefetcher.cpp
+// Class implementation
+
+// Project includes
+#include "CachePrefetcher.h"
+#include "FractalImage.h"
+
+// Qt includes
+#include <QVector>
+
+
+
+// We don't do call tracing here because our way of doing that is not thread
+// safe.
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+CachePrefetcher::CachePrefetcher(FractalImage * mpFractalImage)
+{
+    m_FractalImage = mpFractalImage;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+CachePrefetcher::~CachePrefetcher()
+{
+    // Nothing to do.
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start prefetching
+void CachePrefetcher::Start()
+{
+    QVector < double > color_data;
+    QVector < double > brightness_data;
+    while (true)
+    {
+        // Next tile in dispatch order (waits while the memory budget is
+        // used up)
+        const int tile_id = m_FractalImage -> NextTileToPrefetch();
+        if (tile_id == PREFETCH_DONE)
+        {
+            break;
+        }
+
+        // Read it (may or may not work)
+        color_data.clear();
+        brightness_data.clear();
+        int depth = 0;
+        const bool success = m_FractalImage -> ReadCacheFile(tile_id,
+            color_data, brightness_data, depth);
+        m_FractalImage -> StorePrefetchedTile(tile_id, success, color_data,
+            brightness_data, depth);
+    }
+}
@@ -0,0 +1,44 @@
+// CachePrefetcher.h
+// Class definition
+
+// Reads cached tile data from disk ahead of the tiles being dispatched to
+// workers, so workers don't have to wait for the files to be read.
+
+#ifndef CACHEPREFETCHER_H
+#define CACHEPREFETCHER_H
+
+// Qt includes
+#include <QObject>
+
+// Forward declaration
+class FractalImage;
+
+// Class definition
+class CachePrefetcher
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    CachePrefetcher(FractalImage * mpFractalImage);
+
+    // Destructor
+    virtual ~CachePrefetcher();
+
+
+
+    // ======================================================== Everything else
+public slots:
+    // Start prefetching
+    void Start();
+
+private:
+    // Image we're prefetching for
+    FractalImage * m_FractalImage;
+};
+
+#endif
@@ -13,4 +13,10 @@
 #define APPLICATION_NAME "MandelPoster"
 
 // Version for stored cache data format
-#define CACHE_FILE_VERSION 1
+#define CACHE_FILE_VERSION 5
+
+// Version for render journal format
+#define JOURNAL_FILE_VERSION 1
+
+// Version for the work queue protocol between coordinator and workers
+#define WORK_QUEUE_VERSION 2
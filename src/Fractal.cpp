@@ -44,6 +44,8 @@ Fractal::Fractal()
     m_ImagMin_Long = -1.3L;
     m_ImagMax_Long = 1.3L;
     m_Depth = 1000;
+    m_AutoDepth = false;
+    m_AutoDepthFidelity = 99.9;
     m_EscapeRadius = 4000;
 
     // For Julia set
@@ -134,6 +136,8 @@ void Fractal::JustLikeThis(Fractal * mpFractal) const
     mpFractal -> m_ImagMin_Long = m_ImagMin_Long;
     mpFractal -> m_ImagMax_Long = m_ImagMax_Long;
     mpFractal -> m_Depth = m_Depth;
+    mpFractal -> m_AutoDepth = m_AutoDepth;
+    mpFractal -> m_AutoDepthFidelity = m_AutoDepthFidelity;
     mpFractal -> m_EscapeRadius = m_EscapeRadius;
     mpFractal -> m_Oversampling = m_Oversampling;
     mpFractal -> m_JuliaReal = m_JuliaReal;
@@ -176,6 +180,132 @@ void Fractal::JustLikeThis(Fractal * mpFractal) const
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Initialize with a view between two fractals (animation frames)
+void Fractal::Interpolate(const Fractal * mpStart, const Fractal * mpEnd,
+    const double mcPosition)
+{
+    CALL_IN(QString("mpStart=%1, mpEnd=%2, mcPosition=%3")
+        .arg(CALL_SHOW(mpStart),
+             CALL_SHOW(mpEnd),
+             CALL_SHOW(mcPosition)));
+
+    // Everything that can't be interpolated is taken from the start
+    mpStart -> JustLikeThis(this);
+    const double position = qBound(0., mcPosition, 1.);
+
+    // Deep zooms end up in long double precision
+    m_UseLongDoublePrecision = mpStart -> m_UseLongDoublePrecision ||
+        mpEnd -> m_UseLongDoublePrecision;
+
+    // Range follows a logarithmic zoom path: its size changes by the same
+    // factor from frame to frame, and its center moves in proportion to the
+    // change in size, so the end view stays in the same place on screen
+    const long double start_range[4] = {
+        mpStart -> m_UseLongDoublePrecision ?
+            mpStart -> m_RealMin_Long : mpStart -> m_RealMin,
+        mpStart -> m_UseLongDoublePrecision ?
+            mpStart -> m_RealMax_Long : mpStart -> m_RealMax,
+        mpStart -> m_UseLongDoublePrecision ?
+            mpStart -> m_ImagMin_Long : mpStart -> m_ImagMin,
+        mpStart -> m_UseLongDoublePrecision ?
+            mpStart -> m_ImagMax_Long : mpStart -> m_ImagMax };
+    const long double end_range[4] = {
+        mpEnd -> m_UseLongDoublePrecision ?
+            mpEnd -> m_RealMin_Long : mpEnd -> m_RealMin,
+        mpEnd -> m_UseLongDoublePrecision ?
+            mpEnd -> m_RealMax_Long : mpEnd -> m_RealMax,
+        mpEnd -> m_UseLongDoublePrecision ?
+            mpEnd -> m_ImagMin_Long : mpEnd -> m_ImagMin,
+        mpEnd -> m_UseLongDoublePrecision ?
+            mpEnd -> m_ImagMax_Long : mpEnd -> m_ImagMax };
+    long double range[4];
+    for (int axis = 0; axis < 2; axis++)
+    {
+        const long double start_size =
+            start_range[2 * axis + 1] - start_range[2 * axis];
+        const long double end_size =
+            end_range[2 * axis + 1] - end_range[2 * axis];
+        long double size = start_size + (end_size - start_size) * position;
+        long double center_position = position;
+        if (start_size > 0 &&
+            end_size > 0 &&
+            start_size != end_size)
+        {
+            size = start_size * powl(end_size / start_size, position);
+            center_position = (start_size - size) / (start_size - end_size);
+        }
+        const long double start_center =
+            (start_range[2 * axis] + start_range[2 * axis + 1]) / 2;
+        const long double end_center =
+            (end_range[2 * axis] + end_range[2 * axis + 1]) / 2;
+        const long double center =
+            start_center + (end_center - start_center) * center_position;
+        range[2 * axis] = center - size / 2;
+        range[2 * axis + 1] = center + size / 2;
+    }
+    m_RealMin_Long = range[0];
+    m_RealMax_Long = range[1];
+    m_ImagMin_Long = range[2];
+    m_ImagMax_Long = range[3];
+    m_RealMin = double(range[0]);
+    m_RealMax = double(range[1]);
+    m_ImagMin = double(range[2]);
+    m_ImagMax = double(range[3]);
+
+    // Julia constant moves in a straight line
+    const long double start_julia_real = mpStart -> m_UseLongDoublePrecision ?
+        mpStart -> m_JuliaReal_Long : mpStart -> m_JuliaReal;
+    const long double start_julia_imag = mpStart -> m_UseLongDoublePrecision ?
+        mpStart -> m_JuliaImag_Long : mpStart -> m_JuliaImag;
+    const long double end_julia_real = mpEnd -> m_UseLongDoublePrecision ?
+        mpEnd -> m_JuliaReal_Long : mpEnd -> m_JuliaReal;
+    const long double end_julia_imag = mpEnd -> m_UseLongDoublePrecision ?
+        mpEnd -> m_JuliaImag_Long : mpEnd -> m_JuliaImag;
+    m_JuliaReal_Long = start_julia_real +
+        (end_julia_real - start_julia_real) * position;
+    m_JuliaImag_Long = start_julia_imag +
+        (end_julia_imag - start_julia_imag) * position;
+    m_JuliaReal = double(m_JuliaReal_Long);
+    m_JuliaImag = double(m_JuliaImag_Long);
+
+    // Everything else that's a number, too
+    m_Depth = int(std::round(mpStart -> m_Depth +
+        (mpEnd -> m_Depth - mpStart -> m_Depth) * position));
+    const QList < QPair < double *, const double * > > values = {
+        { &m_AutoDepthFidelity, &mpEnd -> m_AutoDepthFidelity },
+        { &m_EscapeRadius, &mpEnd -> m_EscapeRadius },
+        { &m_Periodic_FactorR, &mpEnd -> m_Periodic_FactorR },
+        { &m_Periodic_OffsetR, &mpEnd -> m_Periodic_OffsetR },
+        { &m_Periodic_FactorG, &mpEnd -> m_Periodic_FactorG },
+        { &m_Periodic_OffsetG, &mpEnd -> m_Periodic_OffsetG },
+        { &m_Periodic_FactorB, &mpEnd -> m_Periodic_FactorB },
+        { &m_Periodic_OffsetB, &mpEnd -> m_Periodic_OffsetB },
+        { &m_Periodic_Factor, &mpEnd -> m_Periodic_Factor },
+        { &m_Periodic_Offset, &mpEnd -> m_Periodic_Offset },
+        { &m_Ramp_Factor, &mpEnd -> m_Ramp_Factor },
+        { &m_Ramp_Offset, &mpEnd -> m_Ramp_Offset },
+        { &m_StripAverage_FoldChange, &mpEnd -> m_StripAverage_FoldChange },
+        { &m_StripAverage_Factor, &mpEnd -> m_StripAverage_Factor },
+        { &m_StripAverage_Offset, &mpEnd -> m_StripAverage_Offset },
+        { &m_StripAverage_MinBrightness,
+            &mpEnd -> m_StripAverage_MinBrightness },
+        { &m_StripAverageAlt_FoldChange,
+            &mpEnd -> m_StripAverageAlt_FoldChange },
+        { &m_StripAverageAlt_Regularity,
+            &mpEnd -> m_StripAverageAlt_Regularity },
+        { &m_StripAverageAlt_Exponent,
+            &mpEnd -> m_StripAverageAlt_Exponent } };
+    for (const auto & value : values)
+    {
+        *value.first += (*value.second - *value.first) * position;
+    }
+
+    CALL_OUT("");
+}
+
+
+
 // ============================================================== Serialization
 
 
@@ -266,6 +396,8 @@ QString Fractal::ToXML() const
             QString::number(m_ImagMax, 'g', 20));
     }
     dom_render.setAttribute("depth", m_Depth);
+    dom_render.setAttribute("auto_depth", (m_AutoDepth ? "yes" : "no"));
+    dom_render.setAttribute("auto_depth_fidelity", m_AutoDepthFidelity);
     dom_render.setAttribute("escape_radius", m_EscapeRadius);
 
     QDomElement dom_picture = doc.createElement("picture");
@@ -360,7 +492,7 @@ QString Fractal::ToXML() const
 
 ///////////////////////////////////////////////////////////////////////////////
 // Read from file
-void Fractal::FromFile(const QString mcFilename)
+bool Fractal::FromFile(const QString mcFilename)
 {
     CALL_IN(QString("mcFilename=%1")
         .arg(CALL_SHOW(mcFilename)));
@@ -370,13 +502,14 @@ void Fractal::FromFile(const QString mcFilename)
     if (!in_file.open(QIODevice::ReadOnly | QIODevice::Text))
     {
         CALL_OUT(tr("File could not be opened for reading"));
-        return;
+        return false;
     }
     QTextStream in_stream(&in_file);
     const QString xml = in_stream.readAll();
-    FromXML(xml);
+    const bool success = FromXML(xml);
 
     CALL_OUT("");
+    return success;
 }
 
 
@@ -428,6 +561,9 @@ bool Fractal::FromXML(const QString mcXML)
         m_ImagMax = dom_render.attribute("imag_max").toDouble();
     }
     m_Depth = dom_render.attribute("depth").toInt();
+    m_AutoDepth = (dom_render.attribute("auto_depth", "no") == "yes");
+    m_AutoDepthFidelity =
+        dom_render.attribute("auto_depth_fidelity", "99.9").toDouble();
     m_EscapeRadius = dom_render.attribute("escape_radius").toDouble();
 
     if (m_FractalType == "julia")
@@ -823,6 +959,57 @@ int Fractal::GetDepth() const
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Set automatic depth
+void Fractal::SetAutoDepth(const bool mcAutoDepth, const double mcFidelity)
+{
+    CALL_IN(QString("mcAutoDepth=%1, mcFidelity=%2")
+        .arg(CALL_SHOW(mcAutoDepth),
+             CALL_SHOW(mcFidelity)));
+
+    // Check for no change
+    if (mcAutoDepth == m_AutoDepth &&
+        mcFidelity == m_AutoDepthFidelity)
+    {
+        CALL_OUT("No change");
+        return;
+    }
+
+    m_AutoDepth = mcAutoDepth;
+    m_AutoDepthFidelity = mcFidelity;
+
+    // Storage no longer valid
+    emit InvalidateStorage();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if depth is chosen automatically
+bool Fractal::HasAutoDepth() const
+{
+    CALL_IN("");
+
+    CALL_OUT("");
+    return m_AutoDepth;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Fidelity target for automatic depth
+double Fractal::GetAutoDepthFidelity() const
+{
+    CALL_IN("");
+
+    CALL_OUT("");
+    return m_AutoDepthFidelity;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Set escape radius
 void Fractal::SetEscapeRadius(const double mcEscapeRadius)
@@ -1741,6 +1928,12 @@ QString Fractal::CheckAllParametersValid() const
         CALL_OUT("");
         return tr("Invalid depth parameter %1").arg(m_Depth);
     }
+    if (m_AutoDepth &&
+        (m_AutoDepthFidelity <= 0 || m_AutoDepthFidelity > 100))
+    {
+        CALL_OUT("");
+        return tr("Invalid auto depth fidelity %1").arg(m_AutoDepthFidelity);
+    }
 
     // Escape radius
     if (m_EscapeRadius < 1)
@@ -1800,6 +1993,8 @@ QHash < QString, QString > Fractal::GetAllParameters() const
         parameters["julia imag"] = QString::number(m_JuliaImag, 'g', 16);
     }
     parameters["depth"] = QString("%1").arg(m_Depth);
+    parameters["auto depth"] = (m_AutoDepth ? "yes" : "no");
+    parameters["auto depth fidelity"] = QString("%1").arg(m_AutoDepthFidelity);
     parameters["escape radius"] = QString("%1").arg(m_EscapeRadius);
 
     parameters["oversampling"] = QString("%1").arg(m_Oversampling);
@@ -1887,3 +2082,171 @@ QHash < QString, QString > Fractal::GetAllParameters() const
     CALL_OUT("");
     return parameters;
 }
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculate range based on resolution
+QHash < QString, QString > Fractal::GetRangeForResolution(
+    const int mcWidth, const int mcHeight) const
+{
+    CALL_IN(QString("mcWidth=%1, mcHeight=%2")
+        .arg(CALL_SHOW(mcWidth),
+             CALL_SHOW(mcHeight)));
+
+    // We'll fit the entire range into an existing resolution with square
+    // pixels, and will expand the range to fit all pixels.
+
+    // When we get here, the resolution already has been set, without any
+    // or a pre-defined aspect ratio, as this step has nothing to do with
+    // the complex range.
+    const QHash < QString, QString > parameters = GetAllParameters();
+
+    // Area in the complex plane
+    QHash < QString, QString > parameters_ret;
+    if (parameters["precision"] == "long double")
+    {
+        long double real_min =
+            StringHelper::ToLongDouble(parameters["real min"]);
+        long double real_max =
+            StringHelper::ToLongDouble(parameters["real max"]);
+        long double imag_min =
+            StringHelper::ToLongDouble(parameters["imag min"]);
+        long double imag_max =
+            StringHelper::ToLongDouble(parameters["imag max"]);
+        const long double area_width = real_max - real_min;
+        const long double area_height = imag_max - imag_min;
+
+        const long double res_x = area_width / mcWidth;
+        const long double res_y = area_height / mcHeight;
+        if (res_x > res_y)
+        {
+            const long double imag_center = 0.5 * (imag_min + imag_max);
+            imag_min = imag_center - 0.5 * res_x * mcHeight;
+            imag_max = imag_center + 0.5 * res_x * mcHeight;
+        } else
+        {
+            const long double real_center = 0.5 * (real_min + real_max);
+            real_min = real_center - 0.5 * res_y * mcWidth;
+            real_max = real_center + 0.5 * res_y * mcWidth;
+        }
+
+        // Return area
+        parameters_ret["real min"] = StringHelper::ToString(real_min);
+        parameters_ret["real max"] = StringHelper::ToString(real_max);
+        parameters_ret["imag min"] = StringHelper::ToString(imag_min);
+        parameters_ret["imag max"] = StringHelper::ToString(imag_max);
+    } else
+    {
+        double real_min = parameters["real min"].toDouble();
+        double real_max = parameters["real max"].toDouble();
+        double imag_min = parameters["imag min"].toDouble();
+        double imag_max = parameters["imag max"].toDouble();
+        const double area_width = real_max - real_min;
+        const double area_height = imag_max - imag_min;
+
+        const double res_x = area_width / mcWidth;
+        const double res_y = area_height / mcHeight;
+        if (res_x > res_y)
+        {
+            const double imag_center = 0.5 * (imag_min + imag_max);
+            imag_min = imag_center - 0.5 * res_x * mcHeight;
+            imag_max = imag_center + 0.5 * res_x * mcHeight;
+        } else
+        {
+            const double real_center = 0.5 * (real_min + real_max);
+            real_min = real_center - 0.5 * res_y * mcWidth;
+            real_max = real_center + 0.5 * res_y * mcWidth;
+        }
+
+        // Return area
+        parameters_ret["real min"] = QString::number(real_min, 'g', 16);
+        parameters_ret["real max"] = QString::number(real_max, 'g', 16);
+        parameters_ret["imag min"] = QString::number(imag_min, 'g', 16);
+        parameters_ret["imag max"] = QString::number(imag_max, 'g', 16);
+    }
+
+    CALL_OUT("");
+    return parameters_ret;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add rendering and cache preferences to parameters
+void Fractal::AddRenderPreferences(QHash < QString, QString > & mrParameters,
+    const Preferences * mcpPreferences)
+{
+    CALL_IN("mrParameters=..., mcpPreferences=...");
+
+    const Preferences * p = mcpPreferences;
+    mrParameters["storage prefetch threads"] =
+        p -> GetTagValue("Cache:Prefetch Threads");
+    mrParameters["storage prefetch memory budget mb"] =
+        p -> GetTagValue("Cache:Prefetch Memory Budget MB");
+    mrParameters["storage cache size limit mb"] =
+        p -> GetTagValue("Cache:Size Limit MB");
+    mrParameters["storage cache memory format"] =
+        p -> GetTagValue("Cache:Memory Format");
+    mrParameters["storage cache orbit data"] =
+        p -> GetTagValue("Cache:Orbit Data");
+    mrParameters["storage cache resume orbits"] =
+        p -> GetTagValue("Cache:Resume Orbits");
+    mrParameters["storage render journal"] =
+        p -> GetTagValue("Cache:Render Journal");
+    mrParameters["storage render journal max age days"] =
+        p -> GetTagValue("Cache:Render Journal Max Age Days");
+    mrParameters["render depth passes"] =
+        p -> GetTagValue("Render:Depth Passes");
+    mrParameters["render auto depth probe size"] =
+        p -> GetTagValue("Render:Auto Depth Probe Size");
+    mrParameters["render progressive start step"] =
+        p -> GetTagValue("Render:Progressive Start Step");
+    mrParameters["render progressive antialiasing"] =
+        p -> GetTagValue("Render:Progressive Antialiasing");
+    mrParameters["render dispatch order"] =
+        p -> GetTagValue("Render:Dispatch Order");
+    mrParameters["render threads"] = p -> GetTagValue("Render:Threads");
+    mrParameters["render cpu affinity"] =
+        p -> GetTagValue("Render:CPU Affinity");
+    mrParameters["render numa local buffers"] =
+        p -> GetTagValue("Render:NUMA Local Buffers");
+    mrParameters["render work queue address"] =
+        p -> GetTagValue("Render:Work Queue Address");
+    mrParameters["render work queue secret"] =
+        p -> GetTagValue("Render:Work Queue Secret");
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// All parameters for rendering at a fixed resolution without a window
+QHash < QString, QString > Fractal::GetParametersForResolution(
+    const int mcWidth, const int mcHeight,
+    const Preferences * mcpPreferences) const
+{
+    CALL_IN(QString("mcWidth=%1, mcHeight=%2, mcpPreferences=...")
+        .arg(CALL_SHOW(mcWidth),
+             CALL_SHOW(mcHeight)));
+
+    QHash < QString, QString > parameters = GetAllParameters();
+    parameters["actual resolution width"] = QString("%1").arg(mcWidth);
+    parameters["actual resolution height"] = QString("%1").arg(mcHeight);
+    const QHash < QString, QString > range =
+        GetRangeForResolution(mcWidth, mcHeight);
+    for (auto key_iterator = range.keyBegin();
+         key_iterator != range.keyEnd();
+         key_iterator++)
+    {
+        const QString key = *key_iterator;
+        parameters[key] = range[key];
+    }
+
+    // Rendering and cache preferences
+    AddRenderPreferences(parameters, mcpPreferences);
+
+    CALL_OUT("");
+    return parameters;
+}
@@ -10,6 +10,9 @@
 // Qt includes
 #include <QObject>
 
+// Forward declaration
+class Preferences;
+
 // Class definition
 class Fractal
     : public QObject
@@ -29,6 +32,11 @@ public:
     // Initilize given object with data from this object
     void JustLikeThis(Fractal * mpFractal) const;
 
+    // Initialize with a view between two fractals (position 0 is the start,
+    // 1 the end; used for animation frames)
+    void Interpolate(const Fractal * mpStart, const Fractal * mpEnd,
+        const double mcPosition);
+
 
 
     // ========================================================== Serialization
@@ -39,8 +47,8 @@ public:
     // Serialize
     QString ToXML() const;
 
-    // Read from file
-    void FromFile(const QString mcFilename);
+    // Read from file (false if it can't be read or isn't a fractal)
+    bool FromFile(const QString mcFilename);
 
     // Deserialize
     bool FromXML(const QString mcXML);
@@ -96,6 +104,17 @@ public:
 private:
     int m_Depth;
 
+public:
+    // Automatic depth (chosen from a probe of the view before rendering;
+    // the depth above is the upper limit then, and the fidelity is the
+    // percentage of samples that have to come out as they would with it)
+    void SetAutoDepth(const bool mcAutoDepth, const double mcFidelity);
+    bool HasAutoDepth() const;
+    double GetAutoDepthFidelity() const;
+private:
+    bool m_AutoDepth;
+    double m_AutoDepthFidelity;
+
 public:
     // Escape radius
     void SetEscapeRadius(const double mcEscapeRadius);
@@ -254,6 +273,20 @@ public:
     // Get all parameters
     QHash < QString, QString > GetAllParameters() const;
 
+    // Calculate range based on resolution
+    QHash < QString, QString > GetRangeForResolution(const int mcWidth,
+        const int mcHeight) const;
+
+    // Add rendering and cache preferences to parameters
+    static void AddRenderPreferences(
+        QHash < QString, QString > & mrParameters,
+        const Preferences * mcpPreferences);
+
+    // All parameters for rendering at a fixed resolution without a window
+    // (e.g. headless or batch renders), with the given preferences
+    QHash < QString, QString > GetParametersForResolution(const int mcWidth,
+        const int mcHeight, const Preferences * mcpPreferences) const;
+
 signals:
     // Invalidate Storage
     void InvalidateStorage();
@@ -2,27 +2,48 @@
 // Class implementation
 
 // Project includes
+#include "AutoDepthProbe.h"
+#include "CachePrefetcher.h"
 #include "CallTracer.h"
 #include "FractalImage.h"
 #include "FractalWorker.h"
 #include "MessageLogger.h"
+#include "RecolorEngine.h"
+#include "RenderJournal.h"
+#include "TileCacheEncoding.h"
+#include "TileCacheFile.h"
 #include "StringHelper.h"
+#include "WorkQueueServer.h"
 
 // Qt includes
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
 #include <QPainter>
 #include <QPixmap>
+#include <QTextStream>
 #include <QThread>
 
 // System include
+#include <algorithm>
 #include <cmath>
+#include <functional>
 
 #define TILE_SIZE 100
 #define UPDATE_FREQUENCY 500
 
+// Deviation (in pixels) up to which a view counts as moved by whole pixels
+#define SHIFT_TOLERANCE 0.01
+
+// Most bands of rows an expensive tile is split into
+#define MAX_TILE_BANDS 8
+
 
 
 // ================================================================== Lifecycle
@@ -38,6 +59,43 @@ FractalImage::FractalImage()
     // Not running, not stopping
     m_IsWorking = false;
     m_IsStopped = false;
+    m_RunState.storeRelaxed(RUN_STATE_RUNNING);
+
+    // No tiles yet
+    m_NumberOfTiles = 0;
+    m_CurrentTile = 0;
+    m_CurrentTileBand = 0;
+    m_NextUnitID = 0;
+    m_TotalCost = 0;
+    m_PreviousAverageCost = 0.;
+    m_NumberOfThreads = qMax(1, QThread::idealThreadCount() - 1);
+    m_PassDepths << 0;
+    m_PassSteps << 1;
+    m_PassSampleSteps << 1;
+    m_CurrentPass = 0;
+
+    // Depth isn't chosen automatically yet
+    m_AutoDepthProbe = new AutoDepthProbe();
+    connect (m_AutoDepthProbe, SIGNAL(Finished()),
+        this, SLOT(AutoDepthProbeFinished()));
+    m_AutoDepthProbeResult = 0;
+
+    // Mouse position isn't known yet
+    m_FocusX = -1;
+    m_FocusY = -1;
+
+    // No cache file yet
+    m_CacheFile = nullptr;
+    m_Journal = new RenderJournal();
+
+    // No worker processes
+    m_WorkQueueServer = nullptr;
+
+    // Not prefetching
+    m_NextPrefetchTile = 0;
+    m_PrefetchedBytes = 0;
+    m_PrefetchBudget = 0;
+    m_PrefetchStopped = true;
 
     // Reset statistics
     ResetStatistics();
@@ -53,7 +111,12 @@ FractalImage::~FractalImage()
 {
     CALL_IN("");
 
-    // Nothing to do
+    // Prefetcher threads are still accessing us
+    delete m_AutoDepthProbe;
+    StopPrefetching();
+    CloseCacheFile();
+    delete m_Journal;
+    delete m_WorkQueueServer;
 
     CALL_OUT("");
 }
@@ -114,16 +177,65 @@ void FractalImage::Render(const QHash < QString, QString > mcParameters)
     CALL_IN(QString("mcParameters=%1")
         .arg(CALL_SHOW(mcParameters)));
 
+    // Statistics of a restored view don't describe this render, and its
+    // output hasn't been saved yet
+    m_Statistics_Restored.clear();
+    m_OutputError.clear();
+
+    // A probe for an earlier render isn't needed anymore
+    m_AutoDepthProbe -> Stop();
+
+    // Choose depth from a probe of the view first, unless it's the view of
+    // the last probe (the probe runs in a thread of its own, and the render
+    // starts once it's done)
+    int auto_depth = 0;
+    if (mcParameters["auto depth"] == "yes")
+    {
+        if (GetAutoDepthProbeKey(mcParameters) != m_AutoDepthProbeKey)
+        {
+            m_IsStopped = false;
+            m_AutoDepthProbeParameters = mcParameters;
+            m_AutoDepthProbe -> Start(mcParameters);
+            CALL_OUT("Probing depth");
+            return;
+        }
+        auto_depth = m_AutoDepthProbeResult;
+    }
+    StartRender(mcParameters, auto_depth, 0);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Render image with the depth chosen, once that's known
+void FractalImage::StartRender(
+    const QHash < QString, QString > & mcrParameters, const int mcAutoDepth,
+    const qint64 mcProbeTime_ms)
+{
+    CALL_IN(QString("mcrParameters=%1, mcAutoDepth=%2, mcProbeTime_ms=%3")
+        .arg(CALL_SHOW(mcrParameters),
+             CALL_SHOW(mcAutoDepth),
+             CALL_SHOW(mcProbeTime_ms)));
+
     // Abbreviation
-    const int width = mcParameters["actual resolution width"].toInt();
-    const int height = mcParameters["actual resolution height"].toInt();
+    const int width = mcrParameters["actual resolution width"].toInt();
+    const int height = mcrParameters["actual resolution height"].toInt();
+
+    // Depth chosen by the probe
+    QHash < QString, QString > parameters = mcrParameters;
+    if (mcAutoDepth > 0)
+    {
+        parameters["depth"] = QString("%1").arg(mcAutoDepth);
+    }
 
     // Check if parameter set invalidates storage
     bool invalidate_cache = false;
     if (!m_Parameters.isEmpty())
     {
         // We don't clear out the disk cache if we just opened a fractal
-        if (WillParametersInvalidateCache(mcParameters))
+        if (WillParametersInvalidateCache(parameters))
         {
             // If parameter changes don't change cached values, don't clear
             // out the disk space!
@@ -131,8 +243,54 @@ void FractalImage::Render(const QHash < QString, QString > mcParameters)
         }
     }
 
+    // Prefetchers of a previous run are still reading our parameters
+    StopPrefetching();
+
+    // If the view has only been moved by whole pixels (or resized at the
+    // same scale), samples it has in common with the current one are kept
+    int shift_x = 0;
+    int shift_y = 0;
+    const bool is_shifted = invalidate_cache &&
+        GetPixelShift(parameters, shift_x, shift_y);
+    QHash < int, QByteArray > moved_color_data;
+    QHash < int, QByteArray > moved_brightness_data;
+    QSet < int > partial_tiles;
+    QPixmap previous_image;
+    if (is_shifted)
+    {
+        ShiftSamples(parameters, shift_x, shift_y, moved_color_data,
+            moved_brightness_data, partial_tiles);
+        previous_image = m_Image;
+    }
+
+    // Zoomed in by an integer factor, or with higher resolution or
+    // oversampling: current samples are a subset of the new ones
+    int lattice_factor = 1;
+    int lattice_offset_x = 0;
+    int lattice_offset_y = 0;
+    const bool is_on_lattice = invalidate_cache &&
+        !is_shifted &&
+        GetLatticeMapping(parameters, lattice_factor, lattice_offset_x,
+            lattice_offset_y);
+    if (is_on_lattice)
+    {
+        ImportLatticeSamples(parameters, lattice_factor, lattice_offset_x,
+            lattice_offset_y, m_Parameters["actual resolution width"].toInt(),
+            m_Parameters["actual resolution height"].toInt(),
+            m_Parameters["oversampling"].toInt(),
+            [this](const int mcTileID, QVector < double > & mrColorData,
+                QVector < double > & mrBrightnessData)
+            {
+                return GetFullDepthTile(mcTileID, mrColorData,
+                    mrBrightnessData);
+            }, moved_color_data, moved_brightness_data, partial_tiles);
+    }
+
     // Set new parameters
-    m_Parameters = mcParameters;
+    const bool is_new_view = invalidate_cache ||
+        m_Parameters.isEmpty();
+    m_Parameters = parameters;
+    m_ViewKey = GetViewKey(mcrParameters);
 
     // Actual initialization
     if (invalidate_cache)
@@ -146,35 +304,70 @@ void FractalImage::Render(const QHash < QString, QString > mcParameters)
         // Recreate image
         m_Image = QPixmap(width, height);
         m_Image.fill(QColor(192, 192, 192));
+        if (is_shifted)
+        {
+            QPainter painter(&m_Image);
+            painter.drawPixmap(-shift_x, -shift_y, previous_image);
+        }
         emit PeriodicUpdate();
     }
 
     // Set up cache if necessary
     if (m_TileIDToPointXMin.isEmpty())
     {
-        m_NumberOfTiles = 0;
-        for (int pixel_y = 0; pixel_y < height; pixel_y += TILE_SIZE)
+        SetUpTiles();
+    }
+
+    // Nothing to take from the previous view: an earlier render of this
+    // view with fewer samples (like a preview of a poster) may have some
+    bool is_from_lattice_source = false;
+    if (is_new_view &&
+        !is_shifted &&
+        !is_on_lattice)
+    {
+        is_from_lattice_source = ImportLatticeSourceSamples(moved_color_data,
+            moved_brightness_data, partial_tiles);
+    }
+
+    // Samples moved from the previous view
+    if (is_shifted ||
+        is_on_lattice ||
+        is_from_lattice_source)
+    {
+        m_TileIDToColorData = moved_color_data;
+        m_TileIDToBrightnessData = moved_brightness_data;
+        for (auto tile_iterator = moved_color_data.keyBegin();
+             tile_iterator != moved_color_data.keyEnd();
+             tile_iterator++)
         {
-            const int tile_height = qMin(height - pixel_y, TILE_SIZE);
-            for (int pixel_x = 0; pixel_x < width; pixel_x += TILE_SIZE)
-            {
-                const int tile_width = qMin(width - pixel_x, TILE_SIZE);
-                m_TileIDToPointXMin[m_NumberOfTiles] = pixel_x;
-                m_TileIDToPointXMax[m_NumberOfTiles] = pixel_x + tile_width;
-                m_TileIDToPointYMin[m_NumberOfTiles] = pixel_y;
-                m_TileIDToPointYMax[m_NumberOfTiles] = pixel_y + tile_height;
-                m_NumberOfTiles++;
-            }
+            m_TileIDToDepth[*tile_iterator] = m_Parameters["depth"].toInt();
         }
+        m_PartialTiles = partial_tiles;
+    }
+
+    // Only colors have changed, and we have all values: no need for workers
+    if (!invalidate_cache &&
+        CanRecolor())
+    {
+        m_Statistics_AutoDepth = mcAutoDepth;
+        m_Statistics_AutoDepthProbeTime_ms = mcProbeTime_ms;
+        Recolor();
+        CALL_OUT("Recolored");
+        return;
     }
 
     // We're rendering
     m_IsWorking = true;
     m_IsStopped = false;
+    m_RunState.storeRelaxed(RUN_STATE_RUNNING);
 
     // Statistics stuff
     m_Statistics_StartTime =
         QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
+    m_Statistics_AutoDepth = mcAutoDepth;
+    m_Statistics_AutoDepthProbeTime_ms = mcProbeTime_ms;
+    m_Statistics_RecolorTime_ms = 0;
+    m_Statistics_IsRecolor = false;
 
     // We just started
     emit Started();
@@ -182,10 +375,55 @@ void FractalImage::Render(const QHash < QString, QString > mcParameters)
 
     // Kick off worker threads
     m_CurrentTile = 0;
+    m_CurrentTileBand = 0;
+    m_TileIDToCost.clear();
+    m_TileIDToPreviousCost.clear();
+    m_TotalCost = 0;
+    m_PreviousAverageCost = 0.;
+    SetUpPasses();
+    OpenJournal();
+    ResetPassStatistics();
+    SetUpDispatchOrder();
+    if (m_Parameters["storage save cache data to disk"] == "yes")
+    {
+        // Read cache data ahead of the workers
+        OpenCacheFile();
+
+        // Complete tiles in the cache file are better than moved ones with
+        // samples missing
+        const QList < int > partial_tiles = m_PartialTiles.values();
+        for (const int tile_id : partial_tiles)
+        {
+            if (m_CacheFile &&
+                m_CacheFile -> GetTileDepth(tile_id) >=
+                    m_TileIDToDepth[tile_id])
+            {
+                m_TileIDToColorData.remove(tile_id);
+                m_TileIDToBrightnessData.remove(tile_id);
+                m_TileIDToDepth.remove(tile_id);
+                m_PartialTiles.remove(tile_id);
+            }
+        }
+        StartPrefetching();
+    } else
+    {
+        CloseCacheFile();
+    }
+    // Threads (all cores but one unless configured otherwise)
+    m_NumberOfThreads = m_Parameters["render threads"].toInt();
+    if (m_NumberOfThreads <= 0)
+    {
+        m_NumberOfThreads = qMax(1, QThread::idealThreadCount() - 1);
+    }
+    m_AffinityCores = ParseCoreList(m_Parameters["render cpu affinity"]);
+
+    // Worker processes take units, too
+    SetUpWorkQueue();
+
     // !!! Should this be used?
     // !!! QHash < QString, QString > this_parameters = m_Parameters;
     int workers_started = 0;
-    while (workers_started < QThread::idealThreadCount() - 1)
+    while (workers_started < m_NumberOfThreads)
     {
         LaunchWorker();
         workers_started++;
@@ -197,97 +435,96 @@ void FractalImage::Render(const QHash < QString, QString > mcParameters)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Stop rendering
-void FractalImage::Stop()
+// Check if the image can be recolored from the cached values in memory
+bool FractalImage::CanRecolor() const
 {
     CALL_IN("");
 
-    m_IsStopped = true;
+    // Workers still running, or nothing (complete) kept in memory
+    if (m_IsWorking ||
+        m_Image.isNull() ||
+        m_Parameters["storage save cache data to memory"] != "yes" ||
+        !m_PartialTiles.isEmpty() ||
+        !GetShardName().isEmpty())
+    {
+        CALL_OUT("No");
+        return false;
+    }
+
+    // All tiles need values with (at least) the current depth; anything
+    // else needs workers to resume or recalculate orbits
+    const int depth = m_Parameters["depth"].toInt();
+    for (int tile_id = 0; tile_id < m_NumberOfTiles; tile_id++)
+    {
+        if (!m_TileIDToColorData.contains(tile_id) ||
+            m_TileIDToDepth.value(tile_id, depth) < depth)
+        {
+            CALL_OUT("Tile missing");
+            return false;
+        }
+    }
 
     CALL_OUT("");
+    return true;
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Launch a new worker
-void FractalImage::LaunchWorker()
+// Recolor image from the cached values in memory, without any workers
+void FractalImage::Recolor()
 {
     CALL_IN("");
 
-    // Check for no more work
-    if (m_CurrentTile >= m_NumberOfTiles ||
-        m_IsStopped)
-    {
-        if (m_TileIDToWorker.isEmpty())
-        {
-            // We're done!
-            m_IsWorking = false;
-            m_Statistics_FinishTime =
-                QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
-            if (m_Parameters["storage save picture"] == "yes")
-            {
-                SavePicture();
-            }
-            if (m_Parameters["storage save statistics"] == "yes")
-            {
-                SaveStatistics();
-            }
-            emit PeriodicUpdate();
-            emit Finished();
-        }
-
-        CALL_OUT("Done");
-        return;
-    }
-
-    // There's more work.
-    const int tile_id = m_CurrentTile++;
-
-    // Initialize parameter set for this time
-    QHash < QString, QString > parameters = m_Parameters;
-    parameters["tile id"] = QString("%1").arg(tile_id);
-    parameters["total pixel width"] = parameters["actual resolution width"];
-    parameters["total pixel height"] = parameters["actual resolution height"];
-    parameters["pixel x min"] =
-        QString("%1").arg(m_TileIDToPointXMin[tile_id]);
-    parameters["pixel x max"] =
-        QString("%1").arg(m_TileIDToPointXMax[tile_id]);
-    parameters["pixel y min"] =
-        QString("%1").arg(m_TileIDToPointYMin[tile_id]);
-    parameters["pixel y max"] =
-        QString("%1").arg(m_TileIDToPointYMax[tile_id]);
-
-    // Create new worker
-    FractalWorker * worker = new FractalWorker();
-    m_TileIDToWorker[tile_id] = worker;
-    worker -> Prepare(parameters);
-    connect (worker, SIGNAL(Finished(const int)),
-        this, SLOT(WorkerFinished(const int)));
+    // Statistics stuff (nothing gets calculated; points stay those of the
+    // cached values)
+    StopPrefetching();
+    m_IsStopped = false;
+    m_Statistics_StartTime =
+        QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
+    m_Statistics_ProcessingTime_ms = 0;
+    m_Statistics_TotalIterations = 0;
+    m_Statistics_IsRecolor = true;
+    emit Started();
 
-    // Check if we can read the tile data
-    if (m_Parameters["storage save cache data to disk"] == "yes")
+    // Threads (all cores but one unless configured otherwise)
+    int number_of_threads = m_Parameters["render threads"].toInt();
+    if (number_of_threads <= 0)
     {
-        // May or may not work
-        ReadCacheData(tile_id);
+        number_of_threads = qMax(1, QThread::idealThreadCount() - 1);
     }
 
-    // Let's see if we already have cached values for this tile
-    if (m_TileIDToColorData.contains(tile_id))
+    // Recolor all tiles
+    QElapsedTimer timer;
+    timer.start();
+    RecolorEngine engine(m_Parameters);
+    for (int tile_id = 0; tile_id < m_NumberOfTiles; tile_id++)
     {
-        worker -> SetCacheValues(m_TileIDToColorData[tile_id],
+        engine.AddTile(m_TileIDToPointXMin[tile_id],
+            m_TileIDToPointXMax[tile_id], m_TileIDToPointYMin[tile_id],
+            m_TileIDToPointYMax[tile_id], m_TileIDToColorData[tile_id],
             m_TileIDToBrightnessData[tile_id]);
     }
-
-    // Move worker to its own thread
-    QThread * thread = new QThread();
-    m_TileIDToWorkerThread[tile_id] = thread;
-    connect (thread, SIGNAL(started()),
-        worker, SLOT(Start()));
-    worker -> moveToThread(thread);
-
-    // Start thread
-    thread -> start();
+    // (Starting from the current image, so tiles whose values don't fit
+    // keep their pixels)
+    QImage image = m_Image.toImage().convertToFormat(QImage::Format_RGB32);
+    engine.Recolor(image, number_of_threads);
+    m_Image = QPixmap::fromImage(image);
+    m_Statistics_RecolorTime_ms = timer.elapsed();
+
+    // We're done
+    m_Statistics_FinishTime =
+        QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
+    if (m_Parameters["storage save picture"] == "yes")
+    {
+        SavePicture();
+    }
+    if (m_Parameters["storage save statistics"] == "yes")
+    {
+        SaveStatistics();
+    }
+    emit PeriodicUpdate();
+    emit Finished();
 
     CALL_OUT("");
 }
@@ -295,116 +532,184 @@ void FractalImage::LaunchWorker()
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Store results from a finished worker
-void FractalImage::WorkerFinished(const int mcTileID)
+// Recolor areas of the image, each with its own parameters
+bool FractalImage::RecolorAreas(const QList < QRect > & mcrAreas,
+    const QList < QHash < QString, QString > > & mcrAreaParameters,
+    const QList < QString > & mcrLabels)
 {
-    CALL_IN(QString("mcTileID=%1")
-        .arg(CALL_SHOW(mcTileID)));
+    CALL_IN("mcrAreas=..., mcrAreaParameters=..., mcrLabels=...");
 
-    // Lock while processing
-    m_Mutex.lock();
+    // Need all values of the current image
+    if (!CanRecolor())
+    {
+        CALL_OUT("Cannot recolor");
+        return false;
+    }
 
-    // Image portion
-    FractalWorker * worker = m_TileIDToWorker[mcTileID];
+    // Parameters of all areas (must not need different values)
+    QList < QHash < QString, QString > > area_parameters;
+    for (const QHash < QString, QString > & changes : mcrAreaParameters)
     {
-        QPainter painter(&m_Image);
-        QImage tile_image = worker -> GetImage();
-        painter.drawImage(m_TileIDToPointXMin[mcTileID],
-            m_TileIDToPointYMin[mcTileID], tile_image);
+        QHash < QString, QString > parameters = m_Parameters;
+        for (auto parameter_iterator = changes.constBegin();
+             parameter_iterator != changes.constEnd();
+             parameter_iterator++)
+        {
+            parameters[parameter_iterator.key()] = parameter_iterator.value();
+        }
+        if (WillParametersInvalidateCache(parameters))
+        {
+            CALL_OUT("Parameters need calculation");
+            return false;
+        }
+        area_parameters << parameters;
     }
 
-    // Cache data
-    if (m_Parameters["storage save cache data to disk"] == "yes")
+    // Threads (all cores but one unless configured otherwise)
+    int number_of_threads = m_Parameters["render threads"].toInt();
+    if (number_of_threads <= 0)
     {
-        SaveCacheData(mcTileID, worker -> GetColorData(),
-            worker -> GetBrightnessData());
+        number_of_threads = qMax(1, QThread::idealThreadCount() - 1);
     }
-    if (m_Parameters["storage save cache data to memory"] == "yes")
+
+    // One engine per area, all recolored in one batch
+    QElapsedTimer timer;
+    timer.start();
+    QList < RecolorEngine * > engines;
+    QList < const RecolorEngine * > batch;
+    for (int area = 0; area < mcrAreas.size(); area++)
     {
-        m_TileIDToColorData[mcTileID] = worker -> GetColorData();
-        m_TileIDToBrightnessData[mcTileID] = worker -> GetBrightnessData();
-    } else
+        RecolorEngine * engine = new RecolorEngine(area_parameters[area]);
+        engine -> SetArea(mcrAreas[area]);
+        for (int tile_id = 0; tile_id < m_NumberOfTiles; tile_id++)
+        {
+            engine -> AddTile(m_TileIDToPointXMin[tile_id],
+                m_TileIDToPointXMax[tile_id], m_TileIDToPointYMin[tile_id],
+                m_TileIDToPointYMax[tile_id], m_TileIDToColorData[tile_id],
+                m_TileIDToBrightnessData[tile_id]);
+        }
+        engines << engine;
+        batch << engine;
+    }
+    // (Pixels outside the areas, and of tiles whose values don't fit, stay
+    // as they are)
+    QImage image = m_Image.toImage().convertToFormat(QImage::Format_RGB32);
+    RecolorEngine::RecolorBatch(batch, image, number_of_threads);
+    qDeleteAll(engines);
+
+    // Labels (top left corner of each area, on a dark background)
+    QPainter painter(&image);
+    for (int area = 0; area < mcrAreas.size() && area < mcrLabels.size();
+         area++)
     {
-        m_TileIDToColorData.remove(mcTileID);
-        m_TileIDToBrightnessData.remove(mcTileID);
+        if (mcrLabels[area].isEmpty())
+        {
+            continue;
+        }
+        const QRect text_area = mcrAreas[area].adjusted(4, 4, -4, -4);
+        const QRect bounds = painter.boundingRect(text_area,
+            Qt::AlignLeft | Qt::AlignTop, mcrLabels[area]);
+        painter.fillRect(bounds.adjusted(-2, -1, 2, 1),
+            QColor(0, 0, 0, 160));
+        painter.setPen(Qt::white);
+        painter.drawText(text_area, Qt::AlignLeft | Qt::AlignTop,
+            mcrLabels[area]);
     }
+    painter.end();
+    m_Image = QPixmap::fromImage(image);
+    m_Statistics_ProcessingTime_ms = 0;
+    m_Statistics_TotalIterations = 0;
+    m_Statistics_RecolorTime_ms = timer.elapsed();
+    m_Statistics_IsRecolor = true;
+    emit PeriodicUpdate();
 
-    // Collect statistics
-    AddToStatistics(worker -> GetStatistics());
-
-    // Unlock
-    m_Mutex.unlock();
+    CALL_OUT("");
+    return true;
+}
 
-    // Trigger update
-    if (m_UpdateTimer.elapsed() > UPDATE_FREQUENCY)
-    {
-        emit PeriodicUpdate();
-        m_UpdateTimer.restart();
-    }
 
-    // End thread
-    m_TileIDToWorker[mcTileID]-> deleteLater();
-    m_TileIDToWorker.remove(mcTileID);
 
-    m_TileIDToWorkerThread[mcTileID] -> quit();
-    m_TileIDToWorkerThread[mcTileID] -> wait();
-    m_TileIDToWorkerThread[mcTileID] -> deleteLater();
-    m_TileIDToWorkerThread.remove(mcTileID);
+///////////////////////////////////////////////////////////////////////////////
+// Parse a list of cores like "0-7,16-23"
+QList < int > FractalImage::ParseCoreList(const QString & mcrCoreList) const
+{
+    CALL_IN(QString("mcrCoreList=%1")
+        .arg(CALL_SHOW(mcrCoreList)));
 
-    // Start a new worker
-    LaunchWorker();
+    QList < int > cores;
+    const QStringList ranges =
+        mcrCoreList.split(",", Qt::SkipEmptyParts);
+    for (const QString & range : ranges)
+    {
+        const QStringList limits = range.trimmed().split("-");
+        bool first_ok = false;
+        bool last_ok = false;
+        const int first_core = limits.first().toInt(&first_ok);
+        const int last_core = limits.last().toInt(&last_ok);
+        if (limits.size() > 2 ||
+            !first_ok ||
+            !last_ok ||
+            first_core < 0 ||
+            last_core < first_core)
+        {
+            const QString reason = tr("Invalid core list \"%1\"; workers "
+                "are not pinned.").arg(mcrCoreList);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return QList < int >();
+        }
+        for (int core = first_core; core <= last_core; core++)
+        {
+            cores << core;
+        }
+    }
 
     CALL_OUT("");
+    return cores;
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Save cache data to a file
-void FractalImage::SaveCacheData(const int mcTileID,
-    const QVector < double > & mcrColorData,
-    const QVector < double > & mcrBrightnessData) const
+// Stop rendering
+void FractalImage::Stop()
 {
-    CALL_IN(QString("mcTileID=%1, mcrColorData=%2, mcrBrightnessData=%3")
-        .arg(CALL_SHOW(mcTileID),
-             CALL_SHOW(mcrColorData),
-             CALL_SHOW(mcrBrightnessData)));
+    CALL_IN("");
 
-    // Base path for this fractal
-    const QString storage_directory = m_Parameters["storage directory"];
-    const QString fractal_name = m_Parameters["name"];
-    const int width = m_Parameters["actual resolution width"].toInt();
-    const int height = m_Parameters["actual resolution height"].toInt();
-    const QString directory = QString("%1/%2/%3x%4/cache")
-        .arg(storage_directory).arg(fractal_name).arg(width).arg(height);
-    const QString filename =
-        QString("%1/tile_%2.bin").arg(directory).arg(mcTileID);
+    m_IsStopped = true;
+    m_RunState.storeRelaxed(RUN_STATE_STOPPED);
 
-    // Don't do anything if file already exists (in which case we just read
-    // from it!)
-    if (QFile::exists(filename))
+    // Nothing more to read ahead (prefetchers may be waiting for room)
+    m_PrefetchMutex.lock();
+    m_PrefetchStopped = true;
+    m_PrefetchCondition.wakeAll();
+    m_PrefetchMutex.unlock();
+
+    // Render hasn't started yet if we're still choosing the depth
+    if (m_AutoDepthProbe -> IsRunning())
     {
-        CALL_OUT(tr("Saving data file unnecessary."));
-        return;
+        m_AutoDepthProbe -> Stop();
+        emit Finished();
     }
 
-    // Save cache data
-    QDir().mkpath(directory);
-    QFile out_file(filename);
-    if (!out_file.open(QFile::WriteOnly))
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Pause rendering
+void FractalImage::Pause()
+{
+    CALL_IN("");
+
+    if (!m_IsWorking ||
+        m_IsStopped)
     {
-        const QString reason =
-            tr("Could not open cache data \"%1\" file for saving.")
-                .arg(filename);
-        MessageLogger::Error(CALL_METHOD,
-            reason);
-        CALL_OUT(reason);
+        CALL_OUT("Not rendering");
         return;
     }
-    QDataStream out_stream(&out_file);
-    out_stream << mcrColorData;
-    out_stream << mcrBrightnessData;
-    out_file.close();
+    m_RunState.storeRelaxed(RUN_STATE_PAUSED);
 
     CALL_OUT("");
 }
@@ -412,37 +717,17 @@ void FractalImage::SaveCacheData(const int mcTileID,
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Read cache data to a file
-void FractalImage::ReadCacheData(const int mcTileID)
+// Resume rendering
+void FractalImage::Resume()
 {
-    CALL_IN(QString("mcTileID=%1")
-        .arg(CALL_SHOW(mcTileID)));
-
-    // Base path for this fractal
-    const QString storage_directory = m_Parameters["storage directory"];
-    const QString fractal_name = m_Parameters["name"];
-    const int width = m_Parameters["actual resolution width"].toInt();
-    const int height = m_Parameters["actual resolution height"].toInt();
-    const QString directory = QString("%1/%2/%3x%4/cache")
-        .arg(storage_directory,
-             fractal_name,
-             QString::number(width),
-             QString::number(height));
+    CALL_IN("");
 
-    // Read cache data
-    const QString filename = QString("%1/tile_%2.bin")
-        .arg(directory,
-             QString::number(mcTileID));
-    QFile in_file(filename);
-    if (!in_file.open(QFile::ReadOnly))
+    if (m_RunState.loadRelaxed() != RUN_STATE_PAUSED)
     {
-        CALL_OUT("No cache data for reading.");
+        CALL_OUT("Not paused");
         return;
     }
-    QDataStream in_stream(&in_file);
-    in_stream >> m_TileIDToColorData[mcTileID];
-    in_stream >> m_TileIDToBrightnessData[mcTileID];
-    in_file.close();
+    m_RunState.storeRelaxed(RUN_STATE_RUNNING);
 
     CALL_OUT("");
 }
@@ -450,30 +735,29 @@ void FractalImage::ReadCacheData(const int mcTileID)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Save picture
-void FractalImage::SavePicture() const
+// Set up tiles for the current resolution
+void FractalImage::SetUpTiles()
 {
     CALL_IN("");
 
-    // Base path for this fractal
-    const QString storage_directory = m_Parameters["storage directory"];
-    const QString fractal_name = m_Parameters["name"];
+    // Abbreviation
     const int width = m_Parameters["actual resolution width"].toInt();
     const int height = m_Parameters["actual resolution height"].toInt();
-    const QString directory = QString("%1/%2/%3x%4")
-        .arg(storage_directory,
-             fractal_name,
-             QString::number(width),
-             QString::number(height));
-    QDir().mkpath(directory);
-
-    // Save picture
-    const QString filename = QString("%1/%2.png")
-        .arg(directory,
-             fractal_name);
 
-    // Save it.
-    m_Image.save(filename, "png");
+    m_NumberOfTiles = 0;
+    for (int pixel_y = 0; pixel_y < height; pixel_y += TILE_SIZE)
+    {
+        const int tile_height = qMin(height - pixel_y, TILE_SIZE);
+        for (int pixel_x = 0; pixel_x < width; pixel_x += TILE_SIZE)
+        {
+            const int tile_width = qMin(width - pixel_x, TILE_SIZE);
+            m_TileIDToPointXMin[m_NumberOfTiles] = pixel_x;
+            m_TileIDToPointXMax[m_NumberOfTiles] = pixel_x + tile_width;
+            m_TileIDToPointYMin[m_NumberOfTiles] = pixel_y;
+            m_TileIDToPointYMax[m_NumberOfTiles] = pixel_y + tile_height;
+            m_NumberOfTiles++;
+        }
+    }
 
     CALL_OUT("");
 }
@@ -481,22 +765,25 @@ void FractalImage::SavePicture() const
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Save statistics
-void FractalImage::SaveStatistics() const
+// Order in which tiles are handed out to workers
+void FractalImage::SetUpDispatchOrder()
 {
     CALL_IN("");
 
-    // Base path for this fractal
-    const QString storage_directory = m_Parameters["storage directory"];
-    const QString fractal_name = m_Parameters["name"];
-    const int width = m_Parameters["actual resolution width"].toInt();
-    const int height = m_Parameters["actual resolution height"].toInt();
-    const QString directory = QString("%1/%2/%3x%4")
-        .arg(storage_directory).arg(fractal_name).arg(width).arg(height);
-    QDir().mkpath(directory);
-
-    // Save statistics
-    // !!!
+    // All tiles of this shard that aren't finished yet, in the preferred
+    // order (rows from the top left otherwise)
+    m_PrefetchMutex.lock();
+    m_DispatchOrder.clear();
+    for (int tile_id = 0; tile_id < m_NumberOfTiles; tile_id++)
+    {
+        if (!m_JournaledTiles.contains(tile_id) &&
+            IsTileInShard(tile_id))
+        {
+            m_DispatchOrder << tile_id;
+        }
+    }
+    SortDispatchOrder(0);
+    m_PrefetchMutex.unlock();
 
     CALL_OUT("");
 }
@@ -504,94 +791,2494 @@ void FractalImage::SaveStatistics() const
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Check if new parameters invalidate cache
-bool FractalImage::WillParametersInvalidateCache(
-    const QHash < QString, QString > mcParameters) const
+// Sort tiles that haven't been handed out (or read ahead) yet by priority
+// (prefetch mutex must be locked)
+void FractalImage::SortDispatchOrder(const int mcFirstPosition)
 {
-    CALL_IN(QString("mcParameters=%1")
-        .arg(CALL_SHOW(mcParameters)));
+    CALL_IN(QString("mcFirstPosition=%1")
+        .arg(CALL_SHOW(mcFirstPosition)));
+
+    const QString order = m_Parameters["render dispatch order"];
+    if (order == "center" ||
+        order == "mouse" ||
+        order == "viewport")
+    {
+        // Point to start from
+        const int width = m_Parameters["actual resolution width"].toInt();
+        const int height = m_Parameters["actual resolution height"].toInt();
+        double focus_x = width / 2.;
+        double focus_y = height / 2.;
+        if (order == "mouse" &&
+            m_FocusX >= 0)
+        {
+            focus_x = m_FocusX;
+            focus_y = m_FocusY;
+        }
+        if (order == "viewport" &&
+            !m_VisibleArea.isEmpty())
+        {
+            focus_x = m_VisibleArea.center().x();
+            focus_y = m_VisibleArea.center().y();
+        }
+
+        // Tiles closest to that point first (spiraling out); in viewport
+        // order, visible tiles come before all others
+        QHash < int, double > priority;
+        for (int position = mcFirstPosition;
+             position < m_DispatchOrder.size();
+             position++)
+        {
+            const int tile_id = m_DispatchOrder[position];
+            const QRect tile_area(m_TileIDToPointXMin[tile_id],
+                m_TileIDToPointYMin[tile_id],
+                m_TileIDToPointXMax[tile_id] - m_TileIDToPointXMin[tile_id],
+                m_TileIDToPointYMax[tile_id] - m_TileIDToPointYMin[tile_id]);
+            const double delta_x = tile_area.x() + tile_area.width() / 2. -
+                focus_x;
+            const double delta_y = tile_area.y() + tile_area.height() / 2. -
+                focus_y;
+            priority[tile_id] = sqrt(delta_x * delta_x + delta_y * delta_y);
+            if (order == "viewport" &&
+                !m_VisibleArea.isEmpty() &&
+                !m_VisibleArea.intersects(tile_area))
+            {
+                priority[tile_id] += width + height;
+            }
+        }
+        std::stable_sort(m_DispatchOrder.begin() + mcFirstPosition,
+            m_DispatchOrder.end(),
+            [&](const int mcTileID1, const int mcTileID2)
+            {
+                return priority[mcTileID1] < priority[mcTileID2];
+            });
+    }
+
+    // Where each tile is
+    for (int position = mcFirstPosition;
+         position < m_DispatchOrder.size();
+         position++)
+    {
+        m_TileIDToDispatchPosition[m_DispatchOrder[position]] = position;
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Mouse position (tiles around it are calculated first in "mouse" order)
+void FractalImage::SetFocus(const int mcPixelX, const int mcPixelY)
+{
+    CALL_IN(QString("mcPixelX=%1, mcPixelY=%2")
+        .arg(CALL_SHOW(mcPixelX),
+             CALL_SHOW(mcPixelY)));
+
+    // Only re-sort if the mouse moved to a different tile
+    const bool same_tile = (m_FocusX >= 0 &&
+        m_FocusX / TILE_SIZE == mcPixelX / TILE_SIZE &&
+        m_FocusY / TILE_SIZE == mcPixelY / TILE_SIZE);
+    m_FocusX = qMax(0, mcPixelX);
+    m_FocusY = qMax(0, mcPixelY);
+    if (same_tile ||
+        !m_IsWorking ||
+        m_Parameters["render dispatch order"] != "mouse")
+    {
+        CALL_OUT("No need to re-sort");
+        return;
+    }
+
+    m_PrefetchMutex.lock();
+    const int first_position =
+        m_CurrentTile + (m_CurrentTileBand > 0 ? 1 : 0);
+    SortDispatchOrder(m_PrefetchStopped ?
+        first_position : qMax(first_position, m_NextPrefetchTile));
+    m_PrefetchCondition.wakeAll();
+    m_PrefetchMutex.unlock();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Part of the image visible in the window (calculated first in "viewport"
+// order)
+void FractalImage::SetVisibleArea(const QRect & mcrArea)
+{
+    CALL_IN("mcrArea=...");
+
+    if (mcrArea == m_VisibleArea)
+    {
+        CALL_OUT("No change");
+        return;
+    }
+    m_VisibleArea = mcrArea;
+    if (!m_IsWorking ||
+        m_Parameters["render dispatch order"] != "viewport")
+    {
+        CALL_OUT("No need to re-sort");
+        return;
+    }
+
+    m_PrefetchMutex.lock();
+    const int first_position =
+        m_CurrentTile + (m_CurrentTileBand > 0 ? 1 : 0);
+    SortDispatchOrder(m_PrefetchStopped ?
+        first_position : qMax(first_position, m_NextPrefetchTile));
+    m_PrefetchCondition.wakeAll();
+    m_PrefetchMutex.unlock();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Launch a new worker
+void FractalImage::LaunchWorker()
+{
+    CALL_IN("");
+
+    // Check for no more work
+    int tile_id;
+    int row_min;
+    int row_max;
+    if (!NextUnit(tile_id, row_min, row_max))
+    {
+        if (m_UnitIDToWorker.isEmpty() &&
+            !HasRemoteUnitsOut())
+        {
+            // Check if there's another pass
+            if (!m_IsStopped &&
+                m_CurrentPass + 1 < m_PassDepths.size())
+            {
+                StartNextPass();
+                CALL_OUT("Next pass");
+                return;
+            }
+
+            // Units lost while stopping aren't handed out again
+            const QList < int > lost_tile_ids = (m_WorkQueueServer ?
+                m_WorkQueueServer -> DropLostUnits() : QList < int >());
+            for (const int lost_tile_id : lost_tile_ids)
+            {
+                m_TileIDToUnitsRunning.remove(lost_tile_id);
+                m_TileIDToMergedColorData.remove(lost_tile_id);
+                m_TileIDToMergedBrightnessData.remove(lost_tile_id);
+                m_PartialTiles << lost_tile_id;
+            }
+
+            // We're done!
+            StopPrefetching();
+            const bool is_shard = !GetShardName().isEmpty();
+            if (m_Parameters["storage save cache data to disk"] == "yes")
+            {
+                CollectCacheGarbage();
+            }
+            m_IsWorking = false;
+            m_Statistics_FinishTime =
+                QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
+            bool is_saved = true;
+            if (m_Parameters["storage save picture"] == "yes" &&
+                !is_shard)
+            {
+                is_saved = SavePicture();
+            }
+            if (m_Parameters["storage save statistics"] == "yes")
+            {
+                is_saved = SaveStatistics() && is_saved;
+            }
+
+            // The journal isn't needed anymore once everything is finished
+            // and saved - unless it's the output of a shard
+            if (!m_IsStopped &&
+                !is_shard &&
+                is_saved)
+            {
+                m_Journal -> Remove();
+            }
+            emit PeriodicUpdate();
+            emit Finished();
+        } else if (!m_IsStopped)
+        {
+            // Help with whatever is still running
+            SplitRunningUnit();
+        }
+
+        CALL_OUT("Done");
+        return;
+    }
+    LaunchUnit(tile_id, row_min, row_max);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Next unit of work (units of workers that went away come first)
+bool FractalImage::NextUnit(int & mrTileID, int & mrRowMin, int & mrRowMax)
+{
+    CALL_IN("mrTileID=..., mrRowMin=..., mrRowMax=...");
+
+    if (m_IsStopped)
+    {
+        CALL_OUT("Stopped");
+        return false;
+    }
+
+    // Lost unit (it's still counted as running for its tile)
+    if (m_WorkQueueServer &&
+        m_WorkQueueServer -> TakeLostUnit(mrTileID, mrRowMin, mrRowMax))
+    {
+        m_TileIDToUnitsRunning[mrTileID]--;
+        CALL_OUT("Lost unit");
+        return true;
+    }
+
+    if (m_CurrentTile >= m_DispatchOrder.size())
+    {
+        CALL_OUT("No more tiles");
+        return false;
+    }
+
+    // Expensive tiles are handed out in several bands of rows, each a
+    // multiple of the pixel step high
+    const int tile_id = m_DispatchOrder[m_CurrentTile];
+    const int tile_row_min = m_TileIDToPointYMin[tile_id];
+    const int tile_row_max = m_TileIDToPointYMax[tile_id];
+    const int step = m_PassSteps[m_CurrentPass];
+    const int number_of_bands = GetNumberOfBands(tile_id);
+    const int band_height = ((tile_row_max - tile_row_min +
+        number_of_bands - 1) / number_of_bands + step - 1) / step * step;
+    mrTileID = tile_id;
+    mrRowMin = tile_row_min + m_CurrentTileBand * band_height;
+    mrRowMax = qMin(mrRowMin + band_height, tile_row_max);
+    if (mrRowMax >= tile_row_max)
+    {
+        m_CurrentTile++;
+        m_CurrentTileBand = 0;
+    } else
+    {
+        m_CurrentTileBand++;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if there are units left to hand out
+bool FractalImage::HasUnitsLeft() const
+{
+    CALL_IN("");
+
+    const bool has_units_left = !m_IsStopped &&
+        ((m_WorkQueueServer &&
+          m_WorkQueueServer -> HasLostUnits()) ||
+         m_CurrentTile < m_DispatchOrder.size());
+
+    CALL_OUT("");
+    return has_units_left;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Parameters for the worker of a unit
+QHash < QString, QString > FractalImage::GetUnitParameters(
+    const int mcTileID, const int mcUnitID, const int mcRowMin,
+    const int mcRowMax) const
+{
+    CALL_IN(QString("mcTileID=%1, mcUnitID=%2, mcRowMin=%3, mcRowMax=%4")
+        .arg(CALL_SHOW(mcTileID),
+             CALL_SHOW(mcUnitID),
+             CALL_SHOW(mcRowMin),
+             CALL_SHOW(mcRowMax)));
+
+    const int tile_id = mcTileID;
+    QHash < QString, QString > parameters = m_Parameters;
+    parameters["tile id"] = QString("%1").arg(tile_id);
+    parameters["unit id"] = QString("%1").arg(mcUnitID);
+    parameters["total pixel width"] = parameters["actual resolution width"];
+    parameters["total pixel height"] = parameters["actual resolution height"];
+    parameters["pixel x min"] =
+        QString("%1").arg(m_TileIDToPointXMin[tile_id]);
+    parameters["pixel x max"] =
+        QString("%1").arg(m_TileIDToPointXMax[tile_id]);
+    parameters["pixel y min"] =
+        QString("%1").arg(m_TileIDToPointYMin[tile_id]);
+    parameters["pixel y max"] =
+        QString("%1").arg(m_TileIDToPointYMax[tile_id]);
+    parameters["pixel y start"] = QString("%1").arg(mcRowMin);
+    parameters["pixel y stop"] = QString("%1").arg(mcRowMax);
+    parameters["depth"] = QString("%1").arg(m_PassDepths[m_CurrentPass]);
+    parameters["pixel step"] = QString("%1").arg(m_PassSteps[m_CurrentPass]);
+    parameters["sample step"] =
+        QString("%1").arg(m_PassSampleSteps[m_CurrentPass]);
+    if (m_PartialTiles.contains(tile_id) &&
+        m_TileIDToDepth.value(tile_id) > m_PassDepths[m_CurrentPass])
+    {
+        // Samples moved into this tile have the full depth; missing ones
+        // need to be calculated the same way
+        parameters["depth"] = QString("%1").arg(m_TileIDToDepth[tile_id]);
+    }
+
+    CALL_OUT("");
+    return parameters;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Get the cached data of a tile into memory, if there is any
+void FractalImage::LoadTileCacheData(const int mcTileID)
+{
+    CALL_IN(QString("mcTileID=%1")
+        .arg(CALL_SHOW(mcTileID)));
+
+    const int tile_id = mcTileID;
+    if (m_Parameters["storage save cache data to disk"] != "yes" ||
+        m_TileIDToColorData.contains(tile_id))
+    {
+        CALL_OUT("Nothing to load");
+        return;
+    }
+
+    QVector < double > color_data;
+    QVector < double > brightness_data;
+    int depth = 0;
+    if (TakePrefetchedTile(tile_id, color_data, brightness_data, depth))
+    {
+        // Prefetcher got there first (but there may not be a file)
+        if (!color_data.isEmpty())
+        {
+            TileCacheEncoding::EncodeTile(color_data, brightness_data,
+                m_Parameters["storage cache memory format"],
+                m_TileIDToColorData[tile_id],
+                m_TileIDToBrightnessData[tile_id]);
+            m_TileIDToDepth[tile_id] = depth;
+        }
+    } else
+    {
+        // May or may not work
+        ReadCacheData(tile_id);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Launch a worker for some rows of a tile
+void FractalImage::LaunchUnit(const int mcTileID, const int mcRowMin,
+    const int mcRowMax)
+{
+    CALL_IN(QString("mcTileID=%1, mcRowMin=%2, mcRowMax=%3")
+        .arg(CALL_SHOW(mcTileID),
+             CALL_SHOW(mcRowMin),
+             CALL_SHOW(mcRowMax)));
+
+    const int tile_id = mcTileID;
+    const int unit_id = m_NextUnitID++;
+    m_UnitIDToTileID[unit_id] = tile_id;
+    m_TileIDToUnitsRunning[tile_id]++;
+
+    // Worker slot (decides the core, if workers are pinned)
+    int slot = 0;
+    while (m_BusySlots.contains(slot))
+    {
+        slot++;
+    }
+    m_BusySlots << slot;
+    m_UnitIDToSlot[unit_id] = slot;
+
+    // Initialize parameter set for this time
+    QHash < QString, QString > parameters =
+        GetUnitParameters(tile_id, unit_id, mcRowMin, mcRowMax);
+    if (!m_AffinityCores.isEmpty())
+    {
+        parameters["core"] =
+            QString("%1").arg(m_AffinityCores[slot % m_AffinityCores.size()]);
+    }
+
+    // Create new worker
+    FractalWorker * worker = new FractalWorker();
+    m_UnitIDToWorker[unit_id] = worker;
+    worker -> Prepare(parameters);
+    worker -> SetRunState(&m_RunState);
+    connect (worker, SIGNAL(Finished(const int)),
+        this, SLOT(WorkerFinished(const int)));
+
+    // Check if we can read the tile data
+    LoadTileCacheData(tile_id);
+
+    // Let's see if we already have cached values for this tile
+    if (m_TileIDToColorData.contains(tile_id))
+    {
+        // (Worker decodes them in its own thread)
+        worker -> SetEncodedCacheValues(m_TileIDToColorData[tile_id],
+            m_TileIDToBrightnessData[tile_id]);
+
+        // Worker resumes orbits if the data has a lower depth
+        worker -> SetCacheDepth(m_TileIDToDepth.value(tile_id,
+            parameters["depth"].toInt()));
+    }
+
+    // Move worker to its own thread
+    QThread * thread = new QThread();
+    m_UnitIDToWorkerThread[unit_id] = thread;
+    connect (thread, SIGNAL(started()),
+        worker, SLOT(Start()));
+    worker -> moveToThread(thread);
+
+    // Start thread
+    thread -> start();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Set up passes (coarse to fine, then increasing antialiasing, then shallow
+// to deep, resuming orbits in deeper passes)
+void FractalImage::SetUpPasses()
+{
+    CALL_IN("");
+
+    m_PassDepths.clear();
+    m_PassSteps.clear();
+    m_PassSampleSteps.clear();
+    m_CurrentPass = 0;
+
+    // Passes only make sense if there's a cache we can resume orbits from
+    const int depth = m_Parameters["depth"].toInt();
+    const int number_of_passes = m_Parameters["render depth passes"].toInt();
+    const bool has_cache =
+        m_Parameters["storage save cache data to disk"] == "yes" ||
+        m_Parameters["storage save cache data to memory"] == "yes";
+    if (number_of_passes > 1 &&
+        has_cache &&
+        CanResumeOrbits(m_Parameters))
+    {
+        // Each pass is DEPTH_PASS_FACTOR times deeper than the previous one
+        for (int pass = number_of_passes - 1; pass > 0; pass--)
+        {
+            int pass_depth = depth;
+            for (int count = 0; count < pass; count++)
+            {
+                pass_depth /= DEPTH_PASS_FACTOR;
+            }
+            if (pass_depth > 0 &&
+                (m_PassDepths.isEmpty() || pass_depth > m_PassDepths.last()))
+            {
+                m_PassDepths << pass_depth;
+            }
+        }
+    }
+    m_PassDepths << depth;
+    for (int pass = 0; pass < m_PassDepths.size(); pass++)
+    {
+        m_PassSteps << 1;
+        m_PassSampleSteps << 1;
+    }
+
+    // Samples have to be kept in memory in between the following passes
+    if (m_Parameters["storage save cache data to memory"] != "yes")
+    {
+        CALL_OUT("");
+        return;
+    }
+    const int first_depth = m_PassDepths.first();
+    const int oversampling = m_Parameters["oversampling"].toInt();
+
+    // Antialiasing passes start with one sample per pixel and add samples
+    // in between the ones already there (halving the sample step from pass
+    // to pass) with the depth of the first pass
+    if (m_Parameters["render progressive antialiasing"] == "yes")
+    {
+        for (int step = 2; step < 2 * oversampling; step *= 2)
+        {
+            m_PassDepths.prepend(first_depth);
+            m_PassSteps.prepend(1);
+            m_PassSampleSteps.prepend(step);
+        }
+    }
+
+    // Coarse passes calculate one sample every few pixels (halving the step
+    // from pass to pass); finer passes reuse them
+    for (int step = 2;
+         step <= m_Parameters["render progressive start step"].toInt();
+         step *= 2)
+    {
+        m_PassDepths.prepend(first_depth);
+        m_PassSteps.prepend(step);
+        m_PassSampleSteps.prepend(oversampling);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Key of the view a probe looks at
+QString FractalImage::GetAutoDepthProbeKey(
+    const QHash < QString, QString > & mcrParameters) const
+{
+    CALL_IN(QString("mcrParameters=%1")
+        .arg(CALL_SHOW(mcrParameters)));
+
+    QList < QString > relevant_parameters =
+        GetCacheRelevantParameters(mcrParameters);
+    relevant_parameters << "depth" << "auto depth fidelity" <<
+        "render auto depth probe size";
+    QString probe_key;
+    for (const QString & parameter : relevant_parameters)
+    {
+        probe_key += QString("%1=%2\n")
+            .arg(parameter,
+                 mcrParameters[parameter]);
+    }
+
+    CALL_OUT("");
+    return probe_key;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Probe is done: render with the depth it chose
+void FractalImage::AutoDepthProbeFinished()
+{
+    CALL_IN("");
+
+    // Same view, same result next time
+    m_AutoDepthProbeKey = GetAutoDepthProbeKey(m_AutoDepthProbeParameters);
+    m_AutoDepthProbeResult = m_AutoDepthProbe -> GetDepth();
+    StartRender(m_AutoDepthProbeParameters, m_AutoDepthProbeResult,
+        m_AutoDepthProbe -> GetProbeTime_ms());
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start next pass
+void FractalImage::StartNextPass()
+{
+    CALL_IN("");
+
+    // Start over with the next step or depth
+    m_CurrentPass++;
+    m_CurrentTile = 0;
+    m_CurrentTileBand = 0;
+    m_TileIDToPreviousCost = m_TileIDToCost;
+    m_PreviousAverageCost = 0.;
+    if (!m_TileIDToCost.isEmpty())
+    {
+        m_PreviousAverageCost = double(m_TotalCost) / m_TileIDToCost.size();
+    }
+    m_TileIDToCost.clear();
+    m_TotalCost = 0;
+    SetUpDispatchOrder();
+    ResetPassStatistics();
+    emit PeriodicUpdate();
+    m_UpdateTimer.restart();
+
+    // Kick off worker threads
+    if (m_Parameters["storage save cache data to disk"] == "yes")
+    {
+        StartPrefetching();
+    }
+    int workers_started = 0;
+    while (workers_started < m_NumberOfThreads)
+    {
+        LaunchWorker();
+        workers_started++;
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Store results from a finished worker
+void FractalImage::WorkerFinished(const int mcUnitID)
+{
+    CALL_IN(QString("mcUnitID=%1")
+        .arg(CALL_SHOW(mcUnitID)));
+
+    // Store results
+    FractalWorker * worker = m_UnitIDToWorker[mcUnitID];
+    UnitFinished(mcUnitID, worker -> GetRowMin(), worker -> GetRowMax(),
+        worker -> GetImage(), worker -> GetStopRow(), worker -> WasStopped(),
+        worker -> GetColorData(), worker -> GetBrightnessData(),
+        worker -> GetCacheDepth(), worker -> GetStatistics());
+
+    // End thread
+    m_UnitIDToWorker[mcUnitID]-> deleteLater();
+    m_UnitIDToWorker.remove(mcUnitID);
+    m_BusySlots.remove(m_UnitIDToSlot.take(mcUnitID));
+
+    m_UnitIDToWorkerThread[mcUnitID] -> quit();
+    m_UnitIDToWorkerThread[mcUnitID] -> wait();
+    m_UnitIDToWorkerThread[mcUnitID] -> deleteLater();
+    m_UnitIDToWorkerThread.remove(mcUnitID);
+
+    // Start a new worker
+    LaunchWorker();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Store results of a finished unit
+void FractalImage::UnitFinished(const int mcUnitID, const int mcRowMin,
+    const int mcRowMax, const QImage & mcrImage, const int mcStopRow,
+    const bool mcWasStopped, const QVector < double > & mcrColorData,
+    const QVector < double > & mcrBrightnessData, const int mcCacheDepth,
+    const QHash < QString, QString > & mcrStatistics)
+{
+    CALL_IN(QString("mcUnitID=%1, mcRowMin=%2, mcRowMax=%3, mcrImage=..., "
+        "mcStopRow=%4, mcWasStopped=%5, mcrColorData=..., "
+        "mcrBrightnessData=..., mcCacheDepth=%6, mcrStatistics=%7")
+        .arg(CALL_SHOW(mcUnitID),
+             CALL_SHOW(mcRowMin),
+             CALL_SHOW(mcRowMax),
+             CALL_SHOW(mcStopRow),
+             CALL_SHOW(mcWasStopped),
+             CALL_SHOW(mcCacheDepth),
+             CALL_SHOW(mcrStatistics)));
+
+    // Lock while processing
+    m_Mutex.lock();
+
+    // Image portion (only the rows of this unit that are complete)
+    const int tile_id = m_UnitIDToTileID.take(mcUnitID);
+    const int row_min = mcRowMin;
+    const int row_max = mcRowMax;
+    const int stop_row = mcStopRow;
+    if (stop_row > row_min)
+    {
+        QPainter painter(&m_Image);
+        const int tile_row_min = m_TileIDToPointYMin[tile_id];
+        painter.drawImage(QPoint(m_TileIDToPointXMin[tile_id], row_min),
+            mcrImage, QRect(0, row_min - tile_row_min, mcrImage.width(),
+                stop_row - row_min));
+    }
+    if (mcWasStopped)
+    {
+        m_StoppedTiles << tile_id;
+    }
+
+    // Collect samples of all units of this tile
+    MergeUnitData(tile_id, row_min, row_max, mcrColorData,
+        mcrBrightnessData);
+    const qint64 unit_cost = mcrStatistics["processing time ms"].toLongLong();
+    m_TileIDToCost[tile_id] += unit_cost;
+    m_TotalCost += unit_cost;
+    m_TileIDToUnitsRunning[tile_id]--;
+    const bool is_tile_done = (m_TileIDToUnitsRunning[tile_id] == 0);
+    if (is_tile_done)
+    {
+        m_TileIDToUnitsRunning.remove(tile_id);
+        const QVector < double > color_data =
+            m_TileIDToMergedColorData.take(tile_id);
+        const QVector < double > brightness_data =
+            m_TileIDToMergedBrightnessData.take(tile_id);
+
+        // Cache data (tile is complete now, unless this is a coarse pass
+        // or the tile has been stopped)
+        const bool is_coarse_pass = (m_PassSteps[m_CurrentPass] > 1 ||
+            m_PassSampleSteps[m_CurrentPass] > 1);
+        const bool is_stopped = m_StoppedTiles.remove(tile_id);
+        if (is_coarse_pass ||
+            is_stopped)
+        {
+            m_PartialTiles << tile_id;
+        } else
+        {
+            m_PartialTiles.remove(tile_id);
+        }
+        // (Earlier depth passes only need the file if tiles aren't kept in
+        // memory; otherwise every pass would add a block per tile)
+        const bool is_last_pass = (m_CurrentPass + 1 == m_PassDepths.size());
+        if (m_Parameters["storage save cache data to disk"] == "yes" &&
+            !is_coarse_pass &&
+            !is_stopped &&
+            (is_last_pass ||
+                m_Parameters["storage save cache data to memory"] != "yes"))
+        {
+            SaveCacheData(tile_id, color_data, brightness_data, mcCacheDepth);
+        }
+        if (m_Parameters["storage save cache data to memory"] == "yes")
+        {
+            TileCacheEncoding::EncodeTile(color_data, brightness_data,
+                m_Parameters["storage cache memory format"],
+                m_TileIDToColorData[tile_id],
+                m_TileIDToBrightnessData[tile_id]);
+            m_TileIDToDepth[tile_id] = mcCacheDepth;
+        } else
+        {
+            m_TileIDToColorData.remove(tile_id);
+            m_TileIDToBrightnessData.remove(tile_id);
+            m_TileIDToDepth.remove(tile_id);
+        }
+
+        // Tiles finished in the last pass go into the journal
+        if (m_Journal -> IsOpen() &&
+            !is_coarse_pass &&
+            !is_stopped &&
+            m_CurrentPass + 1 == m_PassDepths.size())
+        {
+            const QRect area(m_TileIDToPointXMin[tile_id],
+                m_TileIDToPointYMin[tile_id],
+                m_TileIDToPointXMax[tile_id] - m_TileIDToPointXMin[tile_id],
+                m_TileIDToPointYMax[tile_id] - m_TileIDToPointYMin[tile_id]);
+            const int oversampling = m_Parameters["oversampling"].toInt();
+            if (!m_Journal -> AddTile(tile_id,
+                m_Image.copy(area).toImage(), area.topLeft(), mcCacheDepth,
+                qint64(area.width()) * area.height() *
+                    oversampling * oversampling))
+            {
+                MessageLogger::Error(CALL_METHOD,
+                    m_Journal -> GetLastError());
+            }
+        }
+    }
+
+    // Collect statistics
+    AddToStatistics(mcrStatistics);
+
+    // Unlock
+    m_Mutex.unlock();
+
+    // Trigger update
+    if (m_UpdateTimer.elapsed() > UPDATE_FREQUENCY)
+    {
+        emit PeriodicUpdate();
+        m_UpdateTimer.restart();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Copy the rows of a finished unit into the merged data of its tile
+void FractalImage::MergeUnitData(const int mcTileID, const int mcRowMin,
+    const int mcRowMax, const QVector < double > & mcrColorData,
+    const QVector < double > & mcrBrightnessData)
+{
+    CALL_IN(QString("mcTileID=%1, mcRowMin=%2, mcRowMax=%3, "
+        "mcrColorData=..., mcrBrightnessData=...")
+        .arg(CALL_SHOW(mcTileID),
+             CALL_SHOW(mcRowMin),
+             CALL_SHOW(mcRowMax)));
+
+    // First unit to finish brings the whole tile (rows of other units are
+    // overwritten when they finish)
+    if (!m_TileIDToMergedColorData.contains(mcTileID))
+    {
+        m_TileIDToMergedColorData[mcTileID] = mcrColorData;
+        m_TileIDToMergedBrightnessData[mcTileID] = mcrBrightnessData;
+        CALL_OUT("");
+        return;
+    }
+
+    // Rows are contiguous in the cache
+    const int tile_row_min = m_TileIDToPointYMin[mcTileID];
+    const int tile_height = m_TileIDToPointYMax[mcTileID] - tile_row_min;
+    QVector < double > & color_data = m_TileIDToMergedColorData[mcTileID];
+    QVector < double > & brightness_data =
+        m_TileIDToMergedBrightnessData[mcTileID];
+    if (color_data.size() != mcrColorData.size() ||
+        brightness_data.size() != mcrBrightnessData.size() ||
+        tile_height <= 0)
+    {
+        const QString reason = tr("Units of tile %1 have different sizes")
+            .arg(mcTileID);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+    const int color_per_row = color_data.size() / tile_height;
+    std::copy(mcrColorData.constBegin() +
+            (mcRowMin - tile_row_min) * color_per_row,
+        mcrColorData.constBegin() + (mcRowMax - tile_row_min) * color_per_row,
+        color_data.begin() + (mcRowMin - tile_row_min) * color_per_row);
+    const int brightness_per_row = brightness_data.size() / tile_height;
+    std::copy(mcrBrightnessData.constBegin() +
+            (mcRowMin - tile_row_min) * brightness_per_row,
+        mcrBrightnessData.constBegin() +
+            (mcRowMax - tile_row_min) * brightness_per_row,
+        brightness_data.begin() +
+            (mcRowMin - tile_row_min) * brightness_per_row);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start the next unit for a worker in another process (unit ID, or -1 if
+// there's no work right now)
+int FractalImage::StartRemoteUnit(int & mrTileID, int & mrRowMin,
+    int & mrRowMax, QHash < QString, QString > & mrParameters,
+    QByteArray & mrColorData, QByteArray & mrBrightnessData,
+    int & mrCacheDepth)
+{
+    CALL_IN("mrTileID=..., mrRowMin=..., mrRowMax=..., mrParameters=..., "
+        "mrColorData=..., mrBrightnessData=..., mrCacheDepth=...");
+
+    // No new work while paused
+    int tile_id;
+    int row_min;
+    int row_max;
+    if (!m_IsWorking ||
+        m_RunState.loadRelaxed() != RUN_STATE_RUNNING ||
+        !NextUnit(tile_id, row_min, row_max))
+    {
+        CALL_OUT("No work");
+        return -1;
+    }
+
+    // Like a local unit, but without a worker slot
+    const int unit_id = m_NextUnitID++;
+    m_UnitIDToTileID[unit_id] = tile_id;
+    m_TileIDToUnitsRunning[tile_id]++;
+    mrTileID = tile_id;
+    mrRowMin = row_min;
+    mrRowMax = row_max;
+    mrParameters = GetUnitParameters(tile_id, unit_id, row_min, row_max);
+    mrParameters.remove("render work queue secret");
+
+    // Cached values go along (they are lossless whenever orbits are resumed,
+    // see CanResumeOrbits)
+    LoadTileCacheData(tile_id);
+    mrColorData = m_TileIDToColorData.value(tile_id);
+    mrBrightnessData = m_TileIDToBrightnessData.value(tile_id);
+    mrCacheDepth = m_TileIDToDepth.value(tile_id,
+        mrParameters["depth"].toInt());
+
+    CALL_OUT("");
+    return unit_id;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Unit calculated by a worker in another process is done
+void FractalImage::RemoteUnitFinished(const int mcUnitID,
+    const int mcRowMin, const int mcRowMax, const QImage & mcrImage,
+    const int mcStopRow, const bool mcWasStopped,
+    const QVector < double > & mcrColorData,
+    const QVector < double > & mcrBrightnessData, const int mcCacheDepth,
+    const QHash < QString, QString > & mcrStatistics)
+{
+    CALL_IN(QString("mcUnitID=%1, mcRowMin=%2, mcRowMax=%3, mcrImage=..., "
+        "mcStopRow=%4, mcWasStopped=%5, mcrColorData=..., "
+        "mcrBrightnessData=..., mcCacheDepth=%6, mcrStatistics=%7")
+        .arg(CALL_SHOW(mcUnitID),
+             CALL_SHOW(mcRowMin),
+             CALL_SHOW(mcRowMax),
+             CALL_SHOW(mcStopRow),
+             CALL_SHOW(mcWasStopped),
+             CALL_SHOW(mcCacheDepth),
+             CALL_SHOW(mcrStatistics)));
+
+    // Unit may be from a render that has been given up in the meantime
+    if (!m_UnitIDToTileID.contains(mcUnitID))
+    {
+        CALL_OUT("Unknown unit");
+        return;
+    }
+    UnitFinished(mcUnitID, mcRowMin, mcRowMax, mcrImage, mcStopRow,
+        mcWasStopped, mcrColorData, mcrBrightnessData, mcCacheDepth,
+        mcrStatistics);
+    LaunchIdleWorkers();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Worker in another process is gone (the work queue server hands its rows
+// out again; the unit is still counted as running for its tile until then)
+void FractalImage::RemoteUnitLost(const int mcUnitID)
+{
+    CALL_IN(QString("mcUnitID=%1")
+        .arg(CALL_SHOW(mcUnitID)));
+
+    if (!m_UnitIDToTileID.contains(mcUnitID))
+    {
+        CALL_OUT("Unknown unit");
+        return;
+    }
+    m_UnitIDToTileID.remove(mcUnitID);
+    LaunchIdleWorkers();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Image size and number of color and brightness values of a tile
+bool FractalImage::GetTileSize(const int mcTileID, QSize & mrImageSize,
+    int & mrNumberOfColorValues, int & mrNumberOfBrightnessValues) const
+{
+    CALL_IN(QString("mcTileID=%1, mrImageSize=..., "
+        "mrNumberOfColorValues=..., mrNumberOfBrightnessValues=...")
+        .arg(CALL_SHOW(mcTileID)));
+
+    if (!m_TileIDToPointXMin.contains(mcTileID))
+    {
+        CALL_OUT("Unknown tile");
+        return false;
+    }
+
+    // Same as the worker allocates them
+    mrImageSize = QSize(
+        m_TileIDToPointXMax[mcTileID] - m_TileIDToPointXMin[mcTileID],
+        m_TileIDToPointYMax[mcTileID] - m_TileIDToPointYMin[mcTileID]);
+    const int oversampling = m_Parameters["oversampling"].toInt();
+    const int values_per_sample =
+        (m_Parameters["storage cache orbit data"] == "yes" ? 3 : 1);
+    mrNumberOfBrightnessValues = mrImageSize.width() * mrImageSize.height() *
+        oversampling * oversampling;
+    mrNumberOfColorValues = mrNumberOfBrightnessValues * values_per_sample;
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start or stop listening for worker processes
+void FractalImage::SetUpWorkQueue()
+{
+    CALL_IN("");
+
+    const QString address = m_Parameters["render work queue address"];
+    if (address.isEmpty())
+    {
+        // (Units its workers still had are forgotten along with it; there
+        // aren't any between renders)
+        WorkQueueServer * work_queue_server = m_WorkQueueServer;
+        m_WorkQueueServer = nullptr;
+        delete work_queue_server;
+        CALL_OUT("No work queue");
+        return;
+    }
+
+    // Workers stay connected from one render to the next
+    if (!m_WorkQueueServer)
+    {
+        m_WorkQueueServer = new WorkQueueServer(this);
+    }
+    if (!m_WorkQueueServer -> Listen(address,
+            m_Parameters["render work queue secret"]))
+    {
+        const QString reason = m_WorkQueueServer -> GetLastError();
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Keep local workers busy (when remote units finish or get lost)
+void FractalImage::LaunchIdleWorkers()
+{
+    CALL_IN("");
+
+    while (m_IsWorking &&
+        m_UnitIDToWorker.size() < m_NumberOfThreads &&
+        HasUnitsLeft())
+    {
+        LaunchWorker();
+    }
+
+    // Last unit of the pass (or render) may have been a remote one
+    if (m_IsWorking &&
+        m_UnitIDToWorker.isEmpty() &&
+        !HasRemoteUnitsOut())
+    {
+        LaunchWorker();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if worker processes still have units of ours
+bool FractalImage::HasRemoteUnitsOut() const
+{
+    CALL_IN("");
+
+    const bool has_remote_units_out = (m_WorkQueueServer &&
+        m_WorkQueueServer -> HasUnitsOut());
+
+    CALL_OUT("");
+    return has_remote_units_out;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Hand half of the remaining rows of the running unit with the most rows
+// left to a new worker (so idle cores help with expensive tiles)
+void FractalImage::SplitRunningUnit()
+{
+    CALL_IN("");
+
+    // Unit with the most rows left
+    int split_unit_id = -1;
+    int most_rows_left = 1;
+    for (auto unit_iterator = m_UnitIDToWorker.constBegin();
+         unit_iterator != m_UnitIDToWorker.constEnd();
+         unit_iterator++)
+    {
+        const int rows_left = unit_iterator.value() -> GetRowsLeft();
+        if (rows_left > most_rows_left)
+        {
+            split_unit_id = unit_iterator.key();
+            most_rows_left = rows_left;
+        }
+    }
+    if (split_unit_id == -1)
+    {
+        CALL_OUT("Nothing worth splitting");
+        return;
+    }
+
+    // Split (the unit may have moved on in the meantime)
+    FractalWorker * worker = m_UnitIDToWorker[split_unit_id];
+    const int row_max = worker -> GetRowMax();
+    const int split_row = worker -> SplitRows(m_PassSteps[m_CurrentPass]);
+    if (split_row == -1)
+    {
+        CALL_OUT("Too late to split");
+        return;
+    }
+    LaunchUnit(m_UnitIDToTileID[split_unit_id], split_row, row_max);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of bands of rows a tile is split into (from its cost in the previous
+// pass)
+int FractalImage::GetNumberOfBands(const int mcTileID) const
+{
+    CALL_IN(QString("mcTileID=%1")
+        .arg(CALL_SHOW(mcTileID)));
+
+    // No previous pass (average is worked out when a pass starts)
+    if (m_PreviousAverageCost <= 0)
+    {
+        CALL_OUT("");
+        return 1;
+    }
+
+    // Tiles taking more than twice the average time are split
+    const int number_of_bands = qBound(1,
+        int(m_TileIDToPreviousCost.value(mcTileID) / m_PreviousAverageCost /
+            2),
+        MAX_TILE_BANDS);
+
+    CALL_OUT("");
+    return number_of_bands;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Save cache data to a file
+void FractalImage::SaveCacheData(const int mcTileID,
+    const QVector < double > & mcrColorData,
+    const QVector < double > & mcrBrightnessData, const int mcDepth) const
+{
+    CALL_IN(QString("mcTileID=%1, mcrColorData=%2, mcrBrightnessData=%3, "
+        "mcDepth=%4")
+        .arg(CALL_SHOW(mcTileID),
+             CALL_SHOW(mcrColorData),
+             CALL_SHOW(mcrBrightnessData),
+             CALL_SHOW(mcDepth)));
+
+    // Check if there's a cache file
+    if (!m_CacheFile)
+    {
+        CALL_OUT(tr("No cache file."));
+        return;
+    }
+
+    // Don't do anything if tile is already in there (in which case we just
+    // read from it!) - unless orbits have been resumed to a higher depth
+    if (m_CacheFile -> HasTile(mcTileID) &&
+        m_CacheFile -> GetTileDepth(mcTileID) >= mcDepth)
+    {
+        CALL_OUT(tr("Saving data file unnecessary."));
+        return;
+    }
+
+    // Save cache data
+    if (!m_CacheFile -> WriteTile(mcTileID, mcrColorData, mcrBrightnessData,
+        mcDepth))
+    {
+        const QString reason = m_CacheFile -> GetLastError();
+        MessageLogger::Error(CALL_METHOD,
+            reason);
+        CALL_OUT(reason);
+        return;
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read cache data from a file
+void FractalImage::ReadCacheData(const int mcTileID)
+{
+    CALL_IN(QString("mcTileID=%1")
+        .arg(CALL_SHOW(mcTileID)));
+
+    // Read cache data
+    QVector < double > color_data;
+    QVector < double > brightness_data;
+    int depth = 0;
+    if (!ReadCacheFile(mcTileID, color_data, brightness_data, depth))
+    {
+        CALL_OUT("No cache data for reading.");
+        return;
+    }
+    TileCacheEncoding::EncodeTile(color_data, brightness_data,
+        m_Parameters["storage cache memory format"],
+        m_TileIDToColorData[mcTileID], m_TileIDToBrightnessData[mcTileID]);
+    m_TileIDToDepth[mcTileID] = depth;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Save picture
+bool FractalImage::SavePicture()
+{
+    CALL_IN("");
+
+    // Base path for this fractal
+    const QString directory = GetOutputDirectory();
+    QDir().mkpath(directory);
+
+    // Save picture
+    const QString filename = QString("%1/%2.png")
+        .arg(directory,
+             m_Parameters["name"]);
+
+    // Save it.
+    if (!m_Image.save(filename, "png"))
+    {
+        m_OutputError = tr("Could not save picture to \"%1\".")
+            .arg(filename);
+        MessageLogger::Error(CALL_METHOD, m_OutputError);
+        CALL_OUT(m_OutputError);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Save statistics
+bool FractalImage::SaveStatistics()
+{
+    CALL_IN("");
+
+    // Base path for this fractal
+    const QString directory = GetOutputDirectory();
+    QDir().mkpath(directory);
+
+    // One "key=value" line per statistic, sorted by key
+    const QString filename = QString("%1/%2%3-statistics.txt")
+        .arg(directory,
+             m_Parameters["name"],
+             GetShardName());
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate |
+        QIODevice::Text))
+    {
+        m_OutputError = tr("Could not write statistics to \"%1\": %2")
+            .arg(filename,
+                 file.errorString());
+        MessageLogger::Error(CALL_METHOD, m_OutputError);
+        CALL_OUT(m_OutputError);
+        return false;
+    }
+    const QHash < QString, QString > statistics = GetStatistics();
+    QList < QString > keys = statistics.keys();
+    std::sort(keys.begin(), keys.end());
+    QTextStream out(&file);
+    for (const QString & key : keys)
+    {
+        out << key << "=" << statistics[key] << "\n";
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Why picture or statistics of the last render couldn't be saved
+QString FractalImage::GetOutputError() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_OutputError;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Directory pictures, statistics and shard journals are saved to
+QString FractalImage::GetOutputDirectory() const
+{
+    CALL_IN("");
+
+    // Batch jobs may say where their output goes
+    if (!m_Parameters["storage output directory"].isEmpty())
+    {
+        CALL_OUT("");
+        return m_Parameters["storage output directory"];
+    }
+
+    const QString directory = QString("%1/%2/%3x%4")
+        .arg(m_Parameters["storage directory"],
+             m_Parameters["name"],
+             m_Parameters["actual resolution width"],
+             m_Parameters["actual resolution height"]);
+
+    CALL_OUT("");
+    return directory;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if new parameters invalidate cache
+bool FractalImage::WillParametersInvalidateCache(
+    const QHash < QString, QString > mcParameters) const
+{
+    CALL_IN(QString("mcParameters=%1")
+        .arg(CALL_SHOW(mcParameters)));
+
+    // Check relevant parameters
+    for (const QString & parameter : GetCacheRelevantParameters(mcParameters))
+    {
+        if (mcParameters.contains(parameter) &&
+            m_Parameters.contains(parameter) &&
+            mcParameters[parameter] != m_Parameters[parameter])
+        {
+            CALL_OUT("");
+            return true;
+        }
+    }
+
+    // Special case: Switching the brightness value to "flat" will not
+    // invalidate the cache
+    if (mcParameters["brightness value"] == "flat")
+    {
+        CALL_OUT("");
+        return false;
+    }
+
+    // Any other change will
+    if (mcParameters["brightness value"] != m_Parameters["brightness value"])
+    {
+        CALL_OUT("");
+        return true;
+    }
+
+    // Otherwise, caches are safe!
+    CALL_OUT("");
+    return false;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Invalidate the cache
+void FractalImage::InvalidateCache()
+{
+    CALL_IN("");
+
+    // Remove from memory
+    m_TileIDToPointXMin.clear();
+    m_TileIDToPointXMax.clear();
+    m_TileIDToPointYMin.clear();
+    m_TileIDToPointYMax.clear();
+    m_TileIDToColorData.clear();
+    m_TileIDToBrightnessData.clear();
+    m_TileIDToDepth.clear();
+    m_PartialTiles.clear();
+    m_NumberOfTiles = 0;
+    m_CurrentTile = 0;
+
+    // Data on disk stays around (in case we come back to these parameters);
+    // we're just not using it anymore
+    CloseCacheFile();
+    m_Journal -> Close();
+    m_JournaledTiles.clear();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if new parameters show the current samples, only moved by whole
+// pixels (or cut off or extended by a different image size)
+bool FractalImage::GetPixelShift(
+    const QHash < QString, QString > & mcrParameters, int & mrShiftX,
+    int & mrShiftY) const
+{
+    CALL_IN(QString("mcrParameters=%1, mrShiftX=..., mrShiftY=...")
+        .arg(CALL_SHOW(mcrParameters)));
+
+    // Need samples to move
+    if (m_Parameters.isEmpty() ||
+        m_Image.isNull() ||
+        m_TileIDToPointXMin.isEmpty())
+    {
+        CALL_OUT("Nothing rendered yet");
+        return false;
+    }
+    if (m_TileIDToColorData.isEmpty() &&
+        !m_CacheFile)
+    {
+        CALL_OUT("No samples kept");
+        return false;
+    }
+
+    // Samples only move with the range in the regular projection
+    if (mcrParameters["projection"] == "log-polar" ||
+        m_Parameters["projection"] == "log-polar")
+    {
+        CALL_OUT("Exponential map");
+        return false;
+    }
+
+    // Everything but range and resolution has to be the same
+    QList < QString > relevant_parameters =
+        GetCacheRelevantParameters(mcrParameters);
+    relevant_parameters << "depth" << "brightness value";
+    const QSet < QString > moving_parameters { "real min", "real max",
+        "imag min", "imag max", "actual resolution width",
+        "actual resolution height" };
+    for (const QString & parameter : relevant_parameters)
+    {
+        if (!moving_parameters.contains(parameter) &&
+            mcrParameters[parameter] != m_Parameters[parameter])
+        {
+            CALL_OUT("Different parameters");
+            return false;
+        }
+    }
+
+    // Pixel sizes
+    const int width = m_Parameters["actual resolution width"].toInt();
+    const int height = m_Parameters["actual resolution height"].toInt();
+    const int new_width = mcrParameters["actual resolution width"].toInt();
+    const int new_height = mcrParameters["actual resolution height"].toInt();
+    if (width < 2 ||
+        height < 2 ||
+        new_width < 2 ||
+        new_height < 2)
+    {
+        CALL_OUT("Image too small");
+        return false;
+    }
+    const long double real_min =
+        StringHelper::ToLongDouble(m_Parameters["real min"]);
+    const long double imag_max =
+        StringHelper::ToLongDouble(m_Parameters["imag max"]);
+    const long double pixel_width = (StringHelper::ToLongDouble(
+        m_Parameters["real max"]) - real_min) / width;
+    const long double pixel_height = (imag_max - StringHelper::ToLongDouble(
+        m_Parameters["imag min"])) / height;
+    const long double new_real_min =
+        StringHelper::ToLongDouble(mcrParameters["real min"]);
+    const long double new_imag_max =
+        StringHelper::ToLongDouble(mcrParameters["imag max"]);
+    const long double new_pixel_width = (StringHelper::ToLongDouble(
+        mcrParameters["real max"]) - new_real_min) / new_width;
+    const long double new_pixel_height = (new_imag_max -
+        StringHelper::ToLongDouble(mcrParameters["imag min"])) / new_height;
+
+    // Same scale (deviation across the image less than the tolerance)
+    if (fabsl(new_pixel_width - pixel_width) * qMax(width, new_width) >
+            SHIFT_TOLERANCE * pixel_width ||
+        fabsl(new_pixel_height - pixel_height) * qMax(height, new_height) >
+            SHIFT_TOLERANCE * pixel_height)
+    {
+        CALL_OUT("Different scale");
+        return false;
+    }
+
+    // Moved by whole pixels
+    const long double shift_x = (new_real_min - real_min) / pixel_width;
+    const long double shift_y = (imag_max - new_imag_max) / pixel_height;
+    mrShiftX = int(roundl(shift_x));
+    mrShiftY = int(roundl(shift_y));
+    if (fabsl(shift_x - mrShiftX) > SHIFT_TOLERANCE ||
+        fabsl(shift_y - mrShiftY) > SHIFT_TOLERANCE)
+    {
+        CALL_OUT("Not moved by whole pixels");
+        return false;
+    }
+
+    // Some overlap
+    if (mrShiftX >= width ||
+        mrShiftX + new_width <= 0 ||
+        mrShiftY >= height ||
+        mrShiftY + new_height <= 0)
+    {
+        CALL_OUT("No overlap");
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Move current samples to the tiles of the new parameters (samples that
+// aren't available are NaN)
+void FractalImage::ShiftSamples(
+    const QHash < QString, QString > & mcrParameters, const int mcShiftX,
+    const int mcShiftY, QHash < int, QByteArray > & mrColorData,
+    QHash < int, QByteArray > & mrBrightnessData,
+    QSet < int > & mrPartialTiles) const
+{
+    CALL_IN(QString("mcrParameters=%1, mcShiftX=%2, mcShiftY=%3, "
+        "mrColorData=..., mrBrightnessData=..., mrPartialTiles=...")
+        .arg(CALL_SHOW(mcrParameters),
+             CALL_SHOW(mcShiftX),
+             CALL_SHOW(mcShiftY)));
+
+    // Abbreviations
+    const int width = mcrParameters["actual resolution width"].toInt();
+    const int height = mcrParameters["actual resolution height"].toInt();
+    const int old_width = m_Parameters["actual resolution width"].toInt();
+    const int old_height = m_Parameters["actual resolution height"].toInt();
+    const int old_tiles_per_row = (old_width + TILE_SIZE - 1) / TILE_SIZE;
+    const int oversampling = mcrParameters["oversampling"].toInt();
+    const int samples_per_pixel = oversampling * oversampling;
+    const int values_per_sample =
+        (mcrParameters["storage cache orbit data"] == "yes" ? 3 : 1);
+    const QString format = mcrParameters["storage cache memory format"];
+
+    // New tiles (same layout as in Render())
+    int tile_id = 0;
+    for (int pixel_y = 0; pixel_y < height; pixel_y += TILE_SIZE)
+    {
+        const int tile_height = qMin(height - pixel_y, TILE_SIZE);
+        for (int pixel_x = 0; pixel_x < width; pixel_x += TILE_SIZE)
+        {
+            const int tile_width = qMin(width - pixel_x, TILE_SIZE);
+            const int new_tile_id = tile_id++;
+
+            // Area of this tile in the current image
+            const int x_min = qMax(pixel_x + mcShiftX, 0);
+            const int x_max = qMin(pixel_x + tile_width + mcShiftX, old_width);
+            const int y_min = qMax(pixel_y + mcShiftY, 0);
+            const int y_max =
+                qMin(pixel_y + tile_height + mcShiftY, old_height);
+            if (x_min >= x_max ||
+                y_min >= y_max)
+            {
+                // Newly exposed
+                continue;
+            }
+
+            // Collect samples from the current tiles overlapping that area
+            const int number_of_samples =
+                tile_width * tile_height * samples_per_pixel;
+            QVector < double > color_data(
+                number_of_samples * values_per_sample, NAN);
+            QVector < double > brightness_data(number_of_samples, 0.);
+            int samples_found = 0;
+            for (int old_tile_y = y_min / TILE_SIZE;
+                 old_tile_y * TILE_SIZE < y_max;
+                 old_tile_y++)
+            {
+                for (int old_tile_x = x_min / TILE_SIZE;
+                     old_tile_x * TILE_SIZE < x_max;
+                     old_tile_x++)
+                {
+                    const int old_tile_id =
+                        old_tile_y * old_tiles_per_row + old_tile_x;
+                    QVector < double > old_color_data;
+                    QVector < double > old_brightness_data;
+                    if (!GetFullDepthTile(old_tile_id, old_color_data,
+                        old_brightness_data))
+                    {
+                        continue;
+                    }
+                    const int old_x_min = m_TileIDToPointXMin[old_tile_id];
+                    const int old_x_max = m_TileIDToPointXMax[old_tile_id];
+                    const int old_y_min = m_TileIDToPointYMin[old_tile_id];
+                    const int old_y_max = m_TileIDToPointYMax[old_tile_id];
+                    const int old_tile_width = old_x_max - old_x_min;
+
+                    // Copy pixel by pixel (all samples of a pixel are
+                    // stored together)
+                    const int copy_x_min = qMax(x_min, old_x_min);
+                    const int copy_x_max = qMin(x_max, old_x_max);
+                    const int copy_y_min = qMax(y_min, old_y_min);
+                    const int copy_y_max = qMin(y_max, old_y_max);
+                    for (int y = copy_y_min; y < copy_y_max; y++)
+                    {
+                        for (int x = copy_x_min; x < copy_x_max; x++)
+                        {
+                            const int old_index = samples_per_pixel *
+                                ((y - old_y_min) * old_tile_width +
+                                    x - old_x_min);
+                            const int new_index = samples_per_pixel *
+                                ((y - mcShiftY - pixel_y) * tile_width +
+                                    x - mcShiftX - pixel_x);
+                            std::copy_n(old_color_data.constData() +
+                                    old_index * values_per_sample,
+                                samples_per_pixel * values_per_sample,
+                                color_data.data() +
+                                    new_index * values_per_sample);
+                            std::copy_n(old_brightness_data.constData() +
+                                    old_index,
+                                samples_per_pixel,
+                                brightness_data.data() + new_index);
+                        }
+                    }
+                    samples_found += samples_per_pixel *
+                        (copy_x_max - copy_x_min) * (copy_y_max - copy_y_min);
+                }
+            }
+            if (samples_found == 0)
+            {
+                continue;
+            }
+
+            // Keep it
+            TileCacheEncoding::EncodeTile(color_data, brightness_data, format,
+                mrColorData[new_tile_id], mrBrightnessData[new_tile_id]);
+            if (samples_found < number_of_samples ||
+                HasMissingSamples(color_data, values_per_sample))
+            {
+                mrPartialTiles << new_tile_id;
+            }
+        }
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if the current samples are on the sample lattice of new parameters
+// (new sample index = offset + factor * current sample index, in both
+// directions; earlier renders of the same view at other resolutions are
+// found through the lattice index, see ImportLatticeSourceSamples())
+bool FractalImage::GetLatticeMapping(
+    const QHash < QString, QString > & mcrParameters, int & mrFactor,
+    int & mrOffsetX, int & mrOffsetY) const
+{
+    CALL_IN(QString("mcrParameters=%1, mrFactor=..., mrOffsetX=..., "
+        "mrOffsetY=...")
+        .arg(CALL_SHOW(mcrParameters)));
+
+    // Need samples to import
+    if (m_Parameters.isEmpty() ||
+        m_TileIDToPointXMin.isEmpty())
+    {
+        CALL_OUT("Nothing rendered yet");
+        return false;
+    }
+    if (m_TileIDToColorData.isEmpty() &&
+        !m_CacheFile)
+    {
+        CALL_OUT("No samples kept");
+        return false;
+    }
+
+    // Samples only line up with the range in the regular projection
+    if (mcrParameters["projection"] == "log-polar" ||
+        m_Parameters["projection"] == "log-polar")
+    {
+        CALL_OUT("Exponential map");
+        return false;
+    }
+
+    // Everything but range, resolution, and oversampling has to be the same
+    QList < QString > relevant_parameters =
+        GetCacheRelevantParameters(mcrParameters);
+    relevant_parameters << "depth" << "brightness value";
+    const QSet < QString > lattice_parameters { "real min", "real max",
+        "imag min", "imag max", "actual resolution width",
+        "actual resolution height", "oversampling" };
+    for (const QString & parameter : relevant_parameters)
+    {
+        if (!lattice_parameters.contains(parameter) &&
+            mcrParameters[parameter] != m_Parameters[parameter])
+        {
+            CALL_OUT("Different parameters");
+            return false;
+        }
+    }
+
+    // Sample distances
+    const int samples_x = m_Parameters["actual resolution width"].toInt() *
+        m_Parameters["oversampling"].toInt();
+    const int samples_y = m_Parameters["actual resolution height"].toInt() *
+        m_Parameters["oversampling"].toInt();
+    const int new_samples_x =
+        mcrParameters["actual resolution width"].toInt() *
+        mcrParameters["oversampling"].toInt();
+    const int new_samples_y =
+        mcrParameters["actual resolution height"].toInt() *
+        mcrParameters["oversampling"].toInt();
+    if (samples_x < 1 ||
+        samples_y < 1 ||
+        new_samples_x < 1 ||
+        new_samples_y < 1)
+    {
+        CALL_OUT("No samples");
+        return false;
+    }
+    const long double real_min =
+        StringHelper::ToLongDouble(m_Parameters["real min"]);
+    const long double imag_max =
+        StringHelper::ToLongDouble(m_Parameters["imag max"]);
+    const long double sample_width = (StringHelper::ToLongDouble(
+        m_Parameters["real max"]) - real_min) / samples_x;
+    const long double sample_height = (imag_max - StringHelper::ToLongDouble(
+        m_Parameters["imag min"])) / samples_y;
+    const long double new_real_min =
+        StringHelper::ToLongDouble(mcrParameters["real min"]);
+    const long double new_imag_max =
+        StringHelper::ToLongDouble(mcrParameters["imag max"]);
+    const long double new_sample_width = (StringHelper::ToLongDouble(
+        mcrParameters["real max"]) - new_real_min) / new_samples_x;
+    const long double new_sample_height = (new_imag_max -
+        StringHelper::ToLongDouble(mcrParameters["imag min"])) /
+        new_samples_y;
+    if (new_sample_width <= 0 ||
+        new_sample_height <= 0)
+    {
+        CALL_OUT("Empty range");
+        return false;
+    }
+
+    // Integer factor (deviation across the image less than the tolerance)
+    const long double factor_x = sample_width / new_sample_width;
+    const long double factor_y = sample_height / new_sample_height;
+    mrFactor = int(roundl(factor_x));
+    if (mrFactor < 1 ||
+        int(roundl(factor_y)) != mrFactor ||
+        fabsl(factor_x - mrFactor) * samples_x > SHIFT_TOLERANCE ||
+        fabsl(factor_y - mrFactor) * samples_y > SHIFT_TOLERANCE)
+    {
+        CALL_OUT("No integer factor");
+        return false;
+    }
+
+    // Some overlap
+    const long double offset_x = (real_min - new_real_min) / new_sample_width;
+    const long double offset_y =
+        (new_imag_max - imag_max) / new_sample_height;
+    if (offset_x >= new_samples_x ||
+        offset_x + (long double)(mrFactor) * samples_x <= 0 ||
+        offset_y >= new_samples_y ||
+        offset_y + (long double)(mrFactor) * samples_y <= 0)
+    {
+        CALL_OUT("No overlap");
+        return false;
+    }
+
+    // Integer offset
+    mrOffsetX = int(roundl(offset_x));
+    mrOffsetY = int(roundl(offset_y));
+    if (fabsl(offset_x - mrOffsetX) > SHIFT_TOLERANCE ||
+        fabsl(offset_y - mrOffsetY) > SHIFT_TOLERANCE)
+    {
+        CALL_OUT("Not on lattice");
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Distribute current samples to the tiles of new parameters whose lattice
+// contains them (samples that aren't available are NaN)
+void FractalImage::ImportLatticeSamples(
+    const QHash < QString, QString > & mcrParameters, const int mcFactor,
+    const int mcOffsetX, const int mcOffsetY, const int mcSourceWidth,
+    const int mcSourceHeight, const int mcSourceOversampling,
+    const std::function < bool (const int, QVector < double > &,
+        QVector < double > &) > & mcrReadSourceTile,
+    QHash < int, QByteArray > & mrColorData,
+    QHash < int, QByteArray > & mrBrightnessData,
+    QSet < int > & mrPartialTiles) const
+{
+    CALL_IN(QString("mcrParameters=%1, mcFactor=%2, mcOffsetX=%3, "
+        "mcOffsetY=%4, mcSourceWidth=%5, mcSourceHeight=%6, "
+        "mcSourceOversampling=%7, mcrReadSourceTile=..., mrColorData=..., "
+        "mrBrightnessData=..., mrPartialTiles=...")
+        .arg(CALL_SHOW(mcrParameters),
+             CALL_SHOW(mcFactor),
+             CALL_SHOW(mcOffsetX),
+             CALL_SHOW(mcOffsetY),
+             CALL_SHOW(mcSourceWidth),
+             CALL_SHOW(mcSourceHeight),
+             CALL_SHOW(mcSourceOversampling)));
+
+    // Abbreviations
+    const int width = mcrParameters["actual resolution width"].toInt();
+    const int height = mcrParameters["actual resolution height"].toInt();
+    const int oversampling = mcrParameters["oversampling"].toInt();
+    const int samples_per_pixel = oversampling * oversampling;
+    const int old_width = mcSourceWidth;
+    const int old_height = mcSourceHeight;
+    const int old_oversampling = mcSourceOversampling;
+    const int old_tiles_per_row = (old_width + TILE_SIZE - 1) / TILE_SIZE;
+    const int values_per_sample =
+        (mcrParameters["storage cache orbit data"] == "yes" ? 3 : 1);
+    const QString format = mcrParameters["storage cache memory format"];
+
+    // New tiles (same layout as in Render())
+    int tile_id = 0;
+    for (int pixel_y = 0; pixel_y < height; pixel_y += TILE_SIZE)
+    {
+        // Current tiles used by this row of new tiles (decoded only once)
+        QHash < int, QVector < double > > old_color_data;
+        QHash < int, QVector < double > > old_brightness_data;
+        QSet < int > old_tiles_missing;
+
+        const int tile_height = qMin(height - pixel_y, TILE_SIZE);
+        for (int pixel_x = 0; pixel_x < width; pixel_x += TILE_SIZE)
+        {
+            const int tile_width = qMin(width - pixel_x, TILE_SIZE);
+            const int new_tile_id = tile_id++;
+            const int number_of_samples =
+                tile_width * tile_height * samples_per_pixel;
+            QVector < double > color_data;
+            QVector < double > brightness_data;
+            int samples_found = 0;
+            for (int y = pixel_y; y < pixel_y + tile_height; y++)
+            {
+                for (int x = pixel_x; x < pixel_x + tile_width; x++)
+                {
+                    for (int delta_x = 0; delta_x < oversampling; delta_x++)
+                    {
+                        // Current sample column at this position (if any)
+                        const int sample_x =
+                            x * oversampling + delta_x - mcOffsetX;
+                        if (sample_x < 0 ||
+                            sample_x % mcFactor != 0 ||
+                            sample_x / mcFactor >= old_width *
+                                old_oversampling)
+                        {
+                            continue;
+                        }
+                        const int old_sample_x = sample_x / mcFactor;
+                        const int old_x = old_sample_x / old_oversampling;
+                        for (int delta_y = 0;
+                             delta_y < oversampling;
+                             delta_y++)
+                        {
+                            // Current sample row at this position (if any)
+                            const int sample_y =
+                                y * oversampling + delta_y - mcOffsetY;
+                            if (sample_y < 0 ||
+                                sample_y % mcFactor != 0 ||
+                                sample_y / mcFactor >= old_height *
+                                    old_oversampling)
+                            {
+                                continue;
+                            }
+                            const int old_sample_y = sample_y / mcFactor;
+                            const int old_y = old_sample_y / old_oversampling;
+
+                            // Current tile holding that sample
+                            const int old_tile_id =
+                                (old_y / TILE_SIZE) * old_tiles_per_row +
+                                old_x / TILE_SIZE;
+                            if (old_tiles_missing.contains(old_tile_id))
+                            {
+                                continue;
+                            }
+                            if (!old_color_data.contains(old_tile_id) &&
+                                !mcrReadSourceTile(old_tile_id,
+                                    old_color_data[old_tile_id],
+                                    old_brightness_data[old_tile_id]))
+                            {
+                                old_color_data.remove(old_tile_id);
+                                old_brightness_data.remove(old_tile_id);
+                                old_tiles_missing << old_tile_id;
+                                continue;
+                            }
+
+                            // Copy sample
+                            if (color_data.isEmpty())
+                            {
+                                color_data.fill(NAN,
+                                    number_of_samples * values_per_sample);
+                                brightness_data.fill(0., number_of_samples);
+                            }
+                            // (Same tile layout as in SetUpTiles())
+                            const int old_tile_x_min =
+                                (old_x / TILE_SIZE) * TILE_SIZE;
+                            const int old_tile_y_min =
+                                (old_y / TILE_SIZE) * TILE_SIZE;
+                            const int old_tile_width = qMin(
+                                old_width - old_tile_x_min, TILE_SIZE);
+                            const int old_index = ((old_y -
+                                old_tile_y_min) *
+                                old_tile_width + old_x -
+                                old_tile_x_min) *
+                                old_oversampling * old_oversampling +
+                                (old_sample_x % old_oversampling) *
+                                old_oversampling +
+                                old_sample_y % old_oversampling;
+                            const int new_index = ((y - pixel_y) *
+                                tile_width + x - pixel_x) *
+                                samples_per_pixel +
+                                delta_x * oversampling + delta_y;
+                            std::copy_n(old_color_data[old_tile_id]
+                                    .constData() +
+                                    old_index * values_per_sample,
+                                values_per_sample,
+                                color_data.data() +
+                                    new_index * values_per_sample);
+                            brightness_data[new_index] =
+                                old_brightness_data[old_tile_id][old_index];
+                            samples_found++;
+                        }
+                    }
+                }
+            }
+            if (samples_found == 0)
+            {
+                continue;
+            }
+
+            // Keep it
+            TileCacheEncoding::EncodeTile(color_data, brightness_data, format,
+                mrColorData[new_tile_id], mrBrightnessData[new_tile_id]);
+            if (samples_found < number_of_samples ||
+                HasMissingSamples(color_data, values_per_sample))
+            {
+                mrPartialTiles << new_tile_id;
+            }
+        }
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Import samples from the cache file of an earlier render of the current
+// view with fewer samples
+bool FractalImage::ImportLatticeSourceSamples(
+    QHash < int, QByteArray > & mrColorData,
+    QHash < int, QByteArray > & mrBrightnessData,
+    QSet < int > & mrPartialTiles) const
+{
+    CALL_IN("mrColorData=..., mrBrightnessData=..., mrPartialTiles=...");
+
+    // Samples only line up with the range in the regular projection; shards
+    // only calculate some of the tiles
+    if (m_Parameters["storage save cache data to disk"] != "yes" ||
+        m_Parameters["projection"] == "log-polar" ||
+        !GetShardName().isEmpty())
+    {
+        CALL_OUT("Not applicable");
+        return false;
+    }
+
+    // Earlier render of the same view
+    const int width = m_Parameters["actual resolution width"].toInt();
+    const int height = m_Parameters["actual resolution height"].toInt();
+    const int oversampling = m_Parameters["oversampling"].toInt();
+    QString filename;
+    QByteArray key;
+    int source_width = 0;
+    int source_height = 0;
+    int source_oversampling = 0;
+    if (!TileCacheFile::FindLatticeSource(GetCacheDirectory(),
+        GetLatticeKey(), width * oversampling, height * oversampling,
+        filename, key, source_width, source_height, source_oversampling))
+    {
+        CALL_OUT("No earlier render");
+        return false;
+    }
+    const int source_tiles_per_row = (source_width + TILE_SIZE - 1) /
+        TILE_SIZE;
+    const int source_number_of_tiles = source_tiles_per_row *
+        ((source_height + TILE_SIZE - 1) / TILE_SIZE);
+    TileCacheFile * source_file = TileCacheFile::Acquire(filename, key,
+        source_width, source_height, source_oversampling, TILE_SIZE,
+        source_number_of_tiles);
+    if (!source_file -> IsOpen())
+    {
+        TileCacheFile::Release(source_file);
+        CALL_OUT("Cannot open earlier render");
+        return false;
+    }
+
+    // Same range, so the lattices share their origin; only tiles that are
+    // complete with the current depth are used
+    const int factor = width * oversampling /
+        (source_width * source_oversampling);
+    const int depth = m_Parameters["depth"].toInt();
+    const int values_per_sample =
+        (m_Parameters["storage cache orbit data"] == "yes" ? 3 : 1);
+    auto read_source_tile = [this, source_file, source_width, source_height,
+        source_oversampling, source_tiles_per_row, depth,
+        values_per_sample](const int mcTileID,
+        QVector < double > & mrTileColorData,
+        QVector < double > & mrTileBrightnessData)
+    {
+        int file_depth = 0;
+        if (!source_file -> ReadTile(mcTileID, mrTileColorData,
+                mrTileBrightnessData, file_depth) ||
+            file_depth != depth)
+        {
+            return false;
+        }
+        const int tile_x_min = (mcTileID % source_tiles_per_row) * TILE_SIZE;
+        const int tile_y_min = (mcTileID / source_tiles_per_row) * TILE_SIZE;
+        const int number_of_samples =
+            qMin(source_width - tile_x_min, TILE_SIZE) *
+            qMin(source_height - tile_y_min, TILE_SIZE) *
+            source_oversampling * source_oversampling;
+        return (mrTileColorData.size() ==
+                number_of_samples * values_per_sample &&
+            mrTileBrightnessData.size() == number_of_samples &&
+            !HasMissingSamples(mrTileColorData, values_per_sample));
+    };
+    ImportLatticeSamples(m_Parameters, factor, 0, 0, source_width,
+        source_height, source_oversampling, read_source_tile, mrColorData,
+        mrBrightnessData, mrPartialTiles);
+    TileCacheFile::Release(source_file);
+
+    CALL_OUT("");
+    return !mrColorData.isEmpty();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Key of the current view regardless of resolution and oversampling
+QByteArray FractalImage::GetLatticeKey() const
+{
+    CALL_IN("");
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QList < QString > relevant_parameters =
+        GetCacheRelevantParameters(m_Parameters);
+    relevant_parameters << "brightness value";
+    relevant_parameters.removeAll("actual resolution width");
+    relevant_parameters.removeAll("actual resolution height");
+    relevant_parameters.removeAll("oversampling");
+    for (const QString & parameter : relevant_parameters)
+    {
+        hash.addData(QString("%1=%2\n")
+            .arg(parameter,
+                 m_Parameters[parameter]).toUtf8());
+    }
+
+    CALL_OUT("");
+    return hash.result();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if some samples of a tile haven't been calculated (NaN)
+bool FractalImage::HasMissingSamples(const QVector < double > & mcrColorData,
+    const int mcValuesPerSample) const
+{
+    CALL_IN(QString("mcrColorData=..., mcValuesPerSample=%1")
+        .arg(CALL_SHOW(mcValuesPerSample)));
+
+    for (int index = 0; index < mcrColorData.size();
+         index += mcValuesPerSample)
+    {
+        if (std::isnan(mcrColorData[index]))
+        {
+            CALL_OUT("");
+            return true;
+        }
+    }
+
+    CALL_OUT("");
+    return false;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Samples of a tile calculated with the full depth (from memory or the cache
+// file; some may be missing if the tile isn't finished)
+bool FractalImage::GetFullDepthTile(const int mcTileID,
+    QVector < double > & mrColorData,
+    QVector < double > & mrBrightnessData) const
+{
+    CALL_IN(QString("mcTileID=%1, mrColorData=..., mrBrightnessData=...")
+        .arg(CALL_SHOW(mcTileID)));
+
+    // Tiles that have been calculated with a lower depth pass don't count
+    // (samples of unfinished tiles may be missing, i.e. NaN)
+    const int depth = m_Parameters["depth"].toInt();
+    if (m_TileIDToColorData.contains(mcTileID))
+    {
+        if (m_TileIDToDepth.value(mcTileID) != depth)
+        {
+            CALL_OUT("Different depth");
+            return false;
+        }
+        mrColorData = TileCacheEncoding::Decode(m_TileIDToColorData[mcTileID]);
+        mrBrightnessData =
+            TileCacheEncoding::Decode(m_TileIDToBrightnessData[mcTileID]);
+    } else
+    {
+        int file_depth = 0;
+        if (!m_CacheFile ||
+            !m_CacheFile -> ReadTile(mcTileID, mrColorData, mrBrightnessData,
+                file_depth) ||
+            file_depth != depth)
+        {
+            CALL_OUT("No data");
+            return false;
+        }
+    }
+
+    // Check size
+    const int oversampling = m_Parameters["oversampling"].toInt();
+    const int number_of_samples = oversampling * oversampling *
+        (m_TileIDToPointXMax[mcTileID] - m_TileIDToPointXMin[mcTileID]) *
+        (m_TileIDToPointYMax[mcTileID] - m_TileIDToPointYMin[mcTileID]);
+    const int values_per_sample =
+        (m_Parameters["storage cache orbit data"] == "yes" ? 3 : 1);
+    if (mrColorData.size() != number_of_samples * values_per_sample ||
+        mrBrightnessData.size() != number_of_samples)
+    {
+        CALL_OUT("Unexpected size");
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Parameters that change cached values
+QList < QString > FractalImage::GetCacheRelevantParameters(
+    const QHash < QString, QString > & mcrParameters) const
+{
+    CALL_IN(QString("mcrParameters=%1")
+        .arg(CALL_SHOW(mcrParameters)));
 
     // Relevant parameters which will cause invalidation of cache if changed
     QList < QString > relevant_parameters;
     relevant_parameters << "fractal type" << "real min" << "real max" <<
-        "imag min" << "imag max" << "depth" << "escape radius" <<
-        "oversampling" << "julia real" << "julia imag" << "color base value" <<
+        "imag min" << "imag max" << "escape radius" <<
+        "oversampling" << "julia real" << "julia imag" <<
         "brightness fold change" << "brightness regularity" <<
         "brightness exponent" << "actual resolution width" <<
-        "actual resolution height" << "precision";
+        "actual resolution height" << "precision" <<
+        "storage cache orbit data" << "storage cache resume orbits" <<
+        "projection" << "log polar center real" << "log polar center imag" <<
+        "log polar radius min" << "log polar radius max";
+
+    // Orbits cut off by the depth are resumed when the depth is raised, so
+    // the depth doesn't matter then
+    if (!CanResumeOrbits(mcrParameters))
+    {
+        relevant_parameters << "depth";
+    }
 
-    // Check them out
+    // Color value is derived from cached orbit data, so the color base value
+    // doesn't matter then
+    if (mcrParameters["storage cache orbit data"] != "yes")
+    {
+        relevant_parameters << "color base value";
+    }
+
+    CALL_OUT("");
+    return relevant_parameters;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if cached orbits can be resumed with a higher depth
+bool FractalImage::CanResumeOrbits(
+    const QHash < QString, QString > & mcrParameters) const
+{
+    CALL_IN(QString("mcrParameters=%1")
+        .arg(CALL_SHOW(mcrParameters)));
+
+    // (Current z is only kept in double precision, and continuing orbits
+    // from quantized values would give different results)
+    const bool can_resume =
+        mcrParameters["storage cache orbit data"] == "yes" &&
+        mcrParameters["storage cache resume orbits"] == "yes" &&
+        mcrParameters["storage cache memory format"] == "double" &&
+        mcrParameters["precision"] != "long double";
+
+    CALL_OUT("");
+    return can_resume;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Key identifying the cached values for the current parameters
+QByteArray FractalImage::GetCacheKey() const
+{
+    CALL_IN("");
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QList < QString > relevant_parameters =
+        GetCacheRelevantParameters(m_Parameters);
+    relevant_parameters << "brightness value";
     for (const QString & parameter : relevant_parameters)
     {
-        if (mcParameters.contains(parameter) &&
-            m_Parameters.contains(parameter) &&
-            mcParameters[parameter] != m_Parameters[parameter])
+        hash.addData(QString("%1=%2\n")
+            .arg(parameter,
+                 m_Parameters[parameter]).toUtf8());
+    }
+
+    CALL_OUT("");
+    return hash.result();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Directory holding the cache files
+QString FractalImage::GetCacheDirectory() const
+{
+    CALL_IN("");
+
+    // Shared by all fractals using the same storage directory
+    const QString directory = QString("%1/cache")
+        .arg(m_Parameters["storage directory"]);
+
+    CALL_OUT("");
+    return directory;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Open cache file for current parameters
+void FractalImage::OpenCacheFile()
+{
+    CALL_IN("");
+
+    // Done with the previous one
+    CloseCacheFile();
+
+    // Cache files are named after their key, so identical renders share them
+    const QByteArray key = GetCacheKey();
+    // (Shards get their own, so nodes sharing a storage directory don't
+    // write to the same file)
+    const QString filename = QString("%1/%2%3.bin")
+        .arg(GetCacheDirectory(),
+             QString::fromLatin1(key.toHex()),
+             GetShardName());
+
+    // Open it
+    const int width = m_Parameters["actual resolution width"].toInt();
+    const int height = m_Parameters["actual resolution height"].toInt();
+    m_CacheFile = TileCacheFile::Acquire(filename, key, width, height,
+        m_Parameters["oversampling"].toInt(), TILE_SIZE, m_NumberOfTiles);
+    if (!m_CacheFile -> IsOpen())
+    {
+        const QString reason = m_CacheFile -> GetLastError();
+        MessageLogger::Error(CALL_METHOD,
+            reason);
+        CloseCacheFile();
+        CALL_OUT(reason);
+        return;
+    }
+
+    // Later renders of this view with more samples can find it (shards
+    // only have some of the tiles)
+    if (GetShardName().isEmpty() &&
+        m_Parameters["projection"] != "log-polar")
+    {
+        TileCacheFile::AddToLatticeIndex(GetCacheDirectory(), GetLatticeKey(),
+            filename, key, width, height,
+            m_Parameters["oversampling"].toInt());
+    }
+
+    // Make room for the new one
+    CollectCacheGarbage();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Close cache file
+void FractalImage::CloseCacheFile()
+{
+    CALL_IN("");
+
+    TileCacheFile::Release(m_CacheFile);
+    m_CacheFile = nullptr;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Remove least recently used cache files beyond the size limit
+void FractalImage::CollectCacheGarbage()
+{
+    CALL_IN("");
+
+    // Check if there is a limit
+    const qint64 size_limit =
+        m_Parameters["storage cache size limit mb"].toLongLong() * 1024 * 1024;
+    if (size_limit <= 0)
+    {
+        CALL_OUT("No size limit.");
+        return;
+    }
+
+    TileCacheFile::CollectGarbage(GetCacheDirectory(), size_limit);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Open journal for the current parameters, and put the tiles it has finished
+// into the image
+void FractalImage::OpenJournal()
+{
+    CALL_IN("");
+
+    // Only for fixed resolution renders (shards always have one; it's their
+    // output)
+    const QString shard_name = GetShardName();
+    if (shard_name.isEmpty() &&
+        (m_Parameters["storage render journal"] != "yes" ||
+         m_Parameters["use fixed resolution"] != "yes"))
+    {
+        m_Journal -> Close();
+        m_JournaledTiles.clear();
+        CALL_OUT("No journal");
+        return;
+    }
+
+    // Journals are named after their key, like cache files; those of shards
+    // go next to the picture, where ShardMerger looks for them
+    const QByteArray key = GetJournalKey();
+    QString filename;
+    if (shard_name.isEmpty())
+    {
+        // (Batch jobs name their journal, since two jobs may render the
+        // same thing, and each removes its journal when it's done)
+        const QString directory =
+            QString("%1/journal").arg(m_Parameters["storage directory"]);
+        QString journal_name = QString::fromLatin1(key.toHex());
+        if (!m_Parameters["storage render journal name"].isEmpty())
         {
-            CALL_OUT("");
-            return true;
+            journal_name = m_Parameters["storage render journal name"];
         }
+        filename = QString("%1/%2.journal")
+            .arg(directory,
+                 journal_name);
+
+        // Journals of renders that were stopped, or whose parameters have
+        // changed since, are never picked up again
+        RenderJournal::CollectGarbage(directory, filename,
+            m_Parameters["storage render journal max age days"].toInt());
+    } else
+    {
+        filename = QString("%1/%2%3.journal")
+            .arg(GetOutputDirectory(),
+                 m_Parameters["name"],
+                 shard_name);
     }
 
-    // Special case: Switching the brightness value to "flat" will not
-    // invalidate the cache
-    if (mcParameters["brightness value"] == "flat")
+    // Same journal as before (finished tiles are in the image already)
+    if (m_Journal -> IsOpen() &&
+        QFileInfo(filename).absoluteFilePath() ==
+            QFileInfo(m_Journal -> GetFilename()).absoluteFilePath())
     {
-        CALL_OUT("");
-        return false;
+        const QList < int > finished_tiles = m_Journal -> GetFinishedTiles();
+        m_JournaledTiles = QSet < int >(finished_tiles.begin(),
+            finished_tiles.end());
+        CALL_OUT("Journal is open already");
+        return;
     }
 
-    // Any other change will
-    if (mcParameters["brightness value"] != m_Parameters["brightness value"])
+    // Open it
+    m_JournaledTiles.clear();
+    const int width = m_Parameters["actual resolution width"].toInt();
+    const int height = m_Parameters["actual resolution height"].toInt();
+    if (!m_Journal -> Open(filename, key, width, height))
     {
-        CALL_OUT("");
-        return true;
+        const QString reason = m_Journal -> GetLastError();
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
+    // Put finished tiles into the image as they are (without calculating or
+    // coloring anything)
+    QPainter painter(&m_Image);
+    const QList < int > finished_tiles = m_Journal -> GetFinishedTiles();
+    for (const int tile_id : finished_tiles)
+    {
+        const QImage tile_image = m_Journal -> GetTileImage(tile_id);
+        if (tile_image.isNull() ||
+            m_Journal -> GetTileArea(tile_id).topLeft() !=
+                QPoint(m_TileIDToPointXMin.value(tile_id),
+                    m_TileIDToPointYMin.value(tile_id)))
+        {
+            continue;
+        }
+        painter.drawImage(m_Journal -> GetTileArea(tile_id).topLeft(),
+            tile_image);
+        m_JournaledTiles << tile_id;
+        m_PartialTiles.remove(tile_id);
     }
 
-    // Otherwise, caches are safe!
     CALL_OUT("");
-    return false;
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Invalidate the cache
-void FractalImage::InvalidateCache()
+// Key identifying the pixels of the current parameters (everything except
+// rendering and storage options)
+QByteArray FractalImage::GetJournalKey() const
 {
     CALL_IN("");
 
-    // Remove from memory
-    m_TileIDToPointXMin.clear();
-    m_TileIDToPointXMax.clear();
-    m_TileIDToPointYMin.clear();
-    m_TileIDToPointYMax.clear();
-    m_TileIDToColorData.clear();
-    m_TileIDToBrightnessData.clear();
-    m_NumberOfTiles = 0;
-    m_CurrentTile = 0;
+    QList < QString > keys = m_Parameters.keys();
+    std::sort(keys.begin(), keys.end());
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const QString & key : keys)
+    {
+        if (key.startsWith("render ") ||
+            key.startsWith("storage "))
+        {
+            continue;
+        }
+        hash.addData(QString("%1=%2\n")
+            .arg(key,
+                 m_Parameters[key]).toUtf8());
+    }
+
+    CALL_OUT("");
+    return hash.result();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if a tile belongs to the shard being rendered (every tile does if
+// there are no shards)
+bool FractalImage::IsTileInShard(const int mcTileID) const
+{
+    CALL_IN(QString("mcTileID=%1")
+        .arg(CALL_SHOW(mcTileID)));
+
+    // Tiles are dealt out round robin, so every shard gets about the same
+    // share of every region of the image
+    const int shard_count = m_Parameters["render shard count"].toInt();
+    const int shard_index = m_Parameters["render shard index"].toInt();
+    if (shard_count <= 1)
+    {
+        CALL_OUT("No shards");
+        return true;
+    }
+
+    CALL_OUT("");
+    return (mcTileID % shard_count) + 1 == shard_index;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Suffix for the files of the shard being rendered ("" if there are no
+// shards)
+QString FractalImage::GetShardName() const
+{
+    CALL_IN("");
 
-    // Remove from disk
-    // Base path for this fractal
-    const QString storage_directory = m_Parameters["storage directory"];
-    const QString fractal_name = m_Parameters["name"];
-    const int width = m_Parameters["actual resolution width"].toInt();
-    const int height = m_Parameters["actual resolution height"].toInt();
-    const QString directory = QString("%1/%2/%3x%4/cache")
-        .arg(storage_directory).arg(fractal_name).arg(width).arg(height);
-    int tile_id = 0;
-    while (true)
+    const int shard_count = m_Parameters["render shard count"].toInt();
+    if (shard_count <= 1)
     {
-        const QString filename =
-            QString("%1/tile_%2.bin").arg(directory).arg(tile_id);
-        if (!QFile::exists(filename))
-        {
-            break;
-        }
-        QFile::remove(filename);
-        tile_id++;
+        CALL_OUT("No shards");
+        return QString();
     }
 
     CALL_OUT("");
+    return QString("-shard-%1-of-%2")
+        .arg(m_Parameters["render shard index"].toInt())
+        .arg(shard_count);
 }
 
 
@@ -607,7 +3294,14 @@ QString FractalImage::GetRenderStatus() const
         CALL_OUT("");
         return "stopped";
     }
-    if (m_IsWorking)
+    if (m_IsWorking &&
+        m_RunState.loadRelaxed() == RUN_STATE_PAUSED)
+    {
+        CALL_OUT("");
+        return "paused";
+    }
+    if (m_IsWorking ||
+        m_AutoDepthProbe -> IsRunning())
     {
         CALL_OUT("");
         return "working";
@@ -619,6 +3313,20 @@ QString FractalImage::GetRenderStatus() const
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Run state
+int FractalImage::GetRunState() const
+{
+    CALL_IN("");
+
+    const int run_state = m_RunState.loadRelaxed();
+
+    CALL_OUT("");
+    return run_state;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Color value at a particular position
 double FractalImage::GetColorValueAt(const int mcPixelX, const int mcPixelY)
@@ -684,6 +3392,424 @@ double FractalImage::GetBrightnessValueAt(const int mcPixelX,
 
 
 
+// ========================================================== Cache prefetching
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start prefetcher threads
+void FractalImage::StartPrefetching()
+{
+    CALL_IN("");
+
+    // Just in case some are still running
+    StopPrefetching();
+
+    // Settings
+    const int number_of_threads =
+        m_Parameters["storage prefetch threads"].toInt();
+    if (number_of_threads < 1)
+    {
+        CALL_OUT("Prefetching is turned off.");
+        return;
+    }
+    m_PrefetchBudget =
+        m_Parameters["storage prefetch memory budget mb"].toLongLong() *
+            1024 * 1024;
+    if (m_PrefetchBudget <= 0)
+    {
+        CALL_OUT("No memory for prefetching.");
+        return;
+    }
+
+    // Start where the workers start
+    m_PrefetchMutex.lock();
+    m_NextPrefetchTile = m_CurrentTile;
+    m_PrefetchedBytes = 0;
+    m_PrefetchStopped = false;
+    m_PrefetchSkip.clear();
+    for (auto tile_iterator = m_TileIDToColorData.keyBegin();
+         tile_iterator != m_TileIDToColorData.keyEnd();
+         tile_iterator++)
+    {
+        m_PrefetchSkip += *tile_iterator;
+    }
+    m_PrefetchMutex.unlock();
+
+    // Start prefetchers
+    for (int count = 0; count < number_of_threads; count++)
+    {
+        CachePrefetcher * prefetcher = new CachePrefetcher(this);
+        m_Prefetchers << prefetcher;
+        QThread * thread = new QThread();
+        m_PrefetcherThreads << thread;
+        connect (thread, SIGNAL(started()),
+            prefetcher, SLOT(Start()));
+        prefetcher -> moveToThread(thread);
+        thread -> start();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Stop prefetcher threads
+void FractalImage::StopPrefetching()
+{
+    CALL_IN("");
+
+    // Let prefetchers know they're done
+    m_PrefetchMutex.lock();
+    m_PrefetchStopped = true;
+    m_PrefetchCondition.wakeAll();
+    m_PrefetchMutex.unlock();
+
+    // Wait for them to finish their current tile
+    for (int index = 0; index < m_PrefetcherThreads.size(); index++)
+    {
+        QThread * thread = m_PrefetcherThreads[index];
+        thread -> quit();
+        thread -> wait();
+
+        // Thread is gone, so it's safe to delete these directly
+        delete m_Prefetchers[index];
+        delete thread;
+    }
+    m_PrefetcherThreads.clear();
+    m_Prefetchers.clear();
+
+    // Drop whatever hasn't been used
+    m_PrefetchInProgress.clear();
+    m_PrefetchSkip.clear();
+    m_PrefetchedColorData.clear();
+    m_PrefetchedBrightnessData.clear();
+    m_PrefetchedDepth.clear();
+    m_PrefetchedBytes = 0;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Next tile to be read ahead (waits while the memory budget is used up);
+// PREFETCH_DONE otherwise
+int FractalImage::NextTileToPrefetch()
+{
+    QMutexLocker locker(&m_PrefetchMutex);
+
+    // Check if there's anything left to do
+    if (m_PrefetchStopped ||
+        m_NextPrefetchTile >= m_DispatchOrder.size())
+    {
+        return PREFETCH_DONE;
+    }
+
+    // Don't go beyond the memory budget (wait for workers to take tiles,
+    // for the order to change, or for the end)
+    while (!m_PrefetchStopped &&
+        m_PrefetchedBytes >= m_PrefetchBudget)
+    {
+        m_PrefetchCondition.wait(&m_PrefetchMutex);
+    }
+    if (m_PrefetchStopped ||
+        m_NextPrefetchTile >= m_DispatchOrder.size())
+    {
+        return PREFETCH_DONE;
+    }
+
+    // No need to read what's already in memory
+    while (m_NextPrefetchTile < m_DispatchOrder.size() &&
+        m_PrefetchSkip.contains(m_DispatchOrder[m_NextPrefetchTile]))
+    {
+        m_NextPrefetchTile++;
+    }
+    if (m_NextPrefetchTile >= m_DispatchOrder.size())
+    {
+        return PREFETCH_DONE;
+    }
+
+    const int tile_id = m_DispatchOrder[m_NextPrefetchTile++];
+    m_PrefetchInProgress += tile_id;
+    return tile_id;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read cache data for a tile from the cache file
+bool FractalImage::ReadCacheFile(const int mcTileID,
+    QVector < double > & mrColorData, QVector < double > & mrBrightnessData,
+    int & mrDepth) const
+{
+    if (!m_CacheFile)
+    {
+        return false;
+    }
+    return m_CacheFile -> ReadTile(mcTileID, mrColorData, mrBrightnessData,
+        mrDepth);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Store data that has been read ahead
+void FractalImage::StorePrefetchedTile(const int mcTileID,
+    const bool mcSuccess, const QVector < double > & mcrColorData,
+    const QVector < double > & mcrBrightnessData, const int mcDepth)
+{
+    QMutexLocker locker(&m_PrefetchMutex);
+
+    m_PrefetchInProgress -= mcTileID;
+    if (mcSuccess &&
+        !m_PrefetchStopped)
+    {
+        m_PrefetchedColorData[mcTileID] = mcrColorData;
+        m_PrefetchedBrightnessData[mcTileID] = mcrBrightnessData;
+        m_PrefetchedDepth[mcTileID] = mcDepth;
+        m_PrefetchedBytes += (mcrColorData.size() +
+            mcrBrightnessData.size()) * qint64(sizeof(double));
+    }
+
+    // Somebody may be waiting for this tile
+    m_PrefetchCondition.wakeAll();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Get data that has been read ahead (false if prefetcher didn't get to it)
+bool FractalImage::TakePrefetchedTile(const int mcTileID,
+    QVector < double > & mrColorData, QVector < double > & mrBrightnessData,
+    int & mrDepth)
+{
+    CALL_IN(QString("mcTileID=%1, mrColorData=..., mrBrightnessData=..., "
+        "mrDepth=...")
+        .arg(CALL_SHOW(mcTileID)));
+
+    QMutexLocker locker(&m_PrefetchMutex);
+
+    // Check if prefetching is active at all
+    if (m_PrefetchStopped)
+    {
+        CALL_OUT("Not prefetching.");
+        return false;
+    }
+
+    // Check if prefetcher hasn't gotten to this tile yet
+    const int position = m_TileIDToDispatchPosition[mcTileID];
+    if (m_NextPrefetchTile <= position)
+    {
+        // Prefetcher doesn't need to read this one anymore
+        m_NextPrefetchTile = position + 1;
+        CALL_OUT("Tile has not been prefetched.");
+        return false;
+    }
+
+    // Tile may currently be read
+    while (m_PrefetchInProgress.contains(mcTileID))
+    {
+        m_PrefetchCondition.wait(&m_PrefetchMutex);
+    }
+
+    // There may not have been a file
+    if (m_PrefetchedColorData.contains(mcTileID))
+    {
+        mrColorData = m_PrefetchedColorData.take(mcTileID);
+        mrBrightnessData = m_PrefetchedBrightnessData.take(mcTileID);
+        mrDepth = m_PrefetchedDepth.take(mcTileID);
+        m_PrefetchedBytes -= (mrColorData.size() +
+            mrBrightnessData.size()) * qint64(sizeof(double));
+
+        // There's room for another tile now
+        m_PrefetchCondition.wakeAll();
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+// ====================================================================== Views
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Keep the current view (if it is complete) for showing it again later
+void FractalImage::KeepView(const bool mcKeepSamples)
+{
+    CALL_IN(QString("mcKeepSamples=%1")
+        .arg(CALL_SHOW(mcKeepSamples)));
+
+    // Only finished images
+    if (m_ViewKey.isEmpty() ||
+        m_Image.isNull() ||
+        m_IsWorking ||
+        m_IsStopped ||
+        m_CurrentTile < m_DispatchOrder.size() ||
+        !m_PartialTiles.isEmpty())
+    {
+        CALL_OUT("No complete view");
+        return;
+    }
+
+    // Keep it (data is shared with the current view until that changes)
+    const QString key = m_ViewKey;
+    m_KeptViews.removeAll(key);
+    m_KeptViews << key;
+    m_KeptViewToParameters[key] = m_Parameters;
+    m_KeptViewToImage[key] = m_Image;
+    m_KeptViewToStatistics[key] = GetStatistics();
+    qint64 size = qint64(m_Image.width()) * m_Image.height() * 4;
+    if (mcKeepSamples)
+    {
+        m_KeptViewToColorData[key] = m_TileIDToColorData;
+        m_KeptViewToBrightnessData[key] = m_TileIDToBrightnessData;
+        m_KeptViewToDepth[key] = m_TileIDToDepth;
+        for (const QByteArray & data : m_TileIDToColorData)
+        {
+            size += data.size();
+        }
+        for (const QByteArray & data : m_TileIDToBrightnessData)
+        {
+            size += data.size();
+        }
+    } else
+    {
+        m_KeptViewToColorData.remove(key);
+        m_KeptViewToBrightnessData.remove(key);
+        m_KeptViewToDepth.remove(key);
+    }
+    m_KeptViewToSize[key] = size;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Show a kept view for the given parameters (false if there is none)
+bool FractalImage::RestoreView(
+    const QHash < QString, QString > & mcrParameters)
+{
+    CALL_IN(QString("mcrParameters=%1")
+        .arg(CALL_SHOW(mcrParameters)));
+
+    // Check if we have it
+    const QString key = GetViewKey(mcrParameters);
+    if (!m_KeptViewToParameters.contains(key))
+    {
+        CALL_OUT("View not kept");
+        return false;
+    }
+    if (m_IsWorking ||
+        m_AutoDepthProbe -> IsRunning())
+    {
+        CALL_OUT("Still rendering");
+        return false;
+    }
+
+    // Most recently used now
+    m_KeptViews.removeAll(key);
+    m_KeptViews << key;
+
+    // Replace current view
+    StopPrefetching();
+    InvalidateCache();
+    ResetStatistics();
+    m_Parameters = m_KeptViewToParameters[key];
+    m_ViewKey = key;
+    m_Image = m_KeptViewToImage[key];
+    SetUpTiles();
+    if (m_KeptViewToColorData.contains(key))
+    {
+        m_TileIDToColorData = m_KeptViewToColorData[key];
+        m_TileIDToBrightnessData = m_KeptViewToBrightnessData[key];
+        m_TileIDToDepth = m_KeptViewToDepth[key];
+    }
+    m_PassDepths.clear();
+    m_PassDepths << m_Parameters["depth"].toInt();
+    m_PassSteps.clear();
+    m_PassSteps << 1;
+    m_PassSampleSteps.clear();
+    m_PassSampleSteps << 1;
+    m_CurrentPass = 0;
+    m_Statistics_Restored = m_KeptViewToStatistics[key];
+
+    // Nothing left to do (if samples haven't been kept, a later render with
+    // the same parameters calculates them again); the dispatch order has to
+    // match the restored tiles, since it tells whether the view is complete
+    SetUpDispatchOrder();
+    m_CurrentTile = m_DispatchOrder.size();
+    m_IsStopped = false;
+    emit Started();
+    emit PeriodicUpdate();
+    emit Finished();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Drop least recently used views beyond a memory budget
+void FractalImage::LimitKeptViews(const qint64 mcMemoryBudget)
+{
+    CALL_IN(QString("mcMemoryBudget=%1")
+        .arg(CALL_SHOW(mcMemoryBudget)));
+
+    qint64 total_size = 0;
+    for (const qint64 size : m_KeptViewToSize)
+    {
+        total_size += size;
+    }
+    while (!m_KeptViews.isEmpty() &&
+        total_size > mcMemoryBudget)
+    {
+        const QString key = m_KeptViews.takeFirst();
+        total_size -= m_KeptViewToSize[key];
+        m_KeptViewToParameters.remove(key);
+        m_KeptViewToImage.remove(key);
+        m_KeptViewToColorData.remove(key);
+        m_KeptViewToBrightnessData.remove(key);
+        m_KeptViewToDepth.remove(key);
+        m_KeptViewToStatistics.remove(key);
+        m_KeptViewToSize.remove(key);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Key identifying a view (all parameters the image was requested with)
+QString FractalImage::GetViewKey(
+    const QHash < QString, QString > & mcrParameters) const
+{
+    CALL_IN(QString("mcrParameters=%1")
+        .arg(CALL_SHOW(mcrParameters)));
+
+    QList < QString > keys = mcrParameters.keys();
+    std::sort(keys.begin(), keys.end());
+    QString view_key;
+    for (const QString & key : keys)
+    {
+        view_key += QString("%1=%2\n")
+            .arg(key,
+                 mcrParameters[key]);
+    }
+
+    CALL_OUT("");
+    return view_key;
+}
+
+
+
 // ========================================================== Render statistics
 
 
@@ -694,17 +3820,47 @@ QHash < QString, QString > FractalImage::GetStatistics() const
 {
     CALL_IN("");
 
+    // Statistics of a view that has been restored are those of its render
+    if (!m_Statistics_Restored.isEmpty())
+    {
+        CALL_OUT("Restored view");
+        return m_Statistics_Restored;
+    }
+
     QHash < QString, QString > statistics;
     statistics["start time"] = m_Statistics_StartTime;
     statistics["finish time"] = m_Statistics_FinishTime;
     statistics["processing time ms"] =
         QString("%1").arg(m_Statistics_ProcessingTime_ms);
-    statistics["number of threads"] =
-        QString("%1").arg(QThread::idealThreadCount() - 1);
+    statistics["number of threads"] = QString("%1").arg(m_NumberOfThreads);
+    QList < int > cores = m_Statistics_CoreToUnits.keys();
+    std::sort(cores.begin(), cores.end());
+    QStringList worker_cores;
+    for (const int core : cores)
+    {
+        worker_cores << QString("%1 (node %2): %3")
+            .arg(core)
+            .arg(m_Statistics_CoreToNumaNode[core])
+            .arg(m_Statistics_CoreToUnits[core]);
+    }
+    statistics["units per core at start"] = worker_cores.join(", ");
+    if (m_WorkQueueServer)
+    {
+        statistics["remote workers"] =
+            m_WorkQueueServer -> GetWorkerStatus().join("; ");
+    }
 
-    const int width = m_Parameters["actual resolution width"].toInt();
-    const int height = m_Parameters["actual resolution height"].toInt();
-    const int total_pixels = width * height;
+    // (Shards only have their own tiles)
+    qint64 total_pixels = 0;
+    for (int tile_id = 0; tile_id < m_NumberOfTiles; tile_id++)
+    {
+        if (IsTileInShard(tile_id))
+        {
+            total_pixels += qint64(m_TileIDToPointXMax[tile_id] -
+                m_TileIDToPointXMin[tile_id]) *
+                (m_TileIDToPointYMax[tile_id] - m_TileIDToPointYMin[tile_id]);
+        }
+    }
     statistics["total pixels long"] = QString("%1").arg(total_pixels);
     statistics["total pixels short"] =
         StringHelper::ConvertNumber(total_pixels);
@@ -736,12 +3892,45 @@ QHash < QString, QString > FractalImage::GetStatistics() const
     statistics["total iterations short"] =
         StringHelper::ConvertNumber(m_Statistics_TotalIterations);
 
+    // Progress over all passes (points describe the current pass, which
+    // only calculates a subset of the samples unless it's the last one)
+    qint64 pass_points = 0;
+    for (int tile_id = 0; tile_id < m_NumberOfTiles; tile_id++)
+    {
+        if (IsTileInShard(tile_id))
+        {
+            pass_points += GetTilePassPoints(tile_id);
+        }
+    }
+    const int number_of_passes = qMax(1, int(m_PassDepths.size()));
+    const int finished_passes = qMin(m_CurrentPass, number_of_passes - 1);
+    double pass_fraction = 0.;
+    if (pass_points > 0)
+    {
+        pass_fraction =
+            qMin(1., double(m_Statistics_PointsFinished) / pass_points);
+    }
     statistics["percent complete"] = QString("%1")
-        .arg(double(m_Statistics_PointsFinished)/double(total_points) * 100.);
+        .arg((finished_passes + pass_fraction) / number_of_passes * 100.);
 
     statistics["min depth"] = QString("%1").arg(m_Statistics_MinDepth);
     statistics["max depth"] = QString("%1").arg(m_Statistics_MaxDepth);
 
+    if (m_Statistics_AutoDepth > 0)
+    {
+        statistics["auto depth"] =
+            QString("%1").arg(m_Statistics_AutoDepth);
+        statistics["auto depth probe time ms"] =
+            QString("%1").arg(m_Statistics_AutoDepthProbeTime_ms);
+    }
+
+    if (m_Statistics_IsRecolor)
+    {
+        statistics["recolored"] = "yes";
+        statistics["recolor time ms"] =
+            QString("%1").arg(m_Statistics_RecolorTime_ms);
+    }
+
     if (isnan(m_Statistics_MinColorValue) ||
         isnan(m_Statistics_MaxColorValue))
     {
@@ -790,12 +3979,76 @@ void FractalImage::ResetStatistics()
     m_Statistics_TotalIterations = 0;
     m_Statistics_MinDepth = 0;
     m_Statistics_MaxDepth = 0;
+    m_Statistics_AutoDepth = 0;
+    m_Statistics_AutoDepthProbeTime_ms = 0;
+    m_Statistics_RecolorTime_ms = 0;
+    m_Statistics_IsRecolor = false;
+    m_Statistics_CoreToUnits.clear();
+    m_Statistics_CoreToNumaNode.clear();
+    m_Statistics_MinColorValue = NAN;
+    m_Statistics_MaxColorValue = NAN;
+    m_Statistics_MinBrightnessValue = NAN;
+    m_Statistics_MaxBrightnessValue = NAN;
+    m_Statistics_Restored.clear();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Reset statistics that describe the samples of a pass (every pass goes
+// over all samples again; time and iterations keep adding up)
+void FractalImage::ResetPassStatistics()
+{
+    CALL_IN("");
+
+    m_Statistics_FirstTile = true;
+    m_Statistics_PointsFinished = 0;
+    m_Statistics_PointsInSet = 0;
+    m_Statistics_PointsOutOfBounds = 0;
+    m_Statistics_MinDepth = 0;
+    m_Statistics_MaxDepth = 0;
     m_Statistics_MinColorValue = NAN;
     m_Statistics_MaxColorValue = NAN;
     m_Statistics_MinBrightnessValue = NAN;
     m_Statistics_MaxBrightnessValue = NAN;
 
+    // Tiles from the journal are finished in every pass
+    for (const int tile_id : m_JournaledTiles)
+    {
+        m_Statistics_PointsFinished += GetTilePassPoints(tile_id);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of samples the current pass calculates in a tile
+qint64 FractalImage::GetTilePassPoints(const int mcTileID) const
+{
+    CALL_IN(QString("mcTileID=%1")
+        .arg(CALL_SHOW(mcTileID)));
+
+    int pixel_step = 1;
+    int sample_step = 1;
+    if (m_CurrentPass < m_PassSteps.size())
+    {
+        pixel_step = m_PassSteps[m_CurrentPass];
+        sample_step = m_PassSampleSteps[m_CurrentPass];
+    }
+    const int width =
+        m_TileIDToPointXMax[mcTileID] - m_TileIDToPointXMin[mcTileID];
+    const int height =
+        m_TileIDToPointYMax[mcTileID] - m_TileIDToPointYMin[mcTileID];
+    const qint64 points = FractalWorker::GetNumberOfPassPoints(width, 0,
+        height, m_Parameters["oversampling"].toInt(), pixel_step,
+        sample_step);
+
     CALL_OUT("");
+    return points;
 }
 
 
@@ -818,6 +4071,13 @@ void FractalImage::AddToStatistics(
         mcTileStatistics["points out of bounds long"].toLongLong();
     m_Statistics_TotalIterations +=
         mcTileStatistics["total iterations long"].toLongLong();
+    if (mcTileStatistics.contains("core at start"))
+    {
+        const int core = mcTileStatistics["core at start"].toInt();
+        m_Statistics_CoreToUnits[core]++;
+        m_Statistics_CoreToNumaNode[core] =
+            mcTileStatistics["numa node at start"].toInt();
+    }
     if (m_Statistics_FirstTile)
     {
         m_Statistics_MinDepth = mcTileStatistics["min depth"].toInt();
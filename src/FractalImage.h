@@ -5,6 +5,7 @@
 #define FRACTALIMAGE_H
 
 // Qt includes
+#include <QAtomicInt>
 #include <QElapsedTimer>
 #include <QColor>
 #include <QHash>
@@ -12,11 +13,29 @@
 #include <QMutex>
 #include <QObject>
 #include <QPixmap>
+#include <QRect>
+#include <QSet>
+#include <QSize>
 #include <QThread>
 #include <QVector>
+#include <QWaitCondition>
+
+// System includes
+#include <functional>
+
+// Factor between depths of successive depth passes
+#define DEPTH_PASS_FACTOR 4
+
+// Return value of FractalImage::NextTileToPrefetch() other than a tile ID
+#define PREFETCH_DONE -1
 
 // Forward declaration
+class AutoDepthProbe;
+class CachePrefetcher;
 class FractalWorker;
+class RenderJournal;
+class TileCacheFile;
+class WorkQueueServer;
 
 // Class definition
 class FractalImage
@@ -59,41 +78,219 @@ public:
 private:
     QHash < QString, QString > m_Parameters;
 
+    // Render image with the depth chosen (if "auto depth" is used), once
+    // that's known
+    void StartRender(const QHash < QString, QString > & mcrParameters,
+        const int mcAutoDepth, const qint64 mcProbeTime_ms);
+
 private slots:
     // Launch a new worker
     void LaunchWorker();
 
     // Store results from a finished worker
-    void WorkerFinished(const int mcTileID);
+    void WorkerFinished(const int mcUnitID);
+
+private:
+    // Next unit of work (false if there is none right now)
+    bool NextUnit(int & mrTileID, int & mrRowMin, int & mrRowMax);
+    bool HasUnitsLeft() const;
+
+    // Parameters for the worker of a unit
+    QHash < QString, QString > GetUnitParameters(const int mcTileID,
+        const int mcUnitID, const int mcRowMin, const int mcRowMax) const;
+
+    // Get the cached data of a tile into memory, if there is any
+    void LoadTileCacheData(const int mcTileID);
+
+    // Launch a worker for some rows of a tile
+    void LaunchUnit(const int mcTileID, const int mcRowMin,
+        const int mcRowMax);
+
+    // Store results of a finished unit (wherever it has been calculated)
+    void UnitFinished(const int mcUnitID, const int mcRowMin,
+        const int mcRowMax, const QImage & mcrImage, const int mcStopRow,
+        const bool mcWasStopped, const QVector < double > & mcrColorData,
+        const QVector < double > & mcrBrightnessData, const int mcCacheDepth,
+        const QHash < QString, QString > & mcrStatistics);
+
+    // Hand half of the remaining rows of the running unit with the most
+    // rows left to a new worker (so idle cores help with expensive tiles)
+    void SplitRunningUnit();
+
+    // Number of bands of rows a tile is split into (from its cost in the
+    // previous pass)
+    int GetNumberOfBands(const int mcTileID) const;
+
+    // Copy the rows of a finished unit into the merged data of its tile
+    void MergeUnitData(const int mcTileID, const int mcRowMin,
+        const int mcRowMax, const QVector < double > & mcrColorData,
+        const QVector < double > & mcrBrightnessData);
+
+    // Set up passes (coarse to fine, then increasing antialiasing, then
+    // shallow to deep, resuming orbits in deeper passes)
+    void SetUpPasses();
+
+    // Set up tiles for the current resolution
+    void SetUpTiles();
+
+    // Start next pass
+    void StartNextPass();
+
+    // Check if the image can be recolored from the cached values in memory
+    // (all tiles complete, calculated with at least the current depth)
+    bool CanRecolor() const;
+
+    // Recolor image from the cached values in memory, without any workers
+    void Recolor();
+
+public:
+    // Recolor areas of the image, each with its own parameters (on top of
+    // the current ones), from the cached values in memory and label them
+    // (if there are labels). Returns false if anything would need to be
+    // calculated.
+    bool RecolorAreas(const QList < QRect > & mcrAreas,
+        const QList < QHash < QString, QString > > & mcrAreaParameters,
+        const QList < QString > & mcrLabels);
+private:
+
+    QList < int > m_PassDepths;
+    // (Pixel step of coarse passes, and sample step of antialiasing passes;
+    // 1 otherwise)
+    QList < int > m_PassSteps;
+    QList < int > m_PassSampleSteps;
+    int m_CurrentPass;
+
+    // Order in which tiles are handed out to workers
+    void SetUpDispatchOrder();
+
+    // Sort tiles that haven't been handed out (or read ahead) yet by
+    // priority (prefetch mutex must be locked)
+    void SortDispatchOrder(const int mcFirstPosition);
+
+    QList < int > m_DispatchOrder;
+    QHash < int, int > m_TileIDToDispatchPosition;
+
+public:
+    // Mouse position (tiles around it are calculated first in "mouse"
+    // order)
+    void SetFocus(const int mcPixelX, const int mcPixelY);
+
+    // Part of the image visible in the window (calculated first in
+    // "viewport" order)
+    void SetVisibleArea(const QRect & mcrArea);
+private:
+    int m_FocusX;
+    int m_FocusY;
+    QRect m_VisibleArea;
+
+    // Probe choosing the depth with "auto depth" (in a thread of its own;
+    // the render waits for it with its parameters)
+    AutoDepthProbe * m_AutoDepthProbe;
+    QHash < QString, QString > m_AutoDepthProbeParameters;
+
+    // Key of the view a probe looks at (the last probe is reused as long
+    // as the view doesn't change)
+    QString GetAutoDepthProbeKey(
+        const QHash < QString, QString > & mcrParameters) const;
+    QString m_AutoDepthProbeKey;
+    int m_AutoDepthProbeResult;
+
+private slots:
+    // Probe is done: render with the depth it chose
+    void AutoDepthProbeFinished();
 
+private slots:
     // Save cache data to a file
     void SaveCacheData(const int mcTileID,
         const QVector < double > & mcrColorData,
-        const QVector < double > & mcrBrightnessData) const;
+        const QVector < double > & mcrBrightnessData, const int mcDepth) const;
 
-    // Read cache data to a file
+    // Read cache data from a file
     void ReadCacheData(const int mcTileID);
 
     // Save picture
-    void SavePicture() const;
+    bool SavePicture();
 
     // Save statistics
-    void SaveStatistics() const;
+    bool SaveStatistics();
+
+public:
+    // Why picture or statistics of the last render couldn't be saved (""
+    // if they could)
+    QString GetOutputError() const;
 
 private:
-    QHash < int, FractalWorker * > m_TileIDToWorker;
-    QHash < int, QThread * > m_TileIDToWorkerThread;
+    QString m_OutputError;
+
+    // Directory pictures, statistics and shard journals are saved to
+    QString GetOutputDirectory() const;
+
+    QHash < int, FractalWorker * > m_UnitIDToWorker;
+    QHash < int, QThread * > m_UnitIDToWorkerThread;
     QMutex m_Mutex;
 
+    // Number of worker threads, and the cores they are pinned to (if any;
+    // worker slot n uses the n-th core of the list)
+    int m_NumberOfThreads;
+    QList < int > m_AffinityCores;
+    QHash < int, int > m_UnitIDToSlot;
+    QSet < int > m_BusySlots;
+
+    // Parse a list of cores like "0-7,16-23"
+    QList < int > ParseCoreList(const QString & mcrCoreList) const;
+
 public:
-    // Stop rendering
+    // Work queue: worker processes connected to our WorkQueueServer get
+    // units just like local workers do. The server keeps track of which
+    // rows are out with which worker, and hands out units of workers that
+    // went away again.
+    int StartRemoteUnit(int & mrTileID, int & mrRowMin, int & mrRowMax,
+        QHash < QString, QString > & mrParameters, QByteArray & mrColorData,
+        QByteArray & mrBrightnessData, int & mrCacheDepth);
+    void RemoteUnitFinished(const int mcUnitID, const int mcRowMin,
+        const int mcRowMax, const QImage & mcrImage, const int mcStopRow,
+        const bool mcWasStopped, const QVector < double > & mcrColorData,
+        const QVector < double > & mcrBrightnessData, const int mcCacheDepth,
+        const QHash < QString, QString > & mcrStatistics);
+    void RemoteUnitLost(const int mcUnitID);
+
+    // Image size and number of color and brightness values of a tile (to
+    // check results of worker processes against)
+    bool GetTileSize(const int mcTileID, QSize & mrImageSize,
+        int & mrNumberOfColorValues, int & mrNumberOfBrightnessValues) const;
+private:
+    // Start or stop listening for worker processes
+    void SetUpWorkQueue();
+
+    // Keep local workers busy (when remote units finish or get lost)
+    void LaunchIdleWorkers();
+
+    // Check if worker processes still have units of ours
+    bool HasRemoteUnitsOut() const;
+
+    WorkQueueServer * m_WorkQueueServer;
+
+public:
+    // Stop rendering (running workers stop within a pixel; what they
+    // didn't get to is calculated when rendering is started again)
     void Stop();
 
+    // Pause rendering (workers wait where they are) and resume it
+    void Pause();
+    void Resume();
+
     // Render status
     QString GetRenderStatus() const;
+
+    // Run state (RUN_STATE_*, see FractalWorker)
+    int GetRunState() const;
 private:
     bool m_IsWorking;
     bool m_IsStopped;
+    // (Checked by workers while running)
+    QAtomicInt m_RunState;
+    // (Tiles a worker has been stopped in)
+    QSet < int > m_StoppedTiles;
     QElapsedTimer m_UpdateTimer;
 
 signals:
@@ -115,6 +312,93 @@ private:
     // Invalidate the cache
     void InvalidateCache();
 
+    // Check if new parameters show the current samples, only moved by whole
+    // pixels (or cut off or extended by a different image size)
+    bool GetPixelShift(const QHash < QString, QString > & mcrParameters,
+        int & mrShiftX, int & mrShiftY) const;
+
+    // Move current samples to the tiles of the new parameters (samples that
+    // aren't available are NaN)
+    void ShiftSamples(const QHash < QString, QString > & mcrParameters,
+        const int mcShiftX, const int mcShiftY,
+        QHash < int, QByteArray > & mrColorData,
+        QHash < int, QByteArray > & mrBrightnessData,
+        QSet < int > & mrPartialTiles) const;
+
+    // Check if the current samples are on the sample lattice of new
+    // parameters (new sample index = offset + factor * current sample
+    // index, in both directions)
+    bool GetLatticeMapping(const QHash < QString, QString > & mcrParameters,
+        int & mrFactor, int & mrOffsetX, int & mrOffsetY) const;
+
+    // Distribute samples of an image (its resolution and oversampling, and
+    // how to read its tiles) to the tiles of new parameters whose lattice
+    // contains them (samples that aren't available are NaN)
+    void ImportLatticeSamples(
+        const QHash < QString, QString > & mcrParameters, const int mcFactor,
+        const int mcOffsetX, const int mcOffsetY, const int mcSourceWidth,
+        const int mcSourceHeight, const int mcSourceOversampling,
+        const std::function < bool (const int, QVector < double > &,
+            QVector < double > &) > & mcrReadSourceTile,
+        QHash < int, QByteArray > & mrColorData,
+        QHash < int, QByteArray > & mrBrightnessData,
+        QSet < int > & mrPartialTiles) const;
+
+    // Import samples from the cache file of an earlier render of the current
+    // view with fewer samples (like a preview of a poster), if there is one
+    bool ImportLatticeSourceSamples(QHash < int, QByteArray > & mrColorData,
+        QHash < int, QByteArray > & mrBrightnessData,
+        QSet < int > & mrPartialTiles) const;
+
+    // Key of the current view regardless of resolution and oversampling
+    QByteArray GetLatticeKey() const;
+
+    // Check if some samples of a tile haven't been calculated (NaN)
+    bool HasMissingSamples(const QVector < double > & mcrColorData,
+        const int mcValuesPerSample) const;
+
+    // Samples of a tile calculated with the full depth (from memory or the
+    // cache file; some may be missing if the tile isn't finished)
+    bool GetFullDepthTile(const int mcTileID,
+        QVector < double > & mrColorData,
+        QVector < double > & mrBrightnessData) const;
+
+    // Parameters that change cached values
+    QList < QString > GetCacheRelevantParameters(
+        const QHash < QString, QString > & mcrParameters) const;
+
+    // Check if cached orbits can be resumed with a higher depth
+    bool CanResumeOrbits(
+        const QHash < QString, QString > & mcrParameters) const;
+
+    // Key identifying the cached values for the current parameters
+    QByteArray GetCacheKey() const;
+
+    // Directory holding the cache files
+    QString GetCacheDirectory() const;
+
+    // Open and close cache file for current parameters
+    void OpenCacheFile();
+    void CloseCacheFile();
+
+    // Remove least recently used cache files beyond the size limit
+    void CollectCacheGarbage();
+
+    // Journal of finished tiles, so an interrupted render of the same
+    // parameters continues where it left off (only for fixed resolution
+    // renders; others are quick enough to start over)
+    void OpenJournal();
+    QByteArray GetJournalKey() const;
+    RenderJournal * m_Journal;
+    // (Finished tiles from the journal; these are not calculated again)
+    QSet < int > m_JournaledTiles;
+
+    // Shards: a headless render of shard i of N ("render shard index",
+    // starting at 1, and "render shard count") only does every N-th tile.
+    // Its journal is kept as the partial output for ShardMerger.
+    bool IsTileInShard(const int mcTileID) const;
+    QString GetShardName() const;
+
 public:
     // Color value at a particular position
     double GetColorValueAt(const int mcPixelX, const int mcPixelY);
@@ -128,10 +412,103 @@ private:
     QHash < int, int > m_TileIDToPointXMax;
     QHash < int, int > m_TileIDToPointYMin;
     QHash < int, int > m_TileIDToPointYMax;
-    QHash < int, QVector < double > > m_TileIDToColorData;
-    QHash < int, QVector < double > > m_TileIDToBrightnessData;
+    // (Encoded by TileCacheEncoding)
+    QHash < int, QByteArray > m_TileIDToColorData;
+    QHash < int, QByteArray > m_TileIDToBrightnessData;
+    QHash < int, int > m_TileIDToDepth;
+    // (Tiles with samples moved from a previous view, and some missing)
+    QSet < int > m_PartialTiles;
     int m_NumberOfTiles;
     int m_CurrentTile;
+    TileCacheFile * m_CacheFile;
+
+    // Work units (bands of rows of a tile; most tiles are a single unit)
+    QHash < int, int > m_UnitIDToTileID;
+    int m_NextUnitID;
+    int m_CurrentTileBand;
+    // (Units still running for a tile, and the rows finished so far)
+    QHash < int, int > m_TileIDToUnitsRunning;
+    QHash < int, QVector < double > > m_TileIDToMergedColorData;
+    QHash < int, QVector < double > > m_TileIDToMergedBrightnessData;
+    // (Processing time of tiles in the current and the previous pass; the
+    // total is kept up to date as units finish)
+    QHash < int, qint64 > m_TileIDToCost;
+    QHash < int, qint64 > m_TileIDToPreviousCost;
+    qint64 m_TotalCost;
+    double m_PreviousAverageCost;
+
+
+
+    // ====================================================== Cache prefetching
+    // (Called from prefetcher threads, so there's no call tracing in here)
+public:
+    // Next tile to be read ahead (waits while the memory budget is used
+    // up); PREFETCH_DONE otherwise
+    int NextTileToPrefetch();
+
+    // Read cache data for a tile from the cache file
+    bool ReadCacheFile(const int mcTileID, QVector < double > & mrColorData,
+        QVector < double > & mrBrightnessData, int & mrDepth) const;
+
+    // Store data that has been read ahead
+    void StorePrefetchedTile(const int mcTileID, const bool mcSuccess,
+        const QVector < double > & mcrColorData,
+        const QVector < double > & mcrBrightnessData, const int mcDepth);
+
+private:
+    // Start and stop prefetcher threads
+    void StartPrefetching();
+    void StopPrefetching();
+
+    // Get data that has been read ahead (false if prefetcher didn't get to it)
+    bool TakePrefetchedTile(const int mcTileID,
+        QVector < double > & mrColorData,
+        QVector < double > & mrBrightnessData, int & mrDepth);
+
+    QList < CachePrefetcher * > m_Prefetchers;
+    QList < QThread * > m_PrefetcherThreads;
+    QMutex m_PrefetchMutex;
+    QWaitCondition m_PrefetchCondition;
+    QSet < int > m_PrefetchInProgress;
+
+    // Tiles that were already in memory when prefetching started
+    QSet < int > m_PrefetchSkip;
+    QHash < int, QVector < double > > m_PrefetchedColorData;
+    QHash < int, QVector < double > > m_PrefetchedBrightnessData;
+    QHash < int, int > m_PrefetchedDepth;
+    int m_NextPrefetchTile;
+    qint64 m_PrefetchedBytes;
+    qint64 m_PrefetchBudget;
+    bool m_PrefetchStopped;
+
+
+
+    // ================================================================== Views
+public:
+    // Keep the current view (if it is complete) for showing it again later
+    void KeepView(const bool mcKeepSamples);
+
+    // Show a kept view for the given parameters (false if there is none)
+    bool RestoreView(const QHash < QString, QString > & mcrParameters);
+
+    // Drop least recently used views beyond a memory budget
+    void LimitKeptViews(const qint64 mcMemoryBudget);
+
+private:
+    // Key identifying a view (all parameters the image was requested with)
+    QString GetViewKey(const QHash < QString, QString > & mcrParameters)
+        const;
+
+    QString m_ViewKey;
+    // (Least recently used first)
+    QList < QString > m_KeptViews;
+    QHash < QString, QHash < QString, QString > > m_KeptViewToParameters;
+    QHash < QString, QPixmap > m_KeptViewToImage;
+    QHash < QString, QHash < int, QByteArray > > m_KeptViewToColorData;
+    QHash < QString, QHash < int, QByteArray > > m_KeptViewToBrightnessData;
+    QHash < QString, QHash < int, int > > m_KeptViewToDepth;
+    QHash < QString, QHash < QString, QString > > m_KeptViewToStatistics;
+    QHash < QString, qint64 > m_KeptViewToSize;
 
 
 
@@ -146,6 +523,12 @@ public:
     // Add to statistics
     void AddToStatistics(const QHash < QString, QString > mTileStatistics);
 private:
+    // Reset statistics that describe the samples of a pass
+    void ResetPassStatistics();
+
+    // Number of samples the current pass calculates in a tile
+    qint64 GetTilePassPoints(const int mcTileID) const;
+
     bool m_Statistics_FirstTile;
     QString m_Statistics_StartTime;
     QString m_Statistics_FinishTime;
@@ -156,10 +539,22 @@ private:
     qint64 m_Statistics_TotalIterations;
     int m_Statistics_MinDepth;
     int m_Statistics_MaxDepth;
+    int m_Statistics_AutoDepth;
+    qint64 m_Statistics_AutoDepthProbeTime_ms;
+    qint64 m_Statistics_RecolorTime_ms;
+    // (Recolored from cached values: points are those of the values, but
+    // nothing was calculated)
+    bool m_Statistics_IsRecolor;
+    // (Units calculated per core a worker started on, and the NUMA node of
+    // the core)
+    QHash < int, int > m_Statistics_CoreToUnits;
+    QHash < int, int > m_Statistics_CoreToNumaNode;
     double m_Statistics_MinColorValue;
     double m_Statistics_MaxColorValue;
     double m_Statistics_MinBrightnessValue;
     double m_Statistics_MaxBrightnessValue;
+    // (Statistics of a view that has been restored)
+    QHash < QString, QString > m_Statistics_Restored;
 };
 
 #endif
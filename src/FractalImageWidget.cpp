@@ -178,6 +178,9 @@ void FractalImageWidget::mouseMoveEvent(QMouseEvent * mpEvent)
 {
     CALL_IN("mpEvent=...");
 
+    // Rendering may want to know where we are
+    emit PointerMoved(mpEvent -> pos().x(), mpEvent -> pos().y());
+
     // Not possible if non-interactive or working
     if (m_IsNonInteractive ||
         m_Image.isNull())
@@ -72,6 +72,9 @@ private:
     int m_LineY;
 
 signals:
+    // Mouse pointer moved (also while non-interactive)
+    void PointerMoved(const int mcX, const int mcY);
+
     // Hovering
     void HoveringAt(const int mcX, const int mcY);
 
@@ -10,6 +10,7 @@
 #include "FractalImageWidget.h"
 #include "MainWindow.h"
 #include "MessageLogger.h"
+#include "Preferences.h"
 #include "StringHelper.h"
 
 // Qt includes
@@ -32,6 +33,9 @@
 // Border
 #define IMAGE_BORDER 40
 
+// Number of views to go back to
+#define HISTORY_LENGTH 100
+
 
 
 // ================================================================== Lifecycle
@@ -65,6 +69,10 @@ FractalWidget::FractalWidget()
     // Is showing image
     m_IsShowingImage = true;
 
+    // No image yet
+    m_LastResolution = QPair < int, int >(0, 0);
+    m_HistoryPosition = -1;
+
     CALL_OUT("");
 }
 
@@ -120,6 +128,8 @@ void FractalWidget::InitGUI()
         SLOT(AreaSelected(const int, const int, const int, const int)));
     connect (m_FractalImageWidget, SIGNAL(MouseLeftWidget()),
         this, SLOT(MouseLeftFractalImage()));
+    connect (m_FractalImageWidget, SIGNAL(PointerMoved(const int, const int)),
+        this, SLOT(PointerMoved(const int, const int)));
     layout -> addWidget(m_FractalImageWidget, 0, Qt::AlignHCenter);
 
     // Message
@@ -154,7 +164,9 @@ void FractalWidget::Refresh_Progress()
     CALL_IN("");
 
     QString title = m_Fractal -> GetName();
-    if (m_FractalImage -> GetRenderStatus() == "working")
+    const QString status = m_FractalImage -> GetRenderStatus();
+    if (status == "working" ||
+        status == "paused")
     {
         const QHash < QString, QString > statistics =
             m_FractalImage -> GetStatistics();
@@ -315,6 +327,21 @@ void FractalWidget::UpdateImage()
     parameters["actual resolution height"] =
         QString("%1").arg(actual_height);
 
+    // If only the image size has changed, keep the scale (the range grows or
+    // shrinks around the center) so samples that have already been
+    // calculated can be reused. This changes the range of the fractal
+    // itself, so it has to be turned on explicitly.
+    Preferences * p = Preferences::Instance();
+    if (parameters["use fixed resolution"] == "no" &&
+        p -> GetTagValue("Render:Keep Scale When Resizing") == "yes" &&
+        m_LastResolution.first > 1 &&
+        m_LastResolution.second > 1 &&
+        m_LastResolution != QPair < int, int >(actual_width, actual_height) &&
+        m_LastRange == m_Fractal -> GetRange())
+    {
+        KeepScale(actual_width, actual_height);
+    }
+
     // Update range if necessary
     const QHash < QString, QString > new_range =
         GetRangeForResolution(actual_width, actual_height);
@@ -325,6 +352,14 @@ void FractalWidget::UpdateImage()
         const QString key = *key_iterator;
         parameters[key] = new_range[key];
     }
+    m_LastRange = m_Fractal -> GetRange();
+    m_LastResolution = QPair < int, int >(actual_width, actual_height);
+    AddToHistory(m_LastRange);
+
+    // Rendering and cache preferences
+    Fractal::AddRenderPreferences(parameters, Preferences::Instance());
+    m_FractalImage -> SetVisibleArea(QRect(0, 0,
+        m_FractalImageWidget -> width(), m_FractalImageWidget -> height()));
 
     // Update title
     Refresh_Progress();
@@ -343,6 +378,18 @@ void FractalWidget::UpdateImage()
         }
     }
 
+    // Views that have been rendered recently are shown right away
+    m_FractalImage -> KeepView(
+        p -> GetTagValue("Render:History Keeps Samples") == "yes");
+    m_FractalImage -> LimitKeptViews(
+        p -> GetTagValue("Render:History Memory Budget MB").toLongLong() *
+        1024 * 1024);
+    if (m_FractalImage -> RestoreView(parameters))
+    {
+        CALL_OUT("Restored view");
+        return;
+    }
+
     // Do the work
     m_FractalImage -> Render(parameters);
 
@@ -396,81 +443,70 @@ QHash < QString, QString > FractalWidget::GetRangeForResolution(
         .arg(CALL_SHOW(mcWidth),
              CALL_SHOW(mcHeight)));
 
-    // We'll fit the entire range into an existing resolution with square
-    // pixels, and will expand the range to fit all pixels.
+    const QHash < QString, QString > range =
+        m_Fractal -> GetRangeForResolution(mcWidth, mcHeight);
 
-    // When we get here, the resolution already has been set, without any
-    // or a pre-defined aspect ratio, as this step has nothing to do with
-    // the complex range.
-    const QHash < QString, QString > parameters =
-        m_Fractal -> GetAllParameters();
+    CALL_OUT("");
+    return range;
+}
 
-    // Area in the complex plane
-    QHash < QString, QString > parameters_ret;
-    if (parameters["precision"] == "long double")
-    {
-        long double real_min =
-            StringHelper::ToLongDouble(parameters["real min"]);
-        long double real_max =
-            StringHelper::ToLongDouble(parameters["real max"]);
-        long double imag_min =
-            StringHelper::ToLongDouble(parameters["imag min"]);
-        long double imag_max =
-            StringHelper::ToLongDouble(parameters["imag max"]);
-        const long double area_width = real_max - real_min;
-        const long double area_height = imag_max - imag_min;
-
-        const long double res_x = area_width / mcWidth;
-        const long double res_y = area_height / mcHeight;
-        if (res_x > res_y)
-        {
-            const long double imag_center = 0.5 * (imag_min + imag_max);
-            imag_min = imag_center - 0.5 * res_x * mcHeight;
-            imag_max = imag_center + 0.5 * res_x * mcHeight;
-        } else
-        {
-            const long double real_center = 0.5 * (real_min + real_max);
-            real_min = real_center - 0.5 * res_y * mcWidth;
-            real_max = real_center + 0.5 * res_y * mcWidth;
-        }
 
-        // Return area
-        parameters_ret["real min"] = StringHelper::ToString(real_min);
-        parameters_ret["real max"] = StringHelper::ToString(real_max);
-        parameters_ret["imag min"] = StringHelper::ToString(imag_min);
-        parameters_ret["imag max"] = StringHelper::ToString(imag_max);
+
+///////////////////////////////////////////////////////////////////////////////
+// Change range for a new image size, keeping the scale of the last image
+void FractalWidget::KeepScale(const int mcWidth, const int mcHeight)
+{
+    CALL_IN(QString("mcWidth=%1, mcHeight=%2")
+        .arg(CALL_SHOW(mcWidth),
+             CALL_SHOW(mcHeight)));
+
+    // Range the last image has been rendered with
+    const int last_width = m_LastResolution.first;
+    const int last_height = m_LastResolution.second;
+    const QHash < QString, QString > range =
+        GetRangeForResolution(last_width, last_height);
+
+    // Grow or shrink by whole pixels on either side
+    const int offset_x = (mcWidth - last_width) / 2;
+    const int offset_y = (mcHeight - last_height) / 2;
+    if (m_Fractal -> GetPrecision() == "long double")
+    {
+        const long double real_min =
+            StringHelper::ToLongDouble(range["real min"]);
+        const long double real_max =
+            StringHelper::ToLongDouble(range["real max"]);
+        const long double imag_min =
+            StringHelper::ToLongDouble(range["imag min"]);
+        const long double imag_max =
+            StringHelper::ToLongDouble(range["imag max"]);
+        const long double pixel_width = (real_max - real_min) / last_width;
+        const long double pixel_height =
+            (imag_max - imag_min) / last_height;
+        const long double new_real_min = real_min - offset_x * pixel_width;
+        const long double new_real_max =
+            new_real_min + mcWidth * pixel_width;
+        const long double new_imag_max = imag_max + offset_y * pixel_height;
+        const long double new_imag_min =
+            new_imag_max - mcHeight * pixel_height;
+        m_Fractal -> SetRange(new_real_min, new_real_max, new_imag_min,
+            new_imag_max);
     } else
     {
-        double real_min = parameters["real min"].toDouble();
-        double real_max = parameters["real max"].toDouble();
-        double imag_min = parameters["imag min"].toDouble();
-        double imag_max = parameters["imag max"].toDouble();
-        const double area_width = real_max - real_min;
-        const double area_height = imag_max - imag_min;
-
-        const double res_x = area_width / mcWidth;
-        const double res_y = area_height / mcHeight;
-        if (res_x > res_y)
-        {
-            const double imag_center = 0.5 * (imag_min + imag_max);
-            imag_min = imag_center - 0.5 * res_x * mcHeight;
-            imag_max = imag_center + 0.5 * res_x * mcHeight;
-        } else
-        {
-            const double real_center = 0.5 * (real_min + real_max);
-            real_min = real_center - 0.5 * res_y * mcWidth;
-            real_max = real_center + 0.5 * res_y * mcWidth;
-        }
-
-        // Return area
-        parameters_ret["real min"] = QString::number(real_min, 'g', 16);
-        parameters_ret["real max"] = QString::number(real_max, 'g', 16);
-        parameters_ret["imag min"] = QString::number(imag_min, 'g', 16);
-        parameters_ret["imag max"] = QString::number(imag_max, 'g', 16);
+        const double real_min = range["real min"].toDouble();
+        const double real_max = range["real max"].toDouble();
+        const double imag_min = range["imag min"].toDouble();
+        const double imag_max = range["imag max"].toDouble();
+        const double pixel_width = (real_max - real_min) / last_width;
+        const double pixel_height = (imag_max - imag_min) / last_height;
+        const double new_real_min = real_min - offset_x * pixel_width;
+        const double new_real_max = new_real_min + mcWidth * pixel_width;
+        const double new_imag_max = imag_max + offset_y * pixel_height;
+        const double new_imag_min = new_imag_max - mcHeight * pixel_height;
+        m_Fractal -> SetRange(new_real_min, new_real_max, new_imag_min,
+            new_imag_max);
     }
 
     CALL_OUT("");
-    return parameters_ret;
 }
 
 
@@ -513,12 +549,12 @@ void FractalWidget::HoveringAtPixel(const int mcX, const int mcY)
             StringHelper::ToLongDouble(range["real min"]) +
             (StringHelper::ToLongDouble(range["real max"]) -
             StringHelper::ToLongDouble(range["real min"])) *
-            mcX / (resolution.first - 1.);
+            (mcX + 0.5) / resolution.first;
         const long double imag =
             StringHelper::ToLongDouble(range["imag max"]) -
             (StringHelper::ToLongDouble(range["imag max"]) -
             StringHelper::ToLongDouble(range["imag min"])) *
-            mcY / (resolution.second - 1.);
+            (mcY + 0.5) / resolution.second;
 
         message = QString("z = %1 %2 %3i")
             .arg(StringHelper::ToString(real),
@@ -528,10 +564,10 @@ void FractalWidget::HoveringAtPixel(const int mcX, const int mcY)
     {
         const double real = range["real min"].toDouble() +
             (range["real max"].toDouble() - range["real min"].toDouble()) *
-            mcX / (resolution.first - 1.);
+            (mcX + 0.5) / resolution.first;
         const double imag = range["imag max"].toDouble() -
             (range["imag max"].toDouble() - range["imag min"].toDouble()) *
-            mcY / (resolution.second - 1.);
+            (mcY + 0.5) / resolution.second;
 
         message = QString("z = %1 %2 %3i")
             .arg(QString::number(real, 'g', 20),
@@ -564,28 +600,94 @@ void FractalWidget::AreaSelected(const int mcXMin, const int mcXMax,
     const QHash < QString, QString > range = m_Fractal -> GetRange();
     const QPair < int, int > resolution =
         m_FractalImage -> GetImageResolution();
+
+    // Zoom in by an integer factor if possible, so samples that have already
+    // been calculated can be reused
+    Preferences * p = Preferences::Instance();
+    const int zoom_factor =
+        qMin(resolution.first / qMax(1, mcXMax - mcXMin),
+            resolution.second / qMax(1, mcYMax - mcYMin));
+    if (p -> GetTagValue("Render:Snap Zoom") == "yes" &&
+        zoom_factor >= 2)
+    {
+        // New image is centered on the selected area, moved by whole (new)
+        // pixels from the current one
+        const QHash < QString, QString > rendered_range =
+            GetRangeForResolution(resolution.first, resolution.second);
+        const int offset_x = qRound(0.5 * (mcXMin + mcXMax) * zoom_factor -
+            0.5 * resolution.first);
+        const int offset_y = qRound(0.5 * (mcYMin + mcYMax) * zoom_factor -
+            0.5 * resolution.second);
+        if (m_Fractal -> GetPrecision() == "long double")
+        {
+            const long double pixel_width =
+                (StringHelper::ToLongDouble(rendered_range["real max"]) -
+                StringHelper::ToLongDouble(rendered_range["real min"])) /
+                resolution.first / zoom_factor;
+            const long double pixel_height =
+                (StringHelper::ToLongDouble(rendered_range["imag max"]) -
+                StringHelper::ToLongDouble(rendered_range["imag min"])) /
+                resolution.second / zoom_factor;
+            const long double real_min =
+                StringHelper::ToLongDouble(rendered_range["real min"]) +
+                offset_x * pixel_width;
+            const long double real_max =
+                real_min + resolution.first * pixel_width;
+            const long double imag_max =
+                StringHelper::ToLongDouble(rendered_range["imag max"]) -
+                offset_y * pixel_height;
+            const long double imag_min =
+                imag_max - resolution.second * pixel_height;
+            emit ChangeRange_HighPrecision(real_min, real_max, imag_min,
+                imag_max);
+        } else
+        {
+            const double pixel_width =
+                (rendered_range["real max"].toDouble() -
+                rendered_range["real min"].toDouble()) /
+                resolution.first / zoom_factor;
+            const double pixel_height =
+                (rendered_range["imag max"].toDouble() -
+                rendered_range["imag min"].toDouble()) /
+                resolution.second / zoom_factor;
+            const double real_min = rendered_range["real min"].toDouble() +
+                offset_x * pixel_width;
+            const double real_max = real_min + resolution.first * pixel_width;
+            const double imag_max = rendered_range["imag max"].toDouble() -
+                offset_y * pixel_height;
+            const double imag_min =
+                imag_max - resolution.second * pixel_height;
+            emit ChangeRange_LowPrecision(real_min, real_max, imag_min,
+                imag_max);
+        }
+
+        CALL_OUT("Zoomed by integer factor");
+        return;
+    }
+
+    // Selected area as it is
     if (m_Fractal -> GetPrecision() == "long double")
     {
         const long double real_min =
             StringHelper::ToLongDouble(range["real min"]) +
             (StringHelper::ToLongDouble(range["real max"]) -
             StringHelper::ToLongDouble(range["real min"])) *
-            (long double)(mcXMin) / (long double)(resolution.first - 1.);
+            (long double)(mcXMin) / resolution.first;
         const long double real_max =
             StringHelper::ToLongDouble(range["real min"]) +
             (StringHelper::ToLongDouble(range["real max"]) -
             StringHelper::ToLongDouble(range["real min"])) *
-            (long double)(mcXMax) / (long double)(resolution.first - 1.);
+            (long double)(mcXMax) / resolution.first;
         const long double imag_min =
             StringHelper::ToLongDouble(range["imag max"]) -
             (StringHelper::ToLongDouble(range["imag max"]) -
             StringHelper::ToLongDouble(range["imag min"])) *
-            (long double)(mcYMax) / (long double)(resolution.second - 1.);
+            (long double)(mcYMax) / resolution.second;
         const long double imag_max =
             StringHelper::ToLongDouble(range["imag max"]) -
             (StringHelper::ToLongDouble(range["imag max"]) -
             StringHelper::ToLongDouble(range["imag min"])) *
-            (long double)(mcYMin) / (long double)(resolution.second - 1.);
+            (long double)(mcYMin) / resolution.second;
 
         // Set new range
         emit ChangeRange_HighPrecision(real_min, real_max, imag_min, imag_max);
@@ -593,16 +695,16 @@ void FractalWidget::AreaSelected(const int mcXMin, const int mcXMax,
     {
         const double real_min = range["real min"].toDouble() +
             (range["real max"].toDouble() - range["real min"].toDouble()) *
-            mcXMin / (resolution.first - 1.);
+            mcXMin / double(resolution.first);
         const double imag_min = range["imag max"].toDouble() -
             (range["imag max"].toDouble() - range["imag min"].toDouble()) *
-            mcYMax / (resolution.second - 1.);
+            mcYMax / double(resolution.second);
         const double real_max = range["real min"].toDouble() +
             (range["real max"].toDouble() - range["real min"].toDouble()) *
-            mcXMax / (resolution.first - 1.);
+            mcXMax / double(resolution.first);
         const double imag_max = range["imag max"].toDouble() -
             (range["imag max"].toDouble() - range["imag min"].toDouble()) *
-            mcYMin / (resolution.second - 1.);
+            mcYMin / double(resolution.second);
 
         // Set new range
         emit ChangeRange_LowPrecision(real_min, real_max, imag_min, imag_max);
@@ -626,6 +728,22 @@ void FractalWidget::MouseLeftFractalImage()
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Mouse pointer moved
+void FractalWidget::PointerMoved(const int mcX, const int mcY)
+{
+    CALL_IN(QString("mcX=%1, mcY=%2")
+        .arg(CALL_SHOW(mcX),
+             CALL_SHOW(mcY)));
+
+    // Tiles around the mouse pointer may be calculated first
+    m_FractalImage -> SetFocus(mcX, mcY);
+
+    CALL_OUT("");
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // We use this to detect when window was activated
 bool FractalWidget::event(QEvent * mpEvent)
@@ -654,6 +772,10 @@ void FractalWidget::resizeEvent(QResizeEvent * mpEvent)
     // Accept event
     mpEvent -> accept();
 
+    // Tiles in the visible part of the image may be calculated first
+    m_FractalImage -> SetVisibleArea(QRect(0, 0,
+        m_FractalImageWidget -> width(), m_FractalImageWidget -> height()));
+
     // Let everybody know size changed
     emit WindowSizeChanged();
 
@@ -830,6 +952,20 @@ void FractalWidget::contextMenuEvent(QContextMenuEvent * mpEvent)
     QMenu * menu = new QMenu();
     QAction * action;
 
+    action = new QAction(tr("Back"), this);
+    action -> setEnabled(m_HistoryPosition > 0);
+    connect (action, SIGNAL(triggered()),
+        this, SLOT(Context_Back()));
+    menu -> addAction(action);
+
+    action = new QAction(tr("Forward"), this);
+    action -> setEnabled(m_HistoryPosition + 1 < m_History.size());
+    connect (action, SIGNAL(triggered()),
+        this, SLOT(Context_Forward()));
+    menu -> addAction(action);
+
+    menu -> addSeparator();
+
     action = new QAction(tr("Zoom out"), this);
     connect (action, SIGNAL(triggered()),
         this, SLOT(Context_ZoomOut()));
@@ -869,8 +1005,30 @@ void FractalWidget::Context_ZoomOut()
 {
     CALL_IN("");
 
-    // New Range
+    // Go back to the last view containing this one, if there is one
     const QHash < QString, QString > range = m_Fractal -> GetRange();
+    for (int position = m_HistoryPosition - 1; position >= 0; position--)
+    {
+        const QHash < QString, QString > & previous_range =
+            m_History[position];
+        if (previous_range != range &&
+            StringHelper::ToLongDouble(previous_range["real min"]) <=
+                StringHelper::ToLongDouble(range["real min"]) &&
+            StringHelper::ToLongDouble(previous_range["real max"]) >=
+                StringHelper::ToLongDouble(range["real max"]) &&
+            StringHelper::ToLongDouble(previous_range["imag min"]) <=
+                StringHelper::ToLongDouble(range["imag min"]) &&
+            StringHelper::ToLongDouble(previous_range["imag max"]) >=
+                StringHelper::ToLongDouble(range["imag max"]))
+        {
+            m_HistoryPosition = position;
+            GoToRange(previous_range);
+            CALL_OUT("Previous view");
+            return;
+        }
+    }
+
+    // New Range
     if (m_Fractal -> GetPrecision() == "long double")
     {
         const long double real_range =
@@ -946,53 +1104,58 @@ void FractalWidget::Context_CenterHere()
 {
     CALL_IN("");
 
-    // New center
+    // Move by whole pixels, so samples that have already been calculated
+    // can be reused
     const QHash < QString, QString > range = m_Fractal -> GetRange();
     const QPair < int, int > resolution =
         m_FractalImage -> GetImageResolution();
+    const int shift_x = m_Context_PixelX - resolution.first / 2;
+    const int shift_y = m_Context_PixelY - resolution.second / 2;
+
+    // Pixel size in the range the image has been rendered with
+    const QHash < QString, QString > rendered_range =
+        GetRangeForResolution(resolution.first, resolution.second);
     if (m_Fractal -> GetPrecision() == "long double")
     {
-        const long double center_real =
-            StringHelper::ToLongDouble(range["real min"]) +
-            (StringHelper::ToLongDouble(range["real max"]) -
-            StringHelper::ToLongDouble(range["real min"])) *
-            m_Context_PixelX / (resolution.first - 1.L);
-        const long double center_imag =
-            StringHelper::ToLongDouble(range["imag max"]) -
-            (StringHelper::ToLongDouble(range["imag max"]) -
-            StringHelper::ToLongDouble(range["imag min"])) *
-            m_Context_PixelY / (resolution.second - 1.L);
+        const long double pixel_width =
+            (StringHelper::ToLongDouble(rendered_range["real max"]) -
+            StringHelper::ToLongDouble(rendered_range["real min"])) /
+            resolution.first;
+        const long double pixel_height =
+            (StringHelper::ToLongDouble(rendered_range["imag max"]) -
+            StringHelper::ToLongDouble(rendered_range["imag min"])) /
+            resolution.second;
 
         // New range
-        const long double real_range =
-            StringHelper::ToLongDouble(range["real max"]) -
-            StringHelper::ToLongDouble(range["real min"]);
-        const long double real_min = center_real - real_range/2;
-        const long double real_max = center_real + real_range/2;
-        const long double imag_range =
+        const long double real_min =
+            StringHelper::ToLongDouble(range["real min"]) +
+            shift_x * pixel_width;
+        const long double real_max =
+            StringHelper::ToLongDouble(range["real max"]) +
+            shift_x * pixel_width;
+        const long double imag_min =
+            StringHelper::ToLongDouble(range["imag min"]) -
+            shift_y * pixel_height;
+        const long double imag_max =
             StringHelper::ToLongDouble(range["imag max"]) -
-            StringHelper::ToLongDouble(range["imag min"]);
-        const long double imag_min = center_imag - imag_range/2;
-        const long double imag_max = center_imag + imag_range/2;
+            shift_y * pixel_height;
         emit ChangeRange_HighPrecision(real_min, real_max, imag_min, imag_max);
     } else
     {
-        const double center_real = range["real min"].toDouble() +
-            (range["real max"].toDouble() - range["real min"].toDouble()) *
-            m_Context_PixelX / (resolution.first - 1.);
-        const double center_imag = range["imag max"].toDouble() -
-            (range["imag max"].toDouble() - range["imag min"].toDouble()) *
-            m_Context_PixelY / (resolution.second - 1.);
+        const double pixel_width = (rendered_range["real max"].toDouble() -
+            rendered_range["real min"].toDouble()) / resolution.first;
+        const double pixel_height = (rendered_range["imag max"].toDouble() -
+            rendered_range["imag min"].toDouble()) / resolution.second;
 
         // New range
-        const double real_range =
-            range["real max"].toDouble() - range["real min"].toDouble();
-        const double real_min = center_real - real_range/2;
-        const double real_max = center_real + real_range/2;
-        const double imag_range =
-            range["imag max"].toDouble() - range["imag min"].toDouble();
-        const double imag_min = center_imag - imag_range/2;
-        const double imag_max = center_imag + imag_range/2;
+        const double real_min =
+            range["real min"].toDouble() + shift_x * pixel_width;
+        const double real_max =
+            range["real max"].toDouble() + shift_x * pixel_width;
+        const double imag_min =
+            range["imag min"].toDouble() - shift_y * pixel_height;
+        const double imag_max =
+            range["imag max"].toDouble() - shift_y * pixel_height;
         emit ChangeRange_LowPrecision(real_min, real_max, imag_min, imag_max);
     }
 
@@ -1043,3 +1206,107 @@ void FractalWidget::Context_CreateJuliaSet()
 
     CALL_OUT("");
 }
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Back to the previous view
+void FractalWidget::Context_Back()
+{
+    CALL_IN("");
+
+    // Check if there is one
+    if (m_HistoryPosition < 1)
+    {
+        CALL_OUT("No previous view");
+        return;
+    }
+
+    m_HistoryPosition--;
+    GoToRange(m_History[m_HistoryPosition]);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Forward to the next view
+void FractalWidget::Context_Forward()
+{
+    CALL_IN("");
+
+    // Check if there is one
+    if (m_HistoryPosition + 1 >= m_History.size())
+    {
+        CALL_OUT("No next view");
+        return;
+    }
+
+    m_HistoryPosition++;
+    GoToRange(m_History[m_HistoryPosition]);
+
+    CALL_OUT("");
+}
+
+
+
+// ========================================================= Navigation history
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a view to the history (unless we've just navigated to it)
+void FractalWidget::AddToHistory(const QHash < QString, QString > & mcrRange)
+{
+    CALL_IN(QString("mcrRange=%1")
+        .arg(CALL_SHOW(mcrRange)));
+
+    // Check if it's the current one
+    if (m_HistoryPosition >= 0 &&
+        m_History[m_HistoryPosition] == mcrRange)
+    {
+        CALL_OUT("Current view");
+        return;
+    }
+
+    // Views we could have gone forward to are gone
+    while (m_History.size() > m_HistoryPosition + 1)
+    {
+        m_History.removeLast();
+    }
+    m_History << mcrRange;
+    while (m_History.size() > HISTORY_LENGTH)
+    {
+        m_History.removeFirst();
+    }
+    m_HistoryPosition = m_History.size() - 1;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Change to a range from the history
+void FractalWidget::GoToRange(const QHash < QString, QString > & mcrRange)
+{
+    CALL_IN(QString("mcrRange=%1")
+        .arg(CALL_SHOW(mcrRange)));
+
+    if (m_Fractal -> GetPrecision() == "long double")
+    {
+        emit ChangeRange_HighPrecision(
+            StringHelper::ToLongDouble(mcrRange["real min"]),
+            StringHelper::ToLongDouble(mcrRange["real max"]),
+            StringHelper::ToLongDouble(mcrRange["imag min"]),
+            StringHelper::ToLongDouble(mcrRange["imag max"]));
+    } else
+    {
+        emit ChangeRange_LowPrecision(mcrRange["real min"].toDouble(),
+            mcrRange["real max"].toDouble(), mcrRange["imag min"].toDouble(),
+            mcrRange["imag max"].toDouble());
+    }
+
+    CALL_OUT("");
+}
@@ -107,6 +107,14 @@ public:
     QHash < QString, QString > GetRangeForResolution(const int mcWidth,
         const int mcHeight) const;
 
+private:
+    // Change range for a new image size, keeping the scale of the last image
+    void KeepScale(const int mcWidth, const int mcHeight);
+
+    // Range (as set in the fractal) and resolution of the last image
+    QHash < QString, QString > m_LastRange;
+    QPair < int, int > m_LastResolution;
+
 
 
     // ============================================================== GUI stuff
@@ -127,6 +135,9 @@ private slots:
     // Mouse left fractal image
     void MouseLeftFractalImage();
 
+    // Mouse pointer moved
+    void PointerMoved(const int mcX, const int mcY);
+
 protected:
     // We use this to detect when window was activated
     bool event(QEvent * mpEvent);
@@ -171,6 +182,12 @@ private:
     int m_Context_PixelY;
 
 private slots:
+    // Back to the previous view
+    void Context_Back();
+
+    // Forward to the next view
+    void Context_Forward();
+
     // Zoom out
     void Context_ZoomOut();
 
@@ -182,6 +199,20 @@ private slots:
 
     // Create Julia set
     void Context_CreateJuliaSet();
+
+
+
+    // ===================================================== Navigation history
+private:
+    // Add a view to the history (unless we've just navigated to it)
+    void AddToHistory(const QHash < QString, QString > & mcrRange);
+
+    // Change to a range from the history
+    void GoToRange(const QHash < QString, QString > & mcrRange);
+
+    // Ranges of recent views
+    QList < QHash < QString, QString > > m_History;
+    int m_HistoryPosition;
 };
 
 #endif
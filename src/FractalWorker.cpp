@@ -5,16 +5,27 @@
 #include "FractalWorker.h"
 #include "MessageLogger.h"
 #include "StringHelper.h"
+#include "TileCacheEncoding.h"
 
 // Qt includes
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QDebug>
+#include <QDir>
+#include <QMutexLocker>
+#include <QThread>
 #include <QTimer>
 
 // System includes
 #include <cmath>
 
+// Interval (in ms) in which paused workers check if they may continue
+#define PAUSE_POLL_INTERVAL 10
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 
 
 // We don't do call tracing here because our way of doing that is not thread
@@ -35,9 +46,19 @@ FractalWorker::FractalWorker()
 
     // Cache isn't preset
     m_CacheIsPreset = false;
+    m_CacheOrbitData = false;
+    m_ResumeOrbits = false;
+    m_ResumingOrbits = false;
+    m_CacheDepth = 0;
 
     // Currently is idle
     m_IsIdle = true;
+
+    // Never stopped
+    m_RunState = nullptr;
+    m_WasStopped = false;
+    m_StopRow = 0;
+    m_PausedTime_ms = 0;
 }
 
 
@@ -68,32 +89,97 @@ void FractalWorker::Prepare(const QHash < QString, QString > mcParameters)
     // Parse parameters
     SetParameters(mcParameters);
 
-    // Initialize caches
+    // Initialize caches and image (unless that's done in our own thread)
+    m_CacheIndex = 0;
+    m_CacheDepth = m_Depth;
+    if (!m_NumaLocalBuffers)
+    {
+        AllocateBuffers();
+    }
+
+    // ... and oversampling
+    // (Pixel (x,y) is the square [x,x+1]x[y,y+1], and oversampling spreads
+    // the points over it such that they all represent 1/oversampling/
+    // oversampling area. Points start at the corner of the square, so all
+    // points of an image are on one lattice with the pixel corners, and the
+    // lattice of an image zoomed in by an integer factor, or with twice the
+    // resolution or oversampling, contains it. This way, samples can be
+    // reused. Centred points, (i+1/2)/oversampling, would only line up for
+    // odd factors. The price is that the samples of a pixel are shifted by
+    // half a sample spacing toward its top left corner, and without
+    // oversampling the image moves by half a pixel compared to versions
+    // that sampled pixel centres.)
+    m_OversamplingValues.clear();
+    for (int i = 0; i < m_Oversampling; i++)
+    {
+        m_OversamplingValues << double(i) / m_Oversampling;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Allocate cache and image
+void FractalWorker::AllocateBuffers()
+{
     const int tile_width = m_PixelXMax - m_PixelXMin;
     const int tile_height = m_PixelYMax - m_PixelYMin;
-    const int cache_size =
-        tile_width * tile_height * m_Oversampling * m_Oversampling;
-    m_ColorCache.resize(cache_size);
-    m_BrightnessCache.resize(cache_size);
-    m_CacheIndex = 0;
 
-    // .. image ...
+    // Preset caches are replaced anyway
+    if (!m_CacheIsPreset)
+    {
+        const int cache_size =
+            tile_width * tile_height * m_Oversampling * m_Oversampling;
+        m_ColorCache.resize(cache_size * (m_CacheOrbitData ? 3 : 1));
+        m_BrightnessCache.resize(cache_size);
+    }
+
     m_Image = QImage(tile_width, tile_height, QImage::Format_RGB32);
     m_Image.fill(Qt::black);
+}
 
-    // ... and oversampling
-    // (In order to get a good sample for the integer coordinate (x,y),
-    // oversampling should sample the square [-1/2,1/2]x[-1/2,1/2] instead
-    // of the single point at its center. The best way to do this is to sample
-    // from an uniform distribution, that is, spread the points such that
-    // they all represent 1/oversampling/oversampling area. Below formula
-    // calculates these coordinates)
-    m_OversamplingValues.clear();
-    for (int i = 0; i < m_Oversampling; i++)
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Pin our thread to a core (if any) and record where we're running
+void FractalWorker::PinToCore()
+{
+#ifdef Q_OS_LINUX
+    if (m_Core >= 0)
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(m_Core, &cpu_set);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+    }
+    m_Statistics_Core = sched_getcpu();
+#else
+    // No pinning here
+    m_Statistics_Core = -1;
+#endif
+    m_Statistics_NumaNode = GetNumaNode(m_Statistics_Core);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// NUMA node of a core (0 without NUMA information)
+int FractalWorker::GetNumaNode(const int mcCore)
+{
+    if (mcCore < 0)
+    {
+        return -1;
+    }
+
+    // Linux lists the node as a link in the core's directory
+    const QDir core_dir(QString("/sys/devices/system/cpu/cpu%1").arg(mcCore));
+    const QStringList nodes = core_dir.entryList(QStringList() << "node*",
+        QDir::Dirs | QDir::NoDotAndDotDot);
+    if (nodes.isEmpty())
     {
-        m_OversamplingValues <<
-            (2. * i - m_Oversampling + 1.) / 2 / m_Oversampling;
+        return 0;
     }
+    return nodes.first().mid(4).toInt();
 }
 
 
@@ -110,6 +196,36 @@ void FractalWorker::SetCacheValues(const QVector < double > mcColorCache,
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Set cache values (encoded by TileCacheEncoding; decoded in Start())
+void FractalWorker::SetEncodedCacheValues(const QByteArray & mcrColorCache,
+    const QByteArray & mcrBrightnessCache)
+{
+    m_EncodedColorCache = mcrColorCache;
+    m_EncodedBrightnessCache = mcrBrightnessCache;
+    m_CacheIsPreset = true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Depth the cache values have been calculated with
+void FractalWorker::SetCacheDepth(const int mcDepth)
+{
+    m_CacheDepth = mcDepth;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Depth the cache values have been calculated with
+int FractalWorker::GetCacheDepth() const
+{
+    return m_CacheDepth;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Precision
 void FractalWorker::SetLongDoublePrecision(const bool mcNewState)
@@ -141,40 +257,162 @@ void FractalWorker::Start()
     // Start timer
     m_Timer.restart();
 
+    // Run where we're supposed to, and allocate memory there
+    PinToCore();
+    if (m_NumaLocalBuffers)
+    {
+        AllocateBuffers();
+    }
+
+    // Tiles entirely inside the set or out of bounds have a single color
+    double uniform_value;
+    int number_of_values;
+    if (TileCacheEncoding::IsUniform(m_EncodedColorCache, uniform_value,
+            number_of_values) &&
+        isinf(uniform_value))
+    {
+        const int number_of_samples =
+            (m_CacheOrbitData ? number_of_values / 3 : number_of_values);
+        m_ColorCache.fill(uniform_value, number_of_values);
+        m_BrightnessCache.fill(0., number_of_samples);
+        m_EncodedColorCache.clear();
+        m_EncodedBrightnessCache.clear();
+        m_Image.fill(CalculateColorForIndex(0));
+        const qint64 pass_points = GetNumberOfPassPoints(
+            m_PixelXMax - m_PixelXMin, m_RowMin - m_PixelYMin,
+            m_RowMax - m_PixelYMin, m_Oversampling, m_PixelStep,
+            m_SampleStep);
+        m_Statistics_PointsFinished += pass_points;
+        if (uniform_value > 0)
+        {
+            m_Statistics_PointsInSet += pass_points;
+        } else
+        {
+            m_Statistics_PointsOutOfBounds += pass_points;
+        }
+        m_Statistics_ProcessingTime_ms = m_Timer.elapsed();
+        emit Finished(m_UnitID);
+        return;
+    }
+
+    // Decode cache values (done here so it happens in our own thread)
+    if (!m_EncodedColorCache.isEmpty())
+    {
+        m_ColorCache = TileCacheEncoding::Decode(m_EncodedColorCache);
+        m_BrightnessCache =
+            TileCacheEncoding::Decode(m_EncodedBrightnessCache);
+        m_EncodedColorCache.clear();
+        m_EncodedBrightnessCache.clear();
+    }
+
+    // Coarse passes leave samples missing
+    if ((m_PixelStep > 1 || m_SampleStep > 1) &&
+        !m_CacheIsPreset)
+    {
+        m_ColorCache.fill(NAN);
+        m_BrightnessCache.fill(0.);
+        m_CacheIsPreset = true;
+    }
+
+    // Orbits cut off at a lower depth continue from where they stopped
+    m_ResumingOrbits = m_CacheIsPreset &&
+        m_ResumeOrbits &&
+        m_CacheDepth < m_Depth;
+
     // Not idle anymore!
     m_IsIdle = false;
 
-    // Generate image
-    double normalizer_oversampling = 1./m_Oversampling/m_Oversampling;
-    for (int pixel_y = m_PixelYMin; pixel_y < m_PixelYMax; pixel_y++)
+    // Generate image (passes with a sample step only use every step-th
+    // sample in each direction)
+    const int samples_per_direction =
+        (m_Oversampling + m_SampleStep - 1) / m_SampleStep;
+    double normalizer_oversampling =
+        1./samples_per_direction/samples_per_direction;
+    const int tile_width = m_PixelXMax - m_PixelXMin;
+    for (int pixel_y = m_RowMin; StartRow(pixel_y); pixel_y++)
     {
         for (int pixel_x = m_PixelXMin; pixel_x < m_PixelXMax; pixel_x++)
         {
+            // Stop (or pause) if we're asked to
+            if (!KeepRunning())
+            {
+                MarkMissingFrom(pixel_x, pixel_y);
+                break;
+            }
+
+            // Coarse passes only calculate the first sample of every
+            // step-th pixel and show it for the whole block
+            if (m_PixelStep > 1)
+            {
+                if ((pixel_x - m_PixelXMin) % m_PixelStep != 0 ||
+                    (pixel_y - m_PixelYMin) % m_PixelStep != 0)
+                {
+                    continue;
+                }
+                m_CacheIndex = ((pixel_y - m_PixelYMin) * tile_width +
+                    pixel_x - m_PixelXMin) * m_Oversampling * m_Oversampling;
+                QColor color;
+                if (m_UseLongDoublePrecision)
+                {
+                    long double real;
+                    long double imag;
+                    GetPoint(pixel_x, pixel_y, real, imag);
+                    color = CalculatePixelColor(real, imag);
+                } else
+                {
+                    double real;
+                    double imag;
+                    GetPoint(pixel_x, pixel_y, real, imag);
+                    color = CalculatePixelColor(real, imag);
+                }
+                const int block_x_max = qMin(pixel_x + m_PixelStep,
+                    m_PixelXMax);
+                const int block_y_max = qMin(pixel_y + m_PixelStep,
+                    m_PixelYMax);
+                for (int block_y = pixel_y; block_y < block_y_max; block_y++)
+                {
+                    for (int block_x = pixel_x;
+                         block_x < block_x_max;
+                         block_x++)
+                    {
+                        m_Image.setPixelColor(block_x - m_PixelXMin,
+                            block_y - m_PixelYMin, color);
+                    }
+                }
+                continue;
+            }
+
             int color_r = 0;
             int color_g = 0;
             int color_b = 0;
-            for (double delta_x : m_OversamplingValues)
+            const int pixel_index = ((pixel_y - m_PixelYMin) * tile_width +
+                pixel_x - m_PixelXMin) * m_Oversampling * m_Oversampling;
+            for (int index_x = 0;
+                 index_x < m_Oversampling;
+                 index_x += m_SampleStep)
             {
-                for (double delta_y : m_OversamplingValues)
+                const double delta_x = m_OversamplingValues[index_x];
+                for (int index_y = 0;
+                     index_y < m_Oversampling;
+                     index_y += m_SampleStep)
                 {
+                    const double delta_y = m_OversamplingValues[index_y];
+                    m_CacheIndex =
+                        pixel_index + index_x * m_Oversampling + index_y;
                     QColor color;
                     if (m_UseLongDoublePrecision)
                     {
-                        const long double real = m_RealMin_Long +
-                            (m_RealMax_Long - m_RealMin_Long) *
-                                (pixel_x + delta_x) / (m_PixelTotalWidth - 1.L);
-                        const long double imag = m_ImagMax_Long -
-                            (m_ImagMax_Long - m_ImagMin_Long) *
-                            (pixel_y + delta_y) / (m_PixelTotalHeight - 1.L);
+                        long double real;
+                        long double imag;
+                        GetPoint(pixel_x + delta_x, pixel_y + delta_y, real,
+                            imag);
                         color = CalculatePixelColor(real, imag);
                     } else
                     {
-                        const double real = m_RealMin +
-                            (m_RealMax - m_RealMin) *
-                            (pixel_x + delta_x) / (m_PixelTotalWidth - 1.);
-                        const double imag = m_ImagMax -
-                            (m_ImagMax - m_ImagMin) *
-                            (pixel_y + delta_y) / (m_PixelTotalHeight - 1.);
+                        double real;
+                        double imag;
+                        GetPoint(pixel_x + delta_x, pixel_y + delta_y, real,
+                            imag);
                         color = CalculatePixelColor(real, imag);
                     }
                     color_r += color.red();
@@ -188,16 +426,262 @@ void FractalWorker::Start()
             m_Image.setPixelColor(pixel_x - m_PixelXMin, pixel_y - m_PixelYMin,
                 QColor(color_r, color_g, color_b));
         }
+        if (m_WasStopped)
+        {
+            break;
+        }
     }
 
-    // Record elapsed time
-    m_Statistics_ProcessingTime_ms = m_Timer.elapsed();
+    // Record elapsed time (without pauses)
+    m_Statistics_ProcessingTime_ms = m_Timer.elapsed() - m_PausedTime_ms;
+
+    // Cached data is now good for the current depth
+    if (m_ResumingOrbits)
+    {
+        m_CacheDepth = m_Depth;
+    }
 
     // Idle again!
     m_IsIdle = true;
 
     // Let outside world know we're done for now.
-    emit Finished(m_TileID);
+    emit Finished(m_UnitID);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Point of the complex plane at a position in the image
+void FractalWorker::GetPoint(const double mcX, const double mcY,
+    double & mrReal, double & mrImag) const
+{
+    // Exponential map: x is the angle around the center, y goes from the
+    // outer radius (top) to the inner one (bottom) on a logarithmic scale
+    if (m_IsLogPolar)
+    {
+        const double angle = 2 * M_PI * mcX / m_PixelTotalWidth;
+        const double radius = exp(m_LogRadiusMax -
+            (m_LogRadiusMax - m_LogRadiusMin) * mcY / m_PixelTotalHeight);
+        mrReal = m_CenterReal + radius * cos(angle);
+        mrImag = m_CenterImag + radius * sin(angle);
+        return;
+    }
+
+    mrReal = m_RealMin + (m_RealMax - m_RealMin) * mcX / m_PixelTotalWidth;
+    mrImag = m_ImagMax - (m_ImagMax - m_ImagMin) * mcY / m_PixelTotalHeight;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Point of the complex plane at a position in the image
+void FractalWorker::GetPoint(const double mcX, const double mcY,
+    long double & mrReal, long double & mrImag) const
+{
+    // (See above)
+    if (m_IsLogPolar)
+    {
+        const long double angle = 2 * M_PI * mcX / m_PixelTotalWidth;
+        const long double radius = expl(m_LogRadiusMax -
+            (m_LogRadiusMax - m_LogRadiusMin) * mcY / m_PixelTotalHeight);
+        mrReal = m_CenterReal_Long + radius * cosl(angle);
+        mrImag = m_CenterImag_Long + radius * sinl(angle);
+        return;
+    }
+
+    mrReal = m_RealMin_Long +
+        (m_RealMax_Long - m_RealMin_Long) * mcX / m_PixelTotalWidth;
+    mrImag = m_ImagMax_Long -
+        (m_ImagMax_Long - m_ImagMin_Long) * mcY / m_PixelTotalHeight;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// First row this worker calculates
+int FractalWorker::GetRowMin() const
+{
+    return m_RowMin;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Row after the last one this worker calculates
+int FractalWorker::GetRowMax() const
+{
+    QMutexLocker locker(&m_RowMutex);
+    return m_RowMax;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of rows that haven't been started yet
+int FractalWorker::GetRowsLeft() const
+{
+    QMutexLocker locker(&m_RowMutex);
+    return m_RowMax - m_CurrentRow - 1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Give up the second half of the rows not started yet; returns the first row
+// given up (or -1 if there's not enough left to share). Rows are split at a
+// multiple of the step, so coarse blocks stay in one piece.
+int FractalWorker::SplitRows(const int mcStep)
+{
+    QMutexLocker locker(&m_RowMutex);
+    const int first_free_row = m_CurrentRow + 1;
+    int split_row = first_free_row + (m_RowMax - first_free_row) / 2;
+    split_row = m_PixelYMin +
+        (split_row - m_PixelYMin + mcStep - 1) / mcStep * mcStep;
+    if (split_row <= first_free_row ||
+        split_row >= m_RowMax)
+    {
+        return -1;
+    }
+    m_RowMax = split_row;
+    return split_row;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if a row is still ours, and mark it as being calculated
+bool FractalWorker::StartRow(const int mcPixelY)
+{
+    QMutexLocker locker(&m_RowMutex);
+    if (mcPixelY >= m_RowMax)
+    {
+        return false;
+    }
+    m_CurrentRow = mcPixelY;
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Render state to check while running
+void FractalWorker::SetRunState(QAtomicInt * mpRunState)
+{
+    m_RunState = mpRunState;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if the worker has been stopped before it was done
+bool FractalWorker::WasStopped() const
+{
+    return m_WasStopped;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// First row that is incomplete (row after the last one if we weren't
+// stopped)
+int FractalWorker::GetStopRow() const
+{
+    return (m_WasStopped ? m_StopRow : GetRowMax());
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Wait while paused; returns false if we're to stop
+bool FractalWorker::KeepRunning()
+{
+    if (!m_RunState)
+    {
+        return true;
+    }
+
+    if (m_RunState -> loadRelaxed() == RUN_STATE_PAUSED)
+    {
+        QElapsedTimer pause_timer;
+        pause_timer.start();
+        while (m_RunState -> loadRelaxed() == RUN_STATE_PAUSED)
+        {
+            QThread::msleep(PAUSE_POLL_INTERVAL);
+        }
+        m_PausedTime_ms += pause_timer.elapsed();
+    }
+    return (m_RunState -> loadRelaxed() != RUN_STATE_STOPPED);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Mark samples of this pass from the given pixel to the end of our rows as
+// missing (same subset of samples as the pass calculates)
+void FractalWorker::MarkMissingFrom(const int mcPixelX, const int mcPixelY)
+{
+    m_WasStopped = true;
+    m_StopRow = mcPixelY;
+
+    const int tile_width = m_PixelXMax - m_PixelXMin;
+    const int samples_per_pixel = m_Oversampling * m_Oversampling;
+    const int row_max = GetRowMax();
+    for (int pixel_y = mcPixelY; pixel_y < row_max; pixel_y++)
+    {
+        const int first_x = (pixel_y == mcPixelY ? mcPixelX : m_PixelXMin);
+        for (int pixel_x = first_x; pixel_x < m_PixelXMax; pixel_x++)
+        {
+            const int pixel_index = ((pixel_y - m_PixelYMin) * tile_width +
+                pixel_x - m_PixelXMin) * samples_per_pixel;
+
+            // Coarse passes: first sample of every step-th pixel
+            if (m_PixelStep > 1)
+            {
+                if ((pixel_x - m_PixelXMin) % m_PixelStep == 0 &&
+                    (pixel_y - m_PixelYMin) % m_PixelStep == 0)
+                {
+                    MarkSampleMissing(pixel_index);
+                }
+                continue;
+            }
+
+            // Every step-th sample in both directions
+            for (int index_x = 0;
+                 index_x < m_Oversampling;
+                 index_x += m_SampleStep)
+            {
+                for (int index_y = 0;
+                     index_y < m_Oversampling;
+                     index_y += m_SampleStep)
+                {
+                    MarkSampleMissing(
+                        pixel_index + index_x * m_Oversampling + index_y);
+                }
+            }
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Mark a sample that hasn't been reached as missing
+void FractalWorker::MarkSampleMissing(const int mcCacheIndex)
+{
+    // Cached values are still good, except for orbits that would otherwise
+    // count as resumed to the new depth
+    if (m_CacheIsPreset &&
+        !(m_ResumingOrbits && IsOrbitResumable(mcCacheIndex)))
+    {
+        return;
+    }
+
+    const int values_per_sample = (m_CacheOrbitData ? 3 : 1);
+    for (int value = 0; value < values_per_sample; value++)
+    {
+        m_ColorCache[mcCacheIndex * values_per_sample + value] = NAN;
+    }
+    m_BrightnessCache[mcCacheIndex] = 0.;
 }
 
 
@@ -207,10 +691,13 @@ void FractalWorker::Start()
 QColor FractalWorker::CalculatePixelColor(const double mcReal,
     const double mcImag)
 {
-    // Just in case we have cached values
-    if (m_CacheIsPreset)
+    // Just in case we have cached values (unless this is an orbit that was
+    // cut off at a lower depth, or a sample that hasn't been calculated)
+    if (m_CacheIsPreset &&
+        !IsSampleMissing(m_CacheIndex) &&
+        !(m_ResumingOrbits && IsOrbitResumable(m_CacheIndex)))
     {
-        m_Statistics_PointsFinished++;
+        AddCachedSampleToStatistics(m_CacheIndex);
         const int index = m_CacheIndex++;
         return CalculateColorForIndex(index);
     }
@@ -238,6 +725,28 @@ QColor FractalWorker::CalculatePixelColor(const double mcReal,
         imag = mcImag;
     }
 
+    // Continue orbit from where it stopped (orbits that escaped on the
+    // last iteration of the lower depth are calculated again; only the
+    // latest strip average sum is cached, and their brightness needs the
+    // one before, too)
+    if (m_CacheIsPreset &&
+        !IsSampleMissing(m_CacheIndex))
+    {
+        const int offset = 3 * m_CacheIndex;
+        const double cached_real = m_ColorCache[offset + 1];
+        const double cached_imag = m_ColorCache[offset + 2];
+        if (cached_real * cached_real + cached_imag * cached_imag <
+            r_squared)
+        {
+            current_depth = m_CacheDepth;
+            real = cached_real;
+            imag = cached_imag;
+            sac_avg = m_BrightnessCache[m_CacheIndex];
+            sac_previous_avg = sac_avg;
+        }
+    }
+    const int start_depth = current_depth;
+
     // Iteration
     double new_real;
     while (current_depth < m_Depth &&
@@ -285,7 +794,7 @@ QColor FractalWorker::CalculatePixelColor(const double mcReal,
         m_Statistics_MinDepth = qMin(m_Statistics_MinDepth, current_depth);
         m_Statistics_MaxDepth = qMax(m_Statistics_MaxDepth, current_depth);
     }
-    m_Statistics_TotalIterations += current_depth;
+    m_Statistics_TotalIterations += current_depth - start_depth;
 
     // Check if inside the set
     const bool inside_set = (current_depth == m_Depth);
@@ -337,7 +846,6 @@ QColor FractalWorker::CalculatePixelColor(const double mcReal,
     double brightness = 0;
     if (inside_set)
     {
-        m_Statistics_PointsInSet++;
         brightness = 1.;
     } else
     {
@@ -383,8 +891,17 @@ QColor FractalWorker::CalculatePixelColor(const double mcReal,
 
     // Save value in storage
     const int index = m_CacheIndex++;
-    m_ColorCache[index] = color_value;
-    m_BrightnessCache[index] = brightness;
+    SetCacheValue(index, color_value, current_depth, real, imag);
+    if (inside_set &&
+        m_ResumeOrbits)
+    {
+        // Brightness doesn't matter inside the set; keep strip average sum
+        // for resuming the orbit
+        m_BrightnessCache[index] = sac_avg;
+    } else
+    {
+        m_BrightnessCache[index] = brightness;
+    }
 
     // No more first iteration
     m_Statistics_FirstIteration = false;
@@ -400,10 +917,12 @@ QColor FractalWorker::CalculatePixelColor(const double mcReal,
 QColor FractalWorker::CalculatePixelColor(const long double mcReal,
     const long double mcImag)
 {
-    // Just in case we have cached values
-    if (m_CacheIsPreset)
+    // Just in case we have cached values (unless this is a sample that
+    // hasn't been calculated)
+    if (m_CacheIsPreset &&
+        !IsSampleMissing(m_CacheIndex))
     {
-        m_Statistics_PointsFinished++;
+        AddCachedSampleToStatistics(m_CacheIndex);
         const int index = m_CacheIndex++;
         return CalculateColorForIndex(index);
     }
@@ -530,7 +1049,6 @@ QColor FractalWorker::CalculatePixelColor(const long double mcReal,
     double brightness = 0;
     if (inside_set)
     {
-        m_Statistics_PointsInSet++;
         brightness = 1.;
     } else
     {
@@ -576,7 +1094,7 @@ QColor FractalWorker::CalculatePixelColor(const long double mcReal,
 
     // Save value in storage
     const int index = m_CacheIndex++;
-    m_ColorCache[index] = color_value;
+    SetCacheValue(index, color_value, current_depth, real, imag);
     m_BrightnessCache[index] = brightness;
 
     // No more first iteration
@@ -588,10 +1106,164 @@ QColor FractalWorker::CalculatePixelColor(const long double mcReal,
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Store color value (or what it is derived from) in cache
+void FractalWorker::SetCacheValue(const int mcCacheIndex,
+    const double mcColorValue, const int mcDepth, const double mcFinalReal,
+    const double mcFinalImag)
+{
+    if (!m_CacheOrbitData)
+    {
+        m_ColorCache[mcCacheIndex] = mcColorValue;
+        return;
+    }
+
+    // Escape iteration and final z; samples inside the set or out of bounds
+    // have their (infinite) color value in all three places, so tiles made up
+    // of those are still uniform
+    const int offset = 3 * mcCacheIndex;
+    if (isinf(mcColorValue))
+    {
+        m_ColorCache[offset] = mcColorValue;
+        if (mcColorValue > 0 &&
+            m_ResumeOrbits)
+        {
+            // Keep current z so the orbit can be resumed with a higher depth
+            m_ColorCache[offset + 1] = mcFinalReal;
+            m_ColorCache[offset + 2] = mcFinalImag;
+        } else
+        {
+            m_ColorCache[offset + 1] = mcColorValue;
+            m_ColorCache[offset + 2] = mcColorValue;
+        }
+    } else
+    {
+        m_ColorCache[offset] = mcDepth;
+        m_ColorCache[offset + 1] = mcFinalReal;
+        m_ColorCache[offset + 2] = mcFinalImag;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Color value from cache
+double FractalWorker::GetColorValue(const int mcCacheIndex) const
+{
+    if (!m_CacheOrbitData)
+    {
+        return m_ColorCache[mcCacheIndex];
+    }
+
+    // Derive color value from escape iteration and final z
+    const int offset = 3 * mcCacheIndex;
+    return GetOrbitColorValue(m_ColorCache[offset], m_ColorCache[offset + 1],
+        m_ColorCache[offset + 2], m_Depth,
+        m_ColorBaseValue == "continuous", m_ColorBaseValue == "angle");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Color value of a sample from its cached escape iteration and final z
+double FractalWorker::GetOrbitColorValue(const double mcEscapeDepth,
+    const double mcReal, const double mcImag, const int mcDepth,
+    const bool mcIsContinuous, const bool mcIsAngle)
+{
+    if (isinf(mcEscapeDepth))
+    {
+        return mcEscapeDepth;
+    }
+    if (mcEscapeDepth >= mcDepth)
+    {
+        // Cached with a higher depth, but didn't escape before the current
+        // one (like a fresh render, escaping on the last iteration counts
+        // as inside the set)
+        return INFINITY;
+    }
+    if (mcIsContinuous)
+    {
+        return mcEscapeDepth -
+            log2(log2(mcReal * mcReal + mcImag * mcImag) / 2);
+    }
+    if (mcIsAngle)
+    {
+        return ComplexArg(mcReal, mcImag);
+    }
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Count a sample served from the cache
+void FractalWorker::AddCachedSampleToStatistics(const int mcCacheIndex)
+{
+    m_Statistics_PointsFinished++;
+    const double color_value = GetColorValue(mcCacheIndex);
+    if (color_value == INFINITY)
+    {
+        m_Statistics_PointsInSet++;
+    }
+    if (color_value == -INFINITY)
+    {
+        m_Statistics_PointsOutOfBounds++;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of samples a pass calculates in the given rows of a tile (coarse
+// passes take one sample per block of pixels, antialiasing passes every
+// step-th sample of each pixel in both directions)
+qint64 FractalWorker::GetNumberOfPassPoints(const int mcWidth,
+    const int mcRowMin, const int mcRowMax, const int mcOversampling,
+    const int mcPixelStep, const int mcSampleStep)
+{
+    if (mcPixelStep > 1)
+    {
+        // Rows with a multiple of the step (relative to the tile)
+        const int first_row =
+            (mcRowMin + mcPixelStep - 1) / mcPixelStep * mcPixelStep;
+        const qint64 rows = (mcRowMax > first_row ?
+            (mcRowMax - first_row + mcPixelStep - 1) / mcPixelStep : 0);
+        const qint64 columns = (mcWidth + mcPixelStep - 1) / mcPixelStep;
+        return rows * columns;
+    }
+    const qint64 samples_per_direction =
+        (mcOversampling + mcSampleStep - 1) / mcSampleStep;
+    return qint64(mcWidth) * (mcRowMax - mcRowMin) *
+        samples_per_direction * samples_per_direction;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if a cached sample is an orbit that can be resumed
+bool FractalWorker::IsOrbitResumable(const int mcCacheIndex) const
+{
+    const int offset = 3 * mcCacheIndex;
+    return (m_ColorCache[offset] == INFINITY &&
+        isfinite(m_ColorCache[offset + 1]));
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if a cached sample hasn't been calculated (NaN)
+bool FractalWorker::IsSampleMissing(const int mcCacheIndex) const
+{
+    const int offset = (m_CacheOrbitData ? 3 * mcCacheIndex : mcCacheIndex);
+    return isnan(m_ColorCache[offset]);
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Calculate argument (angle) of complex number
 double FractalWorker::ComplexArg(const double mcReal,
-    const double mcImag) const
+    const double mcImag)
 {
     if (mcReal > 0)
     {
@@ -659,7 +1331,7 @@ long double FractalWorker::ComplexArg(const long double mcReal,
 QColor FractalWorker::CalculateColorForIndex(const int mcCacheIndex) const
 {
     // Get value (abbreviation)
-    const double color_value = m_ColorCache[mcCacheIndex];
+    const double color_value = GetColorValue(mcCacheIndex);
 
     // Special cases
     if (isinf(color_value))
@@ -732,6 +1404,7 @@ void FractalWorker::SetParameters(
 
     // For faster access
     m_TileID = m_Parameters["tile id"].toInt();
+    m_UnitID = m_Parameters["unit id"].toInt();
 
     m_FractalType = m_Parameters["fractal type"];
     m_UseLongDoublePrecision = (m_Parameters["precision"] == "long double");
@@ -754,11 +1427,34 @@ void FractalWorker::SetParameters(
         m_JuliaReal = m_Parameters["julia real"].toDouble();
         m_JuliaImag = m_Parameters["julia imag"].toDouble();
     }
+    m_IsLogPolar = (m_Parameters["projection"] == "log-polar");
+    if (m_IsLogPolar)
+    {
+        m_CenterReal_Long =
+            StringHelper::ToLongDouble(m_Parameters["log polar center real"]);
+        m_CenterImag_Long =
+            StringHelper::ToLongDouble(m_Parameters["log polar center imag"]);
+        m_CenterReal = double(m_CenterReal_Long);
+        m_CenterImag = double(m_CenterImag_Long);
+        m_LogRadiusMin = log(m_Parameters["log polar radius min"].toDouble());
+        m_LogRadiusMax = log(m_Parameters["log polar radius max"].toDouble());
+    }
     m_Depth = m_Parameters["depth"].toInt();
     m_EscapeRadius = m_Parameters["escape radius"].toDouble();
     m_Oversampling = m_Parameters["oversampling"].toInt();
 
     m_ColorBaseValue = m_Parameters["color base value"];
+    m_CacheOrbitData = (m_Parameters["storage cache orbit data"] == "yes");
+    m_NumaLocalBuffers =
+        (m_Parameters["render numa local buffers"] == "yes");
+    m_Core = -1;
+    if (m_Parameters.contains("core"))
+    {
+        m_Core = m_Parameters["core"].toInt();
+    }
+    m_ResumeOrbits = m_CacheOrbitData &&
+        !m_UseLongDoublePrecision &&
+        (m_Parameters["storage cache resume orbits"] == "yes");
     m_ColorMappingMethod = m_Parameters["color mapping method"];
     if (m_ColorMappingMethod == "periodic")
     {
@@ -821,6 +1517,21 @@ void FractalWorker::SetParameters(
     m_PixelXMax = m_Parameters["pixel x max"].toInt();
     m_PixelYMin = m_Parameters["pixel y min"].toInt();
     m_PixelYMax = m_Parameters["pixel y max"].toInt();
+    m_RowMutex.lock();
+    m_RowMin = m_PixelYMin;
+    if (m_Parameters.contains("pixel y start"))
+    {
+        m_RowMin = m_Parameters["pixel y start"].toInt();
+    }
+    m_RowMax = m_PixelYMax;
+    if (m_Parameters.contains("pixel y stop"))
+    {
+        m_RowMax = m_Parameters["pixel y stop"].toInt();
+    }
+    m_CurrentRow = m_RowMin - 1;
+    m_RowMutex.unlock();
+    m_PixelStep = qMax(1, m_Parameters["pixel step"].toInt());
+    m_SampleStep = qMax(1, m_Parameters["sample step"].toInt());
 }
 
 
@@ -916,6 +1627,9 @@ QHash < QString, QString > FractalWorker::GetStatistics() const
         QString("%1").arg(m_Statistics_MinBrightnessValue);
     statistics["max brightness value"] =
         QString("%1").arg(m_Statistics_MaxBrightnessValue);
+    statistics["core at start"] = QString("%1").arg(m_Statistics_Core);
+    statistics["numa node at start"] =
+        QString("%1").arg(m_Statistics_NumaNode);
     return statistics;
 }
 
@@ -926,6 +1640,9 @@ QHash < QString, QString > FractalWorker::GetStatistics() const
 void FractalWorker::ResetStatistics()
 {
     m_Statistics_FirstIteration = true;
+    m_PausedTime_ms = 0;
+    m_Statistics_Core = -1;
+    m_Statistics_NumaNode = -1;
     m_Statistics_ProcessingTime_ms = 0;
     m_Statistics_PointsFinished = 0;
     m_Statistics_PointsInSet = 0;
@@ -5,12 +5,20 @@
 #define FRACTALWORKER_H
 
 // Qt includes
+#include <QAtomicInt>
+#include <QByteArray>
 #include <QElapsedTimer>
 #include <QHash>
 #include <QImage>
+#include <QMutex>
 #include <QObject>
 #include <QVector>
 
+// Render state shared by all workers of an image
+#define RUN_STATE_RUNNING 0
+#define RUN_STATE_PAUSED 1
+#define RUN_STATE_STOPPED 2
+
 // Class definition
 class FractalWorker
     : public QObject
@@ -37,7 +45,26 @@ public:
     // Set cache values
     void SetCacheValues(const QVector < double > mcColorCache,
         const QVector < double > mcBrightnessCache);
+
+    // Set cache values (encoded by TileCacheEncoding; decoded in Start())
+    void SetEncodedCacheValues(const QByteArray & mcrColorCache,
+        const QByteArray & mcrBrightnessCache);
 private:
+    // Allocate cache and image (in our own thread if buffers are to be
+    // NUMA-local, so memory is placed on the node of the core we run on;
+    // only these scratch buffers are, tile data kept by FractalImage and its
+    // image stay where the main thread allocates them)
+    void AllocateBuffers();
+    bool m_NumaLocalBuffers;
+
+    // Pin our thread to a core (if any) and record where we're running at
+    // the start of a unit (unpinned threads may move later)
+    void PinToCore();
+    int m_Core;
+
+    // NUMA node of a core (0 without NUMA information)
+    static int GetNumaNode(const int mcCore);
+
     // Oversampling values
     QList < double > m_OversamplingValues;
 
@@ -56,16 +83,38 @@ private:
     QColor CalculatePixelColor(const long double mcReal,
         const long double mcImag);
 
+    // Point of the complex plane at a position in the image (pixels)
+    void GetPoint(const double mcX, const double mcY, double & mrReal,
+        double & mrImag) const;
+    void GetPoint(const double mcX, const double mcY, long double & mrReal,
+        long double & mrImag) const;
+
     // Calculate argument (angle) of complex number
-    double ComplexArg(const double mcReal, const double mcImag) const;
+    static double ComplexArg(const double mcReal, const double mcImag);
     long double ComplexArg(const long double mcReal,
         const long double mcImag) const;
 
     // Calculate color from values
     QColor CalculateColorForIndex(const int mcCacheIndex) const;
 
+    // Store color value (or what it is derived from) in cache
+    void SetCacheValue(const int mcCacheIndex, const double mcColorValue,
+        const int mcDepth, const double mcFinalReal, const double mcFinalImag);
+
+    // Color value from cache
+    double GetColorValue(const int mcCacheIndex) const;
+
+    // Count a sample served from the cache
+    void AddCachedSampleToStatistics(const int mcCacheIndex);
+
+    // Check if a cached sample is an orbit that can be resumed
+    bool IsOrbitResumable(const int mcCacheIndex) const;
+
+    // Check if a cached sample hasn't been calculated (NaN)
+    bool IsSampleMissing(const int mcCacheIndex) const;
+
 signals:
-    void Finished(const int mcTileID);
+    void Finished(const int mcUnitID);
 
 private:
     // Parameters
@@ -77,6 +126,7 @@ private:
 
     // Abbreviations
     int m_TileID;
+    int m_UnitID;
 
     QString m_FractalType;
 
@@ -94,6 +144,16 @@ private:
     long double m_JuliaReal_Long;
     long double m_JuliaImag_Long;
 
+    // Exponential map ("projection" "log-polar") around a center, from the
+    // outer to the inner radius (instead of the range)
+    bool m_IsLogPolar;
+    double m_CenterReal;
+    double m_CenterImag;
+    long double m_CenterReal_Long;
+    long double m_CenterImag_Long;
+    double m_LogRadiusMin;
+    double m_LogRadiusMax;
+
     int m_Depth;
     double m_EscapeRadius;
     int m_Oversampling;
@@ -125,6 +185,54 @@ private:
     int m_PixelYMin;
     int m_PixelYMax;
 
+    // Only calculate every step-th pixel (coarse passes), or every step-th
+    // sample of a pixel in each direction (antialiasing passes)
+    int m_PixelStep;
+    int m_SampleStep;
+
+public:
+    // Rows of the tile this worker calculates (other rows of image and cache
+    // are left alone). Rows not started yet can be handed to another worker
+    // while this one is running.
+    int GetRowMin() const;
+    int GetRowMax() const;
+    int GetRowsLeft() const;
+    int SplitRows(const int mcStep);
+private:
+    // Check if a row is still ours, and mark it as being calculated
+    bool StartRow(const int mcPixelY);
+
+public:
+    // Render state to check while running (workers without one never stop
+    // or pause)
+    void SetRunState(QAtomicInt * mpRunState);
+
+    // Check if the worker has been stopped before it was done; samples it
+    // didn't get to are missing (NaN), and rows from the stop row on are
+    // incomplete
+    bool WasStopped() const;
+    int GetStopRow() const;
+private:
+    // Wait while paused; returns false if we're to stop
+    bool KeepRunning();
+
+    // Mark samples of this pass from the given pixel to the end of our rows
+    // as missing
+    void MarkMissingFrom(const int mcPixelX, const int mcPixelY);
+
+    // Mark a sample that hasn't been reached as missing
+    void MarkSampleMissing(const int mcCacheIndex);
+
+    QAtomicInt * m_RunState;
+    bool m_WasStopped;
+    int m_StopRow;
+    qint64 m_PausedTime_ms;
+
+    int m_RowMin;
+    int m_RowMax;
+    int m_CurrentRow;
+    mutable QMutex m_RowMutex;
+
 public:
     // Access to image
     QImage GetImage() const;
@@ -140,9 +248,27 @@ public:
 private:
     QVector < double > m_ColorCache;
     QVector < double > m_BrightnessCache;
+    QByteArray m_EncodedColorCache;
+    QByteArray m_EncodedBrightnessCache;
     bool m_CacheIsPreset;
     int m_CacheIndex;
 
+    // Color cache holds escape iteration and final z (three values per
+    // sample) rather than the color value
+    bool m_CacheOrbitData;
+
+    // Samples inside the set keep their current z (and strip average sum) so
+    // they can be resumed with a higher depth
+    bool m_ResumeOrbits;
+    bool m_ResumingOrbits;
+
+public:
+    // Depth the cache values have been calculated with
+    void SetCacheDepth(const int mcDepth);
+    int GetCacheDepth() const;
+private:
+    int m_CacheDepth;
+
 public:
     // Check if worker is idle
     bool IsIdle() const;
@@ -152,6 +278,18 @@ private:
 public:
     // Get tile statistics
     QHash < QString, QString > GetStatistics() const;
+
+    // Number of samples a pass calculates in the given rows of a tile
+    // (rows relative to the top of the tile)
+    static qint64 GetNumberOfPassPoints(const int mcWidth,
+        const int mcRowMin, const int mcRowMax, const int mcOversampling,
+        const int mcPixelStep, const int mcSampleStep);
+
+    // Color value of a sample from its cached escape iteration and final z
+    // (also used for recoloring, so both give the same picture)
+    static double GetOrbitColorValue(const double mcEscapeDepth,
+        const double mcReal, const double mcImag, const int mcDepth,
+        const bool mcIsContinuous, const bool mcIsAngle);
 private:
     // Reset statistics
     void ResetStatistics();
@@ -170,6 +308,8 @@ private:
     double m_Statistics_MaxColorValue;
     double m_Statistics_MinBrightnessValue;
     double m_Statistics_MaxBrightnessValue;
+    int m_Statistics_Core;
+    int m_Statistics_NumaNode;
 };
 
 #endif
@@ -0,0 +1,187 @@
+// HeadlessRenderer.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "HeadlessRenderer.h"
+#include "Preferences.h"
+
+// Qt includes
+#include <QFile>
+#include <QHash>
+#include <QTextStream>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+HeadlessRenderer::HeadlessRenderer()
+{
+    CALL_IN("");
+
+    m_Fractal = new Fractal();
+    m_FractalImage = new FractalImage();
+    m_LastPercentComplete = -1;
+
+    connect (m_FractalImage, SIGNAL(PeriodicUpdate()),
+        this, SLOT(PerformPeriodicUpdate()));
+    connect (m_FractalImage, SIGNAL(Finished()),
+        this, SLOT(PerformFinished()));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+HeadlessRenderer::~HeadlessRenderer()
+{
+    CALL_IN("");
+
+    delete m_FractalImage;
+    delete m_Fractal;
+
+    CALL_OUT("");
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start rendering
+bool HeadlessRenderer::Start(const QString & mcrFilename,
+    const int mcShardIndex, const int mcShardCount)
+{
+    CALL_IN(QString("mcrFilename=%1, mcShardIndex=%2, mcShardCount=%3")
+        .arg(CALL_SHOW(mcrFilename),
+             CALL_SHOW(mcShardIndex),
+             CALL_SHOW(mcShardCount)));
+
+    // Check shard
+    if (mcShardCount < 1 ||
+        mcShardIndex < 1 ||
+        mcShardIndex > mcShardCount)
+    {
+        m_LastError = tr("Invalid shard %1 of %2.")
+            .arg(mcShardIndex)
+            .arg(mcShardCount);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Read fractal
+    if (!QFile::exists(mcrFilename))
+    {
+        m_LastError = tr("Fractal \"%1\" does not exist.").arg(mcrFilename);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    if (!m_Fractal -> FromFile(mcrFilename))
+    {
+        m_LastError = tr("Fractal \"%1\" could not be read.")
+            .arg(mcrFilename);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // There's no window to take the size from
+    const QHash < QString, QString > fractal_parameters =
+        m_Fractal -> GetAllParameters();
+    if (fractal_parameters["use fixed resolution"] != "yes")
+    {
+        m_LastError = tr("Fractal \"%1\" needs a fixed resolution to be "
+            "rendered without a window.").arg(mcrFilename);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    const int width = fractal_parameters["fixed resolution width"].toInt();
+    const int height = fractal_parameters["fixed resolution height"].toInt();
+    QHash < QString, QString > parameters =
+        m_Fractal -> GetParametersForResolution(width, height,
+            Preferences::Instance());
+    parameters["render shard index"] = QString("%1").arg(mcShardIndex);
+    parameters["render shard count"] = QString("%1").arg(mcShardCount);
+
+    // Do the work
+    QTextStream(stdout) << tr("Rendering \"%1\" (%2x%3), shard %4 of %5")
+        .arg(parameters["name"])
+        .arg(width)
+        .arg(height)
+        .arg(mcShardIndex)
+        .arg(mcShardCount) << Qt::endl;
+    m_FractalImage -> Render(parameters);
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Last error
+QString HeadlessRenderer::GetLastError() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_LastError;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Report progress
+void HeadlessRenderer::PerformPeriodicUpdate()
+{
+    CALL_IN("");
+
+    // Only whole percents
+    const QHash < QString, QString > statistics =
+        m_FractalImage -> GetStatistics();
+    const int percent_complete =
+        int(statistics["percent complete"].toDouble());
+    if (percent_complete != m_LastPercentComplete)
+    {
+        m_LastPercentComplete = percent_complete;
+        QTextStream out(stdout);
+        out << tr("%1% complete").arg(percent_complete) << Qt::endl;
+
+        // Worker processes helping us
+        if (!statistics["remote workers"].isEmpty())
+        {
+            const QStringList workers =
+                statistics["remote workers"].split("; ");
+            for (const QString & worker : workers)
+            {
+                out << "    " << worker << Qt::endl;
+            }
+        }
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Rendering done
+void HeadlessRenderer::PerformFinished()
+{
+    CALL_IN("");
+
+    const QHash < QString, QString > statistics =
+        m_FractalImage -> GetStatistics();
+    QTextStream(stdout) << tr("Done: %1 points in %2 ms")
+        .arg(statistics["points finished short"],
+             statistics["processing time ms"]) << Qt::endl;
+    emit Finished();
+
+    CALL_OUT("");
+}
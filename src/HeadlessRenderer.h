@@ -0,0 +1,70 @@
+// HeadlessRenderer.h
+// Class definition
+
+// Renders a fractal from a file without any GUI, e.g. one shard of a poster
+// on a render node. Picture, statistics (and the journal of a shard) are
+// saved to the storage directory like they are for renders in a window.
+
+#ifndef HEADLESSRENDERER_H
+#define HEADLESSRENDERER_H
+
+// Project includes
+#include "Fractal.h"
+#include "FractalImage.h"
+
+// Qt includes
+#include <QObject>
+#include <QString>
+
+// Class definition
+class HeadlessRenderer
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    HeadlessRenderer();
+
+    // Destructor
+    virtual ~HeadlessRenderer();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Start rendering (shard index starts at 1; a shard count of 1 renders
+    // everything)
+    bool Start(const QString & mcrFilename, const int mcShardIndex,
+        const int mcShardCount);
+
+    // Last error
+    QString GetLastError() const;
+
+signals:
+    // Rendering done
+    void Finished();
+
+private slots:
+    // Report progress
+    void PerformPeriodicUpdate();
+
+    // Rendering done
+    void PerformFinished();
+
+private:
+    // What's being rendered
+    Fractal * m_Fractal;
+    FractalImage * m_FractalImage;
+
+    // Progress reported last (in percent)
+    int m_LastPercentComplete;
+
+    // Last error
+    QString m_LastError;
+};
+
+#endif
@@ -11,6 +11,7 @@
 #include "MessageLogger.h"
 #include "Preferences.h"
 #include "StringHelper.h"
+#include "TileCacheEncoding.h"
 
 // Qt includes
 #include <QDebug>
@@ -202,6 +203,12 @@ void MainWindow::InitGUI()
         this, SLOT(StartCalculation()));
     bottom_layout -> addWidget(m_StartCalulation);
 
+    m_PauseCalulation = new QPushButton(tr("Pause"));
+    m_PauseCalulation -> setFixedWidth(100);
+    connect (m_PauseCalulation, SIGNAL(clicked()),
+        this, SLOT(PauseCalculation()));
+    bottom_layout -> addWidget(m_PauseCalulation);
+
     m_StopCalulation = new QPushButton(tr("Stop"));
     m_StopCalulation -> setFixedWidth(100);
     connect (m_StopCalulation, SIGNAL(clicked()),
@@ -334,11 +341,30 @@ void MainWindow::InitGUI_Fractal()
     QLabel * l_depth = new QLabel(tr("Maximum depth"));
     main_layout -> addWidget(l_depth, row, 0);
 
+    QHBoxLayout * layout_depth = new QHBoxLayout();
+    main_layout -> addLayout(layout_depth, row, 1);
+
     m_MaxDepth = new QLineEdit();
     m_MaxDepth -> setFixedWidth(70);
     connect (m_MaxDepth, SIGNAL(textChanged(const QString &)),
         this, SLOT(UpdateFractalInfo()));
-    main_layout -> addWidget(m_MaxDepth, row, 1, Qt::AlignLeft);
+    layout_depth -> addWidget(m_MaxDepth);
+
+    // (Maximum depth is the upper limit for the automatic depth)
+    m_AutoDepth = new QCheckBox(tr("Automatic with fidelity"));
+    connect (m_AutoDepth, SIGNAL(stateChanged(int)),
+        this, SLOT(UpdateFractalInfo()));
+    layout_depth -> addWidget(m_AutoDepth);
+
+    m_AutoDepthFidelity = new QLineEdit();
+    m_AutoDepthFidelity -> setFixedWidth(50);
+    connect (m_AutoDepthFidelity, SIGNAL(textChanged(const QString &)),
+        this, SLOT(UpdateFractalInfo()));
+    layout_depth -> addWidget(m_AutoDepthFidelity);
+
+    QLabel * l_auto_depth_percent = new QLabel(tr("%"));
+    layout_depth -> addWidget(l_auto_depth_percent);
+    layout_depth -> addStretch(1);
     row++;
 
     // Escape Radius
@@ -839,7 +865,7 @@ void MainWindow::InitGUI_Optimizer()
     layout -> addWidget(m_FirstParameter_NumIntervals, row, 1, 1, 3);
 
     // Second parameter
-    gb_parameter = new QGroupBox(tr("First parameter (x)"));
+    gb_parameter = new QGroupBox(tr("Second parameter (y)"));
     main_layout -> addWidget(gb_parameter);
 
     layout -> setColumnStretch(0,0);
@@ -1036,6 +1062,14 @@ void MainWindow::InitGUI_Statistics()
     main_layout -> setRowStretch(row, 0);
     row++;
 
+    QLabel * l_remote_workers = new QLabel(tr("Remote workers"));
+    main_layout -> addWidget(l_remote_workers, row, 0);
+    m_Stats_RemoteWorkers = new QLabel();
+    m_Stats_RemoteWorkers -> setWordWrap(true);
+    main_layout -> addWidget(m_Stats_RemoteWorkers, row, 1);
+    main_layout -> setRowStretch(row, 0);
+    row++;
+
     QLabel * l_pixels = new QLabel(tr("Total points"));
     main_layout -> addWidget(l_pixels, row, 0);
     m_Stats_TotalPoints = new QLabel();
@@ -1057,6 +1091,13 @@ void MainWindow::InitGUI_Statistics()
     main_layout -> setRowStretch(row, 0);
     row++;
 
+    QLabel * l_auto_depth = new QLabel(tr("Automatic depth"));
+    main_layout -> addWidget(l_auto_depth, row, 0);
+    m_Stats_AutoDepth = new QLabel();
+    main_layout -> addWidget(m_Stats_AutoDepth, row, 1);
+    main_layout -> setRowStretch(row, 0);
+    row++;
+
     QLabel * l_color = new QLabel(tr("Color value range"));
     main_layout -> addWidget(l_color, row, 0);
     m_Stats_ColorValueRange = new QLabel();
@@ -1138,6 +1179,8 @@ void MainWindow::Refresh_Values()
         parameters["imag min"] = "-1.3";
         parameters["imag max"] = "1.3";
         parameters["depth"] = "1000";
+        parameters["auto depth"] = "no";
+        parameters["auto depth fidelity"] = "99.9";
         parameters["escape radius"] = "4000";
         parameters["julia real"] = "0";
         parameters["julia imag"] = "0";
@@ -1247,6 +1290,18 @@ void MainWindow::Refresh_Values()
     m_MaxDepth -> setEnabled(m_CurrentFractalWidget != nullptr);
     m_MaxDepth -> blockSignals(false);
 
+    m_AutoDepth -> blockSignals(true);
+    m_AutoDepth -> setCheckState(
+        parameters["auto depth"] == "yes" ? Qt::Checked : Qt::Unchecked);
+    m_AutoDepth -> setEnabled(m_CurrentFractalWidget != nullptr);
+    m_AutoDepth -> blockSignals(false);
+
+    m_AutoDepthFidelity -> blockSignals(true);
+    m_AutoDepthFidelity -> setText(parameters["auto depth fidelity"]);
+    m_AutoDepthFidelity -> setEnabled(m_CurrentFractalWidget != nullptr &&
+        parameters["auto depth"] == "yes");
+    m_AutoDepthFidelity -> blockSignals(false);
+
     m_EscapeRadius -> blockSignals(true);
     m_EscapeRadius -> setText(parameters["escape radius"]);
     m_EscapeRadius -> setEnabled(m_CurrentFractalWidget != nullptr);
@@ -1519,21 +1574,29 @@ void MainWindow::Refresh_Values()
     {
         FractalImage * fractal_image =
             m_CurrentFractalWidget -> GetFractalImage();
-        if (fractal_image -> GetRenderStatus() == "working")
+        const QString status = fractal_image -> GetRenderStatus();
+        if (status == "working" ||
+            status == "paused")
         {
             m_StartCalulation -> setVisible(false);
+            m_PauseCalulation -> setVisible(true);
             m_StopCalulation -> setVisible(true);
         } else
         {
             m_StartCalulation -> setVisible(true);
+            m_PauseCalulation -> setVisible(false);
             m_StopCalulation -> setVisible(false);
         }
+        m_PauseCalulation -> setText(status == "paused" ?
+            tr("Resume") : tr("Pause"));
     } else
     {
         m_StartCalulation -> setVisible(false);
+        m_PauseCalulation -> setVisible(false);
         m_StopCalulation -> setVisible(true);
     }
     m_StartCalulation -> setEnabled(m_CurrentFractalWidget != nullptr);
+    m_PauseCalulation -> setEnabled(m_CurrentFractalWidget != nullptr);
     m_StopCalulation -> setEnabled(m_CurrentFractalWidget != nullptr);
 
     CALL_OUT("");
@@ -2007,8 +2070,13 @@ void MainWindow::NewWidth()
 
     // Check if we need to disable saving cache to ram
     const int oversampling = fractal -> GetOversampling();
+    Preferences * p = Preferences::Instance();
+    const QString format = p -> GetTagValue("Cache:Memory Format");
+    const int values_per_sample =
+        (p -> GetTagValue("Cache:Orbit Data") == "yes" ? 4 : 2);
     const double cache_size =
-        width * oversampling * height * oversampling * 2 * sizeof(double);
+        double(width) * oversampling * height * oversampling *
+            values_per_sample * TileCacheEncoding::GetBytesPerValue(format);
     if (cache_size > 8e9)
     {
         // De-activate ram caching
@@ -2157,6 +2225,10 @@ void MainWindow::UpdateFractalInfo()
     // Depth and escape radius
     const int depth = m_MaxDepth -> text().toInt();
     fractal -> SetDepth(depth);
+    const bool auto_depth = (m_AutoDepth -> checkState() == Qt::Checked);
+    const double fidelity = m_AutoDepthFidelity -> text().toDouble();
+    fractal -> SetAutoDepth(auto_depth, fidelity);
+    m_AutoDepthFidelity -> setEnabled(auto_depth);
     const double escape_radius = m_EscapeRadius -> text().toDouble();
     fractal -> SetEscapeRadius(escape_radius);
 
@@ -2395,10 +2467,9 @@ void MainWindow::Refresh_Optimizer()
     m_IncludeParameterValues -> setEnabled(true);
     m_StartOptimizer -> setEnabled(true);
 
-    // !!! We only vary parameters of the current visualization
-    // Current fractal
-    // FractalWidget * widget = m_Windows[row];
-    // Fractal * fractal = widget -> GetWorker();
+    // We only vary parameters of the current visualization that don't change
+    // cached values (so the image can be recolored without calculating
+    // anything)
 
     m_FirstParameter -> clear();
     m_FirstParameter -> addItem(tr("none"), "");
@@ -2422,8 +2493,6 @@ void MainWindow::Refresh_Optimizer()
         "color offset");
     m_FirstParameter -> addItem(tr("Factor (ramp coloring/greyscale)"),
         "color factor");
-    m_FirstParameter -> addItem(tr("Fold change (brightness/strip average)"),
-        "brightness fold change");
     m_FirstParameter -> addItem(tr("Factor (brightness/strip average)"),
         "brightness factor");
     m_FirstParameter -> addItem(tr("Offset (brightness/strip average)"),
@@ -2431,15 +2500,6 @@ void MainWindow::Refresh_Optimizer()
     m_FirstParameter -> addItem(
         tr("Minimum brightness (brightness/strip average)"),
         "brightness min brightness");
-    m_FirstParameter -> addItem(
-        tr("Fold change (brightness/alternative strip average)"),
-        "brightness fold change");
-    m_FirstParameter -> addItem(
-        tr("Regularity (brightness/alternative strip average)"),
-        "brightness regularity");
-    m_FirstParameter -> addItem(
-        tr("Exponent (brightness/alternative strip average)"),
-        "brightness exponent");
 
     m_SecondParameter -> clear();
     m_SecondParameter -> addItem(tr("none"), "");
@@ -2463,8 +2523,6 @@ void MainWindow::Refresh_Optimizer()
         "color offset");
     m_SecondParameter -> addItem(tr("Factor (ramp coloring/greyscale)"),
         "color factor");
-    m_SecondParameter -> addItem(tr("Fold change (brightness/strip average)"),
-        "brightness fold change");
     m_SecondParameter -> addItem(tr("Factor (brightness/strip average)"),
         "brightness factor");
     m_SecondParameter -> addItem(tr("Offset (brightness/strip average)"),
@@ -2472,15 +2530,6 @@ void MainWindow::Refresh_Optimizer()
     m_SecondParameter -> addItem(
         tr("Minimum brightness (brightness/strip average)"),
         "brightness min brightness");
-    m_SecondParameter -> addItem(
-        tr("Fold change (brightness/alternative strip average)"),
-        "brightness fold change");
-    m_SecondParameter -> addItem(
-        tr("Regularity (brightness/alternative strip average)"),
-        "brightness regularity");
-    m_SecondParameter -> addItem(
-        tr("Exponent (brightness/alternative strip average)"),
-        "brightness exponent");
 
     CALL_OUT("");
 }
@@ -2515,49 +2564,81 @@ void MainWindow::StartOptimizer()
 
     // Current fractal
     FractalImage * fractal_image = m_CurrentFractalWidget -> GetFractalImage();
-    Fractal * fractal = m_CurrentFractalWidget -> GetFractal();
 
-    // Calculation
+    // Areas, their parameters and labels (second parameter goes from top to
+    // bottom, both ranges include their ends)
     const QPair < int, int > resolution =
         fractal_image -> GetImageResolution();
-    QHash < QString, QString > parameters = fractal -> GetAllParameters();
     const int width = resolution.first;
     const int height = resolution.second;
-    for (int area_y = 0; area_y < second_intervals; area_y++)
+    const int number_x = (first_parameter.isEmpty() ? 1 : first_intervals);
+    const int number_y = (second_parameter.isEmpty() ? 1 : second_intervals);
+    QList < QRect > areas;
+    QList < QHash < QString, QString > > area_parameters;
+    QList < QString > labels;
+    for (int area_y = 0; area_y < number_y; area_y++)
     {
         // Area
-        const int y_min = height * area_y * 1./second_intervals;
-        const int y_max = height * (area_y + 1) * 1./second_intervals;
-        parameters["pixel y min"] = QString("%1").arg(y_min);
-        parameters["pixel y max"] = QString("%1").arg(y_max);
+        const int y_min = height * area_y * 1./number_y;
+        const int y_max = height * (area_y + 1) * 1./number_y;
 
         // Value in that area
-        const double value = second_max +
-            (second_min - second_max) * area_y * 1./second_intervals;
-        parameters[second_parameter] = QString("%1").arg(value);
+        double second_value = second_max;
+        if (number_y > 1)
+        {
+            second_value += (second_min - second_max) * area_y /
+                (number_y - 1.);
+        }
 
-        for (int area_x = 0; area_x < first_intervals; area_x++)
+        for (int area_x = 0; area_x < number_x; area_x++)
         {
             // Area
-            const int x_min = width * area_x * 1./first_intervals;
-            const int x_max = width * (area_x + 1) * 1./first_intervals;
-            parameters["pixel x min"] = QString("%1").arg(x_min);
-            parameters["pixel x max"] = QString("%1").arg(x_max);
+            const int x_min = width * area_x * 1./number_x;
+            const int x_max = width * (area_x + 1) * 1./number_x;
+            areas << QRect(x_min, y_min, x_max - x_min, y_max - y_min);
 
             // Value in that area
-            const double value = first_min +
-                (first_max - first_min) * area_x * 1./first_intervals;
-            // !!! Do we need this somewhere?
-            // !!! QHash < QString, QString > this_parameter;
-            parameters[first_parameter] = QString("%1").arg(value);
-
-            // Calculate tile
-            // !!! fractal -> StartRendering(x_min, x_max, y_min, y_max);
+            double first_value = first_min;
+            if (number_x > 1)
+            {
+                first_value += (first_max - first_min) * area_x /
+                    (number_x - 1.);
+            }
+            QHash < QString, QString > parameters;
+            QList < QString > label;
+            if (!first_parameter.isEmpty())
+            {
+                parameters[first_parameter] =
+                    QString("%1").arg(first_value);
+                label << QString("%1 = %2")
+                    .arg(first_parameter,
+                         parameters[first_parameter]);
+            }
+            if (!second_parameter.isEmpty())
+            {
+                parameters[second_parameter] =
+                    QString("%1").arg(second_value);
+                label << QString("%1 = %2")
+                    .arg(second_parameter,
+                         parameters[second_parameter]);
+            }
+            area_parameters << parameters;
+            labels << (m_IncludeParameterValues -> isChecked() ?
+                label.join("\n") : QString());
         }
     }
 
-    // Include text on image (if requested)
-    // !!!
+    // Recolor all areas at once from the values of the current image
+    if (!fractal_image -> RecolorAreas(areas, area_parameters, labels))
+    {
+        QMessageBox::warning(this, tr("Optimizer"),
+            tr("The optimizer recolors the current image from the values "
+               "kept in memory. Please render the image completely first, "
+               "with cache data kept in memory."));
+        CALL_OUT("Cannot recolor");
+        return;
+    }
+    Refresh_Statistics();
 
     CALL_OUT("");
 }
@@ -2570,15 +2651,21 @@ void MainWindow::StartCalculation()
 {
     CALL_IN("");
 
-    // Only "Stop" button
+    // Only "Pause" and "Stop" buttons
     m_StartCalulation -> setEnabled(true);
     m_StartCalulation -> hide();
+    m_PauseCalulation -> setEnabled(true);
+    m_PauseCalulation -> setText(tr("Pause"));
+    m_PauseCalulation -> show();
     m_StopCalulation -> setEnabled(true);
     m_StopCalulation -> show();
 
     // Start calculating
     m_CurrentFractalWidget -> UpdateImage();
 
+    // Range may have changed to keep the scale of a resized image
+    Refresh_Values();
+
     CALL_OUT("");
 }
 
@@ -2597,6 +2684,7 @@ void MainWindow::StopCalculation()
     fractal_image -> Stop();
 
     // Wait for threads to finish
+    m_PauseCalulation -> setEnabled(false);
     m_StopCalulation -> setEnabled(false);
 
     CALL_OUT("");
@@ -2604,6 +2692,32 @@ void MainWindow::StopCalculation()
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Pause/Resume calculation
+void MainWindow::PauseCalculation()
+{
+    CALL_IN("");
+
+    // Get current fractal
+    FractalImage * fractal_image = m_CurrentFractalWidget -> GetFractalImage();
+
+    // Workers wait where they are until we resume
+    if (fractal_image -> GetRenderStatus() == "paused")
+    {
+        fractal_image -> Resume();
+        m_PauseCalulation -> setText(tr("Pause"));
+    } else
+    {
+        fractal_image -> Pause();
+        m_PauseCalulation -> setText(tr("Resume"));
+    }
+    Refresh_Statistics();
+
+    CALL_OUT("");
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Calculate new image width/height when window size changes
 void MainWindow::FractalWindowSizeChanged(const int mcFractalWidgetID)
@@ -2886,9 +3000,11 @@ void MainWindow::Refresh_Statistics()
         m_Stats_Finished -> setText("n/a");
         m_Stats_Duration -> setText("n/a");
         m_Stats_NumberOfThreads -> setText("n/a");
+        m_Stats_RemoteWorkers -> setText("n/a");
         m_Stats_TotalPoints -> setText("n/a");
         m_Stats_PointsInSet -> setText("n/a");
         m_Stats_TotalIterations -> setText("n/a");
+        m_Stats_AutoDepth -> setText("n/a");
         m_Stats_ColorValueRange -> setText("n/a");
         m_Stats_BrightnessValueRange -> setText("n/a");
 
@@ -2910,6 +3026,9 @@ void MainWindow::Refresh_Statistics()
     } else if (status == "working")
     {
         m_Stats_Status -> setText(tr("working"));
+    } else if (status == "paused")
+    {
+        m_Stats_Status -> setText(tr("paused"));
     } else
     {
         m_Stats_Status -> setText(tr("unknown status"));
@@ -2940,12 +3059,31 @@ void MainWindow::Refresh_Statistics()
 
     m_Stats_NumberOfThreads -> setText(statistics["number of threads"]);
 
+    if (statistics["remote workers"].isEmpty())
+    {
+        m_Stats_RemoteWorkers -> setText(tr("none"));
+    } else
+    {
+        m_Stats_RemoteWorkers -> setText(
+            statistics["remote workers"].split("; ").join("\n"));
+    }
+
     m_Stats_TotalPoints -> setText(statistics["points finished short"]);
 
     m_Stats_PointsInSet -> setText(statistics["points in set short"]);
 
     m_Stats_TotalIterations -> setText(statistics["total iterations short"]);
 
+    if (statistics["auto depth"].isEmpty())
+    {
+        m_Stats_AutoDepth -> setText(tr("n/a"));
+    } else
+    {
+        m_Stats_AutoDepth -> setText(tr("%1 (probe: %2 ms)")
+            .arg(statistics["auto depth"],
+                 statistics["auto depth probe time ms"]));
+    }
+
     if (statistics["min color value"].isEmpty() ||
         statistics["max color value"].isEmpty())
     {
@@ -3017,6 +3155,7 @@ void MainWindow::Finished(const int mcFractalWidgetID)
     // Back to "Start" button
     m_StartCalulation -> setEnabled(true);
     m_StartCalulation -> show();
+    m_PauseCalulation -> hide();
     m_StopCalulation -> setEnabled(true);
     m_StopCalulation -> hide();
 
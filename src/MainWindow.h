@@ -76,6 +76,8 @@ private:
     QLineEdit * m_ImagMin;
     QLineEdit * m_ImagMax;
     QLineEdit * m_MaxDepth;
+    QCheckBox * m_AutoDepth;
+    QLineEdit * m_AutoDepthFidelity;
     QLineEdit * m_EscapeRadius;
 
     QCheckBox * m_UseHighPrecision;
@@ -163,14 +165,17 @@ private:
     QLabel * m_Stats_Finished;
     QLabel * m_Stats_Duration;
     QLabel * m_Stats_NumberOfThreads;
+    QLabel * m_Stats_RemoteWorkers;
     QLabel * m_Stats_TotalPoints;
     QLabel * m_Stats_PointsInSet;
     QLabel * m_Stats_TotalIterations;
+    QLabel * m_Stats_AutoDepth;
     QLabel * m_Stats_ColorValueRange;
     QLabel * m_Stats_BrightnessValueRange;
 
     // Everything else
     QPushButton * m_StartCalulation;
+    QPushButton * m_PauseCalulation;
     QPushButton * m_StopCalulation;
 
 private slots:
@@ -212,6 +217,9 @@ private slots:
     void StartCalculation();
     void StopCalculation();
 
+    // Pause/Resume calculation
+    void PauseCalculation();
+
     // Calculate new image width/height when window size changes
     void FractalWindowSizeChanged(const int mcFractalWidgetID);
 
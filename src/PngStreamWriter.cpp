@@ -0,0 +1,297 @@
+// PngStreamWriter.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "PngStreamWriter.h"
+
+// Qt includes
+#include <QtEndian>
+
+// Size of IDAT chunks
+#define CHUNK_SIZE (1 << 20)
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+PngStreamWriter::PngStreamWriter()
+{
+    CALL_IN("");
+
+    m_Width = 0;
+    m_Height = 0;
+    m_RowsWritten = 0;
+    m_IsStreamOpen = false;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+PngStreamWriter::~PngStreamWriter()
+{
+    CALL_IN("");
+
+    // An incomplete file is no use to anyone
+    if (m_IsStreamOpen)
+    {
+        deflateEnd(&m_Stream);
+        m_File.close();
+        m_File.remove();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Open file and write the header
+bool PngStreamWriter::Open(const QString & mcrFilename, const int mcWidth,
+    const int mcHeight)
+{
+    CALL_IN(QString("mcrFilename=%1, mcWidth=%2, mcHeight=%3")
+        .arg(CALL_SHOW(mcrFilename),
+             CALL_SHOW(mcWidth),
+             CALL_SHOW(mcHeight)));
+
+    // Check dimensions
+    if (mcWidth <= 0 ||
+        mcHeight <= 0)
+    {
+        m_LastError = tr("Invalid picture size %1x%2.")
+            .arg(mcWidth)
+            .arg(mcHeight);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Open file
+    m_File.setFileName(mcrFilename);
+    if (!m_File.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        m_LastError = tr("Could not open \"%1\" for writing: %2")
+            .arg(mcrFilename,
+                 m_File.errorString());
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    m_Width = mcWidth;
+    m_Height = mcHeight;
+    m_RowsWritten = 0;
+
+    // Signature
+    static const char signature[] = "\x89PNG\r\n\x1a\n";
+    m_File.write(signature, 8);
+
+    // Header: dimensions, 8 bit RGB, no interlacing
+    QByteArray header(13, '\0');
+    qToBigEndian < quint32 >(quint32(mcWidth), header.data());
+    qToBigEndian < quint32 >(quint32(mcHeight), header.data() + 4);
+    header[8] = 8;
+    header[9] = 2;
+    if (!WriteChunk("IHDR", header))
+    {
+        m_File.close();
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Start compression
+    m_Stream = z_stream();
+    if (deflateInit(&m_Stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+    {
+        m_LastError = tr("Could not initialize compression.");
+        m_File.close();
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    m_IsStreamOpen = true;
+    m_Row.resize(1 + 3 * mcWidth);
+    m_Compressed.clear();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write the next row
+bool PngStreamWriter::WriteRow(const uchar * mcpPixels)
+{
+    CALL_IN("mcpPixels=...");
+
+    if (!m_IsStreamOpen ||
+        m_RowsWritten >= m_Height)
+    {
+        m_LastError = tr("No more rows expected.");
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Filter type "none", followed by RGB
+    uchar * row = reinterpret_cast < uchar * >(m_Row.data());
+    row[0] = 0;
+    const QRgb * pixels = reinterpret_cast < const QRgb * >(mcpPixels);
+    for (int x = 0; x < m_Width; x++)
+    {
+        row[1 + 3 * x] = uchar(qRed(pixels[x]));
+        row[2 + 3 * x] = uchar(qGreen(pixels[x]));
+        row[3 + 3 * x] = uchar(qBlue(pixels[x]));
+    }
+
+    // Compress it
+    m_Stream.next_in = row;
+    m_Stream.avail_in = uInt(m_Row.size());
+    if (!Deflate(Z_NO_FLUSH))
+    {
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    m_RowsWritten++;
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write the rest and close the file
+bool PngStreamWriter::Close()
+{
+    CALL_IN("");
+
+    if (!m_IsStreamOpen)
+    {
+        m_LastError = tr("File is not open.");
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    if (m_RowsWritten != m_Height)
+    {
+        m_LastError = tr("Only %1 of %2 rows have been written.")
+            .arg(m_RowsWritten)
+            .arg(m_Height);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Rest of the compressed data, and the end
+    m_Stream.next_in = nullptr;
+    m_Stream.avail_in = 0;
+    if (!Deflate(Z_FINISH) ||
+        !WriteChunk("IDAT", m_Compressed) ||
+        !WriteChunk("IEND", QByteArray()))
+    {
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    deflateEnd(&m_Stream);
+    m_IsStreamOpen = false;
+    m_Compressed.clear();
+    m_File.close();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Last error
+QString PngStreamWriter::GetLastError() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_LastError;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Compress what's in m_Stream, and write chunks when there's enough
+bool PngStreamWriter::Deflate(const int mcFlush)
+{
+    CALL_IN(QString("mcFlush=%1")
+        .arg(CALL_SHOW(mcFlush)));
+
+    char buffer[16384];
+    int result;
+    do
+    {
+        m_Stream.next_out = reinterpret_cast < Bytef * >(buffer);
+        m_Stream.avail_out = sizeof(buffer);
+        result = deflate(&m_Stream, mcFlush);
+        if (result == Z_STREAM_ERROR)
+        {
+            m_LastError = tr("Compression failed.");
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        m_Compressed.append(buffer, int(sizeof(buffer) - m_Stream.avail_out));
+
+        // Full chunk
+        if (m_Compressed.size() >= CHUNK_SIZE)
+        {
+            if (!WriteChunk("IDAT", m_Compressed))
+            {
+                CALL_OUT(m_LastError);
+                return false;
+            }
+            m_Compressed.clear();
+        }
+    } while (m_Stream.avail_out == 0 ||
+        (mcFlush == Z_FINISH && result != Z_STREAM_END));
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write a chunk (length, type, data, checksum of type and data)
+bool PngStreamWriter::WriteChunk(const QByteArray & mcrType,
+    const QByteArray & mcrData)
+{
+    CALL_IN(QString("mcrType=%1, mcrData=...")
+        .arg(CALL_SHOW(QString::fromLatin1(mcrType))));
+
+    uchar length[4];
+    qToBigEndian < quint32 >(quint32(mcrData.size()), length);
+    uLong crc = crc32(0, nullptr, 0);
+    crc = crc32(crc, reinterpret_cast < const Bytef * >(mcrType.constData()),
+        uInt(mcrType.size()));
+    crc = crc32(crc, reinterpret_cast < const Bytef * >(mcrData.constData()),
+        uInt(mcrData.size()));
+    uchar checksum[4];
+    qToBigEndian < quint32 >(quint32(crc), checksum);
+
+    m_File.write(reinterpret_cast < const char * >(length), 4);
+    m_File.write(mcrType);
+    m_File.write(mcrData);
+    if (m_File.write(reinterpret_cast < const char * >(checksum), 4) != 4)
+    {
+        m_LastError = tr("Could not write to \"%1\": %2")
+            .arg(m_File.fileName(),
+                 m_File.errorString());
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
@@ -0,0 +1,80 @@
+// PngStreamWriter.h
+// Class definition
+
+// Writes a PNG file row by row, so pictures far larger than what fits into
+// memory (e.g. when merging the shards of a poster) can be saved. Rows are
+// 8 bit RGB and compressed with zlib as they come in; only the compressed
+// data of the current chunk is held in memory.
+
+#ifndef PNGSTREAMWRITER_H
+#define PNGSTREAMWRITER_H
+
+// Qt includes
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QRgb>
+#include <QString>
+
+// System includes
+#include <zlib.h>
+
+// Class definition
+class PngStreamWriter
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    PngStreamWriter();
+
+    // Destructor
+    virtual ~PngStreamWriter();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Open file and write the header
+    bool Open(const QString & mcrFilename, const int mcWidth,
+        const int mcHeight);
+
+    // Write the next row (pixels in QImage::Format_RGB32)
+    bool WriteRow(const uchar * mcpPixels);
+
+    // Write the rest and close the file (fails if rows are missing)
+    bool Close();
+
+    // Last error
+    QString GetLastError() const;
+
+private:
+    // Compress what's in m_Stream, and write chunks when there's enough
+    bool Deflate(const int mcFlush);
+
+    // Write a chunk
+    bool WriteChunk(const QByteArray & mcrType, const QByteArray & mcrData);
+
+    // File
+    QFile m_File;
+
+    // Dimensions, and rows written so far
+    int m_Width;
+    int m_Height;
+    int m_RowsWritten;
+
+    // Compression
+    z_stream m_Stream;
+    bool m_IsStreamOpen;
+    QByteArray m_Row;
+    QByteArray m_Compressed;
+
+    // Last error
+    QString m_LastError;
+};
+
+#endif
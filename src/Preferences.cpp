@@ -105,6 +105,13 @@ QString Preferences::GetTagValue(const QString mcTag) const
     CALL_IN(QString("mcTag=%1")
         .arg(CALL_SHOW(mcTag)));
 
+    // Values for this session only
+    if (m_SessionTagValues.contains(mcTag))
+    {
+        CALL_OUT("");
+        return m_SessionTagValues[mcTag];
+    }
+
     QSettings settings(QCoreApplication::organizationName(),
         QCoreApplication::applicationName());
     QStringList all_keys = settings.allKeys();
@@ -143,6 +150,22 @@ void Preferences::SetTagValue(const QString mcTag, const QString mcValue)
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Set preference value for this session only
+void Preferences::SetSessionTagValue(const QString mcTag,
+    const QString mcValue)
+{
+    CALL_IN(QString("mcTag=%1, mcValue=%2")
+        .arg(CALL_SHOW(mcTag),
+             CALL_SHOW(mcValue)));
+
+    m_SessionTagValues[mcTag] = mcValue;
+
+    CALL_OUT("");
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Clean up stuff
 void Preferences::DeleteTagsMatching(const QString mcPattern)
@@ -44,6 +44,14 @@ public:
     // Set preference value
     void SetTagValue(const QString mcTag, const QString mcValue);
 
+    // Set preference value for this session only (e.g. from the command
+    // line; not stored, and takes precedence over the stored value)
+    void SetSessionTagValue(const QString mcTag, const QString mcValue);
+private:
+    QHash < QString, QString > m_SessionTagValues;
+
+public:
+
     // Clean up stuff
     void DeleteTagsMatching(const QString mcPattern);
 
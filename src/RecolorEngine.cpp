@@ -0,0 +1,338 @@
+// RecolorEngine.cpp
+// Class implementation
+
+// Project includes
+#include "FractalWorker.h"
+#include "RecolorEngine.h"
+#include "TileCacheEncoding.h"
+
+// Qt includes
+#include <QPair>
+#include <QThread>
+
+// System includes
+#include <cmath>
+
+// Entries of the lookup tables (power of 2), and the range of the tanh
+// table (it's 1 beyond, as far as 8 bit colors are concerned)
+#define LOOKUP_TABLE_SIZE 8192
+#define TANH_RANGE 8.
+
+
+
+// We don't do call tracing here because recoloring happens in several
+// threads, and our way of doing that is not thread safe.
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+RecolorEngine::RecolorEngine(
+    const QHash < QString, QString > & mcrParameters)
+{
+    // Lookup tables
+    m_HalfSine.resize(LOOKUP_TABLE_SIZE);
+    m_Tanh.resize(LOOKUP_TABLE_SIZE);
+    for (int index = 0; index < LOOKUP_TABLE_SIZE; index++)
+    {
+        m_HalfSine[index] =
+            float((sin(2 * M_PI * index / LOOKUP_TABLE_SIZE) + 1.) / 2);
+        m_Tanh[index] = float(tanh(TANH_RANGE * index / LOOKUP_TABLE_SIZE));
+    }
+
+    // Values (the same way FractalWorker has them)
+    m_CacheOrbitData = (mcrParameters["storage cache orbit data"] == "yes");
+    m_IsContinuous = (mcrParameters["color base value"] == "continuous");
+    m_IsAngle = (mcrParameters["color base value"] == "angle");
+    m_Depth = mcrParameters["depth"].toInt();
+    m_Oversampling = qMax(1, mcrParameters["oversampling"].toInt());
+
+    // Color
+    m_IsRamp = (mcrParameters["color mapping method"] == "ramp");
+    m_IsPeriodic = (mcrParameters["color mapping method"] == "periodic");
+    m_Ramp_Factor = mcrParameters["color factor"].toDouble();
+    m_Ramp_Offset = mcrParameters["color offset"].toDouble();
+    if (mcrParameters["color scheme"] == "color")
+    {
+        m_Periodic_FactorR = mcrParameters["color factor red"].toDouble();
+        m_Periodic_OffsetR = mcrParameters["color offset red"].toDouble();
+        m_Periodic_FactorG = mcrParameters["color factor green"].toDouble();
+        m_Periodic_OffsetG = mcrParameters["color offset green"].toDouble();
+        m_Periodic_FactorB = mcrParameters["color factor blue"].toDouble();
+        m_Periodic_OffsetB = mcrParameters["color offset blue"].toDouble();
+    } else
+    {
+        m_Periodic_FactorR = mcrParameters["color factor"].toDouble();
+        m_Periodic_OffsetR = mcrParameters["color offset"].toDouble();
+        m_Periodic_FactorG = m_Periodic_FactorR;
+        m_Periodic_OffsetG = m_Periodic_OffsetR;
+        m_Periodic_FactorB = m_Periodic_FactorR;
+        m_Periodic_OffsetB = m_Periodic_OffsetR;
+    }
+
+    // Brightness
+    m_IsFlat = (mcrParameters["brightness value"] == "flat");
+    m_IsStripAverage =
+        (mcrParameters["brightness value"] == "strip average" ||
+        mcrParameters["brightness value"] == "strip average alt");
+    m_StripAverage_Factor = mcrParameters["brightness factor"].toDouble();
+    m_StripAverage_Offset = mcrParameters["brightness offset"].toDouble();
+    m_StripAverage_MinBrightness =
+        mcrParameters["brightness min brightness"].toDouble();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+RecolorEngine::~RecolorEngine()
+{
+    // Nothing to do.
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Only recolor pixels within an area (before adding tiles)
+void RecolorEngine::SetArea(const QRect & mcrArea)
+{
+    m_Area = mcrArea;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a tile
+void RecolorEngine::AddTile(const int mcPixelXMin, const int mcPixelXMax,
+    const int mcPixelYMin, const int mcPixelYMax,
+    const QByteArray & mcrColorData, const QByteArray & mcrBrightnessData)
+{
+    // Tiles outside the area don't need to be recolored
+    if (m_Area.isValid() &&
+        !m_Area.intersects(QRect(mcPixelXMin, mcPixelYMin,
+            mcPixelXMax - mcPixelXMin, mcPixelYMax - mcPixelYMin)))
+    {
+        return;
+    }
+
+    m_PixelXMin << mcPixelXMin;
+    m_PixelXMax << mcPixelXMax;
+    m_PixelYMin << mcPixelYMin;
+    m_PixelYMax << mcPixelYMax;
+    m_ColorData << mcrColorData;
+    m_BrightnessData << mcrBrightnessData;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Recolor all tiles into an image
+void RecolorEngine::Recolor(QImage & mrImage, const int mcThreads) const
+{
+    RecolorBatch(QList < const RecolorEngine * >() << this, mrImage,
+        mcThreads);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Recolor the tiles of several engines into one image
+void RecolorEngine::RecolorBatch(
+    const QList < const RecolorEngine * > & mcrEngines, QImage & mrImage,
+    const int mcThreads)
+{
+    // Every tile of every engine is a job
+    QList < QPair < const RecolorEngine *, int > > jobs;
+    for (const RecolorEngine * engine : mcrEngines)
+    {
+        for (int tile = 0; tile < engine -> m_ColorData.size(); tile++)
+        {
+            jobs << QPair < const RecolorEngine *, int >(engine, tile);
+        }
+    }
+
+    // Threads only ever write to their own jobs' pixels (bits() makes sure
+    // the image isn't shared before they start; areas of engines must not
+    // overlap)
+    uchar * image_data = mrImage.bits();
+    const qsizetype bytes_per_line = mrImage.bytesPerLine();
+    const int number_of_threads =
+        qBound(1, mcThreads, qMax(1, int(jobs.size())));
+    auto recolor_jobs = [&jobs, image_data, bytes_per_line,
+        number_of_threads](const int mcFirstJob)
+    {
+        for (int job = mcFirstJob; job < jobs.size();
+             job += number_of_threads)
+        {
+            jobs[job].first -> RecolorTile(jobs[job].second, image_data,
+                bytes_per_line);
+        }
+    };
+    QList < QThread * > threads;
+    for (int index = 1; index < number_of_threads; index++)
+    {
+        QThread * thread = QThread::create(recolor_jobs, index);
+        thread -> start();
+        threads << thread;
+    }
+
+    // We're one of them
+    recolor_jobs(0);
+    for (QThread * thread : threads)
+    {
+        thread -> wait();
+        delete thread;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Recolor one tile
+void RecolorEngine::RecolorTile(const int mcTile, uchar * mpImageData,
+    const qsizetype mcBytesPerLine) const
+{
+    const QVector < double > color_data =
+        TileCacheEncoding::Decode(m_ColorData[mcTile]);
+    const QVector < double > brightness_data =
+        TileCacheEncoding::Decode(m_BrightnessData[mcTile]);
+    const int number_of_samples = brightness_data.size();
+    if (color_data.size() !=
+        number_of_samples * (m_CacheOrbitData ? 3 : 1))
+    {
+        // Doesn't match the tile; leave it alone
+        return;
+    }
+
+    // Color values (from escape iteration and final z, if that's what's
+    // been cached)
+    QVector < double > values(number_of_samples);
+    const double * color = color_data.constData();
+    if (m_CacheOrbitData)
+    {
+        for (int sample = 0; sample < number_of_samples; sample++)
+        {
+            values[sample] = FractalWorker::GetOrbitColorValue(
+                color[3 * sample], color[3 * sample + 1],
+                color[3 * sample + 2], m_Depth, m_IsContinuous, m_IsAngle);
+        }
+    } else
+    {
+        for (int sample = 0; sample < number_of_samples; sample++)
+        {
+            values[sample] = color[sample];
+        }
+    }
+
+    // Brightness
+    QVector < float > brightness(number_of_samples, m_IsFlat ? 255.f : 0.f);
+    if (m_IsStripAverage)
+    {
+        const double * brightness_values = brightness_data.constData();
+        const float scale = float(255 * (1 - m_StripAverage_MinBrightness));
+        const float minimum = float(255 * m_StripAverage_MinBrightness);
+        for (int sample = 0; sample < number_of_samples; sample++)
+        {
+            brightness[sample] = minimum + scale * GetHalfSine(
+                brightness_values[sample] * m_StripAverage_Factor +
+                    m_StripAverage_Offset);
+        }
+    }
+
+    // Pixels (average of their samples)
+    const int samples_per_pixel = m_Oversampling * m_Oversampling;
+    const float normalizer = 1.f / samples_per_pixel;
+    const int tile_width = m_PixelXMax[mcTile] - m_PixelXMin[mcTile];
+    int pixel_x_min = m_PixelXMin[mcTile];
+    int pixel_x_max = m_PixelXMax[mcTile];
+    int pixel_y_min = m_PixelYMin[mcTile];
+    int pixel_y_max = m_PixelYMax[mcTile];
+    if (m_Area.isValid())
+    {
+        pixel_x_min = qMax(pixel_x_min, m_Area.left());
+        pixel_x_max = qMin(pixel_x_max, m_Area.right() + 1);
+        pixel_y_min = qMax(pixel_y_min, m_Area.top());
+        pixel_y_max = qMin(pixel_y_max, m_Area.bottom() + 1);
+    }
+    for (int pixel_y = pixel_y_min; pixel_y < pixel_y_max; pixel_y++)
+    {
+        QRgb * line = reinterpret_cast < QRgb * >(
+            mpImageData + pixel_y * mcBytesPerLine);
+        int sample = ((pixel_y - m_PixelYMin[mcTile]) * tile_width +
+            pixel_x_min - m_PixelXMin[mcTile]) * samples_per_pixel;
+        for (int pixel_x = pixel_x_min; pixel_x < pixel_x_max; pixel_x++)
+        {
+            float red = 0;
+            float green = 0;
+            float blue = 0;
+            for (int index = 0; index < samples_per_pixel; index++, sample++)
+            {
+                const double value = values[sample];
+                if (std::isinf(value))
+                {
+                    // Inside the set (black) or out of bounds (red)
+                    if (value < 0)
+                    {
+                        red += 255;
+                    }
+                    continue;
+                }
+                if (m_IsRamp)
+                {
+                    const float gray = brightness[sample] *
+                        GetRamp((value - m_Ramp_Offset) * m_Ramp_Factor);
+                    red += gray;
+                    green += gray;
+                    blue += gray;
+                } else if (m_IsPeriodic)
+                {
+                    red += brightness[sample] * GetHalfSine(
+                        value * m_Periodic_FactorR + m_Periodic_OffsetR);
+                    green += brightness[sample] * GetHalfSine(
+                        value * m_Periodic_FactorG + m_Periodic_OffsetG);
+                    blue += brightness[sample] * GetHalfSine(
+                        value * m_Periodic_FactorB + m_Periodic_OffsetB);
+                }
+            }
+            line[pixel_x] = qRgb(int(red * normalizer),
+                int(green * normalizer), int(blue * normalizer));
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// (sin(x) + 1) / 2
+float RecolorEngine::GetHalfSine(const double mcX) const
+{
+    const double position = mcX * (LOOKUP_TABLE_SIZE / (2 * M_PI));
+    const qint64 index = qint64(floor(position));
+    return m_HalfSine[int(index & (LOOKUP_TABLE_SIZE - 1))];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// tanh(x), limited to 0 .. 1
+float RecolorEngine::GetRamp(const double mcX) const
+{
+    if (!(mcX > 0))
+    {
+        return 0;
+    }
+    const double position = mcX * (LOOKUP_TABLE_SIZE / TANH_RANGE);
+    if (position >= LOOKUP_TABLE_SIZE)
+    {
+        return 1;
+    }
+    return m_Tanh[int(position)];
+}
@@ -0,0 +1,110 @@
+// RecolorEngine.h
+// Class definition
+
+// Recolors cached tile data (color and brightness values, as kept in memory
+// by FractalImage) straight into an image, without any workers. Coloring
+// parameters are read once, sines and tanh come from lookup tables, and
+// tiles are shared among threads, each turning a whole tile into pixels in
+// simple loops over its values. Engines with different parameters can
+// recolor different areas of one image in a single batch.
+
+#ifndef RECOLORENGINE_H
+#define RECOLORENGINE_H
+
+// Qt includes
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+// Class definition
+class RecolorEngine
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor (parameters are those of the render)
+    RecolorEngine(const QHash < QString, QString > & mcrParameters);
+
+    // Destructor
+    virtual ~RecolorEngine();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Only recolor pixels within an area (before adding tiles; default:
+    // whole tiles)
+    void SetArea(const QRect & mcrArea);
+
+    // Add a tile (pixel area and encoded data, see TileCacheEncoding)
+    void AddTile(const int mcPixelXMin, const int mcPixelXMax,
+        const int mcPixelYMin, const int mcPixelYMax,
+        const QByteArray & mcrColorData, const QByteArray & mcrBrightnessData);
+
+    // Recolor all tiles into an image (RGB32, with the size of the render;
+    // pixels of tiles whose values don't fit are left as they are)
+    void Recolor(QImage & mrImage, const int mcThreads) const;
+
+    // Recolor the tiles of several engines into one image, all in one go
+    // (areas of the engines must not overlap)
+    static void RecolorBatch(
+        const QList < const RecolorEngine * > & mcrEngines, QImage & mrImage,
+        const int mcThreads);
+
+private:
+    // Recolor one tile
+    void RecolorTile(const int mcTile, uchar * mpImageData,
+        const qsizetype mcBytesPerLine) const;
+
+    // (sin(x) + 1) / 2
+    float GetHalfSine(const double mcX) const;
+
+    // tanh(x), limited to 0 .. 1
+    float GetRamp(const double mcX) const;
+
+    // Lookup tables
+    QVector < float > m_HalfSine;
+    QVector < float > m_Tanh;
+
+    // Coloring (parsed once)
+    bool m_CacheOrbitData;
+    bool m_IsContinuous;
+    bool m_IsAngle;
+    int m_Depth;
+    int m_Oversampling;
+    bool m_IsRamp;
+    bool m_IsPeriodic;
+    double m_Ramp_Factor;
+    double m_Ramp_Offset;
+    double m_Periodic_FactorR;
+    double m_Periodic_OffsetR;
+    double m_Periodic_FactorG;
+    double m_Periodic_OffsetG;
+    double m_Periodic_FactorB;
+    double m_Periodic_OffsetB;
+    bool m_IsFlat;
+    bool m_IsStripAverage;
+    double m_StripAverage_Factor;
+    double m_StripAverage_Offset;
+    double m_StripAverage_MinBrightness;
+
+    // Area and tiles
+    QRect m_Area;
+    QList < int > m_PixelXMin;
+    QList < int > m_PixelXMax;
+    QList < int > m_PixelYMin;
+    QList < int > m_PixelYMax;
+    QList < QByteArray > m_ColorData;
+    QList < QByteArray > m_BrightnessData;
+};
+
+#endif
@@ -0,0 +1,830 @@
+// RenderDaemon.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "Fractal.h"
+#include "FractalImage.h"
+#include "Preferences.h"
+#include "RenderDaemon.h"
+
+// Qt includes
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <QTextStream>
+
+// System includes
+#include <algorithm>
+
+// How often we look for new jobs anyway [ms]
+#define SCAN_INTERVAL 5000
+
+// How long a job file must not have changed before we pick it up [ms]
+#define JOB_SETTLE_TIME 2000
+
+// How long a control client waits for the daemon [ms]
+#define CONTROL_TIMEOUT 5000
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+RenderDaemon::RenderDaemon()
+{
+    CALL_IN("");
+
+    m_CoreBudget = 1;
+    m_ExitWhenIdle = false;
+    m_IsScanning = false;
+    m_IsRescanNeeded = false;
+
+    connect (&m_Watcher, SIGNAL(directoryChanged(const QString &)),
+        this, SLOT(ScanQueue()));
+    connect (&m_ScanTimer, SIGNAL(timeout()),
+        this, SLOT(ScanQueue()));
+    connect (&m_ControlServer, SIGNAL(newConnection()),
+        this, SLOT(NewControlConnection()));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+RenderDaemon::~RenderDaemon()
+{
+    CALL_IN("");
+
+    // Jobs still running are picked up from their journals next time
+    for (auto job_iterator = m_JobToImage.constBegin();
+         job_iterator != m_JobToImage.constEnd();
+         job_iterator++)
+    {
+        job_iterator.value() -> Stop();
+        delete job_iterator.value();
+        delete m_JobToFractal[job_iterator.key()];
+    }
+    m_ControlServer.close();
+
+    CALL_OUT("");
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start working on the jobs in a directory
+bool RenderDaemon::Start(const QString & mcrDirectory,
+    const int mcCoreBudget, const bool mcExitWhenIdle)
+{
+    CALL_IN(QString("mcrDirectory=%1, mcCoreBudget=%2, mcExitWhenIdle=%3")
+        .arg(CALL_SHOW(mcrDirectory),
+             CALL_SHOW(mcCoreBudget),
+             CALL_SHOW(mcExitWhenIdle)));
+
+    if (mcCoreBudget < 1)
+    {
+        m_LastError = tr("Invalid number of cores %1.").arg(mcCoreBudget);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    m_Directory = QFileInfo(mcrDirectory).absoluteFilePath();
+    m_CoreBudget = mcCoreBudget;
+    m_ExitWhenIdle = mcExitWhenIdle;
+
+    // Directory layout
+    const QStringList subdirectories = { "queue", "running", "done",
+        "failed", "cancelled" };
+    for (const QString & subdirectory : subdirectories)
+    {
+        const QString path = m_Directory + "/" + subdirectory;
+        if (!QDir().mkpath(path))
+        {
+            m_LastError = tr("Could not create directory \"%1\".").arg(path);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+    }
+
+    // Jobs interrupted last time are continued (their journals know how far
+    // they got)
+    const QStringList interrupted_jobs = QDir(m_Directory + "/running")
+        .entryList({ "*.job", "*.xml" }, QDir::Files);
+    for (const QString & job_name : interrupted_jobs)
+    {
+        MoveJob(job_name, "running", "queue");
+    }
+
+    // Control socket
+    const QString control = m_Directory + "/control";
+    QLocalServer::removeServer(control);
+    if (!m_ControlServer.listen(control))
+    {
+        m_LastError = tr("Could not listen on \"%1\": %2")
+            .arg(control,
+                 m_ControlServer.errorString());
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Watch the queue
+    m_Watcher.addPath(m_Directory + "/queue");
+    m_ScanTimer.start(SCAN_INTERVAL);
+    QTextStream(stdout) << tr("Rendering jobs in \"%1\" on %2 cores")
+        .arg(m_Directory)
+        .arg(m_CoreBudget) << Qt::endl;
+    ScanQueue();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Send a command to the daemon working on a directory
+bool RenderDaemon::SendCommand(const QString & mcrDirectory,
+    const QString & mcrCommand, QString & mrAnswer)
+{
+    CALL_IN(QString("mcrDirectory=%1, mcrCommand=%2, mrAnswer=...")
+        .arg(CALL_SHOW(mcrDirectory),
+             CALL_SHOW(mcrCommand)));
+
+    QLocalSocket socket;
+    socket.connectToServer(
+        QFileInfo(mcrDirectory).absoluteFilePath() + "/control");
+    if (!socket.waitForConnected(CONTROL_TIMEOUT))
+    {
+        mrAnswer = tr("No daemon is running in \"%1\": %2")
+            .arg(mcrDirectory,
+                 socket.errorString());
+        CALL_OUT(mrAnswer);
+        return false;
+    }
+    socket.write(mcrCommand.toUtf8() + "\n");
+    socket.flush();
+
+    // Daemon closes the connection after answering
+    QByteArray answer;
+    while (socket.state() == QLocalSocket::ConnectedState &&
+        socket.waitForReadyRead(CONTROL_TIMEOUT))
+    {
+        answer += socket.readAll();
+    }
+    answer += socket.readAll();
+    mrAnswer = QString::fromUtf8(answer).trimmed();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Last error
+QString RenderDaemon::GetLastError() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_LastError;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check for new jobs
+void RenderDaemon::ScanQueue()
+{
+    CALL_IN("");
+
+    // Starting a job may finish one (and get us here again)
+    if (m_IsScanning)
+    {
+        m_IsRescanNeeded = true;
+        CALL_OUT("Scanning already");
+        return;
+    }
+    m_IsScanning = true;
+    do
+    {
+        m_IsRescanNeeded = false;
+
+        // Start jobs in order, as long as they fit (a job that doesn't fit yet
+        // holds back the ones after it, so big jobs don't starve)
+        int free_cores = m_CoreBudget;
+        for (auto threads_iterator = m_JobToThreads.constBegin();
+             threads_iterator != m_JobToThreads.constEnd();
+             threads_iterator++)
+        {
+            free_cores -= threads_iterator.value();
+        }
+        const QDateTime now = QDateTime::currentDateTime();
+        const QStringList queued_jobs = GetQueuedJobs();
+        for (const QString & job_name : queued_jobs)
+        {
+            // Files that were just changed may still be being written (unless
+            // they were renamed into place); the next scan gets them
+            const QFileInfo job_file(m_Directory + "/queue/" + job_name);
+            if (job_file.lastModified().msecsTo(now) < JOB_SETTLE_TIME)
+            {
+                continue;
+            }
+
+            QHash < QString, QString > job;
+            if (!ReadJob(m_Directory + "/queue/" + job_name, job))
+            {
+                MoveJob(job_name, "queue", "failed", job["error"]);
+                continue;
+            }
+            int threads = m_CoreBudget;
+            if (job.contains("threads"))
+            {
+                threads = qBound(1, job["threads"].toInt(), m_CoreBudget);
+            }
+            if (threads > free_cores)
+            {
+                break;
+            }
+            if (StartJob(job_name, threads))
+            {
+                free_cores -= threads;
+            }
+        }
+    } while (m_IsRescanNeeded);
+    m_IsScanning = false;
+
+    // Nothing left to do
+    if (m_ExitWhenIdle &&
+        m_JobToImage.isEmpty() &&
+        GetQueuedJobs().isEmpty())
+    {
+        m_ScanTimer.stop();
+        emit Finished();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// New control connection
+void RenderDaemon::NewControlConnection()
+{
+    CALL_IN("");
+
+    while (m_ControlServer.hasPendingConnections())
+    {
+        QLocalSocket * socket = m_ControlServer.nextPendingConnection();
+        connect (socket, SIGNAL(readyRead()),
+            this, SLOT(ReadControlCommand()));
+        connect (socket, SIGNAL(disconnected()),
+            socket, SLOT(deleteLater()));
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read a control command (one line per connection)
+void RenderDaemon::ReadControlCommand()
+{
+    CALL_IN("");
+
+    QLocalSocket * socket = qobject_cast < QLocalSocket * >(sender());
+    if (!socket ||
+        !socket -> canReadLine())
+    {
+        CALL_OUT("No complete command yet");
+        return;
+    }
+    const QString line = QString::fromUtf8(socket -> readLine()).trimmed();
+    const QStringList words = line.split(' ', Qt::SkipEmptyParts);
+    const QString command = (words.isEmpty() ? QString() : words[0]);
+
+    QString answer;
+    if (command == "enqueue" &&
+        (words.size() == 2 || words.size() == 3))
+    {
+        answer = Enqueue(words[1], words.size() == 3 ? words[2] : QString());
+    } else if (command == "cancel" &&
+        words.size() == 2)
+    {
+        answer = Cancel(words[1]);
+    } else if (command == "status" &&
+        words.size() == 1)
+    {
+        answer = GetStatus();
+    } else
+    {
+        answer = tr("Unknown command \"%1\" (use \"enqueue <file> "
+            "[priority]\", \"cancel <job>\" or \"status\")").arg(line);
+    }
+    socket -> write(answer.toUtf8() + "\n");
+    socket -> flush();
+    socket -> disconnectFromServer();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Job done
+void RenderDaemon::JobFinished()
+{
+    CALL_IN("");
+
+    FractalImage * image = qobject_cast < FractalImage * >(sender());
+    if (!m_ImageToJob.contains(image))
+    {
+        CALL_OUT("Not one of ours");
+        return;
+    }
+    const QString job_name = m_ImageToJob[image];
+    const bool is_cancelled = m_CancelledJobs.contains(job_name);
+    const QString output_error = image -> GetOutputError();
+    const QHash < QString, QString > statistics = image -> GetStatistics();
+    if (is_cancelled)
+    {
+        QTextStream(stdout) << tr("Cancelled \"%1\"").arg(job_name)
+            << Qt::endl;
+        MoveJob(job_name, "running", "cancelled");
+    } else if (!output_error.isEmpty())
+    {
+        // Rendered, but nothing to show for it
+        QTextStream(stdout) << tr("Failed \"%1\": %2")
+            .arg(job_name,
+                 output_error) << Qt::endl;
+        MoveJob(job_name, "running", "failed", output_error);
+    } else
+    {
+        QTextStream(stdout) << tr("Done \"%1\": %2 points in %3 ms")
+            .arg(job_name,
+                 statistics["points finished short"],
+                 statistics["processing time ms"]) << Qt::endl;
+        MoveJob(job_name, "running", "done");
+    }
+
+    // Finished is emitted from within the image, so it goes later
+    image -> deleteLater();
+    m_JobToFractal[job_name] -> deleteLater();
+    m_ImageToJob.remove(image);
+    m_JobToImage.remove(job_name);
+    m_JobToFractal.remove(job_name);
+    m_JobToThreads.remove(job_name);
+    m_CancelledJobs.remove(job_name);
+
+    // Cores are free again
+    ScanQueue();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read a job
+bool RenderDaemon::ReadJob(const QString & mcrFilename,
+    QHash < QString, QString > & mrJob) const
+{
+    CALL_IN(QString("mcrFilename=%1, mrJob=...")
+        .arg(CALL_SHOW(mcrFilename)));
+
+    mrJob.clear();
+
+    // A fractal on its own
+    if (mcrFilename.endsWith(".xml"))
+    {
+        mrJob["fractal"] = mcrFilename;
+        CALL_OUT("");
+        return true;
+    }
+
+    // Job file
+    QFile file(mcrFilename);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        mrJob["error"] = tr("Could not open \"%1\": %2")
+            .arg(mcrFilename,
+                 file.errorString());
+        CALL_OUT(mrJob["error"]);
+        return false;
+    }
+    const QStringList lines = QString::fromUtf8(file.readAll()).split('\n');
+    for (const QString & line : lines)
+    {
+        const QString trimmed_line = line.trimmed();
+        if (trimmed_line.isEmpty() ||
+            trimmed_line.startsWith('#'))
+        {
+            continue;
+        }
+        const int separator = trimmed_line.indexOf('=');
+        if (separator < 0)
+        {
+            mrJob.clear();
+            mrJob["error"] = tr("Invalid line \"%1\"").arg(trimmed_line);
+            CALL_OUT(mrJob["error"]);
+            return false;
+        }
+        mrJob[trimmed_line.left(separator).trimmed()] =
+            trimmed_line.mid(separator + 1).trimmed();
+    }
+
+    // Check it
+    if (mrJob["fractal"].isEmpty())
+    {
+        mrJob.clear();
+        mrJob["error"] = tr("Job does not say which fractal to render.");
+        CALL_OUT(mrJob["error"]);
+        return false;
+    }
+    const QStringList numbers = { "width", "height", "priority", "threads" };
+    for (const QString & key : numbers)
+    {
+        bool is_number = true;
+        if (mrJob.contains(key))
+        {
+            mrJob[key].toInt(&is_number);
+        }
+        if (!is_number)
+        {
+            const QString reason = tr("Invalid %1 \"%2\"")
+                .arg(key,
+                     mrJob[key]);
+            mrJob.clear();
+            mrJob["error"] = reason;
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+
+    // Relative paths are relative to the job directory
+    const QDir directory(m_Directory);
+    mrJob["fractal"] = directory.absoluteFilePath(mrJob["fractal"]);
+    if (mrJob.contains("output"))
+    {
+        mrJob["output"] = directory.absoluteFilePath(mrJob["output"]);
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Queued jobs, in the order they are to be started (higher priority first,
+// then first come, first served)
+QStringList RenderDaemon::GetQueuedJobs() const
+{
+    CALL_IN("");
+
+    const QDir queue(m_Directory + "/queue");
+    const QFileInfoList job_files =
+        queue.entryInfoList({ "*.job", "*.xml" }, QDir::Files);
+    QList < QPair < QPair < int, qint64 >, QString > > order;
+    for (const QFileInfo & job_file : job_files)
+    {
+        QHash < QString, QString > job;
+        ReadJob(job_file.absoluteFilePath(), job);
+        const int priority = job["priority"].toInt();
+        order << qMakePair(
+            qMakePair(-priority, job_file.lastModified().toMSecsSinceEpoch()),
+            job_file.fileName());
+    }
+    std::sort(order.begin(), order.end());
+
+    QStringList job_names;
+    for (const auto & entry : order)
+    {
+        job_names << entry.second;
+    }
+
+    CALL_OUT("");
+    return job_names;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start a job
+bool RenderDaemon::StartJob(const QString & mcrJobName, const int mcThreads)
+{
+    CALL_IN(QString("mcrJobName=%1, mcThreads=%2")
+        .arg(CALL_SHOW(mcrJobName),
+             CALL_SHOW(mcThreads)));
+
+    // Claim it
+    MoveJob(mcrJobName, "queue", "running");
+    QHash < QString, QString > job;
+    if (!ReadJob(m_Directory + "/running/" + mcrJobName, job))
+    {
+        MoveJob(mcrJobName, "running", "failed", job["error"]);
+        CALL_OUT(job["error"]);
+        return false;
+    }
+
+    // Read fractal
+    if (!QFile::exists(job["fractal"]))
+    {
+        const QString reason =
+            tr("Fractal \"%1\" does not exist.").arg(job["fractal"]);
+        MoveJob(mcrJobName, "running", "failed", reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    Fractal * fractal = new Fractal();
+    if (!fractal -> FromFile(job["fractal"]))
+    {
+        delete fractal;
+        const QString reason =
+            tr("Fractal \"%1\" could not be read.").arg(job["fractal"]);
+        MoveJob(mcrJobName, "running", "failed", reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Resolution: from the job or the fractal
+    const QHash < QString, QString > fractal_parameters =
+        fractal -> GetAllParameters();
+    int width = fractal_parameters["fixed resolution width"].toInt();
+    int height = fractal_parameters["fixed resolution height"].toInt();
+    if (job.contains("width") ||
+        job.contains("height"))
+    {
+        width = job.value("width", QString::number(width)).toInt();
+        height = job.value("height", QString::number(height)).toInt();
+    } else if (fractal_parameters["use fixed resolution"] != "yes")
+    {
+        width = 0;
+        height = 0;
+    }
+    if (width <= 0 ||
+        height <= 0)
+    {
+        delete fractal;
+        const QString reason = tr("Fractal \"%1\" needs a fixed resolution "
+            "(or the job a width and height).").arg(job["fractal"]);
+        MoveJob(mcrJobName, "running", "failed", reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Batch jobs always keep a journal (so they survive restarts), save
+    // their output, and don't serve remote workers
+    QHash < QString, QString > parameters =
+        fractal -> GetParametersForResolution(width, height,
+            Preferences::Instance());
+    parameters["use fixed resolution"] = "yes";
+    parameters["fixed resolution width"] = QString("%1").arg(width);
+    parameters["fixed resolution height"] = QString("%1").arg(height);
+    parameters["storage render journal"] = "yes";
+    parameters["storage save picture"] = "yes";
+    parameters["storage save statistics"] = "yes";
+    parameters["storage output directory"] = job["output"];
+    parameters["render threads"] = QString("%1").arg(mcThreads);
+    parameters["render work queue address"] = "";
+
+    // Two jobs may well render the same fractal at the same resolution, so
+    // each gets a journal of its own
+    parameters["storage render journal name"] = mcrJobName;
+
+    // Keep track of it before rendering (a job that's journaled completely
+    // finishes right away)
+    FractalImage * image = new FractalImage();
+    m_JobToFractal[mcrJobName] = fractal;
+    m_JobToImage[mcrJobName] = image;
+    m_JobToThreads[mcrJobName] = mcThreads;
+    m_ImageToJob[image] = mcrJobName;
+    connect (image, SIGNAL(Finished()),
+        this, SLOT(JobFinished()));
+
+    QTextStream(stdout) << tr("Starting \"%1\": \"%2\" (%3x%4) on %5 cores")
+        .arg(mcrJobName,
+             parameters["name"])
+        .arg(width)
+        .arg(height)
+        .arg(mcThreads) << Qt::endl;
+    image -> Render(parameters);
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Move a job (and its error file, if any) to another directory
+void RenderDaemon::MoveJob(const QString & mcrJobName, const QString & mcrFrom,
+    const QString & mcrTo, const QString & mcrError)
+{
+    CALL_IN(QString("mcrJobName=%1, mcrFrom=%2, mcrTo=%3, mcrError=%4")
+        .arg(CALL_SHOW(mcrJobName),
+             CALL_SHOW(mcrFrom),
+             CALL_SHOW(mcrTo),
+             CALL_SHOW(mcrError)));
+
+    const QString source = QString("%1/%2/%3")
+        .arg(m_Directory,
+             mcrFrom,
+             mcrJobName);
+    const QString destination = QString("%1/%2/%3")
+        .arg(m_Directory,
+             mcrTo,
+             mcrJobName);
+
+    // Job of the same name from before is replaced
+    QFile::remove(destination);
+    QFile::remove(destination + ".error");
+    QFile::rename(source, destination);
+    QFile::remove(source + ".error");
+
+    if (!mcrError.isEmpty())
+    {
+        QFile error_file(destination + ".error");
+        if (error_file.open(QIODevice::WriteOnly | QIODevice::Text))
+        {
+            error_file.write(mcrError.toUtf8() + "\n");
+        }
+        QTextStream(stdout) << tr("Failed \"%1\": %2")
+            .arg(mcrJobName,
+                 mcrError) << Qt::endl;
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Control: add a job (a fractal or a job file) to the queue
+QString RenderDaemon::Enqueue(const QString & mcrFilename,
+    const QString & mcrPriority)
+{
+    CALL_IN(QString("mcrFilename=%1, mcrPriority=%2")
+        .arg(CALL_SHOW(mcrFilename),
+             CALL_SHOW(mcrPriority)));
+
+    const QFileInfo file_info(mcrFilename);
+    if (!file_info.isFile())
+    {
+        const QString reason = tr("\"%1\" does not exist.").arg(mcrFilename);
+        CALL_OUT(reason);
+        return reason;
+    }
+    bool is_number = true;
+    if (!mcrPriority.isEmpty())
+    {
+        mcrPriority.toInt(&is_number);
+    }
+    if (!is_number)
+    {
+        const QString reason = tr("Invalid priority \"%1\"").arg(mcrPriority);
+        CALL_OUT(reason);
+        return reason;
+    }
+
+    // Job contents (fractals are referred to where they are)
+    QByteArray contents;
+    if (mcrFilename.endsWith(".job"))
+    {
+        QFile file(mcrFilename);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            const QString reason = tr("Could not open \"%1\": %2")
+                .arg(mcrFilename,
+                     file.errorString());
+            CALL_OUT(reason);
+            return reason;
+        }
+        contents = file.readAll();
+        if (!contents.endsWith('\n'))
+        {
+            contents += '\n';
+        }
+    } else
+    {
+        contents = "fractal=" + file_info.absoluteFilePath().toUtf8() + "\n";
+    }
+    if (!mcrPriority.isEmpty())
+    {
+        // (Later lines win)
+        contents += "priority=" + mcrPriority.toUtf8() + "\n";
+    }
+
+    // Unique name; written under another name first, so it isn't picked up
+    // half-way
+    const QString base_name = file_info.completeBaseName();
+    QString job_name = base_name + ".job";
+    for (int index = 2;
+         QFile::exists(m_Directory + "/queue/" + job_name) ||
+            QFile::exists(m_Directory + "/running/" + job_name);
+         index++)
+    {
+        job_name = QString("%1-%2.job").arg(base_name).arg(index);
+    }
+    const QString filename = m_Directory + "/queue/" + job_name;
+    QFile file(filename + ".new");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text) ||
+        file.write(contents) != contents.size())
+    {
+        const QString reason = tr("Could not write \"%1\": %2")
+            .arg(filename,
+                 file.errorString());
+        CALL_OUT(reason);
+        return reason;
+    }
+    file.close();
+    QFile::rename(filename + ".new", filename);
+    ScanQueue();
+
+    CALL_OUT("");
+    return tr("Queued \"%1\"").arg(job_name);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Control: cancel a job (queued or running)
+QString RenderDaemon::Cancel(const QString & mcrJobName)
+{
+    CALL_IN(QString("mcrJobName=%1")
+        .arg(CALL_SHOW(mcrJobName)));
+
+    // Running: stop it; it's moved once its workers are done
+    if (m_JobToImage.contains(mcrJobName))
+    {
+        m_CancelledJobs << mcrJobName;
+        m_JobToImage[mcrJobName] -> Stop();
+        CALL_OUT("");
+        return tr("Cancelling \"%1\"").arg(mcrJobName);
+    }
+
+    // Queued
+    if (QFile::exists(m_Directory + "/queue/" + mcrJobName))
+    {
+        MoveJob(mcrJobName, "queue", "cancelled");
+        CALL_OUT("");
+        return tr("Cancelled \"%1\"").arg(mcrJobName);
+    }
+
+    const QString reason = tr("There is no job \"%1\".").arg(mcrJobName);
+    CALL_OUT(reason);
+    return reason;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Control: status of running and queued jobs (one line per job)
+QString RenderDaemon::GetStatus() const
+{
+    CALL_IN("");
+
+    QStringList lines;
+    QStringList running_jobs = m_JobToImage.keys();
+    std::sort(running_jobs.begin(), running_jobs.end());
+    for (const QString & job_name : running_jobs)
+    {
+        const QHash < QString, QString > statistics =
+            m_JobToImage[job_name] -> GetStatistics();
+        lines << tr("%1 %2 %3% complete, %4 cores")
+            .arg(job_name,
+                 m_CancelledJobs.contains(job_name) ?
+                     tr("cancelling") : tr("running"),
+                 QString::number(
+                     int(statistics["percent complete"].toDouble())))
+            .arg(m_JobToThreads[job_name]);
+    }
+    const QStringList queued_jobs = GetQueuedJobs();
+    for (const QString & job_name : queued_jobs)
+    {
+        QHash < QString, QString > job;
+        ReadJob(m_Directory + "/queue/" + job_name, job);
+        lines << tr("%1 queued, priority %2")
+            .arg(job_name)
+            .arg(job["priority"].toInt());
+    }
+    if (lines.isEmpty())
+    {
+        lines << tr("No jobs");
+    }
+
+    CALL_OUT("");
+    return lines.join("\n");
+}
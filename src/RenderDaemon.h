@@ -0,0 +1,140 @@
+// RenderDaemon.h
+// Class definition
+
+// Renders jobs from a directory without GUI, one after the other or several
+// at a time as long as they fit into a budget of cores. The directory has
+//
+//   queue/       jobs waiting (drop files here, ideally by renaming them
+//                into place; watched for new ones, which are picked up
+//                once they haven't changed for a moment)
+//   running/     jobs being rendered (moved back to queue/ on restart, and
+//                continued from their render journals)
+//   done/, failed/, cancelled/
+//                finished jobs (failed ones - including those whose
+//                picture or statistics couldn't be saved - with a
+//                "<job>.error" file)
+//   control      local socket taking "enqueue <file> [priority]",
+//                "cancel <job>" and "status"
+//
+// A job is either a fractal (.xml), rendered at its fixed resolution, or a
+// job file (.job) with "key=value" lines:
+//
+//   fractal=<fractal file>     (required; relative to the directory)
+//   width=<pixels>, height=<pixels>
+//                              (default: fixed resolution of the fractal)
+//   output=<directory>         (for picture and statistics; default:
+//                              storage directory of the fractal)
+//   priority=<number>          (higher first; default 0)
+//   threads=<number>           (default: the whole budget)
+
+#ifndef RENDERDAEMON_H
+#define RENDERDAEMON_H
+
+// Qt includes
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QLocalServer>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+// Forward declaration
+class Fractal;
+class FractalImage;
+
+// Class definition
+class RenderDaemon
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    RenderDaemon();
+
+    // Destructor
+    virtual ~RenderDaemon();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Start working on the jobs in a directory (and stop when there are no
+    // more, if asked to)
+    bool Start(const QString & mcrDirectory, const int mcCoreBudget,
+        const bool mcExitWhenIdle);
+
+    // Send a command to the daemon working on a directory
+    static bool SendCommand(const QString & mcrDirectory,
+        const QString & mcrCommand, QString & mrAnswer);
+
+    // Last error
+    QString GetLastError() const;
+
+signals:
+    // No more jobs (only if we're to stop then)
+    void Finished();
+
+private slots:
+    // Check for new jobs
+    void ScanQueue();
+
+    // Control connection
+    void NewControlConnection();
+    void ReadControlCommand();
+
+    // Job done
+    void JobFinished();
+
+private:
+    // Read a job
+    bool ReadJob(const QString & mcrFilename,
+        QHash < QString, QString > & mrJob) const;
+
+    // Queued jobs, in the order they are to be started
+    QStringList GetQueuedJobs() const;
+
+    // Start a job
+    bool StartJob(const QString & mcrJobName, const int mcThreads);
+
+    // Move a job (and its error file, if any) to another directory
+    void MoveJob(const QString & mcrJobName, const QString & mcrFrom,
+        const QString & mcrTo, const QString & mcrError = QString());
+
+    // Control commands
+    QString Enqueue(const QString & mcrFilename, const QString & mcrPriority);
+    QString Cancel(const QString & mcrJobName);
+    QString GetStatus() const;
+
+    // Directory, and whether to stop when there are no more jobs
+    QString m_Directory;
+    int m_CoreBudget;
+    bool m_ExitWhenIdle;
+
+    // Watching the queue (with a periodic scan for file systems that don't
+    // report changes)
+    QFileSystemWatcher m_Watcher;
+    QTimer m_ScanTimer;
+    bool m_IsScanning;
+    bool m_IsRescanNeeded;
+
+    // Control socket
+    QLocalServer m_ControlServer;
+
+    // Running jobs
+    QHash < QString, Fractal * > m_JobToFractal;
+    QHash < QString, FractalImage * > m_JobToImage;
+    QHash < QString, int > m_JobToThreads;
+    QHash < FractalImage *, QString > m_ImageToJob;
+    QSet < QString > m_CancelledJobs;
+
+    // Last error
+    QString m_LastError;
+};
+
+#endif
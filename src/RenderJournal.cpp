@@ -0,0 +1,592 @@
+// RenderJournal.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "Deploy.h"
+#include "RenderJournal.h"
+
+// Qt includes
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+
+// System includes
+#include <cstring>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Identifies a render journal ("MPRJ")
+#define JOURNAL_MAGIC 0x4D50524A
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+RenderJournal::RenderJournal()
+{
+    CALL_IN("");
+
+    m_Width = 0;
+    m_Height = 0;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+RenderJournal::~RenderJournal()
+{
+    CALL_IN("");
+
+    Close();
+
+    CALL_OUT("");
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Open journal (will be created or reset if it doesn't match)
+bool RenderJournal::Open(const QString & mcrFilename,
+    const QByteArray & mcrKey, const int mcWidth, const int mcHeight)
+{
+    CALL_IN(QString("mcrFilename=%1, mcrKey=%2, mcWidth=%3, mcHeight=%4")
+        .arg(CALL_SHOW(mcrFilename),
+             CALL_SHOW(QString::fromLatin1(mcrKey.toHex())),
+             CALL_SHOW(mcWidth),
+             CALL_SHOW(mcHeight)));
+
+    Close();
+
+    // Open file
+    QDir().mkpath(QFileInfo(mcrFilename).path());
+    m_File.setFileName(mcrFilename);
+    const bool file_existed = m_File.exists();
+    if (!m_File.open(QFile::ReadWrite))
+    {
+        m_LastError = tr("Could not open render journal \"%1\".")
+            .arg(mcrFilename);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Check if we can use what's in there
+    if (file_existed &&
+        ReadJournal() &&
+        m_Key == mcrKey &&
+        m_Width == mcWidth &&
+        m_Height == mcHeight)
+    {
+        CALL_OUT("");
+        return true;
+    }
+
+    // Start from scratch
+    if (!WriteHeader(mcrKey, mcWidth, mcHeight))
+    {
+        m_File.close();
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Open an existing journal for reading only
+bool RenderJournal::OpenForReading(const QString & mcrFilename)
+{
+    CALL_IN(QString("mcrFilename=%1")
+        .arg(CALL_SHOW(mcrFilename)));
+
+    Close();
+
+    // Open file
+    m_File.setFileName(mcrFilename);
+    if (!m_File.open(QFile::ReadOnly))
+    {
+        m_LastError = tr("Could not open render journal \"%1\".")
+            .arg(mcrFilename);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Read what's in there
+    if (!ReadJournal())
+    {
+        m_File.close();
+        m_LastError = tr("\"%1\" is not a render journal.")
+            .arg(mcrFilename);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Close journal
+void RenderJournal::Close()
+{
+    CALL_IN("");
+
+    if (m_File.isOpen())
+    {
+        m_File.close();
+    }
+    m_Key.clear();
+    m_Width = 0;
+    m_Height = 0;
+    m_TileIDToArea.clear();
+    m_TileIDToPixelOffset.clear();
+    m_TileIDToDepth.clear();
+    m_TileIDToPoints.clear();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Close and delete journal
+void RenderJournal::Remove()
+{
+    CALL_IN("");
+
+    const QString filename = m_File.fileName();
+    Close();
+    if (!filename.isEmpty())
+    {
+        QFile::remove(filename);
+    }
+    m_File.setFileName(QString());
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Remove journals that haven't been written to for some days
+void RenderJournal::CollectGarbage(const QString & mcrDirectory,
+    const QString & mcrKeepFilename, const int mcMaxAgeDays)
+{
+    CALL_IN(QString("mcrDirectory=%1, mcrKeepFilename=%2, mcMaxAgeDays=%3")
+        .arg(CALL_SHOW(mcrDirectory),
+             CALL_SHOW(mcrKeepFilename),
+             CALL_SHOW(mcMaxAgeDays)));
+
+    // Check if there is a limit
+    if (mcMaxAgeDays <= 0)
+    {
+        CALL_OUT("No age limit.");
+        return;
+    }
+
+    // Files are touched whenever a tile is added
+    const QDateTime oldest_kept =
+        QDateTime::currentDateTime().addDays(-mcMaxAgeDays);
+    const QString keep_filename =
+        QFileInfo(mcrKeepFilename).absoluteFilePath();
+    const QFileInfoList all_files = QDir(mcrDirectory).entryInfoList(
+        QStringList("*.journal"), QDir::Files);
+    for (const QFileInfo & file_info : all_files)
+    {
+        if (file_info.absoluteFilePath() != keep_filename &&
+            file_info.lastModified() < oldest_kept)
+        {
+            QFile::remove(file_info.absoluteFilePath());
+        }
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if journal is open
+bool RenderJournal::IsOpen() const
+{
+    CALL_IN("");
+
+    const bool is_open = m_File.isOpen();
+
+    CALL_OUT("");
+    return is_open;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Filename
+QString RenderJournal::GetFilename() const
+{
+    CALL_IN("");
+
+    const QString filename = m_File.fileName();
+
+    CALL_OUT("");
+    return filename;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Parameter key
+QByteArray RenderJournal::GetKey() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_Key;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Image width
+int RenderJournal::GetWidth() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_Width;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Image height
+int RenderJournal::GetHeight() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_Height;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Finished tiles
+QList < int > RenderJournal::GetFinishedTiles() const
+{
+    CALL_IN("");
+
+    const QList < int > tiles = m_TileIDToArea.keys();
+
+    CALL_OUT("");
+    return tiles;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Area of a finished tile
+QRect RenderJournal::GetTileArea(const int mcTileID) const
+{
+    CALL_IN(QString("mcTileID=%1")
+        .arg(CALL_SHOW(mcTileID)));
+
+    const QRect area = m_TileIDToArea.value(mcTileID);
+
+    CALL_OUT("");
+    return area;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Pixels of a finished tile (null image if they can't be read)
+QImage RenderJournal::GetTileImage(const int mcTileID)
+{
+    CALL_IN(QString("mcTileID=%1")
+        .arg(CALL_SHOW(mcTileID)));
+
+    if (!m_TileIDToPixelOffset.contains(mcTileID) ||
+        !m_File.isOpen())
+    {
+        CALL_OUT("No such tile");
+        return QImage();
+    }
+
+    // Read pixels
+    m_File.seek(m_TileIDToPixelOffset[mcTileID]);
+    QDataStream in_stream(&m_File);
+    QByteArray compressed;
+    in_stream >> compressed;
+    const QByteArray pixels = qUncompress(compressed);
+    const QRect area = m_TileIDToArea[mcTileID];
+    if (in_stream.status() != QDataStream::Ok ||
+        pixels.size() != area.width() * area.height() * 4)
+    {
+        m_LastError = tr("Pixels of tile %1 in render journal \"%2\" are "
+            "damaged.").arg(mcTileID).arg(m_File.fileName());
+        CALL_OUT(m_LastError);
+        return QImage();
+    }
+    QImage image(area.width(), area.height(), QImage::Format_RGB32);
+    for (int row = 0; row < area.height(); row++)
+    {
+        memcpy(image.scanLine(row),
+            pixels.constData() + row * area.width() * 4, area.width() * 4);
+    }
+
+    CALL_OUT("");
+    return image;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Depth a finished tile has been calculated with
+int RenderJournal::GetTileDepth(const int mcTileID) const
+{
+    CALL_IN(QString("mcTileID=%1")
+        .arg(CALL_SHOW(mcTileID)));
+
+    const int depth = m_TileIDToDepth.value(mcTileID);
+
+    CALL_OUT("");
+    return depth;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of samples a finished tile has been calculated with
+qint64 RenderJournal::GetTilePoints(const int mcTileID) const
+{
+    CALL_IN(QString("mcTileID=%1")
+        .arg(CALL_SHOW(mcTileID)));
+
+    const qint64 points = m_TileIDToPoints.value(mcTileID);
+
+    CALL_OUT("");
+    return points;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a finished tile
+bool RenderJournal::AddTile(const int mcTileID, const QImage & mcrImage,
+    const QPoint & mcrPosition, const int mcDepth, const qint64 mcPoints)
+{
+    CALL_IN(QString("mcTileID=%1, mcrImage=..., mcrPosition=..., "
+        "mcDepth=%2, mcPoints=%3")
+        .arg(CALL_SHOW(mcTileID),
+             CALL_SHOW(mcDepth),
+             CALL_SHOW(mcPoints)));
+
+    if (!m_File.isOpen())
+    {
+        m_LastError = tr("Render journal is not open.");
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Pixels, row by row
+    const QImage image = mcrImage.convertToFormat(QImage::Format_RGB32);
+    QByteArray pixels;
+    pixels.reserve(image.width() * image.height() * 4);
+    for (int row = 0; row < image.height(); row++)
+    {
+        pixels.append(reinterpret_cast < const char * >(image.scanLine(row)),
+            image.width() * 4);
+    }
+
+    // Append record (pixels go last, so an incomplete record can't be
+    // mistaken for a complete one)
+    m_File.seek(m_File.size());
+    QDataStream out_stream(&m_File);
+    out_stream << qint32(mcTileID) << qint32(mcrPosition.x()) <<
+        qint32(mcrPosition.y()) << qint32(image.width()) <<
+        qint32(image.height()) << qint32(mcDepth) << qint64(mcPoints);
+    const qint64 pixel_offset = m_File.pos();
+    out_stream << qCompress(pixels);
+    if (out_stream.status() != QDataStream::Ok ||
+        !Sync())
+    {
+        m_LastError = tr("Could not write to render journal \"%1\".")
+            .arg(m_File.fileName());
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    m_TileIDToArea[mcTileID] = QRect(mcrPosition, image.size());
+    m_TileIDToPixelOffset[mcTileID] = pixel_offset;
+    m_TileIDToDepth[mcTileID] = mcDepth;
+    m_TileIDToPoints[mcTileID] = mcPoints;
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Last error
+QString RenderJournal::GetLastError() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_LastError;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read header and records of an existing file
+bool RenderJournal::ReadJournal()
+{
+    CALL_IN("");
+
+    // Header
+    m_File.seek(0);
+    QDataStream in_stream(&m_File);
+    quint32 magic;
+    quint32 version;
+    QByteArray key;
+    qint32 width;
+    qint32 height;
+    in_stream >> magic >> version >> key >> width >> height;
+    if (in_stream.status() != QDataStream::Ok ||
+        magic != JOURNAL_MAGIC ||
+        version != JOURNAL_FILE_VERSION)
+    {
+        CALL_OUT("Not a journal");
+        return false;
+    }
+    m_Key = key;
+    m_Width = width;
+    m_Height = height;
+
+    // Records (skipping the pixels; the last one may be incomplete)
+    qint64 end_of_records = m_File.pos();
+    while (!in_stream.atEnd())
+    {
+        qint32 tile_id;
+        qint32 x;
+        qint32 y;
+        qint32 tile_width;
+        qint32 tile_height;
+        qint32 depth;
+        qint64 points;
+        quint32 pixel_size;
+        in_stream >> tile_id >> x >> y >> tile_width >> tile_height >>
+            depth >> points;
+        const qint64 pixel_offset = m_File.pos();
+        in_stream >> pixel_size;
+        if (in_stream.status() != QDataStream::Ok ||
+            pixel_size == 0xFFFFFFFF ||
+            pixel_offset + 4 + pixel_size > m_File.size())
+        {
+            break;
+        }
+        in_stream.skipRawData(pixel_size);
+        m_TileIDToArea[tile_id] = QRect(x, y, tile_width, tile_height);
+        m_TileIDToPixelOffset[tile_id] = pixel_offset;
+        m_TileIDToDepth[tile_id] = depth;
+        m_TileIDToPoints[tile_id] = points;
+        end_of_records = m_File.pos();
+    }
+
+    // Get rid of an incomplete record (unless we're only reading)
+    if (end_of_records < m_File.size() &&
+        m_File.isWritable())
+    {
+        m_File.resize(end_of_records);
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write header
+bool RenderJournal::WriteHeader(const QByteArray & mcrKey, const int mcWidth,
+    const int mcHeight)
+{
+    CALL_IN(QString("mcrKey=%1, mcWidth=%2, mcHeight=%3")
+        .arg(CALL_SHOW(QString::fromLatin1(mcrKey.toHex())),
+             CALL_SHOW(mcWidth),
+             CALL_SHOW(mcHeight)));
+
+    // Get rid of old content
+    m_Key = mcrKey;
+    m_Width = mcWidth;
+    m_Height = mcHeight;
+    m_TileIDToArea.clear();
+    m_TileIDToPixelOffset.clear();
+    m_TileIDToDepth.clear();
+    m_TileIDToPoints.clear();
+    if (!m_File.resize(0))
+    {
+        m_LastError = tr("Could not reset render journal \"%1\".")
+            .arg(m_File.fileName());
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Header
+    m_File.seek(0);
+    QDataStream out_stream(&m_File);
+    out_stream << quint32(JOURNAL_MAGIC) << quint32(JOURNAL_FILE_VERSION) <<
+        mcrKey << qint32(mcWidth) << qint32(mcHeight);
+    if (out_stream.status() != QDataStream::Ok ||
+        !Sync())
+    {
+        m_LastError = tr("Could not write header of render journal \"%1\".")
+            .arg(m_File.fileName());
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Make sure what has been written is on disk (a record that only made it to
+// the page cache is lost in a power failure, while later records are not)
+bool RenderJournal::Sync()
+{
+    CALL_IN("");
+
+    if (!m_File.flush())
+    {
+        CALL_OUT("Could not flush");
+        return false;
+    }
+#ifdef Q_OS_WIN
+    const bool success = (_commit(m_File.handle()) == 0);
+#else
+    const bool success = (fsync(m_File.handle()) == 0);
+#endif
+
+    CALL_OUT("");
+    return success;
+}
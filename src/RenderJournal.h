@@ -0,0 +1,118 @@
+// RenderJournal.h
+// Class definition
+
+// Journal of a render in progress, so a render that is stopped or interrupted
+// (even by a crash) can pick up where it left off. The file starts with a
+// header (format version, parameter key, dimensions), followed by one record
+// per finished tile: its position, the depth and number of samples it has
+// been calculated with, and its pixels (compressed). Records are only ever
+// appended; a record cut short by a crash is ignored.
+
+#ifndef RENDERJOURNAL_H
+#define RENDERJOURNAL_H
+
+// Qt includes
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QRect>
+#include <QString>
+
+// Class definition
+class RenderJournal
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    RenderJournal();
+
+    // Destructor
+    virtual ~RenderJournal();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Open journal (will be created or reset if it doesn't match); finished
+    // tiles are available right away
+    bool Open(const QString & mcrFilename, const QByteArray & mcrKey,
+        const int mcWidth, const int mcHeight);
+
+    // Open an existing journal for reading only (e.g. to merge shards);
+    // nothing in it is changed
+    bool OpenForReading(const QString & mcrFilename);
+
+    // Close journal
+    void Close();
+
+    // Close and delete journal (render is complete)
+    void Remove();
+
+    // Remove journals that haven't been written to for some days (except
+    // the given one)
+    static void CollectGarbage(const QString & mcrDirectory,
+        const QString & mcrKeepFilename, const int mcMaxAgeDays);
+
+    // Check if journal is open
+    bool IsOpen() const;
+
+    // Filename
+    QString GetFilename() const;
+
+    // Header: parameter key and image dimensions
+    QByteArray GetKey() const;
+    int GetWidth() const;
+    int GetHeight() const;
+
+    // Finished tiles
+    QList < int > GetFinishedTiles() const;
+    QRect GetTileArea(const int mcTileID) const;
+    QImage GetTileImage(const int mcTileID);
+    int GetTileDepth(const int mcTileID) const;
+    qint64 GetTilePoints(const int mcTileID) const;
+
+    // Add a finished tile
+    bool AddTile(const int mcTileID, const QImage & mcrImage,
+        const QPoint & mcrPosition, const int mcDepth, const qint64 mcPoints);
+
+    // Last error
+    QString GetLastError() const;
+
+private:
+    // Read header and records of an existing file
+    bool ReadJournal();
+
+    // Write header
+    bool WriteHeader(const QByteArray & mcrKey, const int mcWidth,
+        const int mcHeight);
+
+    // Make sure what has been written is on disk
+    bool Sync();
+
+    // File
+    QFile m_File;
+
+    // Header
+    QByteArray m_Key;
+    int m_Width;
+    int m_Height;
+
+    // Finished tiles
+    QHash < int, QRect > m_TileIDToArea;
+    // (Pixels are read when needed)
+    QHash < int, qint64 > m_TileIDToPixelOffset;
+    QHash < int, int > m_TileIDToDepth;
+    QHash < int, qint64 > m_TileIDToPoints;
+
+    // Last error
+    QString m_LastError;
+};
+
+#endif
@@ -0,0 +1,474 @@
+// ShardMerger.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "PngStreamWriter.h"
+#include "ShardMerger.h"
+#include "StringHelper.h"
+
+// Qt includes
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QMap>
+#include <QPair>
+#include <QRegularExpression>
+#include <QTextStream>
+
+// System includes
+#include <algorithm>
+#include <cstring>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+ShardMerger::ShardMerger()
+{
+    CALL_IN("");
+
+    m_NumberOfShards = 0;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+ShardMerger::~ShardMerger()
+{
+    CALL_IN("");
+
+    CloseShards();
+
+    CALL_OUT("");
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Merge shards in a directory
+bool ShardMerger::Merge(const QString & mcrDirectory)
+{
+    CALL_IN(QString("mcrDirectory=%1")
+        .arg(CALL_SHOW(mcrDirectory)));
+
+    if (!OpenShards(mcrDirectory))
+    {
+        CloseShards();
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    // Picture
+    const QString picture_filename = QString("%1/%2.png")
+        .arg(mcrDirectory,
+             m_Name);
+    if (!MergePicture(picture_filename))
+    {
+        CloseShards();
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    CloseShards();
+
+    // Statistics
+    const QString statistics_filename = QString("%1/%2-statistics.txt")
+        .arg(mcrDirectory,
+             m_Name);
+    if (!MergeStatistics(mcrDirectory, statistics_filename))
+    {
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Last error
+QString ShardMerger::GetLastError() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_LastError;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Open the journals of all shards, and check they belong together
+bool ShardMerger::OpenShards(const QString & mcrDirectory)
+{
+    CALL_IN(QString("mcrDirectory=%1")
+        .arg(CALL_SHOW(mcrDirectory)));
+
+    CloseShards();
+    m_Name.clear();
+    m_NumberOfShards = 0;
+
+    // Find journals
+    static const QRegularExpression format(
+        "^(.+)-shard-(\\d+)-of-(\\d+)\\.journal$");
+    const QStringList filenames = QDir(mcrDirectory).entryList(
+        QStringList("*-shard-*-of-*.journal"), QDir::Files, QDir::Name);
+    for (const QString & filename : filenames)
+    {
+        const QRegularExpressionMatch match = format.match(filename);
+        if (!match.hasMatch())
+        {
+            continue;
+        }
+
+        // All shards must be of the same render
+        const QString name = match.captured(1);
+        const int shard_index = match.captured(2).toInt();
+        const int number_of_shards = match.captured(3).toInt();
+        if (m_Name.isEmpty())
+        {
+            m_Name = name;
+            m_NumberOfShards = number_of_shards;
+        }
+        if (name != m_Name ||
+            number_of_shards != m_NumberOfShards)
+        {
+            m_LastError = tr("\"%1\" doesn't belong to \"%2\" in %3 shards.")
+                .arg(filename,
+                     m_Name)
+                .arg(m_NumberOfShards);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+
+        // Open journal
+        RenderJournal * journal = new RenderJournal();
+        m_ShardIndexToJournal[shard_index] = journal;
+        if (!journal -> OpenForReading(
+            QString("%1/%2").arg(mcrDirectory, filename)))
+        {
+            m_LastError = journal -> GetLastError();
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        const RenderJournal * first_journal =
+            m_ShardIndexToJournal.begin().value();
+        if (journal -> GetKey() != first_journal -> GetKey() ||
+            journal -> GetWidth() != first_journal -> GetWidth() ||
+            journal -> GetHeight() != first_journal -> GetHeight())
+        {
+            m_LastError = tr("\"%1\" has been rendered with different "
+                "parameters than the other shards.").arg(filename);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+    }
+
+    // Check we've got all of them
+    if (m_ShardIndexToJournal.isEmpty())
+    {
+        m_LastError = tr("No shards found in \"%1\".").arg(mcrDirectory);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    for (int shard_index = 1; shard_index <= m_NumberOfShards; shard_index++)
+    {
+        if (!m_ShardIndexToJournal.contains(shard_index))
+        {
+            m_LastError = tr("Shard %1 of %2 is missing.")
+                .arg(shard_index)
+                .arg(m_NumberOfShards);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write the picture
+bool ShardMerger::MergePicture(const QString & mcrFilename)
+{
+    CALL_IN(QString("mcrFilename=%1")
+        .arg(CALL_SHOW(mcrFilename)));
+
+    // Tiles of all shards by the row they start in (tiles are on a fixed
+    // grid, so every row of tiles is complete in itself)
+    QMap < int, QList < QPair < int, int > > > row_to_tiles;
+    for (auto shard_iterator = m_ShardIndexToJournal.constBegin();
+         shard_iterator != m_ShardIndexToJournal.constEnd();
+         shard_iterator++)
+    {
+        const QList < int > tiles = shard_iterator.value() ->
+            GetFinishedTiles();
+        for (const int tile_id : tiles)
+        {
+            const QRect area = shard_iterator.value() -> GetTileArea(tile_id);
+            row_to_tiles[area.y()] <<
+                QPair < int, int >(shard_iterator.key(), tile_id);
+        }
+    }
+
+    // Write picture one row of tiles at a time
+    const RenderJournal * first_journal =
+        m_ShardIndexToJournal.begin().value();
+    const int width = first_journal -> GetWidth();
+    const int height = first_journal -> GetHeight();
+    PngStreamWriter writer;
+    if (!writer.Open(mcrFilename, width, height))
+    {
+        m_LastError = writer.GetLastError();
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    int pixel_y = 0;
+    while (pixel_y < height)
+    {
+        // Tiles of this row
+        if (!row_to_tiles.contains(pixel_y))
+        {
+            m_LastError = tr("Tiles starting at row %1 are missing (the "
+                "shards are not finished yet).").arg(pixel_y);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        const QList < QPair < int, int > > tiles = row_to_tiles[pixel_y];
+        int band_height = 0;
+        for (const QPair < int, int > & tile : tiles)
+        {
+            const QRect area =
+                m_ShardIndexToJournal[tile.first] -> GetTileArea(tile.second);
+            band_height = qMax(band_height, area.height());
+        }
+        band_height = qMin(band_height, height - pixel_y);
+
+        // Put them together
+        QImage band(width, band_height, QImage::Format_RGB32);
+        band.fill(Qt::black);
+        int covered_width = 0;
+        for (const QPair < int, int > & tile : tiles)
+        {
+            RenderJournal * journal = m_ShardIndexToJournal[tile.first];
+            const QRect area = journal -> GetTileArea(tile.second);
+            const QImage tile_image = journal -> GetTileImage(tile.second);
+            if (tile_image.isNull())
+            {
+                m_LastError = journal -> GetLastError();
+                CALL_OUT(m_LastError);
+                return false;
+            }
+            const int copy_width =
+                qMin(area.width(), width - area.x());
+            const int copy_height = qMin(area.height(), band_height);
+            for (int row = 0; row < copy_height; row++)
+            {
+                memcpy(band.scanLine(row) + area.x() * 4,
+                    tile_image.constScanLine(row), copy_width * 4);
+            }
+            covered_width += copy_width;
+        }
+        if (covered_width != width)
+        {
+            m_LastError = tr("Tiles in row %1 are missing or overlap.")
+                .arg(pixel_y);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+
+        // Write it
+        for (int row = 0; row < band_height; row++)
+        {
+            if (!writer.WriteRow(band.constScanLine(row)))
+            {
+                m_LastError = writer.GetLastError();
+                CALL_OUT(m_LastError);
+                return false;
+            }
+        }
+        pixel_y += band_height;
+    }
+    if (!writer.Close())
+    {
+        m_LastError = writer.GetLastError();
+        CALL_OUT(m_LastError);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Combine statistics of all shards
+bool ShardMerger::MergeStatistics(const QString & mcrDirectory,
+    const QString & mcrFilename)
+{
+    CALL_IN(QString("mcrDirectory=%1, mcrFilename=%2")
+        .arg(CALL_SHOW(mcrDirectory),
+             CALL_SHOW(mcrFilename)));
+
+    // How values are combined
+    static const QStringList sum_keys = {
+        "processing time ms",
+        "number of threads",
+        "total pixels long",
+        "total points long",
+        "points finished long",
+        "points in set long",
+        "points out of bounds long",
+        "total iterations long" };
+    static const QStringList min_keys = {
+        "min depth",
+        "min color value",
+        "min brightness value" };
+    static const QStringList max_keys = {
+        "max depth",
+        "max color value",
+        "max brightness value",
+        "auto depth",
+        "auto depth probe time ms" };
+
+    // Read statistics of all shards
+    QHash < QString, QString > statistics;
+    QStringList units_per_core;
+    for (int shard_index = 1; shard_index <= m_NumberOfShards; shard_index++)
+    {
+        const QString filename =
+            QString("%1/%2-shard-%3-of-%4-statistics.txt")
+                .arg(mcrDirectory,
+                     m_Name)
+                .arg(shard_index)
+                .arg(m_NumberOfShards);
+        QFile file(filename);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            m_LastError = tr("Could not read statistics \"%1\": %2")
+                .arg(filename,
+                     file.errorString());
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        QTextStream in(&file);
+        while (!in.atEnd())
+        {
+            const QString line = in.readLine();
+            const int separator = line.indexOf('=');
+            if (separator < 0)
+            {
+                continue;
+            }
+            const QString key = line.left(separator);
+            const QString value = line.mid(separator + 1);
+
+            if (key == "units per core at start")
+            {
+                units_per_core << tr("shard %1: %2")
+                    .arg(shard_index)
+                    .arg(value);
+            } else if (value.isEmpty())
+            {
+                // Nothing to combine
+                continue;
+            } else if (!statistics.contains(key) ||
+                statistics[key].isEmpty())
+            {
+                statistics[key] = value;
+            } else if (sum_keys.contains(key))
+            {
+                statistics[key] = QString("%1")
+                    .arg(statistics[key].toLongLong() + value.toLongLong());
+            } else if (min_keys.contains(key))
+            {
+                statistics[key] = QString("%1")
+                    .arg(qMin(statistics[key].toDouble(), value.toDouble()));
+            } else if (max_keys.contains(key))
+            {
+                statistics[key] = QString("%1")
+                    .arg(qMax(statistics[key].toDouble(), value.toDouble()));
+            } else if (key == "start time")
+            {
+                // (Format sorts like the times do)
+                statistics[key] = qMin(statistics[key], value);
+            } else if (key == "finish time")
+            {
+                statistics[key] = qMax(statistics[key], value);
+            }
+        }
+    }
+    statistics["units per core at start"] = units_per_core.join("; ");
+    statistics["number of shards"] = QString("%1").arg(m_NumberOfShards);
+
+    // Derived values
+    for (const QString & key : sum_keys)
+    {
+        if (key.endsWith(" long"))
+        {
+            QString short_key = key;
+            short_key.replace(short_key.length() - 4, 4, "short");
+            statistics[short_key] =
+                StringHelper::ConvertNumber(statistics[key].toLongLong());
+        }
+    }
+    const qint64 total_points = statistics["total points long"].toLongLong();
+    if (total_points > 0)
+    {
+        statistics["percent complete"] = QString("%1")
+            .arg(qMin(100.,
+                double(statistics["points finished long"].toLongLong()) /
+                    double(total_points) * 100.));
+    }
+
+    // Write them like FractalImage does
+    QFile file(mcrFilename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate |
+        QIODevice::Text))
+    {
+        m_LastError = tr("Could not write statistics to \"%1\": %2")
+            .arg(mcrFilename,
+                 file.errorString());
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    QList < QString > keys = statistics.keys();
+    std::sort(keys.begin(), keys.end());
+    QTextStream out(&file);
+    for (const QString & key : keys)
+    {
+        out << key << "=" << statistics[key] << "\n";
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Close journals
+void ShardMerger::CloseShards()
+{
+    CALL_IN("");
+
+    qDeleteAll(m_ShardIndexToJournal);
+    m_ShardIndexToJournal.clear();
+
+    CALL_OUT("");
+}
@@ -0,0 +1,73 @@
+// ShardMerger.h
+// Class definition
+
+// Puts together a poster that has been rendered in shards (see
+// FractalImage): reads the journals of all shards from a directory, writes
+// the picture one row of tiles at a time, and combines the statistics of
+// the shards.
+
+#ifndef SHARDMERGER_H
+#define SHARDMERGER_H
+
+// Project includes
+#include "RenderJournal.h"
+
+// Qt includes
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+// Class definition
+class ShardMerger
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    ShardMerger();
+
+    // Destructor
+    virtual ~ShardMerger();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Merge shards in a directory into "<name>.png" and
+    // "<name>-statistics.txt"
+    bool Merge(const QString & mcrDirectory);
+
+    // Last error
+    QString GetLastError() const;
+
+private:
+    // Open the journals of all shards, and check they belong together
+    bool OpenShards(const QString & mcrDirectory);
+
+    // Write the picture
+    bool MergePicture(const QString & mcrFilename);
+
+    // Combine statistics of all shards
+    bool MergeStatistics(const QString & mcrDirectory,
+        const QString & mcrFilename);
+
+    // Close journals
+    void CloseShards();
+
+    // Name of the fractal, and number of shards
+    QString m_Name;
+    int m_NumberOfShards;
+
+    // Journals of the shards (by shard index)
+    QHash < int, RenderJournal * > m_ShardIndexToJournal;
+
+    // Last error
+    QString m_LastError;
+};
+
+#endif
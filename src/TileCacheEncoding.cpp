@@ -0,0 +1,338 @@
+// TileCacheEncoding.cpp
+// Class implementation
+
+// Project includes
+#include "TileCacheEncoding.h"
+
+// System includes
+#include <cmath>
+#include <cstring>
+
+// Format identifiers (first byte of encoded data)
+#define FORMAT_DOUBLE 0
+#define FORMAT_FLOAT 1
+#define FORMAT_16BIT 2
+#define FORMAT_UNIFORM 3
+
+// Sentinel values in 16 bit format; everything below is a regular value
+#define SENTINEL_PLUS_INFINITY 0xFFFF
+#define SENTINEL_MINUS_INFINITY 0xFFFE
+#define SENTINEL_NAN 0xFFFD
+#define MAX_16BIT_VALUE 0xFFFC
+
+
+
+// We don't do call tracing here because encoding and decoding happens in
+// worker threads, and our way of doing that is not thread safe.
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Default constructor (never to be called from outside)
+TileCacheEncoding::TileCacheEncoding()
+{
+    // Nothing to do.
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+TileCacheEncoding::~TileCacheEncoding()
+{
+    // Nothing to do, either.
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Encode values (consisting of interleaved components)
+QByteArray TileCacheEncoding::Encode(const QVector < double > & mcrValues,
+    const QString & mcrFormat, const int mcComponents)
+{
+    const int number_of_values = mcrValues.size();
+    QByteArray data;
+
+    // All values the same (compare bits, so this works for infinities and
+    // NaN, too)
+    bool is_uniform = (number_of_values > 0);
+    for (int index = 1; is_uniform && index < number_of_values; index++)
+    {
+        is_uniform = (memcmp(&mcrValues[index], &mcrValues[0],
+            sizeof(double)) == 0);
+    }
+    if (is_uniform)
+    {
+        const qint32 count = number_of_values;
+        data.resize(1 + int(sizeof(double)) + int(sizeof(qint32)));
+        data[0] = char(FORMAT_UNIFORM);
+        memcpy(data.data() + 1, &mcrValues[0], sizeof(double));
+        memcpy(data.data() + 1 + sizeof(double), &count, sizeof(qint32));
+        return data;
+    }
+
+    // Single precision
+    if (mcrFormat == "float")
+    {
+        data.resize(1 + number_of_values * int(sizeof(float)));
+        data[0] = char(FORMAT_FLOAT);
+        float * values = reinterpret_cast < float * >(data.data() + 1);
+        for (int index = 0; index < number_of_values; index++)
+        {
+            const float value = float(mcrValues[index]);
+            memcpy(values + index, &value, sizeof(float));
+        }
+        return data;
+    }
+
+    // Quantized (every component of interleaved values, like escape depth
+    // and final z of cached orbit data, gets its own range)
+    if (mcrFormat == "16 bit")
+    {
+        // Range of finite values of each component in this tile
+        const int number_of_components = qMax(1, mcComponents);
+        QVector < double > offset(number_of_components, 0.);
+        QVector < double > scale(number_of_components, 1.);
+        for (int component = 0; component < number_of_components;
+             component++)
+        {
+            double min_value = INFINITY;
+            double max_value = -INFINITY;
+            for (int index = component; index < number_of_values;
+                 index += number_of_components)
+            {
+                const double value = mcrValues[index];
+                if (std::isfinite(value))
+                {
+                    min_value = qMin(min_value, value);
+                    max_value = qMax(max_value, value);
+                }
+            }
+            if (min_value <= max_value)
+            {
+                offset[component] = min_value;
+                if (max_value > min_value)
+                {
+                    scale[component] =
+                        (max_value - min_value) / MAX_16BIT_VALUE;
+                }
+            }
+        }
+
+        // Header: number of components, and offset and scale of each
+        const int header_size =
+            2 + 2 * number_of_components * int(sizeof(double));
+        data.resize(header_size + number_of_values * int(sizeof(quint16)));
+        data[0] = char(FORMAT_16BIT);
+        data[1] = char(number_of_components);
+        for (int component = 0; component < number_of_components;
+             component++)
+        {
+            char * component_header =
+                data.data() + 2 + 2 * component * sizeof(double);
+            memcpy(component_header, &offset[component], sizeof(double));
+            memcpy(component_header + sizeof(double), &scale[component],
+                sizeof(double));
+        }
+
+        // Values
+        char * values = data.data() + header_size;
+        for (int index = 0; index < number_of_values; index++)
+        {
+            const double value = mcrValues[index];
+            const int component = index % number_of_components;
+            quint16 encoded;
+            if (std::isnan(value))
+            {
+                encoded = SENTINEL_NAN;
+            } else if (value == INFINITY)
+            {
+                encoded = SENTINEL_PLUS_INFINITY;
+            } else if (value == -INFINITY)
+            {
+                encoded = SENTINEL_MINUS_INFINITY;
+            } else
+            {
+                encoded = quint16(qBound(0.,
+                    std::round((value - offset[component]) /
+                        scale[component]),
+                    double(MAX_16BIT_VALUE)));
+            }
+            memcpy(values + index * sizeof(quint16), &encoded,
+                sizeof(quint16));
+        }
+        return data;
+    }
+
+    // Default: no loss of precision
+    data.resize(1 + number_of_values * int(sizeof(double)));
+    data[0] = char(FORMAT_DOUBLE);
+    memcpy(data.data() + 1, mcrValues.constData(),
+        number_of_values * sizeof(double));
+    return data;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Encode color and brightness values of a tile (brightness doesn't matter for
+// tiles that are entirely inside the set or out of bounds)
+void TileCacheEncoding::EncodeTile(const QVector < double > & mcrColorValues,
+    const QVector < double > & mcrBrightnessValues, const QString & mcrFormat,
+    QByteArray & mrColorData, QByteArray & mrBrightnessData)
+{
+    // Color values may be orbit data (escape depth, real and imaginary part
+    // of final z for every sample)
+    int color_components = 1;
+    if (!mcrBrightnessValues.isEmpty() &&
+        mcrColorValues.size() % mcrBrightnessValues.size() == 0)
+    {
+        color_components =
+            mcrColorValues.size() / mcrBrightnessValues.size();
+    }
+    mrColorData = Encode(mcrColorValues, mcrFormat, color_components);
+    double value;
+    int number_of_values;
+    if (IsUniform(mrColorData, value, number_of_values) &&
+        std::isinf(value))
+    {
+        mrBrightnessData =
+            Encode(QVector < double >(mcrBrightnessValues.size(), 0.),
+                mcrFormat, 1);
+    } else
+    {
+        mrBrightnessData = Encode(mcrBrightnessValues, mcrFormat, 1);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Decode values
+QVector < double > TileCacheEncoding::Decode(const QByteArray & mcrData)
+{
+    QVector < double > values;
+    if (mcrData.isEmpty())
+    {
+        return values;
+    }
+
+    const char * data = mcrData.constData();
+    const int format = int(data[0]);
+    if (format == FORMAT_UNIFORM)
+    {
+        double value;
+        int number_of_values;
+        IsUniform(mcrData, value, number_of_values);
+        values.fill(value, number_of_values);
+        return values;
+    }
+
+    if (format == FORMAT_FLOAT)
+    {
+        const int number_of_values = (mcrData.size() - 1) / sizeof(float);
+        values.resize(number_of_values);
+        for (int index = 0; index < number_of_values; index++)
+        {
+            float value;
+            memcpy(&value, data + 1 + index * sizeof(float), sizeof(float));
+            values[index] = value;
+        }
+        return values;
+    }
+
+    if (format == FORMAT_16BIT)
+    {
+        const int number_of_components = qMax(1, int(data[1]));
+        const int header_size =
+            2 + 2 * number_of_components * int(sizeof(double));
+        QVector < double > offset(number_of_components);
+        QVector < double > scale(number_of_components);
+        for (int component = 0; component < number_of_components;
+             component++)
+        {
+            const char * component_header =
+                data + 2 + 2 * component * sizeof(double);
+            memcpy(&offset[component], component_header, sizeof(double));
+            memcpy(&scale[component], component_header + sizeof(double),
+                sizeof(double));
+        }
+        const int number_of_values =
+            (mcrData.size() - header_size) / sizeof(quint16);
+        values.resize(number_of_values);
+        for (int index = 0; index < number_of_values; index++)
+        {
+            quint16 encoded;
+            memcpy(&encoded, data + header_size + index * sizeof(quint16),
+                sizeof(quint16));
+            const int component = index % number_of_components;
+            switch (encoded)
+            {
+            case SENTINEL_PLUS_INFINITY:
+                values[index] = INFINITY;
+                break;
+            case SENTINEL_MINUS_INFINITY:
+                values[index] = -INFINITY;
+                break;
+            case SENTINEL_NAN:
+                values[index] = NAN;
+                break;
+            default:
+                values[index] = offset[component] + encoded * scale[component];
+                break;
+            }
+        }
+        return values;
+    }
+
+    // Double
+    const int number_of_values = (mcrData.size() - 1) / sizeof(double);
+    values.resize(number_of_values);
+    memcpy(values.data(), data + 1, number_of_values * sizeof(double));
+    return values;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if encoded values are all the same
+bool TileCacheEncoding::IsUniform(const QByteArray & mcrData, double & mrValue,
+    int & mrNumberOfValues)
+{
+    if (mcrData.isEmpty() ||
+        int(mcrData[0]) != FORMAT_UNIFORM)
+    {
+        return false;
+    }
+
+    qint32 count;
+    memcpy(&mrValue, mcrData.constData() + 1, sizeof(double));
+    memcpy(&count, mcrData.constData() + 1 + sizeof(double), sizeof(qint32));
+    mrNumberOfValues = count;
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of bytes used per value
+int TileCacheEncoding::GetBytesPerValue(const QString & mcrFormat)
+{
+    if (mcrFormat == "float")
+    {
+        return sizeof(float);
+    }
+    if (mcrFormat == "16 bit")
+    {
+        return sizeof(quint16);
+    }
+    return sizeof(double);
+}
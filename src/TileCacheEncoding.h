@@ -0,0 +1,68 @@
+// TileCacheEncoding.h
+// Class definition
+
+// Compact representation of a tile's cached values for keeping them in
+// memory. Supported formats are "double" (lossless), "float" and "16 bit"
+// (quantized with a per-tile scale and offset for each component of
+// interleaved values; infinities and NaN are stored as sentinel values).
+// Encoded data starts with the format, so it can always be decoded without
+// knowing how it was encoded.
+//
+// Values that are all the same (typically tiles entirely inside the set or
+// entirely out of bounds) are always stored as a single value, whatever the
+// format.
+
+#ifndef TILECACHEENCODING_H
+#define TILECACHEENCODING_H
+
+// Qt includes
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+// Class definition
+class TileCacheEncoding
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+private:
+    // Default constructor (never to be called from outside)
+    TileCacheEncoding();
+
+public:
+    // Destructor
+    virtual ~TileCacheEncoding();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Encode values (consisting of interleaved components, e.g. 3 for orbit
+    // data)
+    static QByteArray Encode(const QVector < double > & mcrValues,
+        const QString & mcrFormat, const int mcComponents);
+
+    // Encode color and brightness values of a tile (brightness doesn't
+    // matter for tiles that are entirely inside the set or out of bounds)
+    static void EncodeTile(const QVector < double > & mcrColorValues,
+        const QVector < double > & mcrBrightnessValues,
+        const QString & mcrFormat, QByteArray & mrColorData,
+        QByteArray & mrBrightnessData);
+
+    // Decode values
+    static QVector < double > Decode(const QByteArray & mcrData);
+
+    // Check if encoded values are all the same
+    static bool IsUniform(const QByteArray & mcrData, double & mrValue,
+        int & mrNumberOfValues);
+
+    // Number of bytes used per value
+    static int GetBytesPerValue(const QString & mcrFormat);
+};
+
+#endif
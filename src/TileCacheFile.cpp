@@ -0,0 +1,789 @@
+// TileCacheFile.cpp
+// Class implementation
+
+// Project includes
+#include "Deploy.h"
+#include "TileCacheEncoding.h"
+#include "TileCacheFile.h"
+
+// Qt includes
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+// Identifies a tile cache file ("MPTC")
+#define TILE_CACHE_MAGIC 0x4D505443
+
+// Size of one index entry (qint64 offset, qint32 size, qint32 depth)
+#define INDEX_ENTRY_SIZE 16
+
+// Superseded blocks are dropped when they take up more than this, and more
+// than the blocks that are still used
+#define COMPACTION_MIN_UNUSED_SIZE (16 * 1024 * 1024)
+
+
+
+// We don't do call tracing here because the cache file is read from
+// prefetcher threads, and our way of doing that is not thread safe.
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+TileCacheFile::TileCacheFile()
+{
+    m_MappedData = nullptr;
+    m_MappedSize = 0;
+    m_IndexPosition = 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+TileCacheFile::~TileCacheFile()
+{
+    Close();
+}
+
+
+
+// =============================================================== Shared files
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Get shared instance for a file (opened if necessary; check IsOpen())
+TileCacheFile * TileCacheFile::Acquire(const QString & mcrFilename,
+    const QByteArray & mcrKey, const int mcWidth, const int mcHeight,
+    const int mcOversampling, const int mcTileSize, const int mcNumberOfTiles)
+{
+    QMutexLocker locker(&m_RegistryMutex);
+
+    // Check if somebody is using this file already
+    const QString filename = QFileInfo(mcrFilename).absoluteFilePath();
+    if (m_OpenFiles.contains(filename))
+    {
+        TileCacheFile * cache_file = m_OpenFiles[filename];
+        m_UseCount[cache_file]++;
+        return cache_file;
+    }
+
+    // Open it (only keep track of it if that worked)
+    TileCacheFile * cache_file = new TileCacheFile();
+    if (cache_file -> Open(filename, mcrKey, mcWidth, mcHeight,
+        mcOversampling, mcTileSize, mcNumberOfTiles))
+    {
+        m_OpenFiles[filename] = cache_file;
+        m_UseCount[cache_file] = 1;
+    }
+    return cache_file;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Done with a shared instance
+void TileCacheFile::Release(TileCacheFile * mpCacheFile)
+{
+    if (!mpCacheFile)
+    {
+        return;
+    }
+
+    QMutexLocker locker(&m_RegistryMutex);
+
+    // Files that could not be opened were never shared
+    if (!m_UseCount.contains(mpCacheFile))
+    {
+        delete mpCacheFile;
+        return;
+    }
+
+    // Close when nobody uses it anymore
+    m_UseCount[mpCacheFile]--;
+    if (m_UseCount[mpCacheFile] == 0)
+    {
+        m_UseCount.remove(mpCacheFile);
+        m_OpenFiles.remove(m_OpenFiles.key(mpCacheFile));
+        delete mpCacheFile;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Remove least recently used cache files beyond a size limit
+void TileCacheFile::CollectGarbage(const QString & mcrDirectory,
+    const qint64 mcSizeLimit)
+{
+    QMutexLocker locker(&m_RegistryMutex);
+
+    // Oldest files first (files are touched whenever they are opened)
+    const QFileInfoList all_files = QDir(mcrDirectory).entryInfoList(
+        QStringList("*.bin"), QDir::Files, QDir::Time | QDir::Reversed);
+    qint64 total_size = 0;
+    for (const QFileInfo & file_info : all_files)
+    {
+        total_size += file_info.size();
+    }
+
+    // Remove files until we're within the limit
+    for (const QFileInfo & file_info : all_files)
+    {
+        if (total_size <= mcSizeLimit)
+        {
+            break;
+        }
+
+        // Never remove files that are in use
+        if (m_OpenFiles.contains(file_info.absoluteFilePath()))
+        {
+            continue;
+        }
+        if (QFile::remove(file_info.absoluteFilePath()))
+        {
+            total_size -= file_info.size();
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a file to the lattice index of its view
+void TileCacheFile::AddToLatticeIndex(const QString & mcrDirectory,
+    const QByteArray & mcrLatticeKey, const QString & mcrFilename,
+    const QByteArray & mcrKey, const int mcWidth, const int mcHeight,
+    const int mcOversampling)
+{
+    QMutexLocker locker(&m_RegistryMutex);
+
+    // One line per file: "<file> <key> <width> <height> <oversampling>"
+    // (files are in the same directory; lines of files that have been
+    // removed since are dropped)
+    const QString index_filename = QString("%1/%2.lattice")
+        .arg(mcrDirectory,
+             QString::fromLatin1(mcrLatticeKey.toHex()));
+    const QString name = QFileInfo(mcrFilename).fileName();
+    QStringList lines;
+    QFile index_file(index_filename);
+    if (index_file.open(QIODevice::ReadOnly))
+    {
+        const QStringList old_lines =
+            QString::fromUtf8(index_file.readAll()).split("\n",
+                Qt::SkipEmptyParts);
+        index_file.close();
+        for (const QString & line : old_lines)
+        {
+            const QString line_name = line.section(' ', 0, 0);
+            if (line_name != name &&
+                QFile::exists(mcrDirectory + "/" + line_name))
+            {
+                lines << line;
+            }
+        }
+    }
+    lines << QString("%1 %2 %3 %4 %5")
+        .arg(name,
+             QString::fromLatin1(mcrKey.toHex()))
+        .arg(mcWidth)
+        .arg(mcHeight)
+        .arg(mcOversampling);
+
+    // (An index that can't be written only means fewer samples are reused)
+    QSaveFile out_file(index_filename);
+    if (out_file.open(QIODevice::WriteOnly))
+    {
+        out_file.write((lines.join("\n") + "\n").toUtf8());
+        out_file.commit();
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Find the file of a view whose samples are on the lattice of a render with
+// the given number of samples
+bool TileCacheFile::FindLatticeSource(const QString & mcrDirectory,
+    const QByteArray & mcrLatticeKey, const int mcSamplesX,
+    const int mcSamplesY, QString & mrFilename, QByteArray & mrKey,
+    int & mrWidth, int & mrHeight, int & mrOversampling)
+{
+    QMutexLocker locker(&m_RegistryMutex);
+
+    const QString index_filename = QString("%1/%2.lattice")
+        .arg(mcrDirectory,
+             QString::fromLatin1(mcrLatticeKey.toHex()));
+    QFile index_file(index_filename);
+    if (!index_file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    const QStringList lines =
+        QString::fromUtf8(index_file.readAll()).split("\n",
+            Qt::SkipEmptyParts);
+    index_file.close();
+
+    qint64 best_samples = 0;
+    for (const QString & line : lines)
+    {
+        const QStringList fields = line.split(' ');
+        if (fields.size() != 5)
+        {
+            continue;
+        }
+        const int width = fields[2].toInt();
+        const int height = fields[3].toInt();
+        const int oversampling = fields[4].toInt();
+        const int samples_x = width * oversampling;
+        const int samples_y = height * oversampling;
+        if (samples_x < 1 ||
+            samples_y < 1 ||
+            mcSamplesX % samples_x != 0 ||
+            mcSamplesY % samples_y != 0 ||
+            mcSamplesX / samples_x != mcSamplesY / samples_y ||
+            mcSamplesX / samples_x < 2 ||
+            qint64(samples_x) * samples_y <= best_samples)
+        {
+            continue;
+        }
+        const QString filename = mcrDirectory + "/" + fields[0];
+        if (!QFile::exists(filename))
+        {
+            continue;
+        }
+        best_samples = qint64(samples_x) * samples_y;
+        mrFilename = filename;
+        mrKey = QByteArray::fromHex(fields[1].toLatin1());
+        mrWidth = width;
+        mrHeight = height;
+        mrOversampling = oversampling;
+    }
+
+    return (best_samples > 0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Registry of shared files
+QMutex TileCacheFile::m_RegistryMutex;
+QHash < QString, TileCacheFile * > TileCacheFile::m_OpenFiles;
+QHash < TileCacheFile *, int > TileCacheFile::m_UseCount;
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Open file (will be created or reset if it doesn't match)
+bool TileCacheFile::Open(const QString & mcrFilename,
+    const QByteArray & mcrKey, const int mcWidth, const int mcHeight,
+    const int mcOversampling, const int mcTileSize, const int mcNumberOfTiles)
+{
+    Close();
+
+    QMutexLocker locker(&m_Mutex);
+
+    // Open file
+    QDir().mkpath(QFileInfo(mcrFilename).path());
+    m_File.setFileName(mcrFilename);
+    const bool file_existed = m_File.exists();
+    if (!m_File.open(QFile::ReadWrite))
+    {
+        m_LastError = tr("Could not open cache file \"%1\".")
+            .arg(mcrFilename);
+        return false;
+    }
+
+    // Mark as recently used (for garbage collection)
+    m_File.setFileTime(QDateTime::currentDateTime(),
+        QFileDevice::FileModificationTime);
+
+    // Check if we can use what's in there (dropping superseded blocks if
+    // they take up too much space)
+    if (file_existed &&
+        ReadHeader(mcrKey, mcWidth, mcHeight, mcOversampling, mcTileSize,
+            mcNumberOfTiles))
+    {
+        qint64 used_size = m_IndexPosition +
+            qint64(mcNumberOfTiles) * INDEX_ENTRY_SIZE;
+        for (const qint32 size : m_BlockSize)
+        {
+            used_size += size;
+        }
+        const qint64 unused_size = m_File.size() - used_size;
+        if (unused_size > COMPACTION_MIN_UNUSED_SIZE &&
+            unused_size > used_size)
+        {
+            // (File is still fine if this doesn't work)
+            Compact(mcrKey, mcWidth, mcHeight, mcOversampling, mcTileSize,
+                mcNumberOfTiles);
+        }
+        return true;
+    }
+
+    // Start from scratch
+    if (!WriteHeader(mcrKey, mcWidth, mcHeight, mcOversampling, mcTileSize,
+        mcNumberOfTiles))
+    {
+        m_File.close();
+        return false;
+    }
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Close file
+void TileCacheFile::Close()
+{
+    QMutexLocker locker(&m_Mutex);
+
+    UnmapFile();
+    if (m_File.isOpen())
+    {
+        m_File.close();
+    }
+    m_File.setFileName(QString());
+    m_IndexPosition = 0;
+    m_BlockOffset.clear();
+    m_BlockSize.clear();
+    m_BlockDepth.clear();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if file is open
+bool TileCacheFile::IsOpen() const
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_File.isOpen();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Filename
+QString TileCacheFile::GetFilename() const
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_File.fileName();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if there is data for a tile
+bool TileCacheFile::HasTile(const int mcTileID) const
+{
+    QMutexLocker locker(&m_Mutex);
+    return (mcTileID >= 0 &&
+        mcTileID < m_BlockSize.size() &&
+        m_BlockSize[mcTileID] > 0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Depth the data of a tile has been calculated with (0 if there's no data)
+int TileCacheFile::GetTileDepth(const int mcTileID) const
+{
+    QMutexLocker locker(&m_Mutex);
+    if (mcTileID < 0 ||
+        mcTileID >= m_BlockSize.size() ||
+        m_BlockSize[mcTileID] == 0)
+    {
+        return 0;
+    }
+    return m_BlockDepth[mcTileID];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read data of one tile
+bool TileCacheFile::ReadTile(const int mcTileID,
+    QVector < double > & mrColorData, QVector < double > & mrBrightnessData,
+    int & mrDepth) const
+{
+    // Copy compressed block out of the mapped file
+    QByteArray compressed;
+    {
+        QMutexLocker locker(&m_Mutex);
+        if (!m_File.isOpen() ||
+            mcTileID < 0 ||
+            mcTileID >= m_BlockSize.size() ||
+            m_BlockSize[mcTileID] == 0)
+        {
+            return false;
+        }
+        const qint64 offset = m_BlockOffset[mcTileID];
+        const qint32 size = m_BlockSize[mcTileID];
+        mrDepth = m_BlockDepth[mcTileID];
+        if (!MapFile(offset + size))
+        {
+            return false;
+        }
+        compressed = QByteArray(
+            reinterpret_cast < const char * >(m_MappedData + offset), size);
+    }
+
+    // Decompress (outside the lock, so several threads can do this)
+    const QByteArray raw = qUncompress(compressed);
+    if (raw.isEmpty())
+    {
+        QMutexLocker locker(&m_Mutex);
+        m_LastError = tr("Cache data for tile %1 is corrupt.")
+            .arg(mcTileID);
+        return false;
+    }
+    QDataStream in_stream(raw);
+    QByteArray color_data;
+    QByteArray brightness_data;
+    in_stream >> color_data;
+    in_stream >> brightness_data;
+    if (in_stream.status() != QDataStream::Ok)
+    {
+        QMutexLocker locker(&m_Mutex);
+        m_LastError = tr("Cache data for tile %1 is corrupt.")
+            .arg(mcTileID);
+        return false;
+    }
+    mrColorData = TileCacheEncoding::Decode(color_data);
+    mrBrightnessData = TileCacheEncoding::Decode(brightness_data);
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write data of one tile
+bool TileCacheFile::WriteTile(const int mcTileID,
+    const QVector < double > & mcrColorData,
+    const QVector < double > & mcrBrightnessData, const int mcDepth)
+{
+    // Compress data (uniform tiles end up as just a few bytes)
+    QByteArray color_data;
+    QByteArray brightness_data;
+    TileCacheEncoding::EncodeTile(mcrColorData, mcrBrightnessData, "double",
+        color_data, brightness_data);
+    QByteArray raw;
+    {
+        QDataStream out_stream(&raw, QIODevice::WriteOnly);
+        out_stream << color_data;
+        out_stream << brightness_data;
+    }
+    const QByteArray compressed = qCompress(raw);
+
+    QMutexLocker locker(&m_Mutex);
+
+    if (!m_File.isOpen() ||
+        mcTileID < 0 ||
+        mcTileID >= m_BlockSize.size())
+    {
+        m_LastError = tr("Tile %1 is not part of the cache file.")
+            .arg(mcTileID);
+        return false;
+    }
+
+    // Append block (if the tile has been written before, e.g. with a lower
+    // depth, the old block is simply not referenced anymore)
+    const qint64 offset = m_File.size();
+    if (!m_File.seek(offset) ||
+        m_File.write(compressed) != compressed.size())
+    {
+        m_LastError = tr("Could not write to cache file \"%1\".")
+            .arg(m_File.fileName());
+        return false;
+    }
+
+    // Update index (only after the block is there, so an interrupted write
+    // doesn't leave an index entry pointing to garbage)
+    if (!m_File.seek(m_IndexPosition + qint64(mcTileID) * INDEX_ENTRY_SIZE))
+    {
+        m_LastError = tr("Could not update index of cache file \"%1\".")
+            .arg(m_File.fileName());
+        return false;
+    }
+    QDataStream out_stream(&m_File);
+    out_stream << offset;
+    out_stream << qint32(compressed.size());
+    out_stream << qint32(mcDepth);
+    m_File.flush();
+    if (out_stream.status() != QDataStream::Ok)
+    {
+        m_LastError = tr("Could not update index of cache file \"%1\".")
+            .arg(m_File.fileName());
+        return false;
+    }
+    m_BlockOffset[mcTileID] = offset;
+    m_BlockSize[mcTileID] = compressed.size();
+    m_BlockDepth[mcTileID] = mcDepth;
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Last error
+QString TileCacheFile::GetLastError() const
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_LastError;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read header and index of an existing file
+bool TileCacheFile::ReadHeader(const QByteArray & mcrKey, const int mcWidth,
+    const int mcHeight, const int mcOversampling, const int mcTileSize,
+    const int mcNumberOfTiles)
+{
+    // Header
+    m_File.seek(0);
+    QDataStream in_stream(&m_File);
+    quint32 magic;
+    quint32 version;
+    QByteArray key;
+    qint32 width;
+    qint32 height;
+    qint32 oversampling;
+    qint32 tile_size;
+    qint32 number_of_tiles;
+    in_stream >> magic >> version >> key;
+    in_stream >> width >> height >> oversampling >> tile_size >>
+        number_of_tiles;
+    if (in_stream.status() != QDataStream::Ok ||
+        magic != TILE_CACHE_MAGIC ||
+        version != CACHE_FILE_VERSION ||
+        key != mcrKey ||
+        width != mcWidth ||
+        height != mcHeight ||
+        oversampling != mcOversampling ||
+        tile_size != mcTileSize ||
+        number_of_tiles != mcNumberOfTiles)
+    {
+        return false;
+    }
+    m_IndexPosition = m_File.pos();
+
+    // Index
+    const qint64 file_size = m_File.size();
+    m_BlockOffset.resize(number_of_tiles);
+    m_BlockSize.resize(number_of_tiles);
+    m_BlockDepth.resize(number_of_tiles);
+    for (int tile_id = 0; tile_id < number_of_tiles; tile_id++)
+    {
+        qint64 offset;
+        qint32 size;
+        qint32 depth;
+        in_stream >> offset >> size >> depth;
+        if (in_stream.status() != QDataStream::Ok ||
+            size < 0 ||
+            offset + size > file_size)
+        {
+            return false;
+        }
+        m_BlockOffset[tile_id] = offset;
+        m_BlockSize[tile_id] = size;
+        m_BlockDepth[tile_id] = depth;
+    }
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write header and an empty index
+bool TileCacheFile::WriteHeader(const QByteArray & mcrKey, const int mcWidth,
+    const int mcHeight, const int mcOversampling, const int mcTileSize,
+    const int mcNumberOfTiles)
+{
+    // Get rid of old content
+    UnmapFile();
+    if (!m_File.resize(0))
+    {
+        m_LastError = tr("Could not reset cache file \"%1\".")
+            .arg(m_File.fileName());
+        return false;
+    }
+
+    // Header
+    m_File.seek(0);
+    QDataStream out_stream(&m_File);
+    WriteHeaderData(out_stream, mcrKey, mcWidth, mcHeight, mcOversampling,
+        mcTileSize, mcNumberOfTiles);
+    m_IndexPosition = m_File.pos();
+
+    // Empty index
+    for (int tile_id = 0; tile_id < mcNumberOfTiles; tile_id++)
+    {
+        out_stream << qint64(0) << qint32(0) << qint32(0);
+    }
+    m_File.flush();
+    if (out_stream.status() != QDataStream::Ok)
+    {
+        m_LastError = tr("Could not write header of cache file \"%1\".")
+            .arg(m_File.fileName());
+        return false;
+    }
+    m_BlockOffset.fill(0, mcNumberOfTiles);
+    m_BlockSize.fill(0, mcNumberOfTiles);
+    m_BlockDepth.fill(0, mcNumberOfTiles);
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write header fields
+void TileCacheFile::WriteHeaderData(QDataStream & mrOutStream,
+    const QByteArray & mcrKey, const int mcWidth, const int mcHeight,
+    const int mcOversampling, const int mcTileSize, const int mcNumberOfTiles)
+{
+    mrOutStream << quint32(TILE_CACHE_MAGIC) <<
+        quint32(CACHE_FILE_VERSION) << mcrKey;
+    mrOutStream << qint32(mcWidth) << qint32(mcHeight) <<
+        qint32(mcOversampling) << qint32(mcTileSize) <<
+        qint32(mcNumberOfTiles);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Rewrite file with only the blocks the index refers to
+bool TileCacheFile::Compact(const QByteArray & mcrKey, const int mcWidth,
+    const int mcHeight, const int mcOversampling, const int mcTileSize,
+    const int mcNumberOfTiles)
+{
+    const QString filename = m_File.fileName();
+    if (!MapFile(m_File.size()))
+    {
+        return false;
+    }
+
+    // Write new file next to the old one (replaces it only if everything
+    // could be written)
+    QSaveFile new_file(filename);
+    if (!new_file.open(QIODevice::WriteOnly))
+    {
+        m_LastError = tr("Could not compact cache file \"%1\".")
+            .arg(filename);
+        return false;
+    }
+    QDataStream out_stream(&new_file);
+    WriteHeaderData(out_stream, mcrKey, mcWidth, mcHeight, mcOversampling,
+        mcTileSize, mcNumberOfTiles);
+    const qint64 index_position = new_file.pos();
+    QVector < qint64 > block_offset(mcNumberOfTiles, 0);
+    qint64 offset = index_position +
+        qint64(mcNumberOfTiles) * INDEX_ENTRY_SIZE;
+    for (int tile_id = 0; tile_id < mcNumberOfTiles; tile_id++)
+    {
+        if (m_BlockSize[tile_id] > 0)
+        {
+            block_offset[tile_id] = offset;
+            offset += m_BlockSize[tile_id];
+        }
+        out_stream << block_offset[tile_id] << m_BlockSize[tile_id] <<
+            m_BlockDepth[tile_id];
+    }
+    for (int tile_id = 0; tile_id < mcNumberOfTiles; tile_id++)
+    {
+        if (m_BlockSize[tile_id] > 0)
+        {
+            new_file.write(reinterpret_cast < const char * >(
+                m_MappedData + m_BlockOffset[tile_id]),
+                m_BlockSize[tile_id]);
+        }
+    }
+    UnmapFile();
+    if (out_stream.status() != QDataStream::Ok ||
+        !new_file.commit())
+    {
+        m_LastError = tr("Could not compact cache file \"%1\".")
+            .arg(filename);
+        return false;
+    }
+
+    // Continue with the new file
+    m_File.close();
+    if (!m_File.open(QFile::ReadWrite))
+    {
+        m_LastError = tr("Could not open cache file \"%1\".")
+            .arg(filename);
+        return false;
+    }
+    m_IndexPosition = index_position;
+    m_BlockOffset = block_offset;
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Make sure the mapped region covers the given size
+bool TileCacheFile::MapFile(const qint64 mcMinimumSize) const
+{
+    // Check if current mapping is good enough
+    if (m_MappedData &&
+        m_MappedSize >= mcMinimumSize)
+    {
+        return true;
+    }
+
+    // File has grown since; map it again
+    UnmapFile();
+    m_File.flush();
+    const qint64 size = m_File.size();
+    if (size < mcMinimumSize)
+    {
+        m_LastError = tr("Cache file \"%1\" is truncated.")
+            .arg(m_File.fileName());
+        return false;
+    }
+    m_MappedData = m_File.map(0, size);
+    if (!m_MappedData)
+    {
+        m_LastError = tr("Could not map cache file \"%1\".")
+            .arg(m_File.fileName());
+        return false;
+    }
+    m_MappedSize = size;
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Unmap file
+void TileCacheFile::UnmapFile() const
+{
+    if (m_MappedData)
+    {
+        m_File.unmap(m_MappedData);
+        m_MappedData = nullptr;
+        m_MappedSize = 0;
+    }
+}
@@ -0,0 +1,171 @@
+// TileCacheFile.h
+// Class definition
+
+// Single file holding the cache data of all tiles of an image. The file
+// starts with a header (format version, parameter key, dimensions,
+// oversampling, tile size) and a tile index, followed by one compressed block
+// per tile (TileCacheEncoding, losslessly). Blocks are only ever appended;
+// the index is updated in place. Superseded blocks are dropped when the file
+// is opened and they take up more than the blocks still in use.
+// The file is memory-mapped for reading.
+//
+// Cache files are named after the key, so any image rendered with the same
+// parameters (in this or another window, or in a later session) uses the same
+// file. Within the application, images share one instance per file.
+//
+// Files are also listed in a lattice index ("<lattice key>.lattice") by a
+// key of their view that leaves out resolution and oversampling. That way,
+// a render with a multiple of the samples of an earlier one (a poster of a
+// preview) can find the samples it has in common with it.
+
+#ifndef TILECACHEFILE_H
+#define TILECACHEFILE_H
+
+// Qt includes
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+// Class definition
+class TileCacheFile
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    TileCacheFile();
+
+    // Destructor
+    virtual ~TileCacheFile();
+
+
+
+    // =========================================================== Shared files
+public:
+    // Get shared instance for a file (opened if necessary; check IsOpen())
+    static TileCacheFile * Acquire(const QString & mcrFilename,
+        const QByteArray & mcrKey, const int mcWidth, const int mcHeight,
+        const int mcOversampling, const int mcTileSize,
+        const int mcNumberOfTiles);
+
+    // Done with a shared instance
+    static void Release(TileCacheFile * mpCacheFile);
+
+    // Remove least recently used cache files beyond a size limit
+    static void CollectGarbage(const QString & mcrDirectory,
+        const qint64 mcSizeLimit);
+
+    // Add a file to the lattice index of its view
+    static void AddToLatticeIndex(const QString & mcrDirectory,
+        const QByteArray & mcrLatticeKey, const QString & mcrFilename,
+        const QByteArray & mcrKey, const int mcWidth, const int mcHeight,
+        const int mcOversampling);
+
+    // Find the file of a view whose samples are on the lattice of a render
+    // with the given number of samples (an integer factor of 2 or more
+    // fewer in both directions; the one with the most samples if there are
+    // several)
+    static bool FindLatticeSource(const QString & mcrDirectory,
+        const QByteArray & mcrLatticeKey, const int mcSamplesX,
+        const int mcSamplesY, QString & mrFilename, QByteArray & mrKey,
+        int & mrWidth, int & mrHeight, int & mrOversampling);
+
+private:
+    static QMutex m_RegistryMutex;
+    static QHash < QString, TileCacheFile * > m_OpenFiles;
+    static QHash < TileCacheFile *, int > m_UseCount;
+
+
+
+    // ======================================================== Everything else
+public:
+    // Open file (will be created or reset if it doesn't match)
+    bool Open(const QString & mcrFilename, const QByteArray & mcrKey,
+        const int mcWidth, const int mcHeight, const int mcOversampling,
+        const int mcTileSize, const int mcNumberOfTiles);
+
+    // Close file
+    void Close();
+
+    // Check if file is open
+    bool IsOpen() const;
+
+    // Filename
+    QString GetFilename() const;
+
+    // Check if there is data for a tile
+    bool HasTile(const int mcTileID) const;
+
+    // Depth the data of a tile has been calculated with (0 if there's no
+    // data)
+    int GetTileDepth(const int mcTileID) const;
+
+    // Read data of one tile
+    bool ReadTile(const int mcTileID, QVector < double > & mrColorData,
+        QVector < double > & mrBrightnessData, int & mrDepth) const;
+
+    // Write data of one tile
+    bool WriteTile(const int mcTileID,
+        const QVector < double > & mcrColorData,
+        const QVector < double > & mcrBrightnessData, const int mcDepth);
+
+    // Last error
+    QString GetLastError() const;
+
+private:
+    // Read header and index of an existing file
+    bool ReadHeader(const QByteArray & mcrKey, const int mcWidth,
+        const int mcHeight, const int mcOversampling, const int mcTileSize,
+        const int mcNumberOfTiles);
+
+    // Write header fields
+    static void WriteHeaderData(QDataStream & mrOutStream,
+        const QByteArray & mcrKey, const int mcWidth, const int mcHeight,
+        const int mcOversampling, const int mcTileSize,
+        const int mcNumberOfTiles);
+
+    // Rewrite file with only the blocks the index refers to
+    bool Compact(const QByteArray & mcrKey, const int mcWidth,
+        const int mcHeight, const int mcOversampling, const int mcTileSize,
+        const int mcNumberOfTiles);
+
+    // Write header and an empty index
+    bool WriteHeader(const QByteArray & mcrKey, const int mcWidth,
+        const int mcHeight, const int mcOversampling, const int mcTileSize,
+        const int mcNumberOfTiles);
+
+    // Make sure the mapped region covers the given size
+    bool MapFile(const qint64 mcMinimumSize) const;
+
+    // Unmap file
+    void UnmapFile() const;
+
+    // File
+    mutable QFile m_File;
+    mutable uchar * m_MappedData;
+    mutable qint64 m_MappedSize;
+
+    // Index (position of the index in the file, block locations, and the
+    // depth each block has been calculated with)
+    qint64 m_IndexPosition;
+    QVector < qint64 > m_BlockOffset;
+    QVector < qint32 > m_BlockSize;
+    QVector < qint32 > m_BlockDepth;
+
+    // Reading and writing happens from different threads
+    mutable QMutex m_Mutex;
+
+    // Last error
+    mutable QString m_LastError;
+};
+
+#endif
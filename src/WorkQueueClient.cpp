@@ -0,0 +1,380 @@
+// WorkQueueClient.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "Deploy.h"
+#include "FractalWorker.h"
+#include "MessageLogger.h"
+#include "TileCacheEncoding.h"
+#include "WorkQueueClient.h"
+#include "WorkQueueProtocol.h"
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QHostInfo>
+#include <QLocalSocket>
+#include <QTcpSocket>
+
+// How long to wait before asking again when there's no work
+#define WORK_POLL_INTERVAL 500
+
+// How long to wait for the connection
+#define CONNECT_TIMEOUT 10000
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+WorkQueueClient::WorkQueueClient()
+{
+    CALL_IN("");
+
+    m_Connection = nullptr;
+    m_NumberOfThreads = 1;
+    m_UnitsRequested = 0;
+    m_RunState.storeRelaxed(RUN_STATE_RUNNING);
+
+    connect (&m_HeartbeatTimer, SIGNAL(timeout()),
+        this, SLOT(SendHeartbeat()));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+WorkQueueClient::~WorkQueueClient()
+{
+    CALL_IN("");
+
+    // Stop workers
+    m_RunState.storeRelaxed(RUN_STATE_STOPPED);
+    for (auto thread_iterator = m_UnitIDToWorkerThread.constBegin();
+         thread_iterator != m_UnitIDToWorkerThread.constEnd();
+         thread_iterator++)
+    {
+        thread_iterator.value() -> quit();
+        thread_iterator.value() -> wait();
+        delete m_UnitIDToWorker[thread_iterator.key()];
+        delete thread_iterator.value();
+    }
+    delete m_Connection;
+
+    CALL_OUT("");
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Connect to a coordinator
+bool WorkQueueClient::Connect(const QString & mcrAddress,
+    const int mcNumberOfThreads, const QString & mcrSecret)
+{
+    CALL_IN(QString("mcrAddress=%1, mcNumberOfThreads=%2, mcrSecret=...")
+        .arg(CALL_SHOW(mcrAddress),
+             CALL_SHOW(mcNumberOfThreads)));
+
+    m_NumberOfThreads = qMax(1, mcNumberOfThreads);
+    m_Secret = mcrSecret;
+
+    // Connect
+    QString host;
+    quint16 port;
+    QString error;
+    if (WorkQueueProtocol::IsTcpAddress(mcrAddress, host, port))
+    {
+        QTcpSocket * socket = new QTcpSocket();
+        m_Connection = socket;
+        socket -> connectToHost(host, port);
+        if (!socket -> waitForConnected(CONNECT_TIMEOUT))
+        {
+            error = socket -> errorString();
+        }
+        connect (socket, SIGNAL(disconnected()),
+            this, SLOT(ConnectionClosed()));
+    } else
+    {
+        QLocalSocket * socket = new QLocalSocket();
+        m_Connection = socket;
+        socket -> connectToServer(mcrAddress);
+        if (!socket -> waitForConnected(CONNECT_TIMEOUT))
+        {
+            error = socket -> errorString();
+        }
+        connect (socket, SIGNAL(disconnected()),
+            this, SLOT(ConnectionClosed()));
+    }
+    if (!error.isEmpty())
+    {
+        m_LastError = tr("Could not connect to \"%1\": %2")
+            .arg(mcrAddress,
+                 error);
+        CALL_OUT(m_LastError);
+        return false;
+    }
+    connect (m_Connection, SIGNAL(readyRead()),
+        this, SLOT(ReadMessages()));
+
+    // We introduce ourselves when the coordinator challenges us
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Last error
+QString WorkQueueClient::GetLastError() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_LastError;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Message(s) from the coordinator
+void WorkQueueClient::ReadMessages()
+{
+    CALL_IN("");
+
+    QString type;
+    QByteArray payload;
+    while (WorkQueueProtocol::ReadMessage(m_Connection, type, payload))
+    {
+        HandleMessage(type, payload);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Handle a message from the coordinator
+void WorkQueueClient::HandleMessage(const QString & mcrType,
+    const QByteArray & mcrPayload)
+{
+    CALL_IN(QString("mcrType=%1, mcrPayload=...")
+        .arg(CALL_SHOW(mcrType)));
+
+    QDataStream in_stream(mcrPayload);
+
+    // Coordinator wants to know who we are (and if we know the secret)
+    if (mcrType == "challenge")
+    {
+        QByteArray challenge;
+        in_stream >> challenge;
+        const QString name = QString("%1:%2")
+            .arg(QHostInfo::localHostName())
+            .arg(QCoreApplication::applicationPid());
+        QByteArray hello;
+        QDataStream out_stream(&hello, QIODevice::WriteOnly);
+        out_stream << quint32(WORK_QUEUE_VERSION) << name <<
+            qint32(m_NumberOfThreads) <<
+            WorkQueueProtocol::GetChallengeResponse(challenge, m_Secret);
+        WorkQueueProtocol::WriteMessage(m_Connection, "hello", hello);
+        m_HeartbeatTimer.start(HEARTBEAT_INTERVAL);
+
+        // Get to work
+        RequestUnits();
+        CALL_OUT("");
+        return;
+    }
+
+    // A unit to calculate
+    if (mcrType == "unit")
+    {
+        qint32 unit_id;
+        QHash < QString, QString > parameters;
+        qint32 cache_depth;
+        QByteArray color_data;
+        QByteArray brightness_data;
+        in_stream >> unit_id >> parameters >> cache_depth >> color_data >>
+            brightness_data;
+        m_UnitsRequested--;
+        StartUnit(unit_id, parameters, cache_depth, color_data,
+            brightness_data);
+        CALL_OUT("");
+        return;
+    }
+
+    // No work right now; ask again later
+    if (mcrType == "wait")
+    {
+        m_UnitsRequested--;
+        QTimer::singleShot(WORK_POLL_INTERVAL, this, SLOT(RequestUnits()));
+        CALL_OUT("");
+        return;
+    }
+
+    // Coordinator paused, resumed or stopped rendering
+    if (mcrType == "state")
+    {
+        qint32 run_state;
+        in_stream >> run_state;
+        m_RunState.storeRelaxed(run_state);
+        CALL_OUT("");
+        return;
+    }
+
+    // Don't know what to do with this
+    const QString reason = tr("Unknown message \"%1\" from coordinator.")
+        .arg(mcrType);
+    MessageLogger::Error(CALL_METHOD, reason);
+
+    CALL_OUT(reason);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Coordinator has gone away
+void WorkQueueClient::ConnectionClosed()
+{
+    CALL_IN("");
+
+    m_HeartbeatTimer.stop();
+    emit Finished();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Tell coordinator we're alive
+void WorkQueueClient::SendHeartbeat()
+{
+    CALL_IN("");
+
+    WorkQueueProtocol::WriteMessage(m_Connection, "heartbeat");
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Ask for units until every thread has one
+void WorkQueueClient::RequestUnits()
+{
+    CALL_IN("");
+
+    while (m_UnitIDToWorker.size() + m_UnitsRequested < m_NumberOfThreads)
+    {
+        WorkQueueProtocol::WriteMessage(m_Connection, "request");
+        m_UnitsRequested++;
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start a worker for a unit
+void WorkQueueClient::StartUnit(const int mcUnitID,
+    const QHash < QString, QString > & mcrParameters, const int mcCacheDepth,
+    const QByteArray & mcrColorData, const QByteArray & mcrBrightnessData)
+{
+    CALL_IN(QString("mcUnitID=%1, mcrParameters=%2, mcCacheDepth=%3, "
+        "mcrColorData=..., mcrBrightnessData=...")
+        .arg(CALL_SHOW(mcUnitID),
+             CALL_SHOW(mcrParameters),
+             CALL_SHOW(mcCacheDepth)));
+
+    // Cores of the coordinator don't mean anything here
+    QHash < QString, QString > parameters = mcrParameters;
+    parameters.remove("core");
+
+    // Units are only handed out while the coordinator is rendering (the
+    // heartbeat telling us may not have arrived yet)
+    m_RunState.storeRelaxed(RUN_STATE_RUNNING);
+
+    // Same as FractalImage does it
+    FractalWorker * worker = new FractalWorker();
+    m_UnitIDToWorker[mcUnitID] = worker;
+    worker -> Prepare(parameters);
+    worker -> SetRunState(&m_RunState);
+    connect (worker, SIGNAL(Finished(const int)),
+        this, SLOT(WorkerFinished(const int)));
+    if (!mcrColorData.isEmpty())
+    {
+        worker -> SetEncodedCacheValues(mcrColorData, mcrBrightnessData);
+        worker -> SetCacheDepth(mcCacheDepth);
+    }
+    QThread * thread = new QThread();
+    m_UnitIDToWorkerThread[mcUnitID] = thread;
+    connect (thread, SIGNAL(started()),
+        worker, SLOT(Start()));
+    worker -> moveToThread(thread);
+    thread -> start();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Worker is done with a unit
+void WorkQueueClient::WorkerFinished(const int mcUnitID)
+{
+    CALL_IN(QString("mcUnitID=%1")
+        .arg(CALL_SHOW(mcUnitID)));
+
+    // Result (cache data is sent losslessly; the coordinator decides how to
+    // keep it)
+    FractalWorker * worker = m_UnitIDToWorker[mcUnitID];
+    const QImage image =
+        worker -> GetImage().convertToFormat(QImage::Format_RGB32);
+    QByteArray pixels;
+    pixels.reserve(image.width() * image.height() * 4);
+    for (int row = 0; row < image.height(); row++)
+    {
+        pixels.append(reinterpret_cast < const char * >(image.scanLine(row)),
+            image.width() * 4);
+    }
+    QByteArray color_data;
+    QByteArray brightness_data;
+    TileCacheEncoding::EncodeTile(worker -> GetColorData(),
+        worker -> GetBrightnessData(), "double", color_data,
+        brightness_data);
+    QHash < QString, QString > statistics = worker -> GetStatistics();
+    statistics.remove("core at start");
+    statistics.remove("numa node at start");
+
+    QByteArray result;
+    QDataStream out_stream(&result, QIODevice::WriteOnly);
+    out_stream << qint32(mcUnitID) << qint32(worker -> GetStopRow()) <<
+        worker -> WasStopped() << qint32(worker -> GetCacheDepth()) <<
+        qint32(image.width()) << qint32(image.height()) <<
+        qCompress(pixels) << qCompress(color_data) <<
+        qCompress(brightness_data) << statistics;
+    WorkQueueProtocol::WriteMessage(m_Connection, "result", result);
+
+    // End thread
+    m_UnitIDToWorker.take(mcUnitID) -> deleteLater();
+    QThread * thread = m_UnitIDToWorkerThread.take(mcUnitID);
+    thread -> quit();
+    thread -> wait();
+    thread -> deleteLater();
+
+    // Next one
+    RequestUnits();
+
+    CALL_OUT("");
+}
@@ -0,0 +1,103 @@
+// WorkQueueClient.h
+// Class definition
+
+// Worker side of the work queue: connects to a coordinator
+// (WorkQueueServer), keeps one unit per thread going, and sends the results
+// back. Runs until the coordinator goes away. See WorkQueueProtocol for the
+// messages.
+
+#ifndef WORKQUEUECLIENT_H
+#define WORKQUEUECLIENT_H
+
+// Qt includes
+#include <QAtomicInt>
+#include <QHash>
+#include <QIODevice>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QTimer>
+
+// Forward declaration
+class FractalWorker;
+
+// Class definition
+class WorkQueueClient
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    WorkQueueClient();
+
+    // Destructor
+    virtual ~WorkQueueClient();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Connect to a coordinator ("host:port" or name of a local socket),
+    // with the secret it shares with its workers
+    bool Connect(const QString & mcrAddress, const int mcNumberOfThreads,
+        const QString & mcrSecret);
+
+    // Last error
+    QString GetLastError() const;
+
+signals:
+    // Coordinator has gone away
+    void Finished();
+
+private slots:
+    // Message(s) from the coordinator
+    void ReadMessages();
+
+    // Coordinator has gone away
+    void ConnectionClosed();
+
+    // Tell coordinator we're alive
+    void SendHeartbeat();
+
+    // Ask for units until every thread has one
+    void RequestUnits();
+
+    // Worker is done with a unit
+    void WorkerFinished(const int mcUnitID);
+
+private:
+    // Handle a message from the coordinator
+    void HandleMessage(const QString & mcrType,
+        const QByteArray & mcrPayload);
+
+    // Start a worker for a unit
+    void StartUnit(const int mcUnitID,
+        const QHash < QString, QString > & mcrParameters,
+        const int mcCacheDepth, const QByteArray & mcrColorData,
+        const QByteArray & mcrBrightnessData);
+
+    // Connection to the coordinator, and the secret we share with it
+    QIODevice * m_Connection;
+    QString m_Secret;
+
+    // Threads, and units requested but not received yet
+    int m_NumberOfThreads;
+    int m_UnitsRequested;
+
+    // Workers
+    QHash < int, FractalWorker * > m_UnitIDToWorker;
+    QHash < int, QThread * > m_UnitIDToWorkerThread;
+    QAtomicInt m_RunState;
+
+    // Heartbeats
+    QTimer m_HeartbeatTimer;
+
+    // Last error
+    QString m_LastError;
+};
+
+#endif
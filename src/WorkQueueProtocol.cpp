@@ -0,0 +1,136 @@
+// WorkQueueProtocol.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "WorkQueueProtocol.h"
+
+// Qt includes
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QMessageAuthenticationCode>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Default constructor (never to be called from outside)
+WorkQueueProtocol::WorkQueueProtocol()
+{
+    CALL_IN("");
+
+    // Nothing to do.
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+WorkQueueProtocol::~WorkQueueProtocol()
+{
+    CALL_IN("");
+
+    // Nothing to do, either.
+
+    CALL_OUT("");
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if an address is a TCP address ("host:port"; host may be empty for
+// listening on this machine only), and split it
+bool WorkQueueProtocol::IsTcpAddress(const QString & mcrAddress,
+    QString & mrHost, quint16 & mrPort)
+{
+    CALL_IN(QString("mcrAddress=%1, mrHost=..., mrPort=...")
+        .arg(CALL_SHOW(mcrAddress)));
+
+    const int separator = mcrAddress.lastIndexOf(':');
+    if (separator < 0)
+    {
+        CALL_OUT("Local socket");
+        return false;
+    }
+    bool is_number = false;
+    const uint port = mcrAddress.mid(separator + 1).toUInt(&is_number);
+    if (!is_number ||
+        port == 0 ||
+        port > 65535)
+    {
+        CALL_OUT("Local socket");
+        return false;
+    }
+    mrHost = mcrAddress.left(separator);
+    mrPort = quint16(port);
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Send a message
+void WorkQueueProtocol::WriteMessage(QIODevice * mpConnection,
+    const QString & mcrType, const QByteArray & mcrPayload)
+{
+    CALL_IN(QString("mpConnection=%1, mcrType=%2, mcrPayload=...")
+        .arg(CALL_SHOW(mpConnection),
+             CALL_SHOW(mcrType)));
+
+    QDataStream out_stream(mpConnection);
+    out_stream << mcrType << mcrPayload;
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read the next complete message
+bool WorkQueueProtocol::ReadMessage(QIODevice * mpConnection,
+    QString & mrType, QByteArray & mrPayload)
+{
+    CALL_IN(QString("mpConnection=%1, mrType=..., mrPayload=...")
+        .arg(CALL_SHOW(mpConnection)));
+
+    // Messages may arrive in pieces
+    QDataStream in_stream(mpConnection);
+    in_stream.startTransaction();
+    in_stream >> mrType >> mrPayload;
+    if (!in_stream.commitTransaction())
+    {
+        CALL_OUT("Incomplete");
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Answer to a challenge of the coordinator (keyed hash, so the secret itself
+// never goes over the connection)
+QByteArray WorkQueueProtocol::GetChallengeResponse(
+    const QByteArray & mcrChallenge, const QString & mcrSecret)
+{
+    CALL_IN("mcrChallenge=..., mcrSecret=...");
+
+    const QByteArray response = QMessageAuthenticationCode::hash(
+        mcrChallenge, mcrSecret.toUtf8(), QCryptographicHash::Sha256);
+
+    CALL_OUT("");
+    return response;
+}
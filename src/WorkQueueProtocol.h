@@ -0,0 +1,85 @@
+// WorkQueueProtocol.h
+// Class definition
+
+// Messages between a coordinator (WorkQueueServer) handing out units of a
+// render and worker processes (WorkQueueClient) calculating them. Every
+// message is a type and a payload (both serialized with QDataStream); the
+// payload depends on the type:
+//
+//   Worker to coordinator:
+//     "hello"      protocol version, worker name, number of threads,
+//                  response to the challenge (see GetChallengeResponse)
+//     "request"    (none) - asks for one unit
+//     "result"     unit ID, stop row, stopped flag, cache depth, image
+//                  width and height, compressed pixels, compressed color and
+//                  brightness data (TileCacheEncoding), statistics
+//     "heartbeat"  (none)
+//
+//   Coordinator to worker:
+//     "challenge"  random bytes (first message; nothing but "hello" is
+//                  accepted before it has been answered)
+//     "unit"       unit ID, parameters, cache depth, encoded color and
+//                  brightness cache data (may be empty)
+//     "wait"       (none) - no unit available right now
+//     "state"      run state (RUN_STATE_*, see FractalWorker)
+//
+// Addresses are "host:port" for TCP, anything else is the name of a local
+// (Unix domain) socket. Coordinators only accept workers from other
+// machines if they have a shared secret.
+
+#ifndef WORKQUEUEPROTOCOL_H
+#define WORKQUEUEPROTOCOL_H
+
+// Qt includes
+#include <QByteArray>
+#include <QIODevice>
+#include <QObject>
+#include <QString>
+
+// Workers send a heartbeat every second; the coordinator drops them when it
+// hasn't heard from them for a while
+#define HEARTBEAT_INTERVAL 1000
+#define HEARTBEAT_TIMEOUT 10000
+
+// Number of random bytes in a challenge
+#define CHALLENGE_SIZE 32
+
+// Class definition
+class WorkQueueProtocol
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+private:
+    // Default constructor (never to be called from outside)
+    WorkQueueProtocol();
+
+public:
+    // Destructor
+    virtual ~WorkQueueProtocol();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Check if an address is a TCP address, and split it
+    static bool IsTcpAddress(const QString & mcrAddress, QString & mrHost,
+        quint16 & mrPort);
+
+    // Send a message
+    static void WriteMessage(QIODevice * mpConnection,
+        const QString & mcrType, const QByteArray & mcrPayload = QByteArray());
+
+    // Read the next complete message (false if there is none yet)
+    static bool ReadMessage(QIODevice * mpConnection, QString & mrType,
+        QByteArray & mrPayload);
+
+    // Answer to a challenge of the coordinator
+    static QByteArray GetChallengeResponse(const QByteArray & mcrChallenge,
+        const QString & mcrSecret);
+};
+
+#endif
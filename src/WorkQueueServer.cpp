@@ -0,0 +1,657 @@
+// WorkQueueServer.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "Deploy.h"
+#include "FractalImage.h"
+#include "FractalWorker.h"
+#include "MessageLogger.h"
+#include "TileCacheEncoding.h"
+#include "WorkQueueProtocol.h"
+#include "WorkQueueServer.h"
+
+// Qt includes
+#include <QDataStream>
+#include <QHostAddress>
+#include <QImage>
+#include <QLocalSocket>
+#include <QRandomGenerator>
+#include <QSize>
+#include <QTcpSocket>
+#include <QVector>
+
+// System includes
+#include <algorithm>
+#include <cstring>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+WorkQueueServer::WorkQueueServer(FractalImage * mpFractalImage)
+{
+    CALL_IN(QString("mpFractalImage=%1")
+        .arg(CALL_SHOW(mpFractalImage)));
+
+    m_FractalImage = mpFractalImage;
+    m_Clock.start();
+
+    connect (&m_TcpServer, SIGNAL(newConnection()),
+        this, SLOT(NewTcpConnection()));
+    connect (&m_LocalServer, SIGNAL(newConnection()),
+        this, SLOT(NewLocalConnection()));
+    connect (&m_HeartbeatTimer, SIGNAL(timeout()),
+        this, SLOT(CheckHeartbeats()));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+WorkQueueServer::~WorkQueueServer()
+{
+    CALL_IN("");
+
+    Close();
+
+    CALL_OUT("");
+}
+
+
+
+// ============================================================ Everything else
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start listening
+bool WorkQueueServer::Listen(const QString & mcrAddress,
+    const QString & mcrSecret)
+{
+    CALL_IN(QString("mcrAddress=%1, mcrSecret=...")
+        .arg(CALL_SHOW(mcrAddress)));
+
+    // Workers stay connected if nothing changes
+    if (!m_Address.isEmpty() &&
+        m_Address == mcrAddress &&
+        m_Secret == mcrSecret)
+    {
+        CALL_OUT("Listening already");
+        return true;
+    }
+
+    Close();
+
+    QString host;
+    quint16 port;
+    if (WorkQueueProtocol::IsTcpAddress(mcrAddress, host, port))
+    {
+        // TCP (only this machine unless there is a host; "*" is all
+        // interfaces)
+        QHostAddress address(host);
+        if (host.isEmpty() ||
+            host == "localhost")
+        {
+            address = QHostAddress(QHostAddress::LocalHost);
+        } else if (host == "*")
+        {
+            address = QHostAddress(QHostAddress::Any);
+        }
+        if (address.isNull())
+        {
+            m_LastError = tr("\"%1\" is not a valid address to listen on.")
+                .arg(host);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+
+        // Anybody who can reach us would get our parameters and could send
+        // us pixels
+        if (!address.isLoopback() &&
+            mcrSecret.isEmpty())
+        {
+            m_LastError = tr("Listening on \"%1\" needs a shared secret for "
+                "the workers (Render:Work Queue Secret, or --secret).")
+                .arg(mcrAddress);
+            CALL_OUT(m_LastError);
+            return false;
+        }
+        if (!m_TcpServer.listen(address, port))
+        {
+            m_LastError = tr("Could not listen on \"%1\": %2")
+                .arg(mcrAddress,
+                     m_TcpServer.errorString());
+            CALL_OUT(m_LastError);
+            return false;
+        }
+    } else
+    {
+        // Local socket (a previous coordinator may have left its socket
+        // behind)
+        QLocalServer::removeServer(mcrAddress);
+        if (!m_LocalServer.listen(mcrAddress))
+        {
+            m_LastError = tr("Could not listen on \"%1\": %2")
+                .arg(mcrAddress,
+                     m_LocalServer.errorString());
+            CALL_OUT(m_LastError);
+            return false;
+        }
+    }
+    m_Address = mcrAddress;
+    m_Secret = mcrSecret;
+    m_HeartbeatTimer.start(HEARTBEAT_INTERVAL);
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Stop listening and drop all workers
+void WorkQueueServer::Close()
+{
+    CALL_IN("");
+
+    m_HeartbeatTimer.stop();
+    const QList < QIODevice * > connections = m_ConnectionToName.keys();
+    for (QIODevice * connection : connections)
+    {
+        DropConnection(connection);
+    }
+    m_TcpServer.close();
+    m_LocalServer.close();
+    m_Address.clear();
+    m_Secret.clear();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Address we're listening on
+QString WorkQueueServer::GetAddress() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_Address;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Status of connected workers
+QStringList WorkQueueServer::GetWorkerStatus() const
+{
+    CALL_IN("");
+
+    QStringList status;
+    for (auto connection_iterator = m_ConnectionToName.constBegin();
+         connection_iterator != m_ConnectionToName.constEnd();
+         connection_iterator++)
+    {
+        QIODevice * connection = connection_iterator.key();
+        status << tr("%1 (%2 threads): %3 units done, %4 running")
+            .arg(connection_iterator.value())
+            .arg(m_ConnectionToThreads[connection])
+            .arg(m_ConnectionToUnitsDone[connection])
+            .arg(m_ConnectionToUnitIDs[connection].size());
+    }
+    std::sort(status.begin(), status.end());
+
+    CALL_OUT("");
+    return status;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Last error
+QString WorkQueueServer::GetLastError() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return m_LastError;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if workers still have units
+bool WorkQueueServer::HasUnitsOut() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return !m_UnitIDToTileID.isEmpty();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if there are units of workers that went away
+bool WorkQueueServer::HasLostUnits() const
+{
+    CALL_IN("");
+    CALL_OUT("");
+    return !m_LostUnitIDToTileID.isEmpty();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Take a unit of a worker that went away
+bool WorkQueueServer::TakeLostUnit(int & mrTileID, int & mrRowMin,
+    int & mrRowMax)
+{
+    CALL_IN("mrTileID=..., mrRowMin=..., mrRowMax=...");
+
+    if (m_LostUnitIDToTileID.isEmpty())
+    {
+        CALL_OUT("No lost units");
+        return false;
+    }
+    const int lost_unit_id = *m_LostUnitIDToTileID.keyBegin();
+    mrTileID = m_LostUnitIDToTileID.take(lost_unit_id);
+    mrRowMin = m_LostUnitIDToRowMin.take(lost_unit_id);
+    mrRowMax = m_LostUnitIDToRowMax.take(lost_unit_id);
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Forget units that were lost
+QList < int > WorkQueueServer::DropLostUnits()
+{
+    CALL_IN("");
+
+    const QList < int > tile_ids = m_LostUnitIDToTileID.values();
+    m_LostUnitIDToTileID.clear();
+    m_LostUnitIDToRowMin.clear();
+    m_LostUnitIDToRowMax.clear();
+
+    CALL_OUT("");
+    return tile_ids;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Worker connected via TCP
+void WorkQueueServer::NewTcpConnection()
+{
+    CALL_IN("");
+
+    while (m_TcpServer.hasPendingConnections())
+    {
+        QTcpSocket * socket = m_TcpServer.nextPendingConnection();
+        connect (socket, SIGNAL(disconnected()),
+            this, SLOT(ConnectionClosed()));
+        AddConnection(socket);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Worker connected via local socket
+void WorkQueueServer::NewLocalConnection()
+{
+    CALL_IN("");
+
+    while (m_LocalServer.hasPendingConnections())
+    {
+        QLocalSocket * socket = m_LocalServer.nextPendingConnection();
+        connect (socket, SIGNAL(disconnected()),
+            this, SLOT(ConnectionClosed()));
+        AddConnection(socket);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Set up a new connection (worker isn't known until it says hello, and has
+// to answer our challenge in doing so)
+void WorkQueueServer::AddConnection(QIODevice * mpConnection)
+{
+    CALL_IN(QString("mpConnection=%1")
+        .arg(CALL_SHOW(mpConnection)));
+
+    connect (mpConnection, SIGNAL(readyRead()),
+        this, SLOT(ReadMessages()));
+    m_ConnectionToName[mpConnection] = tr("(unknown)");
+    m_ConnectionToThreads[mpConnection] = 0;
+    m_ConnectionToUnitIDs[mpConnection] = QSet < int >();
+    m_ConnectionToUnitsDone[mpConnection] = 0;
+    m_ConnectionToLastHeard[mpConnection] = m_Clock.elapsed();
+
+    // Challenge
+    QByteArray challenge(CHALLENGE_SIZE, 0);
+    for (int index = 0; index < CHALLENGE_SIZE; index++)
+    {
+        challenge[index] = char(QRandomGenerator::system() -> bounded(256));
+    }
+    m_ConnectionToChallenge[mpConnection] = challenge;
+    QByteArray payload;
+    QDataStream out_stream(&payload, QIODevice::WriteOnly);
+    out_stream << challenge;
+    WorkQueueProtocol::WriteMessage(mpConnection, "challenge", payload);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Message(s) from a worker
+void WorkQueueServer::ReadMessages()
+{
+    CALL_IN("");
+
+    QIODevice * connection = qobject_cast < QIODevice * >(sender());
+    if (!m_ConnectionToName.contains(connection))
+    {
+        CALL_OUT("Unknown connection");
+        return;
+    }
+
+    QString type;
+    QByteArray payload;
+    while (m_ConnectionToName.contains(connection) &&
+        WorkQueueProtocol::ReadMessage(connection, type, payload))
+    {
+        m_ConnectionToLastHeard[connection] = m_Clock.elapsed();
+        HandleMessage(connection, type, payload);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Handle a message from a worker
+void WorkQueueServer::HandleMessage(QIODevice * mpConnection,
+    const QString & mcrType, const QByteArray & mcrPayload)
+{
+    CALL_IN(QString("mpConnection=%1, mcrType=%2, mcrPayload=...")
+        .arg(CALL_SHOW(mpConnection),
+             CALL_SHOW(mcrType)));
+
+    QDataStream in_stream(mcrPayload);
+
+    // Worker introduces itself
+    if (mcrType == "hello")
+    {
+        quint32 version;
+        QString name;
+        qint32 threads;
+        QByteArray response;
+        in_stream >> version >> name >> threads;
+        if (version != WORK_QUEUE_VERSION)
+        {
+            const QString reason = tr("Worker \"%1\" speaks protocol "
+                "version %2, we speak %3.")
+                .arg(name)
+                .arg(version)
+                .arg(WORK_QUEUE_VERSION);
+            MessageLogger::Error(CALL_METHOD, reason);
+            DropConnection(mpConnection);
+            CALL_OUT(reason);
+            return;
+        }
+        in_stream >> response;
+        if (!m_ConnectionToChallenge.contains(mpConnection) ||
+            (!m_Secret.isEmpty() &&
+             response != WorkQueueProtocol::GetChallengeResponse(
+                m_ConnectionToChallenge[mpConnection], m_Secret)))
+        {
+            const QString reason = tr("Worker \"%1\" doesn't know the "
+                "secret; dropping it.").arg(name);
+            MessageLogger::Error(CALL_METHOD, reason);
+            DropConnection(mpConnection);
+            CALL_OUT(reason);
+            return;
+        }
+        m_ConnectionToChallenge.remove(mpConnection);
+        m_ConnectionToName[mpConnection] = name;
+        m_ConnectionToThreads[mpConnection] = threads;
+        CALL_OUT("");
+        return;
+    }
+
+    // Nothing else before the worker has introduced itself
+    if (m_ConnectionToChallenge.contains(mpConnection))
+    {
+        const QString reason = tr("Worker sent \"%1\" before saying hello; "
+            "dropping it.").arg(mcrType);
+        MessageLogger::Error(CALL_METHOD, reason);
+        DropConnection(mpConnection);
+        CALL_OUT(reason);
+        return;
+    }
+
+    // Worker is alive (and wants to know if it should pause or stop)
+    if (mcrType == "heartbeat")
+    {
+        QByteArray state;
+        QDataStream out_stream(&state, QIODevice::WriteOnly);
+        out_stream << qint32(m_FractalImage -> GetRunState());
+        WorkQueueProtocol::WriteMessage(mpConnection, "state", state);
+        CALL_OUT("");
+        return;
+    }
+
+    // Worker wants a unit
+    if (mcrType == "request")
+    {
+        int tile_id;
+        int row_min;
+        int row_max;
+        QHash < QString, QString > parameters;
+        QByteArray color_data;
+        QByteArray brightness_data;
+        int cache_depth = 0;
+        const int unit_id = m_FractalImage -> StartRemoteUnit(tile_id,
+            row_min, row_max, parameters, color_data, brightness_data,
+            cache_depth);
+        if (unit_id == -1)
+        {
+            WorkQueueProtocol::WriteMessage(mpConnection, "wait");
+            CALL_OUT("No work");
+            return;
+        }
+        m_ConnectionToUnitIDs[mpConnection] << unit_id;
+        m_UnitIDToTileID[unit_id] = tile_id;
+        m_UnitIDToRowMin[unit_id] = row_min;
+        m_UnitIDToRowMax[unit_id] = row_max;
+        QByteArray unit;
+        QDataStream out_stream(&unit, QIODevice::WriteOnly);
+        out_stream << qint32(unit_id) << parameters << qint32(cache_depth) <<
+            color_data << brightness_data;
+        WorkQueueProtocol::WriteMessage(mpConnection, "unit", unit);
+        CALL_OUT("");
+        return;
+    }
+
+    // Worker is done with a unit
+    if (mcrType == "result")
+    {
+        qint32 unit_id;
+        qint32 stop_row;
+        bool was_stopped;
+        qint32 cache_depth;
+        qint32 width;
+        qint32 height;
+        QByteArray pixels;
+        QByteArray color_data;
+        QByteArray brightness_data;
+        QHash < QString, QString > statistics;
+        in_stream >> unit_id >> stop_row >> was_stopped >> cache_depth >>
+            width >> height >> pixels >> color_data >> brightness_data >>
+            statistics;
+        pixels = qUncompress(pixels);
+        if (in_stream.status() != QDataStream::Ok ||
+            width <= 0 ||
+            height <= 0 ||
+            pixels.size() != qint64(width) * height * 4 ||
+            !m_ConnectionToUnitIDs[mpConnection].contains(unit_id))
+        {
+            const QString reason = tr("Worker \"%1\" sent a damaged result; "
+                "dropping it.").arg(m_ConnectionToName[mpConnection]);
+            MessageLogger::Error(CALL_METHOD, reason);
+            DropConnection(mpConnection);
+            CALL_OUT(reason);
+            return;
+        }
+
+        // Result has to fit the tile and rows of the unit (the unit is
+        // handed out again otherwise)
+        const int row_min = m_UnitIDToRowMin[unit_id];
+        const int row_max = m_UnitIDToRowMax[unit_id];
+        const QVector < double > color_values =
+            TileCacheEncoding::Decode(qUncompress(color_data));
+        const QVector < double > brightness_values =
+            TileCacheEncoding::Decode(qUncompress(brightness_data));
+        QSize tile_size;
+        int number_of_color_values = 0;
+        int number_of_brightness_values = 0;
+        if (!m_FractalImage -> GetTileSize(m_UnitIDToTileID[unit_id],
+                tile_size, number_of_color_values,
+                number_of_brightness_values) ||
+            width != tile_size.width() ||
+            height != tile_size.height() ||
+            stop_row < row_min ||
+            stop_row > row_max ||
+            color_values.size() != number_of_color_values ||
+            brightness_values.size() != number_of_brightness_values)
+        {
+            const QString reason = tr("Worker \"%1\" sent a result that "
+                "doesn't fit its unit; dropping it.")
+                .arg(m_ConnectionToName[mpConnection]);
+            MessageLogger::Error(CALL_METHOD, reason);
+            DropConnection(mpConnection);
+            CALL_OUT(reason);
+            return;
+        }
+
+        QImage image(width, height, QImage::Format_RGB32);
+        for (int row = 0; row < height; row++)
+        {
+            memcpy(image.scanLine(row), pixels.constData() + row * width * 4,
+                width * 4);
+        }
+        m_ConnectionToUnitIDs[mpConnection].remove(unit_id);
+        m_ConnectionToUnitsDone[mpConnection]++;
+        m_UnitIDToTileID.remove(unit_id);
+        m_UnitIDToRowMin.remove(unit_id);
+        m_UnitIDToRowMax.remove(unit_id);
+        m_FractalImage -> RemoteUnitFinished(unit_id, row_min, row_max, image,
+            stop_row, was_stopped, color_values, brightness_values,
+            cache_depth, statistics);
+        CALL_OUT("");
+        return;
+    }
+
+    // Don't know what to do with this
+    const QString reason = tr("Unknown message \"%1\" from worker \"%2\".")
+        .arg(mcrType,
+             m_ConnectionToName[mpConnection]);
+    MessageLogger::Error(CALL_METHOD, reason);
+
+    CALL_OUT(reason);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Worker disconnected
+void WorkQueueServer::ConnectionClosed()
+{
+    CALL_IN("");
+
+    QIODevice * connection = qobject_cast < QIODevice * >(sender());
+    DropConnection(connection);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Drop workers we haven't heard from for too long
+void WorkQueueServer::CheckHeartbeats()
+{
+    CALL_IN("");
+
+    const qint64 now = m_Clock.elapsed();
+    const QList < QIODevice * > connections = m_ConnectionToName.keys();
+    for (QIODevice * connection : connections)
+    {
+        if (now - m_ConnectionToLastHeard[connection] > HEARTBEAT_TIMEOUT)
+        {
+            const QString reason = tr("Worker \"%1\" hasn't sent a heartbeat "
+                "for %2 ms; dropping it.")
+                .arg(m_ConnectionToName[connection])
+                .arg(now - m_ConnectionToLastHeard[connection]);
+            MessageLogger::Error(CALL_METHOD, reason);
+            DropConnection(connection);
+        }
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Forget a worker (its units are handed out again)
+void WorkQueueServer::DropConnection(QIODevice * mpConnection)
+{
+    CALL_IN(QString("mpConnection=%1")
+        .arg(CALL_SHOW(mpConnection)));
+
+    if (!m_ConnectionToName.contains(mpConnection))
+    {
+        CALL_OUT("Unknown connection");
+        return;
+    }
+
+    // Forget it first (closing the connection may call us again)
+    const QSet < int > unit_ids = m_ConnectionToUnitIDs.take(mpConnection);
+    m_ConnectionToName.remove(mpConnection);
+    m_ConnectionToThreads.remove(mpConnection);
+    m_ConnectionToUnitsDone.remove(mpConnection);
+    m_ConnectionToLastHeard.remove(mpConnection);
+    m_ConnectionToChallenge.remove(mpConnection);
+    mpConnection -> disconnect(this);
+    mpConnection -> close();
+    mpConnection -> deleteLater();
+
+    // Somebody else has to do its work
+    for (const int unit_id : unit_ids)
+    {
+        m_LostUnitIDToTileID[unit_id] = m_UnitIDToTileID.take(unit_id);
+        m_LostUnitIDToRowMin[unit_id] = m_UnitIDToRowMin.take(unit_id);
+        m_LostUnitIDToRowMax[unit_id] = m_UnitIDToRowMax.take(unit_id);
+        m_FractalImage -> RemoteUnitLost(unit_id);
+    }
+
+    CALL_OUT("");
+}
@@ -0,0 +1,138 @@
+// WorkQueueServer.h
+// Class definition
+
+// Coordinator side of the work queue: worker processes (on this or other
+// machines) connect via TCP or a local socket and ask for units of the
+// render of a FractalImage, one at a time, so faster machines simply get
+// more of them. Workers that disconnect or stop sending heartbeats are
+// dropped, and the units they were working on are handed out again.
+// Workers have to prove they know the shared secret (if there is one)
+// before they get any work. See WorkQueueProtocol for the messages.
+
+#ifndef WORKQUEUESERVER_H
+#define WORKQUEUESERVER_H
+
+// Qt includes
+#include <QElapsedTimer>
+#include <QHash>
+#include <QIODevice>
+#include <QList>
+#include <QLocalServer>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTimer>
+
+// Forward declaration
+class FractalImage;
+
+// Class definition
+class WorkQueueServer
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    WorkQueueServer(FractalImage * mpFractalImage);
+
+    // Destructor
+    virtual ~WorkQueueServer();
+
+
+
+    // ======================================================== Everything else
+public:
+    // Start listening ("host:port" or name of a local socket; without a
+    // host, only on this machine) for workers knowing the secret (needed
+    // unless only local workers can connect)
+    bool Listen(const QString & mcrAddress, const QString & mcrSecret);
+
+    // Stop listening and drop all workers
+    void Close();
+
+    // Address we're listening on ("" if we aren't)
+    QString GetAddress() const;
+
+    // Status of connected workers (one entry per worker)
+    QStringList GetWorkerStatus() const;
+
+    // Last error
+    QString GetLastError() const;
+
+    // Check if workers still have units
+    bool HasUnitsOut() const;
+
+    // Units of workers that went away; they are handed out again before
+    // anything else, to local workers as well
+    bool HasLostUnits() const;
+    bool TakeLostUnit(int & mrTileID, int & mrRowMin, int & mrRowMax);
+
+    // Forget units that were lost (tile IDs they belonged to)
+    QList < int > DropLostUnits();
+
+private slots:
+    // Worker connected
+    void NewTcpConnection();
+    void NewLocalConnection();
+
+    // Message(s) from a worker
+    void ReadMessages();
+
+    // Worker disconnected
+    void ConnectionClosed();
+
+    // Drop workers we haven't heard from for too long
+    void CheckHeartbeats();
+
+private:
+    // Set up a new connection
+    void AddConnection(QIODevice * mpConnection);
+
+    // Handle a message from a worker
+    void HandleMessage(QIODevice * mpConnection, const QString & mcrType,
+        const QByteArray & mcrPayload);
+
+    // Forget a worker (its units are handed out again)
+    void DropConnection(QIODevice * mpConnection);
+
+    // Image being rendered
+    FractalImage * m_FractalImage;
+
+    // Servers
+    QTcpServer m_TcpServer;
+    QLocalServer m_LocalServer;
+    QString m_Address;
+    QString m_Secret;
+
+    // Workers (and the challenge sent to those that haven't said hello yet)
+    QHash < QIODevice *, QString > m_ConnectionToName;
+    QHash < QIODevice *, QByteArray > m_ConnectionToChallenge;
+    QHash < QIODevice *, int > m_ConnectionToThreads;
+    QHash < QIODevice *, QSet < int > > m_ConnectionToUnitIDs;
+    QHash < QIODevice *, int > m_ConnectionToUnitsDone;
+    QHash < QIODevice *, qint64 > m_ConnectionToLastHeard;
+
+    // Tile and rows of units that are out with workers, and of units of
+    // workers that went away
+    QHash < int, int > m_UnitIDToTileID;
+    QHash < int, int > m_UnitIDToRowMin;
+    QHash < int, int > m_UnitIDToRowMax;
+    QHash < int, int > m_LostUnitIDToTileID;
+    QHash < int, int > m_LostUnitIDToRowMin;
+    QHash < int, int > m_LostUnitIDToRowMax;
+
+    // Heartbeats
+    QTimer m_HeartbeatTimer;
+    QElapsedTimer m_Clock;
+
+    // Last error
+    QString m_LastError;
+};
+
+#endif
@@ -25,8 +25,21 @@ int main(int mNumParameters, char * mpParameter[])
     CALL_IN(QString("mNumParameters=%1, mpParameter={\"%2\"}")
         .arg(mNumParameters).arg(arg_values.join("\", \"")));
 
+    // Rendering and merging without GUI don't need a display
+    if (Application::IsHeadlessCommandLine(arg_values) &&
+        qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     // Handle command line parameters for GUI
     Application * app = Application::Instance(mNumParameters, mpParameter);
+    if (app -> IsHeadless())
+    {
+        const int result = app -> RunHeadless();
+        CALL_OUT("Headless");
+        return result;
+    }
     
     // Make sure main window is the active one
     MainWindow * main_window = MainWindow::Instance();